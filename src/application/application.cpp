@@ -1,29 +1,121 @@
 #include "application.h"
 
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <mutex>
 #include <thread>
 
 #include <imgui_impl_vulkan.h>
 #include <imgui_impl_glfw.h>
 
+#include <denoiser.h>
+#include <gltf.h>
+#include <image.h>
+#include <image_import.h>
+
 #include "gui.h"
 
-Application::Application() {
+static const ShaderBindingTableEntry sbtEntries[] = {
+    { .stage = SHADER_BINDING_TABLE_STAGE_RAYGEN, .generalShader = "raygen.spv" }
+};
+
+static double getMillisecondsSince(std::chrono::steady_clock::time_point start) {
+    const std::chrono::duration<double, std::milli> time = std::chrono::steady_clock::now() - start;
+    return time.count();
+}
+
+Application::Application() : headless(false) {
+    startTime = std::chrono::steady_clock::now();
+
     glfwInit();
 
+    // The font atlas isn't needed until the GUI is initialized, it's built while everything before that is created.
+    jobSystem.submit([this]() {
+        buildFontAtlas();
+    }, &fontAtlasJobCounter);
+
+    // Creating the instance loads the drivers, meanwhile the window is created on the main thread, where GLFW wants it.
+    JobCounter instanceJobCounter = 0;
+
+    jobSystem.submit([this]() {
+        const auto instanceStart = std::chrono::steady_clock::now();
+        instance = createInstance(false);
+        startupTimings.instanceTime = getMillisecondsSince(instanceStart);
+    }, &instanceJobCounter);
+
+    const auto windowStart = std::chrono::steady_clock::now();
     createWindow();
+    startupTimings.windowTime = getMillisecondsSince(windowStart);
+
+    jobSystem.wait(instanceJobCounter);
+
     createEngineResources();
     createGuiResources();
     forLackOfABetterName();
 }
 
+Application::Application(VkExtent2D extent, const DeviceSelection& deviceSelection) : headless(true), deviceSelection(deviceSelection) {
+    startTime = std::chrono::steady_clock::now();
+
+    // The renderer takes its extent from the surface capabilities, which hold nothing else without a surface.
+    surfaceCapabilities = {};
+    surfaceCapabilities.currentExtent = extent;
+
+    const auto instanceStart = std::chrono::steady_clock::now();
+    instance = createInstance(true);
+    startupTimings.instanceTime = getMillisecondsSince(instanceStart);
+
+    createEngineResources();
+    forLackOfABetterName();
+
+    // Batches trace every frame the same way, so they don't start until the deferred resources are ready too.
+    createDeferredResources();
+    jobSystem.wait(environmentMapJobCounter);
+    jobSystem.wait(lightTreeJobCounter);
+
+    samplingTables.update(device, bindlessTables, true);
+    renderer.setSamplingTables(samplingTables.sobolBufferIndex, samplingTables.blueNoiseImageIndex);
+}
+
 Application::~Application() {
+    project.close();
+
     renderer.waitIdle(device.logical);
+    frameCapture.destroy(device.logical, jobSystem);
     renderer.destroy(device.logical);
     shaderBindingTable.destroy(device.logical);
 
-    ImGui_ImplVulkan_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
+    for (Model& model : models) {
+        model.destroy(device.logical, bindlessTables, textureStreamer);
+    }
+
+    textureStreamer.destroy(device.logical, bindlessTables);
+    tlasBuilder.destroy(device.logical);
+
+    if (deferredResourcesCreated) {
+        jobSystem.wait(environmentMapJobCounter);
+        jobSystem.wait(lightTreeJobCounter);
+
+        environmentMap.destroy(device.logical, bindlessTables);
+        lightTree.destroy(device.logical);
+        samplingTables.destroy(device.logical, bindlessTables);
+    }
+
+    samplerCache.destroy(device.logical, bindlessTables);
+    bindlessTables.destroy(device.logical);
+
+    if (!headless) {
+        thumbnailCache.destroy(device.logical);
+
+        ImGui_ImplVulkan_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+
+        // The context only shares the atlas, it's not freed along with it.
+        IM_DELETE(fontAtlas);
+    }
 
     vkDestroyPipeline(device.logical, rayTracingPipeline, nullptr);
     vkDestroyPipelineLayout(device.logical, pipelineLayout, nullptr);
@@ -35,20 +127,40 @@ Application::~Application() {
     vkDestroySurfaceKHR(instance, surface, nullptr);
     vkDestroyInstance(instance, nullptr);
 
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    if (!headless) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
 }
 
 void Application::run() {
     VkExtent2D extent = surfaceCapabilities.currentExtent;
-    renderer.recordCommandBuffers(device.logical, pipelineLayout, rayTracingPipeline, shaderBindingTable, extent);
+    renderer.recordCommandBuffers(device.logical, pipelineLayout, rayTracingPipeline, shaderBindingTable, bindlessTables.descriptorSet);
 
     while (!glfwWindowShouldClose(window)) {
+        renderer.beginFrame();
         glfwPollEvents();
 
         renderGui(*this);
+        thumbnailCache.update(device);
+
+        updateFrame(extent);
+
+        const bool rendered = renderer.render(device, renderPass, extent, frameCapture);
+
+        if (startupTimings.firstFrameTime == 0.0) {
+            startupTimings.firstFrameTime = getMillisecondsSince(startTime);
+
+            fprintf(stderr, "First frame after %.1f ms: instance %.1f ms, window %.1f ms, device %.1f ms, pipeline %.1f ms, font atlas %.1f ms.\n",
+                    startupTimings.firstFrameTime, startupTimings.instanceTime, startupTimings.windowTime, startupTimings.deviceTime,
+                    startupTimings.pipelineTime, startupTimings.fontAtlasTime);
+
+            createDeferredResources();
+        }
+
+        if (!rendered || swapchainChanged) {
+            swapchainChanged = false;
 
-        if (!renderer.render(device, renderPass, extent)) {
             int width, height;
             glfwGetFramebufferSize(window, &width, &height);
 
@@ -62,43 +174,639 @@ void Application::run() {
             RendererCreateInfo rendererCreateInfo = getRendererCreateInfo();
             renderer.resize(device, rendererCreateInfo);
             extent = surfaceCapabilities.currentExtent;
-            renderer.recordCommandBuffers(device.logical, pipelineLayout, rayTracingPipeline, shaderBindingTable, extent);
+            renderer.recordCommandBuffers(device.logical, pipelineLayout, rayTracingPipeline, shaderBindingTable, bindlessTables.descriptorSet);
+        }
+    }
+}
+
+bool Application::renderBatch(const BatchRenderSettings& settings, FILE* report, BatchRenderStatistics* statistics) {
+    std::error_code error;
+    std::filesystem::create_directories(settings.outputDirectory, error);
+
+    if (error) {
+        return false;
+    }
+
+    VkExtent2D extent = surfaceCapabilities.currentExtent;
+    renderer.recordCommandBuffers(device.logical, pipelineLayout, rayTracingPipeline, shaderBindingTable, bindlessTables.descriptorSet);
+
+    frameCapture.format = settings.format;
+    frameCapture.exrCompression = settings.exrCompression;
+
+    struct FrameTimings {
+        double traceTime;
+        double submitTime;
+        uint32_t remainingSampleCount;
+    };
+
+    std::vector<FrameTimings> frameTimings(settings.lastFrame - settings.firstFrame + 1, { 0.0, 0.0, settings.sampleCount });
+
+    // A sample's trace time is read back once its frame index comes around again, until then it's remembered here.
+    struct PendingSample {
+        uint32_t frame;
+        uint32_t frameIndex;
+    };
+
+    std::deque<PendingSample> pendingSamples;
+
+    auto reportSample = [&](const PendingSample& sample) {
+        FrameTimings& timings = frameTimings[sample.frame - settings.firstFrame];
+        timings.traceTime += renderer.profiler.getTime(PROFILER_SECTION_TRACE);
+
+        if (--timings.remainingSampleCount == 0) {
+            fprintf(report, "{\"frame\": %u, \"samples\": %u, \"traceMs\": %.3f, \"submitMs\": %.3f}\n", sample.frame, settings.sampleCount,
+                    timings.traceTime, timings.submitTime);
+            fflush(report);
+        }
+    };
+
+    // Denoising and comparing to the reference need the pixels, so the captures are then handed back here and written
+    // by the batch instead. Frames are processed in order, so sequential frames denoise onto the history of the one
+    // before: whichever capture job finds the next frame read back processes it, along with those read back after it.
+    const bool processCaptures = settings.denoise || !settings.referenceDirectory.empty();
+
+    Denoiser denoiser;
+    std::mutex captureMutex;
+    std::unordered_map<uint64_t, uint32_t> capturedFrames;
+    std::map<uint32_t, std::vector<uint16_t>> readBackFrames;
+    uint32_t nextProcessedFrame = settings.firstFrame;
+    bool processing = false;
+    uint32_t writtenFrameCount = 0;
+    uint32_t failedFrameCount = 0;
+    uint32_t comparedFrameCount = 0;
+    double denoiseTime = 0.0;
+    double squaredErrorSum = 0.0;
+
+    // Called without the mutex held.
+    auto processFrame = [&](uint32_t frame, std::vector<uint16_t>& pixels, bool sequential) {
+        const size_t valueCount = 4 * (size_t)extent.width * extent.height;
+        double frameDenoiseTime = 0.0;
+
+        if (settings.denoise) {
+            const auto denoiseStart = std::chrono::steady_clock::now();
+
+            float* color = new float[valueCount];
+            float* denoised = new float[valueCount];
+            convertFromHalf(pixels.data(), valueCount, color);
+
+            const DenoiserFrame denoiserFrame = {
+                .width  = extent.width,
+                .height = extent.height,
+                .color  = color
+            };
+
+            denoiser.denoise(jobSystem, denoiserFrame, sequential, denoised);
+            convertToHalf(denoised, valueCount, pixels.data());
+
+            delete[] denoised;
+            delete[] color;
+
+            frameDenoiseTime = getMillisecondsSince(denoiseStart);
+        }
+
+        char name[32];
+        double squaredError = -1.0;
+
+        if (!settings.referenceDirectory.empty()) {
+            snprintf(name, sizeof(name), "frame_%05u.exr", frame);
+            squaredError = compareToReference(settings.referenceDirectory / name, extent, pixels.data());
+        }
+
+        snprintf(name, sizeof(name), "frame_%05u%s", frame, settings.format == CAPTURE_FORMAT_EXR ? ".exr" : ".png");
+
+        const bool written = writeCaptureFile(settings.outputDirectory / name, encodeCapture(jobSystem, settings.format, settings.exrCompression, extent, pixels.data(), 1.0f));
+
+        std::lock_guard<std::mutex> lock(captureMutex);
+        written ? ++writtenFrameCount : ++failedFrameCount;
+        denoiseTime += frameDenoiseTime;
+
+        if (squaredError >= 0.0) {
+            squaredErrorSum += squaredError;
+            ++comparedFrameCount;
+        }
+
+        fprintf(report, "{\"frame\": %u, \"denoiseMs\": %.3f, \"referenceMse\": %.9g, \"written\": %s}\n", frame, frameDenoiseTime, squaredError,
+                written ? "true" : "false");
+        fflush(report);
+    };
+
+    if (processCaptures) {
+        frameCapture.captureCallback = [&](uint64_t frameNumber, VkExtent2D, const uint16_t* pixels) {
+            std::unique_lock<std::mutex> lock(captureMutex);
+
+            const uint32_t frame = capturedFrames[frameNumber];
+            capturedFrames.erase(frameNumber);
+            readBackFrames[frame].assign(pixels, pixels + 4 * (size_t)extent.width * extent.height);
+
+            if (processing) {
+                return;
+            }
+
+            processing = true;
+
+            for (auto it = readBackFrames.find(nextProcessedFrame); it != readBackFrames.end(); it = readBackFrames.find(nextProcessedFrame)) {
+                std::vector<uint16_t> framePixels = std::move(it->second);
+                readBackFrames.erase(it);
+
+                const uint32_t processedFrame = nextProcessedFrame++;
+
+                lock.unlock();
+                processFrame(processedFrame, framePixels, processedFrame != settings.firstFrame);
+                lock.lock();
+            }
+
+            processing = false;
+        };
+    }
+
+    const auto batchStart = std::chrono::steady_clock::now();
+
+    for (uint32_t frame = settings.firstFrame; frame <= settings.lastFrame; ++frame) {
+        const auto frameStart = std::chrono::steady_clock::now();
+
+        for (uint32_t sample = 0; sample < settings.sampleCount; ++sample) {
+            updateFrame(extent);
+
+            // The last sample is captured. Waiting for a readback is what keeps a slow encoder from dropping frames,
+            // meanwhile the GPU works through the samples already submitted.
+            if (sample == settings.sampleCount - 1) {
+                while (!frameCapture.hasFreeReadback()) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    frameCapture.update(device.logical, jobSystem, renderer.getCompletedFrameCount(device.logical));
+                }
+
+                char name[32];
+                snprintf(name, sizeof(name), "frame_%05u", frame);
+
+                if (processCaptures) {
+                    std::lock_guard<std::mutex> lock(captureMutex);
+                    capturedFrames[renderer.getFrameNumber()] = frame;
+                }
+
+                frameCapture.requestCapture(settings.outputDirectory / name);
+            }
+
+            const uint32_t frameIndex = renderer.getFrameIndex();
+            HeadlessFrameInfo frameInfo = {
+                .tileOffset  = { 0, 0 },
+                .tileExtent  = extent,
+                .imageExtent = extent,
+                .firstSample = 0,
+                .sampleIndex = sample,
+                .sampleCount = settings.sampleCount
+            };
+
+            renderer.renderHeadless(device, frameInfo, frameCapture);
+
+            if (!pendingSamples.empty() && pendingSamples.front().frameIndex == frameIndex) {
+                reportSample(pendingSamples.front());
+                pendingSamples.pop_front();
+            }
+
+            pendingSamples.push_back({ frame, frameIndex });
+        }
+
+        const std::chrono::duration<double, std::milli> submitTime = std::chrono::steady_clock::now() - frameStart;
+        frameTimings[frame - settings.firstFrame].submitTime = submitTime.count();
+    }
+
+    renderer.waitIdle(device.logical);
+
+    for (const PendingSample& sample : pendingSamples) {
+        renderer.profiler.collect(device.logical, sample.frameIndex);
+        reportSample(sample);
+    }
+
+    frameCapture.flush(device.logical, jobSystem);
+    frameCapture.captureCallback = nullptr;
+
+    // Frames are only left behind if one before them never came back, they can't continue its history.
+    for (auto& [frame, pixels] : readBackFrames) {
+        processFrame(frame, pixels, false);
+    }
+
+    if (!processCaptures) {
+        writtenFrameCount = frameCapture.writtenFrameCount.exchange(0);
+        failedFrameCount = frameCapture.failedFrameCount.exchange(0);
+    }
+
+    const double totalTime = getMillisecondsSince(batchStart);
+
+    fprintf(report, "{\"frames\": %u, \"written\": %u, \"failed\": %u, \"totalMs\": %.3f}\n", (uint32_t)frameTimings.size(), writtenFrameCount,
+            failedFrameCount, totalTime);
+    fflush(report);
+
+    if (statistics != nullptr) {
+        statistics->totalTime = totalTime;
+        statistics->denoiseTime = denoiseTime;
+        statistics->meanSquaredError = comparedFrameCount > 0 ? squaredErrorSum / comparedFrameCount : -1.0;
+    }
+
+    return failedFrameCount == 0;
+}
+
+bool Application::compareDenoiser(const BatchRenderSettings& settings, uint32_t referenceSampleCount, FILE* report) {
+    BatchRenderSettings batch = settings;
+
+    if (batch.referenceDirectory.empty()) {
+        batch.outputDirectory = settings.outputDirectory / "Reference";
+        batch.sampleCount = referenceSampleCount;
+        batch.format = CAPTURE_FORMAT_EXR;
+        batch.denoise = false;
+
+        if (!renderBatch(batch, report)) {
+            return false;
+        }
+
+        batch.referenceDirectory = batch.outputDirectory;
+        batch.format = settings.format;
+    }
+
+    BatchRenderStatistics denoised;
+    batch.outputDirectory = settings.outputDirectory / "Denoised";
+    batch.sampleCount = settings.sampleCount;
+    batch.denoise = true;
+
+    if (!renderBatch(batch, report, &denoised)) {
+        return false;
+    }
+
+    BatchRenderStatistics undenoised;
+    batch.outputDirectory = settings.outputDirectory / "Undenoised";
+    batch.denoise = false;
+
+    if (!renderBatch(batch, report, &undenoised)) {
+        return false;
+    }
+
+    // A batch takes about as long per sample at any sample count, once the first frame is under way.
+    BatchRenderStatistics equalTime;
+    batch.outputDirectory = settings.outputDirectory / "EqualTime";
+    batch.sampleCount = std::max((uint32_t)(settings.sampleCount * denoised.totalTime / undenoised.totalTime + 0.5), settings.sampleCount);
+
+    if (!renderBatch(batch, report, &equalTime)) {
+        return false;
+    }
+
+    fprintf(report,
+            "{\"comparison\": \"denoiser\", \"samples\": %u, \"denoisedMs\": %.3f, \"denoiseMs\": %.3f, \"denoisedMse\": %.9g, \"undenoisedMs\": %.3f, "
+            "\"undenoisedMse\": %.9g, \"equalTimeSamples\": %u, \"equalTimeMs\": %.3f, \"equalTimeMse\": %.9g}\n",
+            settings.sampleCount, denoised.totalTime, denoised.denoiseTime, denoised.meanSquaredError, undenoised.totalTime,
+            undenoised.meanSquaredError, batch.sampleCount, equalTime.totalTime, equalTime.meanSquaredError);
+    fflush(report);
+
+    return true;
+}
+
+void Application::createProject(const std::filesystem::path& path) {
+    project.close();
+    project = Project(path);
+
+    loadProjectResources();
+}
+
+bool Application::openProject(const std::filesystem::path& path) {
+    if (!project.open(path)) {
+        return false;
+    }
+
+    loadProjectResources();
+
+    // Scenes whose source is gone are skipped, they are still in the project if it comes back.
+    for (const AssetGuid& guid : project.getScene()) {
+        const ProjectAsset* asset = project.findAsset(guid);
+
+        if (asset != nullptr) {
+            loadScene(project.getAssetPath(*asset));
+        }
+    }
+
+    return true;
+}
+
+bool Application::importScene(const std::filesystem::path& path) {
+    if (!loadScene(path)) {
+        return false;
+    }
+
+    project.addToScene(project.getAssetGuid(path, ASSET_TYPE_SCENE));
+
+    return true;
+}
+
+void Application::updateFrame(VkExtent2D extent) {
+    scene.updateWorldTransforms(jobSystem);
+
+    // There's no camera yet, LODs are selected for a view from the origin with a 60 degree vertical field of view.
+    const LodView lodView = {
+        .position        = { 0.0f, 0.0f, 0.0f },
+        .pixelsPerRadian = extent.height / 1.0472f
+    };
+
+    VkAccelerationStructureInstanceKHR* instances = tlasBuilder.getInstances(device.logical);
+    const uint32_t movedInstanceCount = scene.updateInstanceTransforms(jobSystem, instances);
+    const uint32_t changedInstanceCount = movedInstanceCount + lodSelector.update(jobSystem, scene, lodView, instances);
+
+    if (changedInstanceCount > 0) {
+        tlasBuilder.markInstancesChanged();
+    }
+
+    tlasBuilder.build(device);
+
+    // Lights follow their instances, only those that moved get new bounds and the tree is only refit for them.
+    if (movedInstanceCount > 0) {
+        for (uint32_t i = 0; i < meshLights.size(); ++i) {
+            const MeshLight& meshLight = meshLights[i];
+
+            if (scene.isWorldTransformChanged(meshLight.entity)) {
+                lightTree.setLight(i, getMeshLightBounds(models[meshLight.model].meshes[meshLight.mesh], scene.getWorldTransform(meshLight.entity)));
+            }
+        }
+    }
+
+    // Stream textures based on what the frame that last used these resources sampled. Without texture feedback there's
+    // only work to do when textures were added or removed.
+    if (renderer.hasTextureFeedback() || textureStreamer.needsUpdate()) {
+        renderer.waitForFrame(device.logical);
+
+        const uint32_t* feedback = renderer.hasTextureFeedback() ? renderer.getTextureFeedback() : nullptr;
+        textureStreamer.update(device, bindlessTables, feedback, renderer.getTextureTable());
+    }
+
+    // Frames go without the sampling tables until they've been loaded or generated.
+    if (deferredResourcesCreated && samplingTables.update(device, bindlessTables)) {
+        renderer.setSamplingTables(samplingTables.sobolBufferIndex, samplingTables.blueNoiseImageIndex);
+    }
+
+    if (isEnvironmentMapReady() && environmentMap.update(device, bindlessTables)) {
+        renderer.setEnvironmentTable(environmentMap.tableAddress);
+    }
+
+    // The light tree writes the buffer of the frame that last used these resources as well, but only once lights
+    // changed.
+    if (isLightTreeReady() && lightTree.needsUpdate()) {
+        renderer.waitForFrame(device.logical);
+        lightTree.update(device, jobSystem);
+    }
+
+    // Hand the captures of finished frames to the encoder, without waiting for the ones still in flight.
+    frameCapture.update(device.logical, jobSystem, renderer.getCompletedFrameCount(device.logical));
+}
+
+bool Application::isEnvironmentMapReady() {
+    return deferredResourcesCreated && environmentMapJobCounter == 0;
+}
+
+bool Application::isLightTreeReady() {
+    return deferredResourcesCreated && lightTreeJobCounter == 0;
+}
+
+bool Application::loadScene(const std::filesystem::path& path) {
+    // Scenes are only opened from the GUI or by batches, after the light tree has been started.
+    jobSystem.wait(lightTreeJobCounter);
+
+    std::filesystem::path cookedPath = project.getCookedAssetPath(path);
+
+    // Only cook the scene again if the source has changed since the last time.
+    std::error_code error;
+    std::filesystem::create_directories(cookedPath.parent_path(), error);
+
+    bool cooked = std::filesystem::exists(cookedPath, error) &&
+                  std::filesystem::last_write_time(cookedPath, error) >= std::filesystem::last_write_time(path, error);
+
+    Model model;
+
+    if (!cooked || !loadCookedAsset(device, jobSystem, bindlessTables, textureStreamer, samplerCache, cookedPath, model)) {
+        // Files cooked by an older version are rejected by the loader and cooked again.
+        if (!cookGltf(jobSystem, project.textureImportSettings, path, cookedPath) || !loadCookedAsset(device, jobSystem, bindlessTables, textureStreamer, samplerCache, cookedPath, model)) {
+            return false;
+        }
+    }
+
+    // Every mesh's LOD chain is registered once, whatever the number of nodes that instance it.
+    uint32_t* lodMeshes = new uint32_t[model.meshCount];
+
+    for (uint32_t i = 0; i < model.meshCount; ++i) {
+        lodMeshes[i] = lodSelector.addMesh(model, i);
+    }
+
+    // Nodes are sorted so that parents come first, their entities always exist by the time a child needs them.
+    uint32_t* nodeEntities = new uint32_t[model.nodeCount];
+
+    static const float identity[16] = { 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f };
+
+    for (uint32_t i = 0; i < model.nodeCount; ++i) {
+        const ModelNode& node = model.nodes[i];
+        nodeEntities[i] = scene.addEntity(node.parent >= 0 ? nodeEntities[node.parent] : SCENE_INVALID_ENTITY, node.transform);
+
+        // Every mesh the node references becomes an instance of one of the mesh's BLASes, nodes that share a mesh share
+        // its BLASes. Instances start out with the finest LOD, their custom index numbers it across every loaded model.
+        for (uint32_t j = 0; j < node.meshCount; ++j) {
+            const uint32_t meshIndex = node.firstMesh + j;
+            const uint32_t entity = node.meshCount == 1 ? nodeEntities[i] : scene.addEntity(nodeEntities[i], identity);
+
+            InstanceDescription instanceDescription = {
+                .blasAddress     = model.lods[model.meshes[meshIndex].firstLod].blas.deviceAddress,
+                .customIndex     = lodSelector.getFirstLod(lodMeshes[meshIndex]),
+                .sbtRecordOffset = 0,
+                .mask            = 1,
+                .flags           = 0
+            };
+
+            const uint32_t instance = tlasBuilder.addInstance(device, instanceDescription);
+
+            scene.setInstance(entity, instance);
+            lodSelector.addInstance(lodMeshes[meshIndex], entity, instance);
+
+            // Emissive instances become lights, their bounds are set once their world transform is known.
+            if (model.meshes[meshIndex].emittedPower > 0.0f) {
+                meshLights.push_back({ entity, (uint32_t)models.size(), meshIndex });
+                lightTree.addLight({});
+            }
+        }
+    }
+
+    delete[] nodeEntities;
+    delete[] lodMeshes;
+
+    models.push_back(model);
+
+    return true;
+}
+
+void Application::loadProjectImages() {
+    for (uint32_t slot : imageTextureSlots) {
+        textureStreamer.removeTexture(slot);
+    }
+
+    imageTextureSlots.clear();
+
+    std::filesystem::path imagesDirectoryPath = project.getAssetsDirectoryPath() / "Images";
+    std::filesystem::path cookedImagesDirectoryPath = project.getCookedDirectoryPath() / "Images";
+
+    std::error_code error;
+    std::filesystem::create_directories(cookedImagesDirectoryPath, error);
+
+    for (const auto& entry : std::filesystem::directory_iterator(imagesDirectoryPath, error)) {
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+
+        std::filesystem::path cookedPath = cookedImagesDirectoryPath / entry.path().stem();
+        cookedPath += COOKED_ASSET_EXTENSION;
+
+        bool cooked = std::filesystem::exists(cookedPath, error) &&
+                      std::filesystem::last_write_time(cookedPath, error) >= entry.last_write_time(error);
+
+        uint32_t slot = cooked ? loadCookedImage(device, bindlessTables, textureStreamer, cookedPath) : BINDLESS_INVALID_INDEX;
+
+        if (slot == BINDLESS_INVALID_INDEX && cookImage(jobSystem, project.textureImportSettings, entry.path(), cookedPath)) {
+            slot = loadCookedImage(device, bindlessTables, textureStreamer, cookedPath);
+        }
+
+        if (slot != BINDLESS_INVALID_INDEX) {
+            imageTextureSlots.push_back(slot);
         }
+
+        project.getAssetGuid(entry.path(), ASSET_TYPE_IMAGE);
     }
 }
 
+void Application::loadProjectSamplers() {
+    projectSamplers.clear();
+
+    std::filesystem::path samplersDirectoryPath = project.getAssetsDirectoryPath() / "Samplers";
+
+    std::error_code error;
+
+    for (const auto& entry : std::filesystem::directory_iterator(samplersDirectoryPath, error)) {
+        if (!entry.is_regular_file() || entry.path().extension() != SAMPLER_ASSET_EXTENSION) {
+            continue;
+        }
+
+        // Samplers are cheap to create, so the assets are read as they are instead of being cooked.
+        SamplerDescription description;
+
+        if (readSamplerAsset(entry.path(), description)) {
+            projectSamplers[entry.path().stem().string()] = samplerCache.getSampler(device, bindlessTables, description);
+        }
+
+        project.getAssetGuid(entry.path(), ASSET_TYPE_SAMPLER);
+    }
+}
+
+void Application::loadProjectResources() {
+    loadProjectImages();
+    loadProjectSamplers();
+
+    assetIndex.open(project.getAssetsDirectoryPath());
+    if (!headless) {
+        thumbnailCache.open(project.path, project.getCookedDirectoryPath());
+    }
+
+    frameCapture.directory = project.getCapturesDirectoryPath();
+}
+
 void Application::createWindow() {
     glfwWindowHint(GLFW_MAXIMIZED, GLFW_TRUE);
     glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
     window = glfwCreateWindow(1600, 900, "Vortex", nullptr, nullptr);
 }
 
+void Application::buildFontAtlas() {
+    const auto fontAtlasStart = std::chrono::steady_clock::now();
+
+    fontAtlas = IM_NEW(ImFontAtlas);
+    fontAtlas->AddFontFromFileTTF("../res/fonts/Ubuntu-Regular.ttf", 13.0f);
+
+    // The backend uploads the atlas as RGBA, converting it here leaves the first frame nothing to do but the upload.
+    unsigned char* pixels;
+    int width, height;
+    fontAtlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    startupTimings.fontAtlasTime = getMillisecondsSince(fontAtlasStart);
+}
+
 void Application::createEngineResources() {
-    instance = createInstance();
-    glfwCreateWindowSurface(instance, window, nullptr, &surface);
-    device = Device(instance, surface);
+    const auto deviceStart = std::chrono::steady_clock::now();
+
+    if (!headless) {
+        glfwCreateWindowSurface(instance, window, nullptr, &surface);
+    }
+
+    device = Device(instance, surface, deviceSelection);
     loadFunctionPointers(device.logical);
-    surfaceFormat = device.getSurfaceFormat(surface);
-    renderPass = createRenderPass(device.logical, surfaceFormat.format, false);
-    guiDescriptorPool = createGuiDescriptorPool(device.logical);
+
+    startupTimings.deviceTime = getMillisecondsSince(deviceStart);
+
+    // Headless applications don't present or draw the GUI.
+    if (!headless) {
+        surfaceFormat = device.getSurfaceFormat(surface);
+        renderPass = createRenderPass(device.logical, surfaceFormat.format, false);
+        guiDescriptorPool = createGuiDescriptorPool(device.logical);
+    }
+
+    // The bindless tables come first, the renderer's post-processing reads from them.
+    bindlessTables = BindlessTables(device.logical);
 
     RendererCreateInfo rendererCreateInfo = getRendererCreateInfo();
     renderer = Renderer(device, rendererCreateInfo);
 
-    pipelineLayout = createPipelineLayout(device.logical, 1, &renderer.descriptorSetLayout);
-
-    ShaderBindingTableEntry sbtEntries[] = {
-        { .stage = SHADER_BINDING_TABLE_STAGE_RAYGEN, .generalShader = "raygen.spv" }
-    };
+    // The pipeline is compiled on the job system while the rest is created.
+    VkDescriptorSetLayout setLayouts[] = { renderer.descriptorSetLayout, bindlessTables.descriptorSetLayout };
+    pipelineLayout = createPipelineLayout(device.logical, ARRAY_SIZE(setLayouts), setLayouts);
 
     const uint32_t sbtEntryCount = ARRAY_SIZE(sbtEntries);
+    JobCounter pipelineJobCounter = 0;
+
+    jobSystem.submit([this, sbtEntryCount]() {
+        const auto pipelineStart = std::chrono::steady_clock::now();
+        rayTracingPipeline = createRayTracingPipeline(device.logical, sbtEntryCount, sbtEntries, pipelineLayout);
+        startupTimings.pipelineTime = getMillisecondsSince(pipelineStart);
+    }, &pipelineJobCounter);
+
+    // The texture streamer and TLAS builder only create objects on the device too, each on a job of its own. The sampler
+    // cache writes to the bindless tables, which aren't safe to share, so it stays here.
+    const uint32_t framesInFlight = rendererCreateInfo.framesInFlight;
+    JobCounter textureStreamerJobCounter = 0;
+    JobCounter tlasBuilderJobCounter = 0;
+
+    jobSystem.submit([this, framesInFlight]() {
+        textureStreamer = TextureStreamer(device, framesInFlight);
+    }, &textureStreamerJobCounter);
+
+    jobSystem.submit([this]() {
+        tlasBuilder = TlasBuilder(device, 1024);
+    }, &tlasBuilderJobCounter);
 
-    rayTracingPipeline = createRayTracingPipeline(device.logical, sbtEntryCount, sbtEntries, pipelineLayout);
+    samplerCache = SamplerCache(device, bindlessTables);
     shaderBindingTable = ShaderBindingTable(device, sbtEntryCount, sbtEntries);
+
+    jobSystem.wait(textureStreamerJobCounter);
+    jobSystem.wait(tlasBuilderJobCounter);
+    jobSystem.wait(pipelineJobCounter);
+}
+
+void Application::createDeferredResources() {
+    const uint32_t framesInFlight = renderer.getFramesInFlight();
+
+    jobSystem.submit([this, framesInFlight]() {
+        environmentMap = EnvironmentMap(device, jobSystem, framesInFlight);
+    }, &environmentMapJobCounter);
+
+    jobSystem.submit([this, framesInFlight]() {
+        lightTree = LightTree(device, framesInFlight);
+    }, &lightTreeJobCounter);
+
+    // The sampling tables are generated in the background when they aren't cached yet, updateFrame uploads them once
+    // they're done.
+    samplingTables = SamplingTables(jobSystem, "sampling_tables.bin");
+    deferredResourcesCreated = true;
 }
 
 void Application::createGuiResources() {
-    ImGui::CreateContext();
+    jobSystem.wait(fontAtlasJobCounter);
+    ImGui::CreateContext(fontAtlas);
 
     ImGui_ImplGlfw_InitForVulkan(window, true);
 
@@ -123,8 +831,7 @@ void Application::createGuiResources() {
 
     ImGui_ImplVulkan_Init(&initInfo);
 
-    ImGuiIO& io = ImGui::GetIO();
-    io.Fonts->AddFontFromFileTTF("../res/fonts/Ubuntu-Regular.ttf", 13.0f);
+    thumbnailCache = ThumbnailCache(device, jobSystem);
 }
 
 void Application::forLackOfABetterName() {
@@ -135,9 +842,9 @@ void Application::forLackOfABetterName() {
                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
 
     {
-        void* data;
-        vkMapMemory(device.logical, stagingBuffer.memory, 0, sbtSize, 0, &data);
-        vkGetRayTracingShaderGroupHandles(device.logical, rayTracingPipeline, 0, 1, sbtSize, data);
+        uint8_t* data;
+        vkMapMemory(device.logical, stagingBuffer.memory, 0, sbtSize, 0, (void**)&data);
+        shaderBindingTable.writeRecords(device, rayTracingPipeline, ARRAY_SIZE(sbtEntries), sbtEntries, data);
         vkUnmapMemory(device.logical, stagingBuffer.memory);
     }
 
@@ -250,14 +957,18 @@ void Application::forLackOfABetterName() {
 }
 
 RendererCreateInfo Application::getRendererCreateInfo() {
-    surfaceCapabilities = device.getSurfaceCapabilities(surface, window);
+    if (!headless) {
+        surfaceCapabilities = device.getSurfaceCapabilities(surface, window, swapchainImageCount);
+    }
 
     RendererCreateInfo rendererCreateInfo = {
-        .surface             = surface,
-        .surfaceCapabilities = &surfaceCapabilities,
-        .surfaceFormat       = surfaceFormat,
-        .renderPass          = renderPass,
-        .framesInFlight      = 2
+        .surface                     = surface,
+        .surfaceCapabilities         = &surfaceCapabilities,
+        .surfaceFormat               = surfaceFormat,
+        .renderPass                  = renderPass,
+        .bindlessDescriptorSetLayout = bindlessTables.descriptorSetLayout,
+        .framesInFlight              = 2,
+        .presentMode                 = presentMode
     };
 
     return rendererCreateInfo;
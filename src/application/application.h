@@ -1,35 +1,170 @@
 #pragma once
 
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
 #include <graphics.h>
+#include <bindless.h>
+#include <cooked_asset.h>
+#include <environment_map.h>
+#include <frame_capture.h>
+#include <image_import.h>
+#include <light_tree.h>
+#include <lod_selector.h>
+#include <sampling.h>
+#include <sampler_cache.h>
+#include <scene.h>
+#include <texture_streaming.h>
+#include <tlas_builder.h>
+#include "asset_index.h"
 #include "project.h"
+#include "thumbnail_cache.h"
+
+// Renders the frames from firstFrame to lastFrame of the project's scene into the output directory, each one averaging
+// sampleCount traced samples. Denoised frames go through the host denoiser before they're encoded. With a reference
+// directory, every frame is compared to the EXR of the same name in it, a render of the frame that has converged.
+struct BatchRenderSettings {
+    std::filesystem::path outputDirectory;
+    uint32_t firstFrame;
+    uint32_t lastFrame;
+    uint32_t sampleCount;
+    CaptureFormat format;
+    ExrCompression exrCompression;
+    bool denoise = false;
+    std::filesystem::path referenceDirectory;
+};
+
+// How long a batch took and spent denoising, in milliseconds, and the mean of its frames' squared errors against the
+// reference, negative without one.
+struct BatchRenderStatistics {
+    double totalTime;
+    double denoiseTime;
+    double meanSquaredError;
+};
+
+// How long each stage of startup took, in milliseconds. The instance and the window, and the ray tracing pipeline and
+// the font atlas, are created side by side, so stages overlap. The first frame is timed from the start of the
+// constructor to the first frame's submission.
+struct StartupTimings {
+    double instanceTime;
+    double windowTime;
+    double deviceTime;
+    double pipelineTime;
+    double fontAtlasTime;
+    double firstFrameTime;
+};
 
 class Application {
 public:
     Project project;
+    AssetIndex assetIndex;
+    ThumbnailCache thumbnailCache;
+    Renderer renderer;
+    TextureStreamer textureStreamer;
+    EnvironmentMap environmentMap;
+    std::vector<Model> models;
+    Scene scene;
+    TlasBuilder tlasBuilder;
+    LodSelector lodSelector;
+    LightTree lightTree;
+    std::vector<uint32_t> imageTextureSlots;
+    SamplerCache samplerCache;
+    SamplingTables samplingTables;
+    std::unordered_map<std::string, uint32_t> projectSamplers;
+    FrameCapture frameCapture;
+    StartupTimings startupTimings = {};
+
+    // The swapchain is recreated with these at the start of the next frame once they are marked as changed, the device
+    // is kept.
+    VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+    uint32_t swapchainImageCount = 3;
+    bool swapchainChanged = false;
 
     Application();
+
+    // Headless applications have no window and no GUI, they trace at the given extent and only render batches.
+    Application(VkExtent2D extent, const DeviceSelection& deviceSelection = {});
     ~Application();
 
     void run();
 
+    // Keeps the GPU busy through the whole batch: the samples of the next frame are traced while earlier frames are
+    // read back and encoded. A JSON object with the timings of every frame is written as a line to the report.
+    bool renderBatch(const BatchRenderSettings& settings, FILE* report, BatchRenderStatistics* statistics = nullptr);
+
+    // Weighs denoising against tracing more samples in the same wall-clock time. The batch is rendered denoised, then
+    // without denoising at the same sample count, and at the sample count that takes as long as the denoised render,
+    // scaled from the first two. Every render is compared to the reference, which is rendered first at
+    // referenceSampleCount samples without a reference directory. Each render goes to a directory of its own in the
+    // output directory, and the report ends with a line that compares them.
+    bool compareDenoiser(const BatchRenderSettings& settings, uint32_t referenceSampleCount, FILE* report);
+
+    // Traces the tasks a coordinator listening on the port hands out until it says to quit, see tile_render.h. Returns
+    // false if the connection is lost.
+    bool runTileWorker(uint16_t port);
+
+    // The environment map and light tree are created after the first frame, each on a job of its own, and can't be used
+    // until it's done.
+    bool isEnvironmentMapReady();
+    bool isLightTreeReady();
+
+    void createProject(const std::filesystem::path& path);
+    bool openProject(const std::filesystem::path& path);
+
+    bool importScene(const std::filesystem::path& path);
+    void loadProjectImages();
+    void loadProjectSamplers();
+
 private:
-    GLFWwindow* window;
+    bool headless;
+    DeviceSelection deviceSelection;
+    GLFWwindow* window = nullptr;
     VkInstance instance;
-    VkSurfaceKHR surface;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
     Device device;
     VkSurfaceCapabilitiesKHR surfaceCapabilities;
     VkSurfaceFormatKHR surfaceFormat;
-    VkRenderPass renderPass;
-    VkDescriptorPool guiDescriptorPool;
-    Renderer renderer;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkDescriptorPool guiDescriptorPool = VK_NULL_HANDLE;
+    JobSystem jobSystem;
+    std::chrono::steady_clock::time_point startTime;
+    ImFontAtlas* fontAtlas = nullptr;
+    JobCounter fontAtlasJobCounter = 0;
+    BindlessTables bindlessTables;
     VkPipelineLayout pipelineLayout;
     VkPipeline rayTracingPipeline;
     ShaderBindingTable shaderBindingTable;
+    bool deferredResourcesCreated = false;
+    JobCounter environmentMapJobCounter = 0;
+    JobCounter lightTreeJobCounter = 0;
+
+    // The instances of emissive meshes, in the order of their lights in the light tree.
+    struct MeshLight {
+        uint32_t entity;
+        uint32_t model;
+        uint32_t mesh;
+    };
+
+    std::vector<MeshLight> meshLights;
 
     void createWindow();
+    void buildFontAtlas();
     void createEngineResources();
+
+    // Starts creating what the first frame doesn't need: the environment map, the light tree and the sampling tables.
+    void createDeferredResources();
     void createGuiResources();
     void forLackOfABetterName();
 
+    // Updates the scene and the resources the next frame reads.
+    void updateFrame(VkExtent2D extent);
+
+    bool loadScene(const std::filesystem::path& path);
+    void loadProjectResources();
+
     RendererCreateInfo getRendererCreateInfo();
 };
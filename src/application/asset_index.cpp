@@ -0,0 +1,294 @@
+#include "asset_index.h"
+
+#include <algorithm>
+#include <chrono>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Notifications tend to come in bursts, so a snapshot is only published once none arrived for this long.
+static const int debounceTime = 100;
+
+// How often the tree is scanned again where there are no notifications.
+static const int rescanInterval = 2000;
+
+static std::string getChildPath(const std::string& relativePath, const std::string& name) {
+    return relativePath.empty() ? name : relativePath + "/" + name;
+}
+
+uint32_t AssetIndexSnapshot::find(const std::filesystem::path& path) const {
+    auto it = entryIndices.find(path.generic_string());
+    return it != entryIndices.end() ? it->second : ASSET_INDEX_INVALID_ENTRY;
+}
+
+AssetIndex::AssetIndex() : running(false), version(0), notifier(-1) {
+    snapshot = std::make_shared<AssetIndexSnapshot>();
+}
+
+AssetIndex::~AssetIndex() {
+    close();
+}
+
+void AssetIndex::open(const std::filesystem::path& root) {
+    close();
+
+    this->root = root;
+    running = true;
+    thread = std::thread(&AssetIndex::threadMain, this);
+}
+
+void AssetIndex::close() {
+    if (!thread.joinable()) {
+        return;
+    }
+
+    running = false;
+    thread.join();
+
+    directories.clear();
+    watchedDirectories.clear();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    snapshot = std::make_shared<AssetIndexSnapshot>();
+}
+
+std::shared_ptr<const AssetIndexSnapshot> AssetIndex::getSnapshot() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return snapshot;
+}
+
+void AssetIndex::threadMain() {
+#ifdef __linux__
+    notifier = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+
+    scanDirectory("", true);
+    publishSnapshot();
+
+#ifdef __linux__
+    if (notifier >= 0) {
+        // Only the directories that changed are scanned again, unless the kernel dropped events.
+        std::unordered_set<std::string> changedDirectories;
+        bool overflowed = false;
+
+        alignas(inotify_event) char buffer[16384];
+
+        while (running) {
+            pollfd pollFd = { notifier, POLLIN, 0 };
+            const bool pending = overflowed || !changedDirectories.empty();
+
+            if (poll(&pollFd, 1, pending ? debounceTime : 250) > 0) {
+                ssize_t size;
+
+                while ((size = read(notifier, buffer, sizeof(buffer))) > 0) {
+                    for (char* event = buffer; event < buffer + size;) {
+                        const inotify_event& notification = *(const inotify_event*)event;
+
+                        auto it = watchedDirectories.find(notification.wd);
+
+                        if (notification.mask & IN_Q_OVERFLOW) {
+                            overflowed = true;
+                        } else if (it != watchedDirectories.end() && (notification.mask & IN_IGNORED)) {
+                            // The directory was deleted or moved away, which its parent hears about too. Dropping it
+                            // right away means one recreated with the same name gets watched again.
+                            const std::string relativePath = it->second;
+                            const size_t separator = relativePath.rfind('/');
+
+                            removeDirectory(relativePath);
+
+                            if (!relativePath.empty()) {
+                                changedDirectories.insert(separator != std::string::npos ? relativePath.substr(0, separator) : "");
+                            }
+                        } else if (it != watchedDirectories.end()) {
+                            changedDirectories.insert(it->second);
+                        }
+
+                        event += sizeof(inotify_event) + notification.len;
+                    }
+                }
+
+                continue;
+            }
+
+            if (!pending) {
+                continue;
+            }
+
+            if (overflowed) {
+                removeDirectory("");
+                scanDirectory("", true);
+            } else {
+                for (const std::string& relativePath : changedDirectories) {
+                    // The directory may be gone already, its parent takes care of it then.
+                    if (directories.count(relativePath) > 0) {
+                        scanDirectory(relativePath, false);
+                    }
+                }
+            }
+
+            changedDirectories.clear();
+            overflowed = false;
+
+            publishSnapshot();
+        }
+
+        removeDirectory("");
+        ::close(notifier);
+        notifier = -1;
+
+        return;
+    }
+#endif
+
+    while (running) {
+        for (int time = 0; time < rescanInterval && running; time += debounceTime) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(debounceTime));
+        }
+
+        removeDirectory("");
+        scanDirectory("", true);
+        publishSnapshot();
+    }
+}
+
+void AssetIndex::scanDirectory(const std::string& relativePath, bool recursive) {
+    Directory& directory = directories[relativePath];
+
+    const std::vector<std::string> previousSubdirectories = std::move(directory.subdirectories);
+
+    directory.subdirectories.clear();
+    directory.files.clear();
+
+    // New directories are watched before they are listed, so nothing created in between is missed.
+    if (recursive) {
+        directory.watch = -1;
+
+#ifdef __linux__
+        if (notifier >= 0) {
+            const std::filesystem::path path = root / relativePath;
+
+            directory.watch = inotify_add_watch(notifier, path.c_str(), IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+
+            if (directory.watch >= 0) {
+                watchedDirectories[directory.watch] = relativePath;
+            }
+        }
+#endif
+    }
+
+    std::error_code error;
+
+    for (const auto& entry : std::filesystem::directory_iterator(root / relativePath, error)) {
+        std::error_code typeError;
+        std::string name = entry.path().filename().string();
+
+        if (entry.is_directory(typeError)) {
+            directory.subdirectories.push_back(std::move(name));
+        } else {
+            directory.files.push_back(std::move(name));
+        }
+    }
+
+    std::sort(directory.subdirectories.begin(), directory.subdirectories.end());
+    std::sort(directory.files.begin(), directory.files.end());
+
+    const std::vector<std::string>& subdirectories = directory.subdirectories;
+
+    for (const std::string& name : previousSubdirectories) {
+        if (!std::binary_search(subdirectories.begin(), subdirectories.end(), name)) {
+            removeDirectory(getChildPath(relativePath, name));
+        }
+    }
+
+    for (const std::string& name : subdirectories) {
+        const std::string childPath = getChildPath(relativePath, name);
+
+        if (recursive || directories.count(childPath) == 0) {
+            scanDirectory(childPath, true);
+        }
+    }
+}
+
+void AssetIndex::removeDirectory(const std::string& relativePath) {
+    auto it = directories.find(relativePath);
+
+    if (it == directories.end()) {
+        return;
+    }
+
+    const std::vector<std::string> subdirectories = std::move(it->second.subdirectories);
+
+#ifdef __linux__
+    // A directory that was moved keeps its watch, which then belongs to its new path if that was scanned already.
+    auto watchIt = watchedDirectories.find(it->second.watch);
+
+    if (watchIt != watchedDirectories.end() && watchIt->second == relativePath) {
+        inotify_rm_watch(notifier, it->second.watch);
+        watchedDirectories.erase(watchIt);
+    }
+#endif
+
+    directories.erase(it);
+
+    for (const std::string& name : subdirectories) {
+        removeDirectory(getChildPath(relativePath, name));
+    }
+}
+
+void AssetIndex::publishSnapshot() {
+    std::shared_ptr<AssetIndexSnapshot> newSnapshot = std::make_shared<AssetIndexSnapshot>();
+    std::vector<AssetIndexEntry>& entries = newSnapshot->entries;
+
+    // Lay out the tree breadth first, so the children of every directory end up next to each other.
+    struct PendingDirectory {
+        uint32_t entryIndex;
+        std::string relativePath;
+    };
+
+    std::vector<PendingDirectory> pendingDirectories;
+
+    entries.push_back({ root, root.filename().string(), ASSET_INDEX_INVALID_ENTRY, 0, 0, 0, true });
+    pendingDirectories.push_back({ 0, "" });
+
+    for (size_t i = 0; i < pendingDirectories.size(); ++i) {
+        const uint32_t entryIndex = pendingDirectories[i].entryIndex;
+        const std::string relativePath = pendingDirectories[i].relativePath;
+
+        auto it = directories.find(relativePath);
+
+        if (it == directories.end()) {
+            continue;
+        }
+
+        const Directory& directory = it->second;
+        const std::filesystem::path path = entries[entryIndex].path;
+
+        entries[entryIndex].firstChild = (uint32_t)entries.size();
+        entries[entryIndex].childCount = (uint32_t)(directory.subdirectories.size() + directory.files.size());
+        entries[entryIndex].subdirectoryCount = (uint32_t)directory.subdirectories.size();
+
+        for (const std::string& name : directory.subdirectories) {
+            pendingDirectories.push_back({ (uint32_t)entries.size(), getChildPath(relativePath, name) });
+            entries.push_back({ path / name, name, entryIndex, 0, 0, 0, true });
+        }
+
+        for (const std::string& name : directory.files) {
+            entries.push_back({ path / name, name, entryIndex, 0, 0, 0, false });
+        }
+    }
+
+    newSnapshot->entryIndices.reserve(entries.size());
+
+    for (uint32_t i = 0; i < entries.size(); ++i) {
+        newSnapshot->entryIndices[entries[i].path.generic_string()] = i;
+    }
+
+    newSnapshot->version = ++version;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    snapshot = std::move(newSnapshot);
+}
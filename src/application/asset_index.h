@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#define ASSET_INDEX_INVALID_ENTRY UINT32_MAX
+
+// A file or directory under the indexed root. The children of a directory are stored next to each other, its
+// subdirectories first, and both subdirectories and files are sorted by name.
+struct AssetIndexEntry {
+    std::filesystem::path path;
+    std::string name;
+    uint32_t parent;
+    uint32_t firstChild;
+    uint32_t childCount;
+    uint32_t subdirectoryCount;
+    bool directory;
+};
+
+// An immutable copy of the index that the GUI can walk without touching the filesystem. The root is the first entry.
+struct AssetIndexSnapshot {
+    std::vector<AssetIndexEntry> entries;
+    std::unordered_map<std::string, uint32_t> entryIndices;
+    uint64_t version;
+
+    // Returns ASSET_INDEX_INVALID_ENTRY if the path isn't indexed.
+    uint32_t find(const std::filesystem::path& path) const;
+};
+
+// Indexes a directory tree on a background thread. The tree is scanned once and then kept current from filesystem
+// notifications (inotify on Linux, periodic rescans elsewhere), and every change publishes a new snapshot.
+class AssetIndex {
+public:
+    AssetIndex();
+    ~AssetIndex();
+
+    AssetIndex(const AssetIndex&) = delete;
+    AssetIndex& operator=(const AssetIndex&) = delete;
+
+    void open(const std::filesystem::path& root);
+    void close();
+
+    // Cheap enough to call every frame. The snapshot stays valid for as long as it's held.
+    std::shared_ptr<const AssetIndexSnapshot> getSnapshot();
+
+private:
+    struct Directory {
+        std::vector<std::string> subdirectories;
+        std::vector<std::string> files;
+        int watch;
+    };
+
+    std::filesystem::path root;
+    std::thread thread;
+    std::atomic<bool> running;
+    std::mutex mutex;
+    std::shared_ptr<const AssetIndexSnapshot> snapshot;
+    uint64_t version;
+
+    // Only touched by the background thread. Directories are keyed by their path relative to the root.
+    std::unordered_map<std::string, Directory> directories;
+    std::unordered_map<int, std::string> watchedDirectories;
+    int notifier;
+
+    void threadMain();
+    void scanDirectory(const std::string& relativePath, bool recursive);
+    void removeDirectory(const std::string& relativePath);
+    void publishSnapshot();
+};
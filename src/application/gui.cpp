@@ -1,5 +1,7 @@
 #include "gui.h"
 
+#include <stdio.h>
+
 #include <stack>
 
 #include <imgui_impl_vulkan.h>
@@ -11,9 +13,12 @@ static bool settingsWindow = false;
 static bool projectPanel = true;
 static bool openOrCreateProjectModal = true;
 static bool createNewProjectModal = false;
+static bool openProjectModal = false;
+static bool importSceneModal = false;
 static std::filesystem::path selectedPath;
 static std::stack<std::filesystem::path> lastVisitedPaths;
 static std::stack<std::filesystem::path> cosa;
+static int blasBudgetMiB = 0;
 
 static void selectPath(const std::filesystem::path& path) {
     if (selectedPath != path) {
@@ -23,9 +28,15 @@ static void selectPath(const std::filesystem::path& path) {
     }
 }
 
-static void renderMainMenuBar() {
+static void renderMainMenuBar(Application& app) {
     if (BeginMainMenuBar()) {
         if (BeginMenu("File")) {
+            MenuItem("Import...", nullptr, &importSceneModal);
+
+            if (MenuItem("Save", nullptr, false, app.project.hasUnsavedChanges())) {
+                app.project.save();
+            }
+
             EndMenu();
         }
 
@@ -57,15 +68,194 @@ static void renderMainMenuBar() {
     }
 }
 
-static void renderSettingsWindow() {
+static void renderSettingsWindow(Application& app) {
     Begin("Settings", &settingsWindow);
 
     if (BeginTabBar("settings_window_tab_bar")) {
         if (BeginTabItem("General")) {
+            // Only assets cooked from now on are affected.
+            static const char* mipFilters[] = { "Box", "Kaiser" };
+            static const char* compressionQualities[] = { "Fast", "Normal", "High" };
+
+            TextureImportSettings& textureImportSettings = app.project.textureImportSettings;
+
+            Text("Texture import");
+
+            if (Combo("Mip filter", (int*)&textureImportSettings.mipFilter, mipFilters, IM_ARRAYSIZE(mipFilters)) |
+                Combo("Compression quality", (int*)&textureImportSettings.quality, compressionQualities, IM_ARRAYSIZE(compressionQualities))) {
+                app.project.markSettingsChanged();
+            }
+
             EndTabItem();
         }
 
         if (BeginTabItem("Graphics")) {
+            DynamicResolution& dynamicResolution = app.renderer.dynamicResolution;
+
+            Checkbox("Dynamic resolution", &dynamicResolution.enabled);
+
+            BeginDisabled(!dynamicResolution.enabled);
+            SliderFloat("Target frame time", &dynamicResolution.targetFrameTime, 4.0f, 50.0f, "%.1f ms");
+            SliderFloat("Minimum scale", &dynamicResolution.minScale, 0.25f, 1.0f, "%.2f");
+            EndDisabled();
+
+            // In the order of VkPresentModeKHR.
+            static const char* presentModes[] = { "Immediate", "Mailbox", "FIFO", "FIFO relaxed" };
+
+            Renderer& renderer = app.renderer;
+
+            Separator();
+
+            if (Combo("Present mode", (int*)&app.presentMode, presentModes, IM_ARRAYSIZE(presentModes)) |
+                SliderInt("Swapchain images", (int*)&app.swapchainImageCount, 2, 4)) {
+                app.swapchainChanged = true;
+            }
+
+            if (!app.swapchainChanged && renderer.getPresentMode() != app.presentMode) {
+                Text("Not supported by the surface, presenting with FIFO");
+            }
+
+            BeginDisabled(!renderer.supportsPresentWait());
+            Checkbox("Low latency pacing", &renderer.lowLatencyPacing);
+            EndDisabled();
+
+            if (renderer.supportsPresentWait()) {
+                Text("Input to present: %.1f ms", renderer.getPresentLatency());
+            } else {
+                Text("Input to present: needs VK_KHR_present_wait");
+            }
+
+            PostProcessor& postProcessor = app.renderer.postProcessor;
+
+            static const char* tonemappers[] = { "ACES", "AgX" };
+
+            Separator();
+            Checkbox("Denoise", &postProcessor.denoiseEnabled);
+
+            BeginDisabled(!postProcessor.denoiseEnabled);
+            SliderInt("Iterations", (int*)&postProcessor.denoiseIterationCount, 1, 5);
+            SliderFloat("Color sigma", &postProcessor.denoiseColorSigma, 0.05f, 2.0f, "%.2f");
+            EndDisabled();
+
+            Checkbox("Exposure", &postProcessor.exposureEnabled);
+
+            BeginDisabled(!postProcessor.exposureEnabled);
+            SliderFloat("EV", &postProcessor.exposure, -8.0f, 8.0f, "%.1f");
+            EndDisabled();
+
+            Checkbox("Tonemap", &postProcessor.tonemapEnabled);
+
+            BeginDisabled(!postProcessor.tonemapEnabled);
+            Combo("Tonemapper", (int*)&postProcessor.tonemapper, tonemappers, IM_ARRAYSIZE(tonemappers));
+            EndDisabled();
+
+            Checkbox("Dither", &postProcessor.ditherEnabled);
+
+            FrameCapture& frameCapture = app.frameCapture;
+
+            static const char* captureFormats[] = { "EXR", "PNG" };
+            static const char* exrCompressions[] = { "ZIP", "PIZ" };
+
+            Separator();
+            Combo("Capture format", (int*)&frameCapture.format, captureFormats, IM_ARRAYSIZE(captureFormats));
+
+            BeginDisabled(frameCapture.format != CAPTURE_FORMAT_EXR);
+            Combo("EXR compression", (int*)&frameCapture.exrCompression, exrCompressions, IM_ARRAYSIZE(exrCompressions));
+            EndDisabled();
+
+            if (Button("Capture frame")) {
+                frameCapture.requestCapture();
+            }
+
+            SameLine();
+
+            if (frameCapture.isRecordingSequence()) {
+                if (Button("Stop sequence")) {
+                    frameCapture.stopSequence();
+                }
+            } else if (Button("Start sequence")) {
+                frameCapture.startSequence();
+            }
+
+            Text("Captured frames: %u written, %u failed, %u dropped", frameCapture.writtenFrameCount.load(), frameCapture.failedFrameCount.load(),
+                 frameCapture.droppedFrameCount);
+
+            Profiler& profiler = app.renderer.profiler;
+
+            Separator();
+            Text("Resolution scale: %.2f", dynamicResolution.scale);
+            Text("Trace: %.2f ms", profiler.getTime(PROFILER_SECTION_TRACE));
+            Text("Denoise: %.2f ms", profiler.getTime(PROFILER_SECTION_DENOISE));
+            Text("Tonemap: %.2f ms", profiler.getTime(PROFILER_SECTION_TONEMAP));
+            Text("GUI: %.2f ms", profiler.getTime(PROFILER_SECTION_GUI));
+            Text("First frame after %.0f ms", app.startupTimings.firstFrameTime);
+
+            TextureStreamer& textureStreamer = app.textureStreamer;
+
+            Separator();
+            Text("Texture memory: %.1f / %.1f MiB", textureStreamer.residentSize / 1048576.0, textureStreamer.budget / 1048576.0);
+            Text("Streamed textures: %u", textureStreamer.streamedTextureCount);
+            Text("Samplers: %u / %u", app.samplerCache.samplerCount, app.samplerCache.capacity);
+
+            TlasBuilder& tlasBuilder = app.tlasBuilder;
+
+            Separator();
+            Text("Instances: %u / %u", tlasBuilder.instanceCount, tlasBuilder.capacity);
+            if (app.isLightTreeReady()) {
+                Text("Lights: %u, light tree depth: %u", app.lightTree.lightCount, app.lightTree.depth);
+            }
+
+            Text("Visible layers");
+
+            for (uint32_t i = 0; i < TLAS_VISIBILITY_LAYER_COUNT; ++i) {
+                char label[16];
+                snprintf(label, sizeof(label), "%u", i);
+
+                if (i > 0) {
+                    SameLine();
+                }
+
+                CheckboxFlags(label, &tlasBuilder.visibleLayers, 1 << i);
+            }
+
+            EnvironmentMap& environmentMap = app.environmentMap;
+            static char environmentPath[256] = "";
+
+            Separator();
+            InputText("Environment map", environmentPath, sizeof(environmentPath));
+
+            const bool environmentMapReady = app.isEnvironmentMapReady();
+
+            BeginDisabled(!environmentMapReady || environmentMap.isLoading());
+            if (Button("Load")) {
+                environmentMap.load(environmentPath);
+            }
+            EndDisabled();
+
+            SameLine();
+
+            if (!environmentMapReady || environmentMap.isLoading()) {
+                Text("Loading...");
+            } else if (environmentMap.loadFailed) {
+                Text("The file couldn't be loaded.");
+            } else if (environmentMap.width > 0) {
+                Text("%u x %u", environmentMap.width, environmentMap.height);
+            }
+
+            LodSelector& lodSelector = app.lodSelector;
+
+            Separator();
+            SliderFloat("LOD error", &lodSelector.errorThreshold, 0.25f, 8.0f, "%.2f px");
+            SliderFloat("LOD hysteresis", &lodSelector.hysteresis, 0.0f, 0.75f);
+
+            // Zero means no budget.
+            if (SliderInt("BLAS budget", &blasBudgetMiB, 0, 4096, blasBudgetMiB == 0 ? "None" : "%d MiB")) {
+                lodSelector.memoryBudget = blasBudgetMiB == 0 ? LOD_NO_BUDGET : (VkDeviceSize)blasBudgetMiB * 1048576;
+            }
+
+            Text("BLAS memory: %.1f MiB", lodSelector.selectedSize / 1048576.0);
+            Text("Finest LOD: %u", lodSelector.finestLevel);
+
             EndTabItem();
         }
 
@@ -75,44 +265,39 @@ static void renderSettingsWindow() {
     End();
 }
 
-static bool hasSubdirectories(const std::filesystem::path& path) {
-    for (const auto& entry : std::filesystem::directory_iterator(path)) {
-        if (entry.is_directory()) {
-            return true;
-        }
-    }
-
-    return false;
-}
+static void renderProjectTree(const AssetIndexSnapshot& snapshot, uint32_t entryIndex) {
+    const AssetIndexEntry& entry = snapshot.entries[entryIndex];
 
-static void renderProjectTree(const std::filesystem::path& path) {
     ImGuiTreeNodeFlags flags = ImGuiTreeNodeFlags_SpanAvailWidth;
     ImGuiTreeNodeFlags nodeFlags = flags | ImGuiTreeNodeFlags_OpenOnArrow | ImGuiTreeNodeFlags_OpenOnDoubleClick;
     ImGuiTreeNodeFlags leafFlags = flags | ImGuiTreeNodeFlags_Leaf | ImGuiTreeNodeFlags_NoTreePushOnOpen;
 
-    if (path == selectedPath) {
+    if (entry.path == selectedPath) {
         nodeFlags |= ImGuiTreeNodeFlags_Selected;
     }
 
-    bool nodeClicked = TreeNodeEx(path.filename().c_str(), nodeFlags);
+    bool nodeClicked = TreeNodeEx(entry.name.c_str(), nodeFlags);
     if (IsItemClicked() && !IsItemToggledOpen()) {
-        selectPath(path);
+        selectPath(entry.path);
     }
 
     if (nodeClicked) {
-        for (const auto& entry : std::filesystem::directory_iterator(path)) {
-            if (entry.is_directory()) {
-                if (hasSubdirectories(entry.path())) {
-                    renderProjectTree(entry.path());
-                } else {
-                    if (entry.path() == selectedPath) {
-                        leafFlags |= ImGuiTreeNodeFlags_Selected;
-                    }
-
-                    TreeNodeEx(entry.path().filename().c_str(), leafFlags);
-                    if (IsItemClicked() && !IsItemToggledOpen()) {
-                        selectPath(entry.path());
-                    }
+        // Subdirectories come first among the children.
+        for (uint32_t i = entry.firstChild; i < entry.firstChild + entry.subdirectoryCount; ++i) {
+            const AssetIndexEntry& child = snapshot.entries[i];
+
+            if (child.subdirectoryCount > 0) {
+                renderProjectTree(snapshot, i);
+            } else {
+                ImGuiTreeNodeFlags childFlags = leafFlags;
+
+                if (child.path == selectedPath) {
+                    childFlags |= ImGuiTreeNodeFlags_Selected;
+                }
+
+                TreeNodeEx(child.name.c_str(), childFlags);
+                if (IsItemClicked() && !IsItemToggledOpen()) {
+                    selectPath(child.path);
                 }
             }
         }
@@ -121,44 +306,101 @@ static void renderProjectTree(const std::filesystem::path& path) {
     }
 }
 
-static void renderProjectFiles() {
+static void renderProjectFiles(const AssetIndexSnapshot& snapshot, ThumbnailCache& thumbnailCache) {
     static std::filesystem::path selectedFile;
 
+    const uint32_t directoryIndex = snapshot.find(selectedPath);
+
+    if (directoryIndex == ASSET_INDEX_INVALID_ENTRY) {
+        return;
+    }
+
+    const AssetIndexEntry& directory = snapshot.entries[directoryIndex];
+
+    BeginChild("project_files");
+
+    // Tiles are a square thumbnail with the name below it.
     float itemWidth = 75.0f;
+    float itemHeight = itemWidth + GetTextLineHeightWithSpacing();
     float spacing = GetStyle().ItemSpacing.x;
-    float availableWidth = ImGui::GetContentRegionAvail().x;
-    float currentX = 0.0f;
+    float availableWidth = GetContentRegionAvail().x;
+
+    int columnCount = (int)((availableWidth + spacing) / (itemWidth + spacing));
+    columnCount = columnCount > 0 ? columnCount : 1;
+
+    int rowCount = (directory.childCount + columnCount - 1) / columnCount;
 
     PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(spacing, spacing));
 
-    for (const auto& entry : std::filesystem::directory_iterator(selectedPath)) {
-        if (currentX + itemWidth > availableWidth) {
-            NewLine();
-            currentX = 0.0f;
-        }
+    // Only the rows on screen are laid out, so huge directories cost as much as small ones.
+    ImGuiListClipper clipper;
+    clipper.Begin(rowCount, itemHeight + spacing);
 
-        if (entry.path() != selectedFile) {
-            PushStyleColor(ImGuiCol_Button, IM_COL32(0, 0, 0, 0));
-        }
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            for (int column = 0; column < columnCount; ++column) {
+                uint32_t i = directory.firstChild + row * columnCount + column;
 
-        if (Button(entry.path().filename().c_str(), ImVec2(itemWidth, itemWidth))) {
-            selectedFile = entry.path();
-        }
+                if (i >= directory.firstChild + directory.childCount) {
+                    break;
+                }
 
-        PopStyleColor();
+                const AssetIndexEntry& entry = snapshot.entries[i];
 
-        if (IsItemHovered() && IsMouseDoubleClicked(0) && entry.is_directory()) {
-            selectPath(entry.path());
-        }
+                if (column > 0) {
+                    SameLine();
+                }
 
-        currentX += itemWidth + spacing;
-        SameLine();
+                PushID(i);
+
+                bool selected = entry.path == selectedFile;
+
+                if (!selected) {
+                    PushStyleColor(ImGuiCol_Button, IM_COL32(0, 0, 0, 0));
+                }
+
+                if (Button("##tile", ImVec2(itemWidth, itemHeight))) {
+                    selectedFile = entry.path;
+                }
+
+                if (!selected) {
+                    PopStyleColor();
+                }
+
+                if (IsItemHovered() && IsMouseDoubleClicked(0) && entry.directory) {
+                    selectPath(entry.path);
+                }
+
+                ImVec2 tileMin = GetItemRectMin();
+                ImDrawList* drawList = GetWindowDrawList();
+
+                ImVec2 uv0, uv1;
+
+                if (!entry.directory && thumbnailCache.getThumbnail(entry.path, uv0, uv1)) {
+                    float inset = 0.5f * (itemWidth - THUMBNAIL_SIZE);
+                    ImVec2 imageMin(tileMin.x + inset, tileMin.y + inset);
+
+                    drawList->AddImage(thumbnailCache.getAtlas(), imageMin, ImVec2(imageMin.x + THUMBNAIL_SIZE, imageMin.y + THUMBNAIL_SIZE), uv0, uv1);
+                }
+
+                ImVec2 textMin(tileMin.x + 2.0f, tileMin.y + itemWidth);
+                ImVec4 textClipRect(tileMin.x, tileMin.y, tileMin.x + itemWidth - 2.0f, tileMin.y + itemHeight);
+
+                drawList->AddText(GetFont(), GetFontSize(), textMin, GetColorU32(ImGuiCol_Text), entry.name.c_str(), nullptr, 0.0f, &textClipRect);
+
+                PopID();
+            }
+        }
     }
 
     PopStyleVar();
+
+    EndChild();
 }
 
-static void renderProjectPanel(Project& project) {
+static void renderProjectPanel(Application& app) {
+    Project& project = app.project;
+
     Begin("Project", &projectPanel);
 
     if (selectedPath != "") {
@@ -195,12 +437,15 @@ static void renderProjectPanel(Project& project) {
             selectPath(project.getAssetsDirectoryPath());
         }
 
-        if (BeginTable("project_panel_table", 2, ImGuiTableFlags_Resizable | ImGuiTableFlags_BordersInnerV, GetContentRegionAvail())) {
+        // The panels only ever read the index, the filesystem is watched on another thread.
+        std::shared_ptr<const AssetIndexSnapshot> snapshot = app.assetIndex.getSnapshot();
+
+        if (!snapshot->entries.empty() && BeginTable("project_panel_table", 2, ImGuiTableFlags_Resizable | ImGuiTableFlags_BordersInnerV, GetContentRegionAvail())) {
             TableNextColumn();
-            renderProjectTree(project.getAssetsDirectoryPath());
+            renderProjectTree(*snapshot, 0);
 
             TableNextColumn();
-            renderProjectFiles();
+            renderProjectFiles(*snapshot, app.thumbnailCache);
 
             EndTable();
         }
@@ -221,6 +466,14 @@ static void renderOpenOrCreateProjectModal() {
             openOrCreateProjectModal = false;
         }
 
+        SameLine();
+
+        if (Button("Open a project")) {
+            openProjectModal = true;
+            CloseCurrentPopup();
+            openOrCreateProjectModal = false;
+        }
+
         EndPopup();
     }
 }
@@ -265,7 +518,7 @@ static void renderCreateNewProjectModal(Application& app) {
 
         if (Button("Create", ImVec2(buttonWidth, 0))) {
             std::filesystem::path path = std::filesystem::path(location) / name;
-            app.project = Project(path);
+            app.createProject(path);
             CloseCurrentPopup();
             createNewProjectModal = false;
             selectedPath = app.project.getAssetsDirectoryPath();
@@ -275,16 +528,107 @@ static void renderCreateNewProjectModal(Application& app) {
     }
 }
 
+static void renderOpenProjectModal(Application& app) {
+    OpenPopup("Open project");
+
+    ImGuiIO& io = GetIO();
+    SetNextWindowPos(ImVec2(io.DisplaySize.x * 0.5f, io.DisplaySize.y * 0.5f), ImGuiCond_Always, ImVec2(0.5f, 0.5f));
+    if (BeginPopupModal("Open project", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_AlwaysAutoResize)) {
+        static char location[256] = "";
+        static bool openFailed = false;
+
+        InputText("Location", location, sizeof(location));
+
+        PushStyleColor(ImGuiCol_Text, IM_COL32(255, 0, 0, 255));
+        Text(openFailed ? "Error: The project couldn't be opened." : "");
+        PopStyleColor();
+
+        float buttonWidth = 75.0f;
+        float buttonSpacing = GetStyle().ItemSpacing.x;
+        float totalWidth = 2 * buttonWidth + buttonSpacing;
+
+        SetCursorPos(ImVec2(GetContentRegionMax().x - totalWidth, GetCursorPosY() + 25.0f));
+
+        if (Button("Cancel", ImVec2(buttonWidth, 0))) {
+            openOrCreateProjectModal = true;
+            CloseCurrentPopup();
+            openProjectModal = false;
+            openFailed = false;
+            strcpy(location, "");
+        }
+
+        SameLine();
+
+        if (Button("Open", ImVec2(buttonWidth, 0))) {
+            openFailed = !app.openProject(location);
+
+            if (!openFailed) {
+                CloseCurrentPopup();
+                openProjectModal = false;
+                selectedPath = app.project.getAssetsDirectoryPath();
+            }
+        }
+
+        EndPopup();
+    }
+}
+
+static void renderImportSceneModal(Application& app) {
+    OpenPopup("Import scene");
+
+    ImGuiIO& io = GetIO();
+    SetNextWindowPos(ImVec2(io.DisplaySize.x * 0.5f, io.DisplaySize.y * 0.5f), ImGuiCond_Always, ImVec2(0.5f, 0.5f));
+    if (BeginPopupModal("Import scene", nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_AlwaysAutoResize)) {
+        static char path[256] = "";
+        static bool importFailed = false;
+
+        InputText("Path", path, sizeof(path));
+
+        PushStyleColor(ImGuiCol_Text, IM_COL32(255, 0, 0, 255));
+        Text(importFailed ? "Error: The file couldn't be imported." : "");
+        PopStyleColor();
+
+        float buttonWidth = 75.0f;
+        float buttonSpacing = GetStyle().ItemSpacing.x;
+        float totalWidth = 2 * buttonWidth + buttonSpacing;
+
+        SetCursorPos(ImVec2(GetContentRegionMax().x - totalWidth, GetCursorPosY() + 25.0f));
+
+        if (Button("Cancel", ImVec2(buttonWidth, 0))) {
+            CloseCurrentPopup();
+            importSceneModal = false;
+            importFailed = false;
+            strcpy(path, "");
+        }
+
+        SameLine();
+
+        if (Button("Import", ImVec2(buttonWidth, 0))) {
+            importFailed = !app.importScene(path);
+
+            if (!importFailed) {
+                CloseCurrentPopup();
+                importSceneModal = false;
+                strcpy(path, "");
+            }
+        }
+
+        EndPopup();
+    }
+}
+
 void renderGui(Application& app) {
     ImGui_ImplVulkan_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     NewFrame();
 
-    renderMainMenuBar();
-    if (settingsWindow) renderSettingsWindow();
-    if (projectPanel) renderProjectPanel(app.project);
+    renderMainMenuBar(app);
+    if (settingsWindow) renderSettingsWindow(app);
+    if (projectPanel) renderProjectPanel(app);
     if (openOrCreateProjectModal) renderOpenOrCreateProjectModal();
     if (createNewProjectModal) renderCreateNewProjectModal(app);
+    if (openProjectModal) renderOpenProjectModal(app);
+    if (importSceneModal) renderImportSceneModal(app);
 
     Render();
 }
@@ -1,17 +1,448 @@
 #include "project.h"
 
-#include <fstream>
+#include <stdio.h>
+#include <string.h>
+
+#include <random>
+
+#include <cooked_asset.h>
+#include <hash.h>
+
+static const uint32_t chunkTypes[] = { PROJECT_CHUNK_ASSETS, PROJECT_CHUNK_SCENE, PROJECT_CHUNK_SETTINGS };
+static const uint32_t chunkVersions[] = { 1, 1, 1 };
+
+struct AssetRecord {
+    AssetGuid guid;
+    uint32_t type;
+    uint32_t pathLength;
+};
+
+struct SettingsRecord {
+    uint32_t mipFilter;
+    uint32_t quality;
+};
+
+static uint64_t alignProjectOffset(uint64_t offset) {
+    return (offset + PROJECT_FILE_ALIGNMENT - 1) & ~(uint64_t)(PROJECT_FILE_ALIGNMENT - 1);
+}
+
+static AssetGuid generateAssetGuid() {
+    static std::mt19937_64 generator(((uint64_t)std::random_device()() << 32) | std::random_device()());
+
+    return { generator(), generator() };
+}
 
 Project::Project(const std::filesystem::path& path) : path(path) {
     std::filesystem::create_directory(path);
-    std::ofstream projectFile(path / "project.vx");
     std::filesystem::path assetsDirectoryPath = getAssetsDirectoryPath();
     std::filesystem::create_directory(assetsDirectoryPath);
     std::filesystem::create_directory(assetsDirectoryPath / "Images");
     std::filesystem::create_directory(assetsDirectoryPath / "Samplers");
     std::filesystem::create_directory(assetsDirectoryPath / "Shaders");
+    std::filesystem::create_directory(getCookedDirectoryPath());
+
+    // There's nothing to read, so every chunk counts as loaded.
+    loadedChunks = (1 << CHUNK_INDEX_COUNT) - 1;
+    dirtyChunks = (1 << CHUNK_INDEX_COUNT) - 1;
+
+    save();
+}
+
+bool Project::open(const std::filesystem::path& path) {
+    close();
+
+    this->path = path;
+    file = MappedFile(path / PROJECT_FILE_NAME);
+
+    if (file.data == nullptr || file.size < sizeof(ProjectFileHeader)) {
+        close();
+        return false;
+    }
+
+    const ProjectFileHeader& header = *(const ProjectFileHeader*)file.data;
+
+    if (header.magic != PROJECT_FILE_MAGIC || header.version != PROJECT_FILE_VERSION || header.fileSize != file.size ||
+        header.chunkCount > (file.size - sizeof(ProjectFileHeader)) / sizeof(ProjectChunk)) {
+        close();
+        return false;
+    }
+
+    const ProjectChunk* chunks = (const ProjectChunk*)(file.data + sizeof(ProjectFileHeader));
+
+    for (uint32_t i = 0; i < header.chunkCount; ++i) {
+        if (chunks[i].offset % PROJECT_FILE_ALIGNMENT != 0 || chunks[i].offset > file.size || chunks[i].size > file.size - chunks[i].offset) {
+            close();
+            return false;
+        }
+    }
+
+    // The settings are needed right away, everything else waits until it's asked for.
+    loadChunk(CHUNK_INDEX_SETTINGS);
+
+    return true;
+}
+
+void Project::close() {
+    file.destroy();
+
+    loadedChunks = 0;
+    dirtyChunks = 0;
+
+    assets.clear();
+    assetIndices.clear();
+    scene.clear();
+
+    textureImportSettings = { MIP_FILTER_KAISER, BLOCK_COMPRESSION_QUALITY_NORMAL };
+}
+
+bool Project::save() {
+    if (dirtyChunks == 0 && file.data != nullptr) {
+        return true;
+    }
+
+    // Lay out the new file: the chunks of the old one in the same order, followed by the ones that are new.
+    std::vector<ProjectChunk> chunks;
+    std::vector<const uint8_t*> chunkData;
+    std::vector<uint8_t> serializedChunks[CHUNK_INDEX_COUNT];
+    uint32_t writtenChunks = 0;
+
+    const uint32_t oldChunkCount = file.data != nullptr ? ((const ProjectFileHeader*)file.data)->chunkCount : 0;
+    const ProjectChunk* oldChunks = (const ProjectChunk*)(file.data + sizeof(ProjectFileHeader));
+
+    for (uint32_t i = 0; i < oldChunkCount + CHUNK_INDEX_COUNT; ++i) {
+        const ProjectChunk* oldChunk = i < oldChunkCount ? &oldChunks[i] : nullptr;
+        const uint32_t type = oldChunk != nullptr ? oldChunk->type : chunkTypes[i - oldChunkCount];
+
+        uint32_t chunkIndex = CHUNK_INDEX_COUNT;
+
+        for (uint32_t j = 0; j < CHUNK_INDEX_COUNT; ++j) {
+            if (chunkTypes[j] == type) {
+                chunkIndex = j;
+            }
+        }
+
+        if (chunkIndex == CHUNK_INDEX_COUNT || !(dirtyChunks & (1 << chunkIndex))) {
+            if (oldChunk != nullptr) {
+                chunks.push_back(*oldChunk);
+                chunkData.push_back(file.data + oldChunk->offset);
+            }
+
+            continue;
+        }
+
+        // A dirty chunk is written once, in place of the first old chunk of its type.
+        if (writtenChunks & (1 << chunkIndex)) {
+            continue;
+        }
+
+        writtenChunks |= 1 << chunkIndex;
+
+        std::vector<uint8_t>& serializedChunk = serializedChunks[chunkIndex];
+        serializedChunk = serializeChunk((ChunkIndex)chunkIndex);
+
+        chunks.push_back({ type, chunkVersions[chunkIndex], 0, serializedChunk.size(), hashData(serializedChunk.data(), serializedChunk.size()) });
+        chunkData.push_back(serializedChunk.data());
+    }
+
+    ProjectFileHeader header = {
+        .magic      = PROJECT_FILE_MAGIC,
+        .version    = PROJECT_FILE_VERSION,
+        .fileSize   = 0,
+        .chunkCount = (uint32_t)chunks.size(),
+        .padding    = 0
+    };
+
+    uint64_t offset = sizeof(ProjectFileHeader) + chunks.size() * sizeof(ProjectChunk);
+
+    for (ProjectChunk& chunk : chunks) {
+        chunk.offset = alignProjectOffset(offset);
+        offset = chunk.offset + chunk.size;
+    }
+
+    header.fileSize = offset;
+
+    // Write the file next to the old one and move it into place once it's on disk.
+    std::filesystem::path projectFilePath = path / PROJECT_FILE_NAME;
+    std::filesystem::path temporaryPath = projectFilePath;
+    temporaryPath += ".tmp";
+
+    MappedFile newFile(temporaryPath, header.fileSize);
+
+    if (newFile.data == nullptr) {
+        return false;
+    }
+
+    memset(newFile.data, 0, header.fileSize);
+    memcpy(newFile.data, &header, sizeof(header));
+    memcpy(newFile.data + sizeof(header), chunks.data(), chunks.size() * sizeof(ProjectChunk));
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        if (chunks[i].size > 0) {
+            memcpy(newFile.data + chunks[i].offset, chunkData[i], chunks[i].size);
+        }
+    }
+
+    bool saved = newFile.flush();
+    newFile.destroy();
+
+    // Some platforms can't replace a file that is mapped, and the old mapping isn't needed anymore anyway.
+    file.destroy();
+
+    std::error_code error;
+
+    if (saved) {
+        std::filesystem::rename(temporaryPath, projectFilePath, error);
+        saved = !error;
+    }
+
+    if (!saved) {
+        std::filesystem::remove(temporaryPath, error);
+    }
+
+    // Chunks that haven't been loaded yet are read from whichever file ended up in place.
+    file = MappedFile(projectFilePath);
+
+    if (saved) {
+        dirtyChunks = 0;
+    }
+
+    return saved;
+}
+
+bool Project::hasUnsavedChanges() {
+    return dirtyChunks != 0;
 }
 
 std::filesystem::path Project::getAssetsDirectoryPath() {
     return path / "Assets";
 }
+
+std::filesystem::path Project::getCookedDirectoryPath() {
+    return path / "Cooked";
+}
+
+std::filesystem::path Project::getCapturesDirectoryPath() {
+    return path / "Captures";
+}
+
+std::filesystem::path Project::getCookedAssetPath(const std::filesystem::path& sourcePath) {
+    return ::getCookedAssetPath(path, sourcePath);
+}
+
+AssetGuid Project::getAssetGuid(const std::filesystem::path& path, AssetType type) {
+    loadChunk(CHUNK_INDEX_ASSETS);
+
+    // Assets inside the project are stored relative to it, so the project can be moved.
+    std::error_code error;
+    std::filesystem::path absolutePath = std::filesystem::absolute(path, error).lexically_normal();
+    std::filesystem::path relativePath = absolutePath.lexically_relative(std::filesystem::absolute(getAssetsDirectoryPath(), error).lexically_normal());
+    std::string assetPath = !relativePath.empty() && *relativePath.begin() != ".." ? relativePath.generic_string() : absolutePath.generic_string();
+
+    auto it = assetIndices.find(assetPath);
+
+    if (it != assetIndices.end()) {
+        return assets[it->second].guid;
+    }
+
+    AssetGuid guid = generateAssetGuid();
+
+    assetIndices[assetPath] = (uint32_t)assets.size();
+    assets.push_back({ guid, type, std::move(assetPath) });
+    dirtyChunks |= 1 << CHUNK_INDEX_ASSETS;
+
+    return guid;
+}
+
+const ProjectAsset* Project::findAsset(const AssetGuid& guid) {
+    loadChunk(CHUNK_INDEX_ASSETS);
+
+    for (const ProjectAsset& asset : assets) {
+        if (asset.guid == guid) {
+            return &asset;
+        }
+    }
+
+    return nullptr;
+}
+
+std::filesystem::path Project::getAssetPath(const ProjectAsset& asset) {
+    std::filesystem::path assetPath = asset.path;
+    return assetPath.is_absolute() ? assetPath : getAssetsDirectoryPath() / assetPath;
+}
+
+const std::vector<AssetGuid>& Project::getScene() {
+    loadChunk(CHUNK_INDEX_SCENE);
+    return scene;
+}
+
+void Project::addToScene(const AssetGuid& guid) {
+    loadChunk(CHUNK_INDEX_SCENE);
+
+    scene.push_back(guid);
+    dirtyChunks |= 1 << CHUNK_INDEX_SCENE;
+}
+
+void Project::markSettingsChanged() {
+    dirtyChunks |= 1 << CHUNK_INDEX_SETTINGS;
+}
+
+const ProjectChunk* Project::findChunk(uint32_t type) {
+    if (file.data == nullptr) {
+        return nullptr;
+    }
+
+    const ProjectFileHeader& header = *(const ProjectFileHeader*)file.data;
+    const ProjectChunk* chunks = (const ProjectChunk*)(file.data + sizeof(ProjectFileHeader));
+
+    for (uint32_t i = 0; i < header.chunkCount; ++i) {
+        if (chunks[i].type == type) {
+            return &chunks[i];
+        }
+    }
+
+    return nullptr;
+}
+
+void Project::loadChunk(ChunkIndex chunkIndex) {
+    if (loadedChunks & (1 << chunkIndex)) {
+        return;
+    }
+
+    loadedChunks |= 1 << chunkIndex;
+
+    // A missing chunk is empty. So is one that is damaged or from a different version, it's replaced on the next save.
+    const ProjectChunk* chunk = findChunk(chunkTypes[chunkIndex]);
+
+    if (chunk == nullptr || chunk->version != chunkVersions[chunkIndex]) {
+        return;
+    }
+
+    const uint8_t* data = file.data + chunk->offset;
+
+    if (hashData(data, chunk->size) != chunk->hash) {
+        return;
+    }
+
+    switch (chunkIndex) {
+        case CHUNK_INDEX_ASSETS:   loadAssets(data, chunk->size);   break;
+        case CHUNK_INDEX_SCENE:    loadScene(data, chunk->size);    break;
+        case CHUNK_INDEX_SETTINGS: loadSettings(data, chunk->size); break;
+        default: break;
+    }
+}
+
+// The assets chunk is the asset count followed by a record for each asset, and then all of their paths back to back.
+void Project::loadAssets(const uint8_t* data, uint64_t size) {
+    if (size < sizeof(uint64_t)) {
+        return;
+    }
+
+    const uint64_t assetCount = *(const uint64_t*)data;
+
+    if (assetCount > (size - sizeof(uint64_t)) / sizeof(AssetRecord)) {
+        return;
+    }
+
+    const AssetRecord* records = (const AssetRecord*)(data + sizeof(uint64_t));
+    const char* paths = (const char*)(records + assetCount);
+    uint64_t pathsSize = size - sizeof(uint64_t) - assetCount * sizeof(AssetRecord);
+
+    assets.reserve(assetCount);
+
+    for (uint64_t i = 0; i < assetCount; ++i) {
+        if (records[i].pathLength > pathsSize) {
+            break;
+        }
+
+        std::string assetPath(paths, records[i].pathLength);
+
+        assetIndices[assetPath] = (uint32_t)assets.size();
+        assets.push_back({ records[i].guid, (AssetType)records[i].type, std::move(assetPath) });
+
+        paths += records[i].pathLength;
+        pathsSize -= records[i].pathLength;
+    }
+}
+
+void Project::loadScene(const uint8_t* data, uint64_t size) {
+    const AssetGuid* guids = (const AssetGuid*)data;
+    scene.assign(guids, guids + size / sizeof(AssetGuid));
+}
+
+void Project::loadSettings(const uint8_t* data, uint64_t size) {
+    if (size < sizeof(SettingsRecord)) {
+        return;
+    }
+
+    const SettingsRecord& settings = *(const SettingsRecord*)data;
+
+    textureImportSettings = { (MipFilter)settings.mipFilter, (BlockCompressionQuality)settings.quality };
+}
+
+std::vector<uint8_t> Project::serializeChunk(ChunkIndex chunkIndex) {
+    std::vector<uint8_t> data;
+
+    switch (chunkIndex) {
+        case CHUNK_INDEX_ASSETS: {
+            const uint64_t assetCount = assets.size();
+            uint64_t pathsSize = 0;
+
+            for (const ProjectAsset& asset : assets) {
+                pathsSize += asset.path.size();
+            }
+
+            data.resize(sizeof(uint64_t) + assetCount * sizeof(AssetRecord) + pathsSize);
+            memcpy(data.data(), &assetCount, sizeof(uint64_t));
+
+            AssetRecord* records = (AssetRecord*)(data.data() + sizeof(uint64_t));
+            char* paths = (char*)(records + assetCount);
+
+            for (uint64_t i = 0; i < assetCount; ++i) {
+                records[i] = { assets[i].guid, (uint32_t)assets[i].type, (uint32_t)assets[i].path.size() };
+
+                memcpy(paths, assets[i].path.data(), assets[i].path.size());
+                paths += assets[i].path.size();
+            }
+
+            break;
+        }
+
+        case CHUNK_INDEX_SCENE: {
+            data.resize(scene.size() * sizeof(AssetGuid));
+
+            if (!scene.empty()) {
+                memcpy(data.data(), scene.data(), data.size());
+            }
+
+            break;
+        }
+
+        case CHUNK_INDEX_SETTINGS: {
+            const SettingsRecord settings = { (uint32_t)textureImportSettings.mipFilter, (uint32_t)textureImportSettings.quality };
+
+            data.resize(sizeof(settings));
+            memcpy(data.data(), &settings, sizeof(settings));
+            break;
+        }
+
+        default: break;
+    }
+
+    return data;
+}
+
+std::filesystem::path getCookedAssetPath(const std::filesystem::path& projectPath, const std::filesystem::path& sourcePath) {
+    // Sources outside the project are keyed by their absolute path.
+    std::error_code error;
+    std::filesystem::path absolutePath = std::filesystem::absolute(sourcePath, error).lexically_normal();
+    std::filesystem::path relativePath = absolutePath.lexically_relative(std::filesystem::absolute(projectPath, error).lexically_normal());
+    std::string key = !relativePath.empty() && *relativePath.begin() != ".." ? relativePath.generic_string() : absolutePath.generic_string();
+
+    char suffix[32];
+    snprintf(suffix, sizeof(suffix), "-%016llx" COOKED_ASSET_EXTENSION, (unsigned long long)hashData(key.data(), key.size()));
+
+    std::filesystem::path cookedPath = projectPath / "Cooked" / sourcePath.stem();
+    cookedPath += suffix;
+
+    return cookedPath;
+}
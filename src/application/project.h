@@ -1,13 +1,132 @@
 #pragma once
 
+#include <stdint.h>
+
 #include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <file_mapping.h>
+#include <image_import.h>
+
+// The project file is a table of contents followed by the chunks it points to:
+//
+//     header | chunk table | chunk | chunk | ...
+//
+// Every chunk starts at a multiple of PROJECT_FILE_ALIGNMENT and is identified by its type. Chunks of types this
+// version doesn't know about are kept as they are when the project is saved.
+#define PROJECT_FILE_MAGIC 0x4A505856 // "VXPJ"
+#define PROJECT_FILE_VERSION 1
+#define PROJECT_FILE_ALIGNMENT 64
+#define PROJECT_FILE_NAME "project.vx"
+
+#define PROJECT_CHUNK_ASSETS   0x54535341 // "ASST"
+#define PROJECT_CHUNK_SCENE    0x454E4353 // "SCNE"
+#define PROJECT_CHUNK_SETTINGS 0x53545453 // "STTS"
+
+struct ProjectFileHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fileSize;
+    uint32_t chunkCount;
+    uint32_t padding;
+};
+
+// The hash covers the chunk's data and is checked when the chunk is read.
+struct ProjectChunk {
+    uint32_t type;
+    uint32_t version;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t hash;
+};
+
+enum AssetType {
+    ASSET_TYPE_SCENE,
+    ASSET_TYPE_IMAGE,
+    ASSET_TYPE_SAMPLER
+};
+
+// Identifies an asset for the lifetime of the project, no matter what else is added or removed.
+struct AssetGuid {
+    uint64_t high;
+    uint64_t low;
+
+    bool operator==(const AssetGuid& other) const {
+        return high == other.high && low == other.low;
+    }
+};
+
+// Paths are relative to the assets directory if the asset is inside it.
+struct ProjectAsset {
+    AssetGuid guid;
+    AssetType type;
+    std::string path;
+};
 
 class Project {
 public:
     std::filesystem::path path;
 
+    // Read when the project is opened. The assets and the scene are only read the first time they are needed.
+    TextureImportSettings textureImportSettings = { MIP_FILTER_KAISER, BLOCK_COMPRESSION_QUALITY_NORMAL };
+
     Project() = default;
+
+    // Creates the project's directories and an empty project file.
     Project(const std::filesystem::path& path);
 
+    // Maps an existing project file. Returns false if it's missing, truncated or was written by a different version.
+    bool open(const std::filesystem::path& path);
+    void close();
+
+    // Writes only the chunks that changed since the project was opened or last saved, the rest is copied from the
+    // mapped file. The new file replaces the old one once it's complete, so a crash leaves either of them intact.
+    bool save();
+    bool hasUnsavedChanges();
+
     std::filesystem::path getAssetsDirectoryPath();
+    std::filesystem::path getCookedDirectoryPath();
+    std::filesystem::path getCapturesDirectoryPath();
+    std::filesystem::path getCookedAssetPath(const std::filesystem::path& sourcePath);
+
+    // Returns the asset's GUID, registering it the first time.
+    AssetGuid getAssetGuid(const std::filesystem::path& path, AssetType type);
+    const ProjectAsset* findAsset(const AssetGuid& guid);
+    std::filesystem::path getAssetPath(const ProjectAsset& asset);
+
+    // The scenes that were imported into the world, in the order they were imported.
+    const std::vector<AssetGuid>& getScene();
+    void addToScene(const AssetGuid& guid);
+
+    // Call after changing the texture import settings.
+    void markSettingsChanged();
+
+private:
+    enum ChunkIndex {
+        CHUNK_INDEX_ASSETS,
+        CHUNK_INDEX_SCENE,
+        CHUNK_INDEX_SETTINGS,
+        CHUNK_INDEX_COUNT
+    };
+
+    MappedFile file;
+    uint32_t loadedChunks = 0;
+    uint32_t dirtyChunks = 0;
+
+    std::vector<ProjectAsset> assets;
+    std::unordered_map<std::string, uint32_t> assetIndices;
+    std::vector<AssetGuid> scene;
+
+    const ProjectChunk* findChunk(uint32_t type);
+    void loadChunk(ChunkIndex chunkIndex);
+    void loadAssets(const uint8_t* data, uint64_t size);
+    void loadScene(const uint8_t* data, uint64_t size);
+    void loadSettings(const uint8_t* data, uint64_t size);
+    std::vector<uint8_t> serializeChunk(ChunkIndex chunkIndex);
 };
+
+// Where a source file is cooked to in the project at the path. Cooked assets are named after the source and the hash of
+// its path relative to the project, so sources of the same name in different directories don't overwrite each other.
+std::filesystem::path getCookedAssetPath(const std::filesystem::path& projectPath, const std::filesystem::path& sourcePath);
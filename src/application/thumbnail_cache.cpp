@@ -0,0 +1,583 @@
+#include "thumbnail_cache.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <imgui_impl_vulkan.h>
+#include <stb_image.h>
+
+#include <cooked_asset.h>
+#include <file_mapping.h>
+#include <hash.h>
+#include <mesh_optimizer.h>
+
+#include "project.h"
+
+static const uint32_t thumbnailByteCount = THUMBNAIL_SIZE * THUMBNAIL_SIZE * 4;
+static const uint32_t atlasTilesPerRow = THUMBNAIL_ATLAS_SIZE / THUMBNAIL_SIZE;
+static const uint32_t atlasTileCount = atlasTilesPerRow * atlasTilesPerRow;
+
+// Enough staging memory for 64 thumbnails a frame.
+static const VkDeviceSize stagingCapacity = 64 * thumbnailByteCount;
+
+// Changing how thumbnails are made has to change this, so the ones on disk are made again.
+static const uint64_t thumbnailVersion = 1;
+
+// Scenes are rasterized at a higher resolution and filtered down.
+static const uint32_t sceneSupersampling = 2;
+
+static const char* imageExtensions[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp", ".psd", ".gif", ".hdr", ".pic", ".ppm", ".pgm" };
+static const char* sceneExtensions[] = { ".gltf", ".glb" };
+
+static bool hasExtension(const std::filesystem::path& extension, const char* const* extensions, size_t extensionCount) {
+    for (size_t i = 0; i < extensionCount; ++i) {
+        if (extension == extensions[i]) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void renderImageThumbnail(const uint8_t* image, int width, int height, uint8_t* pixels) {
+    memset(pixels, 0, thumbnailByteCount);
+
+    // Fit the image in the thumbnail, keeping its aspect ratio and centering it.
+    const float scale = (float)THUMBNAIL_SIZE / (width > height ? width : height);
+    const int thumbnailWidth = width * scale > 1.0f ? (int)(width * scale) : 1;
+    const int thumbnailHeight = height * scale > 1.0f ? (int)(height * scale) : 1;
+    const int offsetX = (THUMBNAIL_SIZE - thumbnailWidth) / 2;
+    const int offsetY = (THUMBNAIL_SIZE - thumbnailHeight) / 2;
+
+    // Every thumbnail pixel averages the block of image pixels it covers.
+    for (int y = 0; y < thumbnailHeight; ++y) {
+        const int y0 = y * height / thumbnailHeight;
+        const int y1 = (y + 1) * height / thumbnailHeight > y0 ? (y + 1) * height / thumbnailHeight : y0 + 1;
+
+        for (int x = 0; x < thumbnailWidth; ++x) {
+            const int x0 = x * width / thumbnailWidth;
+            const int x1 = (x + 1) * width / thumbnailWidth > x0 ? (x + 1) * width / thumbnailWidth : x0 + 1;
+
+            uint32_t sums[4] = {};
+
+            for (int sourceY = y0; sourceY < y1; ++sourceY) {
+                for (int sourceX = x0; sourceX < x1; ++sourceX) {
+                    for (int c = 0; c < 4; ++c) {
+                        sums[c] += image[4 * ((size_t)sourceY * width + sourceX) + c];
+                    }
+                }
+            }
+
+            const uint32_t count = (y1 - y0) * (x1 - x0);
+            uint8_t* pixel = pixels + 4 * ((offsetY + y) * THUMBNAIL_SIZE + offsetX + x);
+
+            for (int c = 0; c < 4; ++c) {
+                pixel[c] = (uint8_t)(sums[c] / count);
+            }
+        }
+    }
+}
+
+static void multiplyMatrices(const float* a, const float* b, float* result) {
+    for (int column = 0; column < 4; ++column) {
+        for (int row = 0; row < 4; ++row) {
+            result[column * 4 + row] = a[row] * b[column * 4] + a[4 + row] * b[column * 4 + 1] +
+                                       a[8 + row] * b[column * 4 + 2] + a[12 + row] * b[column * 4 + 3];
+        }
+    }
+}
+
+// Draws the scene's geometry from above and to the side with a z-buffer and flat shading.
+static bool renderSceneThumbnail(const MappedFile& file, uint8_t* pixels) {
+    const CookedAssetHeader& header = *(const CookedAssetHeader*)file.data;
+    const CookedMesh* meshes = (const CookedMesh*)(file.data + header.meshesOffset);
+    const CookedMeshLod* lods = (const CookedMeshLod*)(file.data + header.lodsOffset);
+    const ModelNode* nodes = (const ModelNode*)(file.data + header.nodesOffset);
+    const QuantizedVertex* vertices = (const QuantizedVertex*)(file.data + header.verticesOffset);
+    const uint32_t* indices = (const uint32_t*)(file.data + header.indicesOffset);
+
+    if (header.nodeCount == 0) {
+        return false;
+    }
+
+    // Compute the node transforms and fold in the view rotation.
+    const float yaw = 0.7854f;
+    const float pitch = 0.5236f;
+
+    const float view[16] = {
+        cosf(yaw),  sinf(pitch) * sinf(yaw), -cosf(pitch) * sinf(yaw), 0.0f,
+        0.0f,       cosf(pitch),             sinf(pitch),              0.0f,
+        sinf(yaw), -sinf(pitch) * cosf(yaw),  cosf(pitch) * cosf(yaw),  0.0f,
+        0.0f,       0.0f,                    0.0f,                     1.0f
+    };
+
+    float* transforms = new float[16 * header.nodeCount];
+
+    for (uint32_t i = 0; i < header.nodeCount; ++i) {
+        const bool hasParent = nodes[i].parent >= 0 && (uint32_t)nodes[i].parent < i;
+        const float* parentTransform = hasParent ? transforms + 16 * nodes[i].parent : view;
+        multiplyMatrices(parentTransform, nodes[i].transform, transforms + 16 * i);
+    }
+
+    auto forEachTriangle = [&](auto function) {
+        for (uint32_t i = 0; i < header.nodeCount; ++i) {
+            const float* m = transforms + 16 * i;
+
+            for (uint32_t j = nodes[i].firstMesh; j < nodes[i].firstMesh + nodes[i].meshCount && j < header.meshCount; ++j) {
+                const CookedMesh& mesh = meshes[j];
+                const CookedMeshLod& lod = lods[mesh.firstLod];
+
+                for (uint32_t k = 0; k + 2 < lod.indexCount; k += 3) {
+                    float triangle[3][3];
+
+                    for (uint32_t v = 0; v < 3; ++v) {
+                        const uint64_t index = (uint64_t)lod.firstIndex + k + v;
+                        const uint64_t vertexIndex = index < header.indexCount ? (uint64_t)mesh.firstVertex + indices[index] : header.vertexCount;
+
+                        if (vertexIndex >= header.vertexCount) {
+                            return;
+                        }
+
+                        float p[3];
+                        dequantizePositions(vertices + vertexIndex, 1, mesh.positionOffset, mesh.positionScale, p);
+
+                        for (uint32_t c = 0; c < 3; ++c) {
+                            triangle[v][c] = m[c] * p[0] + m[4 + c] * p[1] + m[8 + c] * p[2] + m[12 + c];
+                        }
+                    }
+
+                    function(triangle);
+                }
+            }
+        }
+    };
+
+    // Find the bounds of the view, to fit the scene in the thumbnail.
+    float minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY;
+
+    forEachTriangle([&](const float (&triangle)[3][3]) {
+        for (uint32_t v = 0; v < 3; ++v) {
+            minX = fminf(minX, triangle[v][0]);
+            maxX = fmaxf(maxX, triangle[v][0]);
+            minY = fminf(minY, triangle[v][1]);
+            maxY = fmaxf(maxY, triangle[v][1]);
+        }
+    });
+
+    if (!(minX <= maxX)) {
+        delete[] transforms;
+        return false;
+    }
+
+    const uint32_t size = THUMBNAIL_SIZE * sceneSupersampling;
+    const float extent = fmaxf(fmaxf(maxX - minX, maxY - minY), 1e-6f);
+    const float scale = 0.9f * size / extent;
+    const float centerX = 0.5f * (minX + maxX);
+    const float centerY = 0.5f * (minY + maxY);
+
+    float* depths = new float[size * size];
+    float* shades = new float[size * size];
+
+    for (uint32_t i = 0; i < size * size; ++i) {
+        depths[i] = -INFINITY;
+        shades[i] = -1.0f;
+    }
+
+    forEachTriangle([&](const float (&triangle)[3][3]) {
+        float x[3], y[3];
+
+        for (uint32_t v = 0; v < 3; ++v) {
+            x[v] = (triangle[v][0] - centerX) * scale + 0.5f * size;
+            y[v] = (centerY - triangle[v][1]) * scale + 0.5f * size;
+        }
+
+        const float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+
+        if (fabsf(area) < 1e-12f) {
+            return;
+        }
+
+        // Both sides are lit, with a light over the camera's shoulder.
+        const float e1[3] = { triangle[1][0] - triangle[0][0], triangle[1][1] - triangle[0][1], triangle[1][2] - triangle[0][2] };
+        const float e2[3] = { triangle[2][0] - triangle[0][0], triangle[2][1] - triangle[0][1], triangle[2][2] - triangle[0][2] };
+        const float normal[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+        const float length = sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+        const float light = length > 0.0f ? fabsf(0.3f * normal[0] + 0.6f * normal[1] + 0.742f * normal[2]) / length : 0.0f;
+        const float shade = 0.25f + 0.75f * light;
+
+        const int beginX = (int)fmaxf(floorf(fminf(fminf(x[0], x[1]), x[2])), 0.0f);
+        const int endX = (int)fminf(ceilf(fmaxf(fmaxf(x[0], x[1]), x[2])), (float)size);
+        const int beginY = (int)fmaxf(floorf(fminf(fminf(y[0], y[1]), y[2])), 0.0f);
+        const int endY = (int)fminf(ceilf(fmaxf(fmaxf(y[0], y[1]), y[2])), (float)size);
+
+        for (int py = beginY; py < endY; ++py) {
+            for (int px = beginX; px < endX; ++px) {
+                const float sampleX = px + 0.5f;
+                const float sampleY = py + 0.5f;
+
+                const float w0 = ((x[1] - sampleX) * (y[2] - sampleY) - (x[2] - sampleX) * (y[1] - sampleY)) / area;
+                const float w1 = ((x[2] - sampleX) * (y[0] - sampleY) - (x[0] - sampleX) * (y[2] - sampleY)) / area;
+                const float w2 = 1.0f - w0 - w1;
+
+                if (w0 < 0.0f || w1 < 0.0f || w2 < 0.0f) {
+                    continue;
+                }
+
+                // The camera looks down -Z, so the closest surface has the greatest depth.
+                const float depth = w0 * triangle[0][2] + w1 * triangle[1][2] + w2 * triangle[2][2];
+                const uint32_t pixel = py * size + px;
+
+                if (depth > depths[pixel]) {
+                    depths[pixel] = depth;
+                    shades[pixel] = shade;
+                }
+            }
+        }
+    });
+
+    // Resolve the samples into the thumbnail.
+    for (uint32_t y = 0; y < THUMBNAIL_SIZE; ++y) {
+        for (uint32_t x = 0; x < THUMBNAIL_SIZE; ++x) {
+            float shade = 0.0f;
+            float coverage = 0.0f;
+
+            for (uint32_t sy = 0; sy < sceneSupersampling; ++sy) {
+                for (uint32_t sx = 0; sx < sceneSupersampling; ++sx) {
+                    const float sample = shades[(y * sceneSupersampling + sy) * size + x * sceneSupersampling + sx];
+
+                    if (sample >= 0.0f) {
+                        shade += sample;
+                        coverage += 1.0f;
+                    }
+                }
+            }
+
+            uint8_t* pixel = pixels + 4 * (y * THUMBNAIL_SIZE + x);
+            const float value = coverage > 0.0f ? shade / coverage : 0.0f;
+
+            pixel[0] = (uint8_t)(value * 200.0f);
+            pixel[1] = (uint8_t)(value * 210.0f);
+            pixel[2] = (uint8_t)(value * 230.0f);
+            pixel[3] = (uint8_t)(coverage / (sceneSupersampling * sceneSupersampling) * 255.0f);
+        }
+    }
+
+    delete[] shades;
+    delete[] depths;
+    delete[] transforms;
+
+    return true;
+}
+
+// Scenes are drawn from their cooked asset, so they only have a thumbnail once they've been imported.
+static bool generateThumbnail(const std::filesystem::path& path, const std::filesystem::path& projectPath, const std::filesystem::path& cookedDirectoryPath, uint8_t* pixels) {
+    const bool scene = hasExtension(path.extension(), sceneExtensions, ARRAY_SIZE(sceneExtensions));
+
+    const std::filesystem::path sourcePath = scene ? getCookedAssetPath(projectPath, path) : path;
+
+    MappedFile file(sourcePath);
+
+    if (file.data == nullptr || (scene && !isValidCookedAsset(file))) {
+        file.destroy();
+        return false;
+    }
+
+    // Look the thumbnail up on disk by the contents of the file.
+    char cacheName[32];
+    snprintf(cacheName, sizeof(cacheName), "%016llx", (unsigned long long)hashData(file.data, file.size, thumbnailVersion));
+
+    const std::filesystem::path cacheDirectoryPath = cookedDirectoryPath / "Thumbnails";
+    const std::filesystem::path cachePath = cacheDirectoryPath / cacheName;
+
+    MappedFile cacheFile(cachePath);
+
+    if (cacheFile.data != nullptr && cacheFile.size == thumbnailByteCount) {
+        memcpy(pixels, cacheFile.data, thumbnailByteCount);
+
+        cacheFile.destroy();
+        file.destroy();
+
+        return true;
+    }
+
+    cacheFile.destroy();
+
+    bool rendered = false;
+
+    if (scene) {
+        rendered = renderSceneThumbnail(file, pixels);
+    } else {
+        int width, height, channelCount;
+        uint8_t* image = stbi_load_from_memory(file.data, (int)file.size, &width, &height, &channelCount, 4);
+
+        if (image != nullptr) {
+            renderImageThumbnail(image, width, height, pixels);
+            stbi_image_free(image);
+
+            rendered = true;
+        }
+    }
+
+    file.destroy();
+
+    if (!rendered) {
+        return false;
+    }
+
+    // Store the thumbnail, moving it into place once it's complete since other jobs may be reading the cache.
+    std::error_code error;
+    std::filesystem::create_directories(cacheDirectoryPath, error);
+
+    std::filesystem::path temporaryPath = cachePath;
+    temporaryPath += ".tmp";
+
+    MappedFile temporaryFile(temporaryPath, thumbnailByteCount);
+
+    if (temporaryFile.data != nullptr) {
+        memcpy(temporaryFile.data, pixels, thumbnailByteCount);
+        const bool flushed = temporaryFile.flush();
+        temporaryFile.destroy();
+
+        if (flushed) {
+            std::filesystem::rename(temporaryPath, cachePath, error);
+        } else {
+            std::filesystem::remove(temporaryPath, error);
+        }
+    }
+
+    return true;
+}
+
+ThumbnailCache::ThumbnailCache(Device& device, JobSystem& jobSystem)
+        : jobSystem(&jobSystem), frame(0), atlasInitialized(false), freeTileCount(0) {
+    jobCounter = new JobCounter(0);
+    mutex = new std::mutex;
+
+    atlas = Texture(device, VK_FORMAT_R8G8B8A8_UNORM, THUMBNAIL_ATLAS_SIZE, THUMBNAIL_ATLAS_SIZE, 1);
+    uploader = Uploader(device, stagingCapacity);
+
+    VkSamplerCreateInfo samplerCreateInfo = {
+        .sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext                   = nullptr,
+        .flags                   = 0,
+        .magFilter               = VK_FILTER_LINEAR,
+        .minFilter               = VK_FILTER_LINEAR,
+        .mipmapMode              = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+        .addressModeU            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeV            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .addressModeW            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+        .mipLodBias              = 0.0f,
+        .anisotropyEnable        = VK_FALSE,
+        .maxAnisotropy           = 1.0f,
+        .compareEnable           = VK_FALSE,
+        .compareOp               = VK_COMPARE_OP_NEVER,
+        .minLod                  = 0.0f,
+        .maxLod                  = 0.0f,
+        .borderColor             = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+
+    vkCreateSampler(device.logical, &samplerCreateInfo, nullptr, &sampler);
+    descriptorSet = ImGui_ImplVulkan_AddTexture(sampler, atlas.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+    tileOwners = new std::string[atlasTileCount];
+    freeTiles = new uint32_t[atlasTileCount];
+
+    for (uint32_t i = 0; i < atlasTileCount; ++i) {
+        freeTiles[freeTileCount++] = atlasTileCount - 1 - i;
+    }
+}
+
+void ThumbnailCache::destroy(VkDevice device) {
+    open(std::filesystem::path());
+
+    delete[] freeTiles;
+    delete[] tileOwners;
+
+    ImGui_ImplVulkan_RemoveTexture(descriptorSet);
+    vkDestroySampler(device, sampler, nullptr);
+
+    uploader.destroy(device);
+    atlas.destroy(device);
+
+    delete mutex;
+    delete jobCounter;
+}
+
+void ThumbnailCache::open(const std::filesystem::path& projectPath, const std::filesystem::path& cookedDirectoryPath) {
+    // Drop everything that belongs to the previous project.
+    jobSystem->wait(*jobCounter);
+
+    for (GeneratedThumbnail& generatedThumbnail : generatedThumbnails) {
+        delete[] generatedThumbnail.pixels;
+    }
+
+    generatedThumbnails.clear();
+    thumbnails.clear();
+    queue.clear();
+
+    freeTileCount = 0;
+
+    for (uint32_t i = 0; i < atlasTileCount; ++i) {
+        tileOwners[i].clear();
+        freeTiles[freeTileCount++] = atlasTileCount - 1 - i;
+    }
+
+    this->projectPath = projectPath;
+    this->cookedDirectoryPath = cookedDirectoryPath;
+}
+
+bool ThumbnailCache::getThumbnail(const std::filesystem::path& path, ImVec2& uv0, ImVec2& uv1) {
+    const std::filesystem::path extension = path.extension();
+
+    if (!hasExtension(extension, imageExtensions, ARRAY_SIZE(imageExtensions)) &&
+        !hasExtension(extension, sceneExtensions, ARRAY_SIZE(sceneExtensions))) {
+        return false;
+    }
+
+    auto [it, inserted] = thumbnails.try_emplace(path.string(), Thumbnail{ THUMBNAIL_STATE_QUEUED, UINT32_MAX, frame });
+    Thumbnail& thumbnail = it->second;
+
+    thumbnail.lastUsedFrame = frame;
+
+    if (inserted) {
+        queue.push_back(it->first);
+    }
+
+    if (thumbnail.state != THUMBNAIL_STATE_RESIDENT) {
+        return false;
+    }
+
+    const float tileSize = (float)THUMBNAIL_SIZE / THUMBNAIL_ATLAS_SIZE;
+
+    uv0 = ImVec2((thumbnail.tile % atlasTilesPerRow) * tileSize, (thumbnail.tile / atlasTilesPerRow) * tileSize);
+    uv1 = ImVec2(uv0.x + tileSize, uv0.y + tileSize);
+
+    return true;
+}
+
+ImTextureID ThumbnailCache::getAtlas() {
+    return (ImTextureID)descriptorSet;
+}
+
+void ThumbnailCache::update(Device& device) {
+    // Start generating the queued thumbnails that are still on screen, without taking every worker from other jobs.
+    while (*jobCounter < jobSystem->getThreadCount() && !queue.empty()) {
+        std::string path = std::move(queue.front());
+        queue.pop_front();
+
+        auto it = thumbnails.find(path);
+
+        if (it == thumbnails.end() || it->second.state != THUMBNAIL_STATE_QUEUED) {
+            continue;
+        }
+
+        // Scrolled past, it's queued again if it comes back on screen.
+        if (it->second.lastUsedFrame < frame) {
+            thumbnails.erase(it);
+            continue;
+        }
+
+        it->second.state = THUMBNAIL_STATE_GENERATING;
+
+        jobSystem->submit([this, path, projectPath = projectPath, cookedDirectoryPath = cookedDirectoryPath]() {
+            uint8_t* pixels = new uint8_t[thumbnailByteCount];
+
+            if (!generateThumbnail(path, projectPath, cookedDirectoryPath, pixels)) {
+                delete[] pixels;
+                pixels = nullptr;
+            }
+
+            std::lock_guard<std::mutex> lock(*mutex);
+            generatedThumbnails.push_back({ path, pixels });
+        }, jobCounter);
+    }
+
+    // Upload the finished thumbnails, as many as fit in this frame's staging memory.
+    std::vector<GeneratedThumbnail> finishedThumbnails;
+
+    {
+        std::lock_guard<std::mutex> lock(*mutex);
+        finishedThumbnails.swap(generatedThumbnails);
+    }
+
+    size_t uploadedCount = 0;
+
+    for (; uploadedCount < finishedThumbnails.size(); ++uploadedCount) {
+        GeneratedThumbnail& finishedThumbnail = finishedThumbnails[uploadedCount];
+        Thumbnail& thumbnail = thumbnails[finishedThumbnail.path];
+
+        if (finishedThumbnail.pixels == nullptr) {
+            thumbnail.state = THUMBNAIL_STATE_UNAVAILABLE;
+            continue;
+        }
+
+        VkDeviceSize stagingOffset;
+
+        if (!uploader.allocate(thumbnailByteCount, 16, &stagingOffset)) {
+            break;
+        }
+
+        const uint32_t tile = allocateTile();
+
+        if (tile == UINT32_MAX) {
+            // Every tile is on screen, the thumbnail is generated again once some scroll away.
+            thumbnails.erase(finishedThumbnail.path);
+            delete[] finishedThumbnail.pixels;
+            continue;
+        }
+
+        memcpy(uploader.getData() + stagingOffset, finishedThumbnail.pixels, thumbnailByteCount);
+        delete[] finishedThumbnail.pixels;
+
+        const VkOffset2D offset = { (int32_t)((tile % atlasTilesPerRow) * THUMBNAIL_SIZE), (int32_t)((tile / atlasTilesPerRow) * THUMBNAIL_SIZE) };
+        const VkImageLayout oldLayout = atlasInitialized ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+
+        uploader.copyToImageRegion(atlas, oldLayout, offset, { THUMBNAIL_SIZE, THUMBNAIL_SIZE }, stagingOffset);
+        atlasInitialized = true;
+
+        thumbnail.state = THUMBNAIL_STATE_RESIDENT;
+        thumbnail.tile = tile;
+        tileOwners[tile] = finishedThumbnail.path;
+    }
+
+    // Keep the rest for the next frame.
+    if (uploadedCount < finishedThumbnails.size()) {
+        std::lock_guard<std::mutex> lock(*mutex);
+        generatedThumbnails.insert(generatedThumbnails.begin(), finishedThumbnails.begin() + uploadedCount, finishedThumbnails.end());
+    }
+
+    uploader.flush(device);
+
+    ++frame;
+}
+
+uint32_t ThumbnailCache::allocateTile() {
+    if (freeTileCount > 0) {
+        return freeTiles[--freeTileCount];
+    }
+
+    // Reuse the tile that was shown least recently, as long as it isn't on screen.
+    uint32_t leastRecentlyUsedTile = UINT32_MAX;
+    uint64_t leastRecentlyUsedFrame = frame;
+
+    for (uint32_t i = 0; i < atlasTileCount; ++i) {
+        auto it = thumbnails.find(tileOwners[i]);
+
+        if (it == thumbnails.end()) {
+            continue;
+        }
+
+        if (it->second.lastUsedFrame < leastRecentlyUsedFrame) {
+            leastRecentlyUsedTile = i;
+            leastRecentlyUsedFrame = it->second.lastUsedFrame;
+        }
+    }
+
+    if (leastRecentlyUsedTile != UINT32_MAX) {
+        thumbnails.erase(tileOwners[leastRecentlyUsedTile]);
+    }
+
+    return leastRecentlyUsedTile;
+}
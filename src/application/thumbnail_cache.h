@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <imgui.h>
+
+#include <jobs.h>
+#include <texture.h>
+#include <upload.h>
+
+#define THUMBNAIL_SIZE 64
+#define THUMBNAIL_ATLAS_SIZE 2048
+
+// Thumbnails of the images and scenes in the project browser. They are rendered on the job system, kept on disk under
+// Cooked/Thumbnails keyed by the hash of the file they were made from, and uploaded into tiles of an atlas texture,
+// whose least recently shown tiles are reused once it's full.
+class ThumbnailCache {
+public:
+    ThumbnailCache() = default;
+    ThumbnailCache(Device& device, JobSystem& jobSystem);
+    void destroy(VkDevice device);
+
+    // Scenes are drawn from the assets cooked for the project at the path. The cooked directory also holds the thumbnails.
+    void open(const std::filesystem::path& projectPath, const std::filesystem::path& cookedDirectoryPath);
+
+    // Returns false until the file's thumbnail is in the atlas, and queues it up the first time it's asked for. Only
+    // files that are on screen should be asked for, those that aren't asked for again are skipped.
+    bool getThumbnail(const std::filesystem::path& path, ImVec2& uv0, ImVec2& uv1);
+    ImTextureID getAtlas();
+
+    // Starts generating queued thumbnails and uploads the finished ones, once per frame.
+    void update(Device& device);
+
+private:
+    enum ThumbnailState {
+        THUMBNAIL_STATE_QUEUED,
+        THUMBNAIL_STATE_GENERATING,
+        THUMBNAIL_STATE_RESIDENT,
+        THUMBNAIL_STATE_UNAVAILABLE
+    };
+
+    struct Thumbnail {
+        ThumbnailState state;
+        uint32_t tile;
+        uint64_t lastUsedFrame;
+    };
+
+    struct GeneratedThumbnail {
+        std::string path;
+        uint8_t* pixels;
+    };
+
+    JobSystem* jobSystem;
+    JobCounter* jobCounter;
+    std::filesystem::path projectPath;
+    std::filesystem::path cookedDirectoryPath;
+    uint64_t frame;
+
+    Texture atlas;
+    bool atlasInitialized;
+    VkSampler sampler;
+    VkDescriptorSet descriptorSet;
+    Uploader uploader;
+
+    std::unordered_map<std::string, Thumbnail> thumbnails;
+    std::deque<std::string> queue;
+    std::string* tileOwners;
+    uint32_t* freeTiles;
+    uint32_t freeTileCount;
+
+    // Filled by the jobs.
+    std::mutex* mutex;
+    std::vector<GeneratedThumbnail> generatedThumbnails;
+
+    uint32_t allocateTile();
+};
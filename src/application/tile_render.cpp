@@ -0,0 +1,849 @@
+#include "tile_render.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <denoiser.h>
+#include <image.h>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+typedef SOCKET SocketHandle;
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+typedef int SocketHandle;
+
+extern char** environ;
+#endif
+
+// Workers get this many tasks ahead, so they trace the next one while the last is read back and sent.
+#define TILE_TASKS_PER_WORKER 2
+
+// How long the coordinator waits for the spawned workers to connect, creating a device and its pipelines takes a while.
+#define TILE_CONNECT_TIMEOUT_MILLISECONDS 60000
+
+// A worker is lost once its next result takes this many times as long as tasks take on average for the tasks it has, and
+// never before the minimum, which also covers the first tasks, before there's an average.
+#define TILE_RESULT_TIMEOUT_FACTOR 8
+#define TILE_MIN_RESULT_TIMEOUT_MILLISECONDS 30000
+
+#ifdef _WIN32
+#define INVALID_HANDLE ((intptr_t)INVALID_SOCKET)
+#define closeSocket closesocket
+#else
+#define INVALID_HANDLE ((intptr_t)-1)
+#define closeSocket ::close
+#endif
+
+#ifdef MSG_NOSIGNAL
+#define SEND_FLAGS MSG_NOSIGNAL
+#else
+#define SEND_FLAGS 0
+#endif
+
+static void initializeSockets() {
+#ifdef _WIN32
+    static bool initialized = false;
+
+    if (!initialized) {
+        WSADATA data;
+        WSAStartup(MAKEWORD(2, 2), &data);
+        initialized = true;
+    }
+#endif
+}
+
+static sockaddr_in getLoopbackAddress(uint16_t port) {
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    return address;
+}
+
+// Whether the socket can be read within the timeout, a negative one waits for good.
+static bool waitForSocket(intptr_t handle, int timeoutMilliseconds) {
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET((SocketHandle)handle, &readSet);
+
+    timeval timeout = {
+        .tv_sec  = timeoutMilliseconds / 1000,
+        .tv_usec = (timeoutMilliseconds % 1000) * 1000
+    };
+
+    return select((int)handle + 1, &readSet, nullptr, nullptr, timeoutMilliseconds < 0 ? nullptr : &timeout) > 0;
+}
+
+static int getMillisecondsUntil(std::chrono::steady_clock::time_point deadline) {
+    const auto remainingTime = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+
+    return (int)std::max<int64_t>(remainingTime.count(), 0);
+}
+
+TileConnection TileConnection::connect(uint16_t port) {
+    initializeSockets();
+
+    TileConnection connection;
+    connection.handle = (intptr_t)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    if (connection.handle == INVALID_HANDLE) {
+        return connection;
+    }
+
+    sockaddr_in address = getLoopbackAddress(port);
+
+    if (::connect((SocketHandle)connection.handle, (sockaddr*)&address, sizeof(address)) != 0) {
+        connection.close();
+        return connection;
+    }
+
+    // Messages are written in one go, there's nothing to gain from delaying them.
+    int noDelay = 1;
+    setsockopt((SocketHandle)connection.handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+
+    return connection;
+}
+
+bool TileConnection::isValid() {
+    return handle != INVALID_HANDLE;
+}
+
+bool TileConnection::poll(int timeoutMilliseconds) {
+    return waitForSocket(handle, timeoutMilliseconds);
+}
+
+bool TileConnection::send(const void* data, size_t size) {
+    const char* bytes = (const char*)data;
+
+    while (size > 0) {
+        const int chunkSize = (int)(size < INT32_MAX ? size : INT32_MAX);
+        const int sentSize = ::send((SocketHandle)handle, bytes, chunkSize, SEND_FLAGS);
+
+        if (sentSize <= 0) {
+            return false;
+        }
+
+        bytes += sentSize;
+        size -= sentSize;
+    }
+
+    return true;
+}
+
+bool TileConnection::sendMessage(TileMessageType type, const void* payload, size_t payloadSize, const void* data, size_t dataSize) {
+    TileMessageHeader header = {
+        .type = (uint32_t)type,
+        .size = (uint32_t)(payloadSize + dataSize)
+    };
+
+    return send(&header, sizeof(header)) && send(payload, payloadSize) && send(data, dataSize);
+}
+
+bool TileConnection::receive(void* data, size_t size, int timeoutMilliseconds) {
+    char* bytes = (char*)data;
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMilliseconds);
+
+    while (size > 0) {
+        if (timeoutMilliseconds >= 0 && !waitForSocket(handle, getMillisecondsUntil(deadline))) {
+            return false;
+        }
+
+        const int chunkSize = (int)(size < INT32_MAX ? size : INT32_MAX);
+        const int receivedSize = recv((SocketHandle)handle, bytes, chunkSize, 0);
+
+        if (receivedSize <= 0) {
+            return false;
+        }
+
+        bytes += receivedSize;
+        size -= receivedSize;
+    }
+
+    return true;
+}
+
+void TileConnection::close() {
+    if (handle != INVALID_HANDLE) {
+        closeSocket((SocketHandle)handle);
+        handle = INVALID_HANDLE;
+    }
+}
+
+TileListener TileListener::listen() {
+    initializeSockets();
+
+    TileListener listener;
+    listener.handle = (intptr_t)socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+
+    if (listener.handle == INVALID_HANDLE) {
+        return listener;
+    }
+
+    // Port 0 lets the system pick a free one, which is read back for the workers.
+    sockaddr_in address = getLoopbackAddress(0);
+    socklen_t addressSize = sizeof(address);
+
+    if (bind((SocketHandle)listener.handle, (sockaddr*)&address, sizeof(address)) != 0 || ::listen((SocketHandle)listener.handle, SOMAXCONN) != 0 ||
+        getsockname((SocketHandle)listener.handle, (sockaddr*)&address, &addressSize) != 0) {
+        listener.close();
+        return listener;
+    }
+
+    listener.port = ntohs(address.sin_port);
+
+    return listener;
+}
+
+bool TileListener::isValid() {
+    return handle != INVALID_HANDLE;
+}
+
+TileConnection TileListener::accept(int timeoutMilliseconds) {
+    TileConnection connection;
+
+    if (!waitForSocket(handle, timeoutMilliseconds)) {
+        return connection;
+    }
+
+    connection.handle = (intptr_t)::accept((SocketHandle)handle, nullptr, nullptr);
+
+    if (connection.isValid()) {
+        int noDelay = 1;
+        setsockopt((SocketHandle)connection.handle, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
+    }
+
+    return connection;
+}
+
+void TileListener::close() {
+    if (handle != INVALID_HANDLE) {
+        closeSocket((SocketHandle)handle);
+        handle = INVALID_HANDLE;
+    }
+}
+
+// Starts a worker process on the device at its index in the ranking. Returns its handle, or -1 if it couldn't be started.
+static intptr_t spawnWorker(const DistributedRenderSettings& settings, uint16_t port, uint32_t workerIndex) {
+    const std::string executable = settings.executablePath.string();
+    const std::string project = settings.projectPath.string();
+    const std::string portArgument = std::to_string(port);
+    const std::string rankArgument = std::to_string(workerIndex);
+    const std::string sizeArgument = std::to_string(settings.tileSize) + "x" + std::to_string(settings.tileSize);
+
+#ifdef _WIN32
+    std::string commandLine = "\"" + executable + "\" \"" + project + "\" --worker " + portArgument + " --device-rank " + rankArgument + " --size " + sizeArgument;
+
+    STARTUPINFOA startupInfo = {};
+    startupInfo.cb = sizeof(startupInfo);
+
+    PROCESS_INFORMATION processInfo;
+
+    if (!CreateProcessA(nullptr, commandLine.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo, &processInfo)) {
+        return -1;
+    }
+
+    CloseHandle(processInfo.hThread);
+
+    return (intptr_t)processInfo.hProcess;
+#else
+    const char* arguments[] = {
+        executable.c_str(), project.c_str(),
+        "--worker", portArgument.c_str(),
+        "--device-rank", rankArgument.c_str(),
+        "--size", sizeArgument.c_str(),
+        nullptr
+    };
+
+    pid_t processId;
+
+    if (posix_spawnp(&processId, arguments[0], nullptr, nullptr, (char* const*)arguments, environ) != 0) {
+        return -1;
+    }
+
+    return (intptr_t)processId;
+#endif
+}
+
+// Waits for a worker to exit, killing it first if it never connected or was lost.
+static void joinWorker(intptr_t process, bool kill) {
+#ifdef _WIN32
+    if (kill) {
+        TerminateProcess((HANDLE)process, EXIT_FAILURE);
+    }
+
+    WaitForSingleObject((HANDLE)process, INFINITE);
+    CloseHandle((HANDLE)process);
+#else
+    if (kill) {
+        ::kill((pid_t)process, SIGKILL);
+    }
+
+    waitpid((pid_t)process, nullptr, 0);
+#endif
+}
+
+bool renderDistributed(const DistributedRenderSettings& settings, FILE* report) {
+    const BatchRenderSettings& batch = settings.batch;
+
+    std::error_code error;
+    std::filesystem::create_directories(batch.outputDirectory, error);
+
+    if (error) {
+        return false;
+    }
+
+    TileListener listener = TileListener::listen();
+
+    if (!listener.isValid()) {
+        return false;
+    }
+
+    // Split every frame into tiles, and every tile into tasks of consecutive samples.
+    struct Task {
+        TileTask tileTask;
+        uint32_t runningCount;
+        bool done;
+        std::chrono::steady_clock::time_point startTime;
+    };
+
+    struct Frame {
+        float* accumulation = nullptr;
+        uint32_t remainingTaskCount = 0;
+        std::chrono::steady_clock::time_point startTime;
+    };
+
+    const uint32_t tileCountX = (settings.extent.width + settings.tileSize - 1) / settings.tileSize;
+    const uint32_t tileCountY = (settings.extent.height + settings.tileSize - 1) / settings.tileSize;
+
+    std::vector<Task> tasks;
+    std::vector<Frame> frames(batch.lastFrame - batch.firstFrame + 1);
+
+    for (uint32_t frame = batch.firstFrame; frame <= batch.lastFrame; ++frame) {
+        for (uint32_t tileY = 0; tileY < tileCountY; ++tileY) {
+            for (uint32_t tileX = 0; tileX < tileCountX; ++tileX) {
+                const uint32_t x = tileX * settings.tileSize;
+                const uint32_t y = tileY * settings.tileSize;
+
+                for (uint32_t firstSample = 0; firstSample < batch.sampleCount; firstSample += settings.samplesPerTask) {
+                    TileTask tileTask = {
+                        .id          = (uint32_t)tasks.size(),
+                        .frame       = frame,
+                        .offset      = { x, y },
+                        .extent      = { std::min(settings.tileSize, settings.extent.width - x), std::min(settings.tileSize, settings.extent.height - y) },
+                        .imageExtent = { settings.extent.width, settings.extent.height },
+                        .firstSample = firstSample,
+                        .sampleCount = std::min(settings.samplesPerTask, batch.sampleCount - firstSample)
+                    };
+
+                    tasks.push_back({ tileTask, 0, false, {} });
+                    ++frames[frame - batch.firstFrame].remainingTaskCount;
+                }
+            }
+        }
+    }
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<uint32_t> queue;
+    uint32_t remainingTaskCount = (uint32_t)tasks.size();
+    uint32_t writtenFrameCount = 0;
+    uint32_t failedFrameCount = 0;
+    double finishedTaskTime = 0.0;
+    uint32_t finishedTaskCount = 0;
+
+    for (uint32_t i = 0; i < tasks.size(); ++i) {
+        queue.push_back(i);
+    }
+
+    JobSystem jobSystem;
+
+    // Takes the next queued task or, once the queue is empty, the one that has been running the longest on another
+    // worker, if it's been running longer than tasks take on average. Returns UINT32_MAX when there's nothing to take.
+    // The mutex must be held.
+    auto takeTask = [&](const std::vector<uint32_t>& outstanding) {
+        const auto now = std::chrono::steady_clock::now();
+
+        while (!queue.empty()) {
+            const uint32_t id = queue.front();
+            queue.pop_front();
+
+            if (!tasks[id].done) {
+                if (tasks[id].runningCount++ == 0) {
+                    tasks[id].startTime = now;
+                }
+
+                return id;
+            }
+        }
+
+        uint32_t slowest = UINT32_MAX;
+
+        for (uint32_t i = 0; i < tasks.size(); ++i) {
+            const Task& task = tasks[i];
+
+            if (task.done || task.runningCount != 1 || std::find(outstanding.begin(), outstanding.end(), i) != outstanding.end()) {
+                continue;
+            }
+
+            if (slowest == UINT32_MAX || task.startTime < tasks[slowest].startTime) {
+                slowest = i;
+            }
+        }
+
+        if (slowest == UINT32_MAX || finishedTaskCount == 0) {
+            return UINT32_MAX;
+        }
+
+        const std::chrono::duration<double, std::milli> runningTime = now - tasks[slowest].startTime;
+
+        if (runningTime.count() < finishedTaskTime / finishedTaskCount) {
+            return UINT32_MAX;
+        }
+
+        ++tasks[slowest].runningCount;
+
+        return slowest;
+    };
+
+    // Divides the weighted sum of a finished frame by its sample count, denoises it if the batch is, and writes it. Frames
+    // finish in any order, so each one is denoised by itself, without the history of the one before. The squared error
+    // against the reference is negative without one.
+    auto writeFrame = [&](uint32_t frame, float* accumulation, double* squaredError) {
+        const size_t valueCount = 4 * (size_t)settings.extent.width * settings.extent.height;
+        const float weight = 1.0f / (float)batch.sampleCount;
+
+        for (size_t i = 0; i < valueCount; ++i) {
+            accumulation[i] *= weight;
+        }
+
+        if (batch.denoise) {
+            float* denoised = new float[valueCount];
+
+            const DenoiserFrame denoiserFrame = {
+                .width  = settings.extent.width,
+                .height = settings.extent.height,
+                .color  = accumulation
+            };
+
+            Denoiser denoiser;
+            denoiser.denoise(jobSystem, denoiserFrame, false, denoised);
+
+            delete[] accumulation;
+            accumulation = denoised;
+        }
+
+        uint16_t* pixels = new uint16_t[valueCount];
+        convertToHalf(accumulation, valueCount, pixels);
+
+        char name[32];
+        *squaredError = -1.0;
+
+        if (!batch.referenceDirectory.empty()) {
+            snprintf(name, sizeof(name), "frame_%05u.exr", frame);
+            *squaredError = compareToReference(batch.referenceDirectory / name, settings.extent, pixels);
+        }
+
+        snprintf(name, sizeof(name), "frame_%05u%s", frame, batch.format == CAPTURE_FORMAT_EXR ? ".exr" : ".png");
+
+        const bool written = writeCaptureFile(batch.outputDirectory / name, encodeCapture(jobSystem, batch.format, batch.exrCompression, settings.extent, pixels, 1.0f));
+
+        delete[] pixels;
+        delete[] accumulation;
+
+        return written;
+    };
+
+    // The workers' processes, -1 for those that couldn't be started or have been killed.
+    std::vector<intptr_t> processes(settings.workerCount);
+
+    // Every worker is served by a thread of its own, which keeps it fed with tasks and merges what it sends back.
+    auto serveWorker = [&](uint32_t workerIndex, TileConnection connection) {
+        std::vector<uint32_t> outstanding;
+        std::unique_lock<std::mutex> lock(mutex);
+        bool lost = false;
+
+        while (true) {
+            std::vector<uint32_t> newTasks;
+
+            while (outstanding.size() < TILE_TASKS_PER_WORKER) {
+                const uint32_t id = takeTask(outstanding);
+
+                if (id == UINT32_MAX) {
+                    break;
+                }
+
+                outstanding.push_back(id);
+                newTasks.push_back(id);
+
+                Frame& frame = frames[tasks[id].tileTask.frame - batch.firstFrame];
+
+                if (frame.accumulation == nullptr) {
+                    frame.accumulation = new float[4 * (size_t)settings.extent.width * settings.extent.height]();
+                    frame.startTime = std::chrono::steady_clock::now();
+                }
+            }
+
+            if (outstanding.empty()) {
+                if (remainingTaskCount == 0) {
+                    break;
+                }
+
+                // Nothing left is slow enough to take over yet. Check again once a task finishes or a worker is lost, or
+                // after a while since tasks become slow just by running.
+                condition.wait_for(lock, std::chrono::milliseconds(100));
+                continue;
+            }
+
+            const double averageTaskTime = finishedTaskCount > 0 ? finishedTaskTime / finishedTaskCount : 0.0;
+            const double resultTimeout = std::max(TILE_RESULT_TIMEOUT_FACTOR * averageTaskTime * outstanding.size(), (double)TILE_MIN_RESULT_TIMEOUT_MILLISECONDS);
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds((int64_t)resultTimeout);
+
+            lock.unlock();
+
+            bool connected = true;
+
+            for (uint32_t id : newTasks) {
+                connected = connected && connection.sendMessage(TILE_MESSAGE_TYPE_TASK, &tasks[id].tileTask, sizeof(TileTask));
+            }
+
+            TileMessageHeader header;
+            TileResult result;
+            std::vector<uint16_t> pixels;
+
+            connected = connected && connection.receive(&header, sizeof(header), getMillisecondsUntil(deadline)) && header.type == TILE_MESSAGE_TYPE_RESULT &&
+                        header.size >= sizeof(TileResult) && connection.receive(&result, sizeof(result), getMillisecondsUntil(deadline));
+
+            // The result must be for one of this worker's tasks, and cover its tile.
+            connected = connected && std::find(outstanding.begin(), outstanding.end(), result.taskId) != outstanding.end();
+
+            if (connected) {
+                const TileTask& tileTask = tasks[result.taskId].tileTask;
+                pixels.resize(4 * (size_t)tileTask.extent[0] * tileTask.extent[1]);
+
+                connected = header.size == sizeof(TileResult) + pixels.size() * sizeof(uint16_t) && result.sampleCount == tileTask.sampleCount &&
+                            connection.receive(pixels.data(), pixels.size() * sizeof(uint16_t), getMillisecondsUntil(deadline));
+            }
+
+            lock.lock();
+
+            if (!connected) {
+                const bool timedOut = std::chrono::steady_clock::now() >= deadline;
+
+                // Put what the worker was tracing back in front of the queue, unless another worker is on it.
+                for (uint32_t id : outstanding) {
+                    if (--tasks[id].runningCount == 0 && !tasks[id].done) {
+                        queue.push_front(id);
+                    }
+                }
+
+                fprintf(report, "{\"worker\": %u, \"lost\": true, \"timedOut\": %s, \"outstandingTasks\": %u}\n", workerIndex, timedOut ? "true" : "false",
+                        (uint32_t)outstanding.size());
+                fflush(report);
+
+                condition.notify_all();
+                lost = true;
+                break;
+            }
+
+            outstanding.erase(std::find(outstanding.begin(), outstanding.end(), result.taskId));
+
+            Task& task = tasks[result.taskId];
+            --task.runningCount;
+
+            const std::chrono::duration<double, std::milli> taskTime = std::chrono::steady_clock::now() - task.startTime;
+
+            fprintf(report, "{\"frame\": %u, \"task\": %u, \"worker\": %u, \"samples\": %u, \"taskMs\": %.3f, \"duplicate\": %s}\n", task.tileTask.frame,
+                    result.taskId, workerIndex, result.sampleCount, taskTime.count(), task.done ? "true" : "false");
+            fflush(report);
+
+            // Whichever copy of a task finishes first is kept.
+            if (task.done) {
+                continue;
+            }
+
+            task.done = true;
+            --remainingTaskCount;
+
+            finishedTaskTime += taskTime.count();
+            ++finishedTaskCount;
+
+            const uint32_t frameIndex = task.tileTask.frame - batch.firstFrame;
+            Frame& frame = frames[frameIndex];
+
+            // Merge the tile's average weighted by its sample count. Tasks of the same tile are merged under the mutex,
+            // it's little work next to tracing them.
+            float* linearRow = new float[4 * (size_t)task.tileTask.extent[0]];
+
+            for (uint32_t y = 0; y < task.tileTask.extent[1]; ++y) {
+                convertFromHalf(pixels.data() + 4 * (size_t)task.tileTask.extent[0] * y, 4 * (size_t)task.tileTask.extent[0], linearRow);
+
+                float* destinationRow = frame.accumulation + 4 * ((size_t)settings.extent.width * (task.tileTask.offset[1] + y) + task.tileTask.offset[0]);
+
+                for (uint32_t i = 0; i < 4 * task.tileTask.extent[0]; ++i) {
+                    destinationRow[i] += linearRow[i] * (float)result.sampleCount;
+                }
+            }
+
+            delete[] linearRow;
+
+            condition.notify_all();
+
+            if (--frame.remainingTaskCount == 0) {
+                float* accumulation = frame.accumulation;
+                frame.accumulation = nullptr;
+
+                const std::chrono::duration<double, std::milli> frameTime = std::chrono::steady_clock::now() - frame.startTime;
+
+                double squaredError;
+
+                lock.unlock();
+                const bool written = writeFrame(frameIndex + batch.firstFrame, accumulation, &squaredError);
+                lock.lock();
+
+                written ? ++writtenFrameCount : ++failedFrameCount;
+
+                fprintf(report, "{\"frame\": %u, \"samples\": %u, \"frameMs\": %.3f, \"referenceMse\": %.9g, \"written\": %s}\n", frameIndex + batch.firstFrame,
+                        batch.sampleCount, frameTime.count(), squaredError, written ? "true" : "false");
+                fflush(report);
+            }
+        }
+
+        lock.unlock();
+
+        // A lost worker may be hung rather than gone, it's killed so it lets go of its device.
+        if (lost) {
+            joinWorker(processes[workerIndex], true);
+            processes[workerIndex] = -1;
+        } else {
+            connection.sendMessage(TILE_MESSAGE_TYPE_QUIT, nullptr, 0);
+        }
+
+        connection.close();
+    };
+
+    const auto batchStart = std::chrono::steady_clock::now();
+
+    // Spawn the workers, and serve each one as soon as it connects.
+    uint32_t spawnedWorkerCount = 0;
+
+    for (uint32_t i = 0; i < settings.workerCount; ++i) {
+        processes[i] = spawnWorker(settings, listener.port, i);
+
+        if (processes[i] != -1) {
+            ++spawnedWorkerCount;
+        }
+    }
+
+    std::vector<bool> connected(processes.size(), false);
+    std::vector<std::thread> threads;
+
+    while (threads.size() < spawnedWorkerCount) {
+        const std::chrono::duration<double, std::milli> elapsedTime = std::chrono::steady_clock::now() - batchStart;
+
+        if (elapsedTime.count() >= TILE_CONNECT_TIMEOUT_MILLISECONDS) {
+            break;
+        }
+
+        TileConnection connection = listener.accept(TILE_CONNECT_TIMEOUT_MILLISECONDS - (int)elapsedTime.count());
+
+        if (!connection.isValid()) {
+            continue;
+        }
+
+        // Workers introduce themselves with the index they were spawned with.
+        TileMessageHeader header;
+        TileHello hello;
+
+        const int helloTimeout = getMillisecondsUntil(batchStart + std::chrono::milliseconds(TILE_CONNECT_TIMEOUT_MILLISECONDS));
+
+        if (!connection.receive(&header, sizeof(header), helloTimeout) || header.type != TILE_MESSAGE_TYPE_HELLO || header.size != sizeof(TileHello) ||
+            !connection.receive(&hello, sizeof(hello), helloTimeout) || hello.version != TILE_PROTOCOL_VERSION || hello.maxTileSize < settings.tileSize ||
+            hello.workerIndex >= processes.size() || connected[hello.workerIndex] || processes[hello.workerIndex] == -1) {
+            connection.close();
+            continue;
+        }
+
+        connected[hello.workerIndex] = true;
+        threads.emplace_back(serveWorker, hello.workerIndex, connection);
+    }
+
+    listener.close();
+
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (uint32_t i = 0; i < processes.size(); ++i) {
+        if (processes[i] != -1) {
+            joinWorker(processes[i], !connected[i]);
+        }
+    }
+
+    // Frames no worker finished are lost along with them.
+    for (Frame& frame : frames) {
+        delete[] frame.accumulation;
+    }
+
+    const std::chrono::duration<double, std::milli> totalTime = std::chrono::steady_clock::now() - batchStart;
+
+    fprintf(report, "{\"frames\": %u, \"written\": %u, \"failed\": %u, \"workers\": %u, \"totalMs\": %.3f}\n", (uint32_t)frames.size(), writtenFrameCount,
+            failedFrameCount, (uint32_t)threads.size(), totalTime.count());
+    fflush(report);
+
+    return remainingTaskCount == 0 && failedFrameCount == 0;
+}
+
+bool Application::runTileWorker(uint16_t port) {
+    TileConnection connection = TileConnection::connect(port);
+
+    if (!connection.isValid()) {
+        return false;
+    }
+
+    const VkExtent2D extent = surfaceCapabilities.currentExtent;
+
+    TileHello hello = {
+        .version     = TILE_PROTOCOL_VERSION,
+        .maxTileSize = std::min(extent.width, extent.height),
+        .workerIndex = deviceSelection.rank
+    };
+
+    if (!connection.sendMessage(TILE_MESSAGE_TYPE_HELLO, &hello, sizeof(hello))) {
+        return false;
+    }
+
+    renderer.recordCommandBuffers(device.logical, pipelineLayout, rayTracingPipeline, shaderBindingTable, bindlessTables.descriptorSet);
+
+    // The last sample of every task is captured. Its readback is copied out by a job and sent from this thread, since the
+    // connection isn't shared.
+    struct TileReadback {
+        uint64_t frameNumber;
+        std::vector<uint16_t> pixels;
+    };
+
+    std::mutex mutex;
+    std::vector<TileReadback> readbacks;
+
+    frameCapture.captureCallback = [&](uint64_t frameNumber, VkExtent2D tileExtent, const uint16_t* pixels) {
+        TileReadback readback = { frameNumber, std::vector<uint16_t>(pixels, pixels + 4 * (size_t)tileExtent.width * tileExtent.height) };
+
+        std::lock_guard<std::mutex> lock(mutex);
+        readbacks.push_back(std::move(readback));
+    };
+
+    std::deque<TileTask> tasks;
+    std::unordered_map<uint64_t, TileTask> capturedTasks;
+    bool running = true;
+    bool connected = true;
+
+    while (connected && (running || !capturedTasks.empty())) {
+        // Take the tasks that arrived. Only an idle worker blocks on the connection.
+        while (running && connection.poll(tasks.empty() && capturedTasks.empty() ? -1 : 0)) {
+            TileMessageHeader header;
+            TileTask task;
+
+            if (!connection.receive(&header, sizeof(header))) {
+                connected = false;
+                break;
+            }
+
+            if (header.type == TILE_MESSAGE_TYPE_QUIT) {
+                running = false;
+                break;
+            }
+
+            if (header.type != TILE_MESSAGE_TYPE_TASK || header.size != sizeof(TileTask) || !connection.receive(&task, sizeof(task)) ||
+                task.extent[0] > extent.width || task.extent[1] > extent.height || task.sampleCount == 0) {
+                connected = false;
+                break;
+            }
+
+            tasks.push_back(task);
+        }
+
+        if (!tasks.empty()) {
+            const TileTask task = tasks.front();
+            tasks.pop_front();
+
+            for (uint32_t sample = 0; sample < task.sampleCount; ++sample) {
+                updateFrame(extent);
+
+                if (sample == task.sampleCount - 1) {
+                    while (!frameCapture.hasFreeReadback()) {
+                        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                        frameCapture.update(device.logical, jobSystem, renderer.getCompletedFrameCount(device.logical));
+                    }
+
+                    capturedTasks[renderer.getFrameNumber()] = task;
+                    frameCapture.requestCapture();
+                }
+
+                HeadlessFrameInfo frameInfo = {
+                    .tileOffset  = { (int32_t)task.offset[0], (int32_t)task.offset[1] },
+                    .tileExtent  = { task.extent[0], task.extent[1] },
+                    .imageExtent = { task.imageExtent[0], task.imageExtent[1] },
+                    .firstSample = task.firstSample,
+                    .sampleIndex = task.firstSample + sample,
+                    .sampleCount = task.sampleCount
+                };
+
+                renderer.renderHeadless(device, frameInfo, frameCapture);
+            }
+        } else if (!capturedTasks.empty()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+
+        frameCapture.update(device.logical, jobSystem, renderer.getCompletedFrameCount(device.logical));
+
+        std::vector<TileReadback> finishedReadbacks;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finishedReadbacks.swap(readbacks);
+        }
+
+        for (const TileReadback& readback : finishedReadbacks) {
+            const TileTask task = capturedTasks[readback.frameNumber];
+            capturedTasks.erase(readback.frameNumber);
+
+            TileResult result = {
+                .taskId      = task.id,
+                .sampleCount = task.sampleCount
+            };
+
+            connected = connected && connection.sendMessage(TILE_MESSAGE_TYPE_RESULT, &result, sizeof(result), readback.pixels.data(),
+                                                            readback.pixels.size() * sizeof(uint16_t));
+        }
+    }
+
+    renderer.waitIdle(device.logical);
+    frameCapture.flush(device.logical, jobSystem);
+    frameCapture.captureCallback = nullptr;
+
+    connection.close();
+
+    return connected;
+}
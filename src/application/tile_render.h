@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <filesystem>
+
+#include "application.h"
+
+// The coordinator splits every frame into tiles, and the samples of a tile into tasks of a few samples each. Workers are
+// processes of their own, each with its own device, that connect to the coordinator over TCP and trace the tasks it
+// sends. They send back the average of the task's samples, which the coordinator merges into the frame weighted by sample
+// count. Every message is a header followed by its payload, in the byte order of the machine since workers only run
+// next to the coordinator.
+#define TILE_PROTOCOL_VERSION 1
+
+enum TileMessageType {
+    TILE_MESSAGE_TYPE_HELLO,
+    TILE_MESSAGE_TYPE_TASK,
+    TILE_MESSAGE_TYPE_RESULT,
+    TILE_MESSAGE_TYPE_QUIT
+};
+
+struct TileMessageHeader {
+    uint32_t type;
+    uint32_t size;
+};
+
+// Sent by workers once they are connected, with the index they were spawned with.
+struct TileHello {
+    uint32_t version;
+    uint32_t maxTileSize;
+    uint32_t workerIndex;
+};
+
+struct TileTask {
+    uint32_t id;
+    uint32_t frame;
+    uint32_t offset[2];
+    uint32_t extent[2];
+    uint32_t imageExtent[2];
+    uint32_t firstSample;
+    uint32_t sampleCount;
+};
+
+// Followed by the tile's RGBA16F rows, bottom to top as in the trace.
+struct TileResult {
+    uint32_t taskId;
+    uint32_t sampleCount;
+};
+
+// A blocking TCP connection. Connections are only ever made over the loopback interface for now.
+class TileConnection {
+public:
+    TileConnection() = default;
+
+    static TileConnection connect(uint16_t port);
+
+    bool isValid();
+
+    // Whether data arrives within the timeout, a negative one waits for good. A closed connection counts as data, the
+    // next receive fails.
+    bool poll(int timeoutMilliseconds);
+
+    bool send(const void* data, size_t size);
+    bool sendMessage(TileMessageType type, const void* payload, size_t payloadSize, const void* data = nullptr, size_t dataSize = 0);
+    // Fails if the data doesn't arrive in full within the timeout, a negative one waits for good.
+    bool receive(void* data, size_t size, int timeoutMilliseconds = -1);
+
+    void close();
+
+private:
+    intptr_t handle = -1;
+
+    friend class TileListener;
+};
+
+class TileListener {
+public:
+    uint16_t port = 0;
+
+    TileListener() = default;
+
+    // Listens on a free port of the loopback interface.
+    static TileListener listen();
+
+    bool isValid();
+
+    // Returns an invalid connection when no worker connects within the timeout.
+    TileConnection accept(int timeoutMilliseconds);
+
+    void close();
+
+private:
+    intptr_t handle = -1;
+};
+
+// Renders a batch across worker processes, spawned from the executable with the project and their index, which picks the
+// device at that rank. Ranks wrap around, so more workers than devices share them. Tasks are handed out as workers ask for them, so
+// fast devices trace more of the image. Once nothing is left to hand out, idle workers take over the task that has been
+// running the longest, and whichever copy finishes first is kept. Workers that disconnect, or take far longer than tasks
+// take on average to send a result, are lost: they're killed and their tasks go back to the queue. The report gets a JSON line for every task and lost worker, and one for every frame.
+struct DistributedRenderSettings {
+    BatchRenderSettings batch;
+    VkExtent2D extent;
+    std::filesystem::path executablePath;
+    std::filesystem::path projectPath;
+    uint32_t workerCount;
+    uint32_t tileSize;
+    uint32_t samplesPerTask;
+};
+
+bool renderDistributed(const DistributedRenderSettings& settings, FILE* report);
@@ -0,0 +1,328 @@
+#include "acceleration_structure.h"
+
+// Scratch memory is reused between build batches, so huge scenes don't need scratch for every BLAS at once.
+static const VkDeviceSize scratchBudget = 256ull << 20;
+
+static VkDeviceSize alignSize(VkDeviceSize size, VkDeviceSize alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+AccelerationStructure::AccelerationStructure(VkDevice device, VkAccelerationStructureTypeKHR type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size) {
+    VkAccelerationStructureCreateInfoKHR accelerationStructureCreateInfo = {
+        .sType         = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_CREATE_INFO_KHR,
+        .pNext         = nullptr,
+        .createFlags   = 0,
+        .buffer        = buffer,
+        .offset        = offset,
+        .size          = size,
+        .type          = type,
+        .deviceAddress = 0
+    };
+
+    vkCreateAccelerationStructure(device, &accelerationStructureCreateInfo, nullptr, &accelerationStructure);
+
+    VkAccelerationStructureDeviceAddressInfoKHR accelerationStructureDeviceAddressInfo = {
+        .sType                 = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_DEVICE_ADDRESS_INFO_KHR,
+        .pNext                 = nullptr,
+        .accelerationStructure = accelerationStructure
+    };
+
+    deviceAddress = vkGetAccelerationStructureDeviceAddress(device, &accelerationStructureDeviceAddressInfo);
+    this->size = size;
+}
+
+void AccelerationStructure::destroy(VkDevice device) {
+    vkDestroyAccelerationStructure(device, accelerationStructure, nullptr);
+}
+
+AccelerationStructure::operator VkAccelerationStructureKHR() {
+    return accelerationStructure;
+}
+
+// Copies the acceleration structures into a new storage buffer that only takes as much memory as they actually need.
+static void compactAccelerationStructures(Device& device, uint32_t count, AccelerationStructure* accelerationStructures, Buffer& storageBuffer) {
+    VkDeviceSize* compactedSizes = new VkDeviceSize[count];
+    queryAccelerationStructureSizes(device, count, accelerationStructures, VK_QUERY_TYPE_ACCELERATION_STRUCTURE_COMPACTED_SIZE_KHR, compactedSizes);
+
+    VkDeviceSize compactedStorageSize = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        compactedStorageSize += alignSize(compactedSizes[i], 256);
+    }
+
+    Buffer compactedStorageBuffer(device, compactedStorageSize,
+                                  VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    AccelerationStructure* compactedAccelerationStructures = new AccelerationStructure[count];
+
+    ImmediateCommandBuffer commandBuffer(device);
+
+    VkDeviceSize storageOffset = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        compactedAccelerationStructures[i] = AccelerationStructure(device.logical, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+                                                                   compactedStorageBuffer, storageOffset, compactedSizes[i]);
+
+        storageOffset += alignSize(compactedSizes[i], 256);
+
+        VkCopyAccelerationStructureInfoKHR copyAccelerationStructureInfo = {
+            .sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_INFO_KHR,
+            .pNext = nullptr,
+            .src   = accelerationStructures[i],
+            .dst   = compactedAccelerationStructures[i],
+            .mode  = VK_COPY_ACCELERATION_STRUCTURE_MODE_COMPACT_KHR
+        };
+
+        vkCmdCopyAccelerationStructure(commandBuffer, &copyAccelerationStructureInfo);
+    }
+
+    VkMemoryBarrier2 memoryBarrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext         = nullptr,
+        .srcStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_COPY_BIT_KHR,
+        .srcAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+        .dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .dstAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR
+    };
+
+    VkDependencyInfo dependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 1,
+        .pMemoryBarriers          = &memoryBarrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = 0,
+        .pImageMemoryBarriers     = nullptr
+    };
+
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    commandBuffer.submit(device);
+
+    // Replace the original acceleration structures.
+    for (uint32_t i = 0; i < count; ++i) {
+        accelerationStructures[i].destroy(device.logical);
+        accelerationStructures[i] = compactedAccelerationStructures[i];
+    }
+
+    storageBuffer.destroy(device.logical);
+    storageBuffer = compactedStorageBuffer;
+
+    delete[] compactedAccelerationStructures;
+    delete[] compactedSizes;
+}
+
+void buildBottomLevelAccelerationStructures(Device& device, uint32_t geometryCount, const BlasGeometry* geometries,
+                                            AccelerationStructure* blases, Buffer& storageBuffer) {
+    if (geometryCount == 0) {
+        return;
+    }
+
+    VkAccelerationStructureGeometryKHR* asGeometries = new VkAccelerationStructureGeometryKHR[geometryCount];
+    VkAccelerationStructureBuildGeometryInfoKHR* buildGeometryInfos = new VkAccelerationStructureBuildGeometryInfoKHR[geometryCount];
+    VkAccelerationStructureBuildRangeInfoKHR* buildRangeInfos = new VkAccelerationStructureBuildRangeInfoKHR[geometryCount];
+    const VkAccelerationStructureBuildRangeInfoKHR** buildRangeInfoPointers = new const VkAccelerationStructureBuildRangeInfoKHR*[geometryCount];
+    VkDeviceSize* asSizes = new VkDeviceSize[geometryCount];
+    VkDeviceSize* scratchSizes = new VkDeviceSize[geometryCount];
+
+    const VkDeviceSize scratchAlignment = device.asProperties.minAccelerationStructureScratchOffsetAlignment;
+
+    VkDeviceSize storageSize = 0;
+    VkDeviceSize totalScratchSize = 0;
+    VkDeviceSize maxScratchSize = 0;
+
+    // Get the build sizes.
+    for (uint32_t i = 0; i < geometryCount; ++i) {
+        const BlasGeometry& geometry = geometries[i];
+
+        asGeometries[i] = {
+            .sType        = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
+            .pNext        = nullptr,
+            .geometryType = VK_GEOMETRY_TYPE_TRIANGLES_KHR,
+            .geometry     = {
+                .triangles = {
+                    .sType         = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_TRIANGLES_DATA_KHR,
+                    .pNext         = nullptr,
+                    .vertexFormat  = geometry.vertexFormat,
+                    .vertexData    = { .deviceAddress = geometry.vertexAddress },
+                    .vertexStride  = geometry.vertexStride,
+                    .maxVertex     = geometry.vertexCount > 0 ? geometry.vertexCount - 1 : 0,
+                    .indexType     = VK_INDEX_TYPE_UINT32,
+                    .indexData     = { .deviceAddress = geometry.indexAddress },
+                    .transformData = { .deviceAddress = geometry.transformAddress }
+                }
+            },
+            .flags        = VK_GEOMETRY_OPAQUE_BIT_KHR
+        };
+
+        buildGeometryInfos[i] = {
+            .sType                    = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+            .pNext                    = nullptr,
+            .type                     = VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR,
+            .flags                    = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_COMPACTION_BIT_KHR,
+            .mode                     = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
+            .srcAccelerationStructure = VK_NULL_HANDLE,
+            .dstAccelerationStructure = VK_NULL_HANDLE,
+            .geometryCount            = 1,
+            .pGeometries              = &asGeometries[i],
+            .ppGeometries             = nullptr,
+            .scratchData              = { .deviceAddress = 0 }
+        };
+
+        const uint32_t primitiveCount = geometry.indexCount / 3;
+
+        buildRangeInfos[i] = {
+            .primitiveCount  = primitiveCount,
+            .primitiveOffset = 0,
+            .firstVertex     = 0,
+            .transformOffset = 0
+        };
+
+        buildRangeInfoPointers[i] = &buildRangeInfos[i];
+
+        VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo = {
+            .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR,
+            .pNext = nullptr
+        };
+
+        vkGetAccelerationStructureBuildSizes(device.logical, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR,
+                                             &buildGeometryInfos[i], &primitiveCount, &buildSizesInfo);
+
+        // Acceleration structures have to be placed at 256 byte aligned offsets.
+        asSizes[i] = buildSizesInfo.accelerationStructureSize;
+        storageSize += alignSize(asSizes[i], 256);
+
+        scratchSizes[i] = alignSize(buildSizesInfo.buildScratchSize, scratchAlignment);
+        totalScratchSize += scratchSizes[i];
+
+        if (scratchSizes[i] > maxScratchSize) {
+            maxScratchSize = scratchSizes[i];
+        }
+    }
+
+    // Create the acceleration structures.
+    storageBuffer = Buffer(device, storageSize,
+                           VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkDeviceSize storageOffset = 0;
+
+    for (uint32_t i = 0; i < geometryCount; ++i) {
+        blases[i] = AccelerationStructure(device.logical, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, storageBuffer, storageOffset, asSizes[i]);
+        buildGeometryInfos[i].dstAccelerationStructure = blases[i];
+
+        storageOffset += alignSize(asSizes[i], 256);
+    }
+
+    // Create the scratch buffer.
+    VkDeviceSize scratchSize = totalScratchSize < scratchBudget ? totalScratchSize : scratchBudget;
+
+    if (scratchSize < maxScratchSize) {
+        scratchSize = maxScratchSize;
+    }
+
+    Buffer scratchBuffer(device, scratchSize + scratchAlignment,
+                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    const VkDeviceAddress scratchAddress = alignSize(scratchBuffer.getDeviceAddress(device.logical), scratchAlignment);
+
+    // Build the acceleration structures in batches that fit in the scratch buffer.
+    ImmediateCommandBuffer commandBuffer(device);
+
+    VkMemoryBarrier2 memoryBarrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext         = nullptr,
+        .srcStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        .srcAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+        .dstStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        .dstAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR | VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR
+    };
+
+    VkDependencyInfo dependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 1,
+        .pMemoryBarriers          = &memoryBarrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = 0,
+        .pImageMemoryBarriers     = nullptr
+    };
+
+    uint32_t batchBegin = 0;
+    VkDeviceSize scratchOffset = 0;
+
+    for (uint32_t i = 0; i <= geometryCount; ++i) {
+        if (i == geometryCount || scratchOffset + scratchSizes[i] > scratchSize) {
+            vkCmdBuildAccelerationStructures(commandBuffer, i - batchBegin, &buildGeometryInfos[batchBegin], &buildRangeInfoPointers[batchBegin]);
+
+            // The next batch reuses the scratch memory.
+            vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+            batchBegin = i;
+            scratchOffset = 0;
+        }
+
+        if (i < geometryCount) {
+            buildGeometryInfos[i].scratchData.deviceAddress = scratchAddress + scratchOffset;
+            scratchOffset += scratchSizes[i];
+        }
+    }
+
+    // Make the acceleration structures visible to the ray tracing shaders.
+    memoryBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    commandBuffer.submit(device);
+
+    scratchBuffer.destroy(device.logical);
+
+    compactAccelerationStructures(device, geometryCount, blases, storageBuffer);
+
+    delete[] scratchSizes;
+    delete[] asSizes;
+    delete[] buildRangeInfoPointers;
+    delete[] buildRangeInfos;
+    delete[] buildGeometryInfos;
+    delete[] asGeometries;
+}
+
+void queryAccelerationStructureSizes(Device& device, uint32_t count, AccelerationStructure* accelerationStructures,
+                                     VkQueryType queryType, VkDeviceSize* sizes) {
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {
+        .sType              = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext              = nullptr,
+        .flags              = 0,
+        .queryType          = queryType,
+        .queryCount         = count,
+        .pipelineStatistics = 0
+    };
+
+    VkQueryPool queryPool;
+    vkCreateQueryPool(device.logical, &queryPoolCreateInfo, nullptr, &queryPool);
+    vkResetQueryPool(device.logical, queryPool, 0, count);
+
+    VkAccelerationStructureKHR* handles = new VkAccelerationStructureKHR[count];
+
+    for (uint32_t i = 0; i < count; ++i) {
+        handles[i] = accelerationStructures[i];
+    }
+
+    ImmediateCommandBuffer commandBuffer(device);
+    vkCmdWriteAccelerationStructuresProperties(commandBuffer, count, handles, queryType, queryPool, 0);
+    commandBuffer.submit(device);
+
+    vkGetQueryPoolResults(device.logical, queryPool, 0, count, count * sizeof(VkDeviceSize), sizes, sizeof(VkDeviceSize),
+                          VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+
+    delete[] handles;
+
+    vkDestroyQueryPool(device.logical, queryPool, nullptr);
+}
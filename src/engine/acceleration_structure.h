@@ -0,0 +1,39 @@
+#pragma once
+
+#include "graphics.h"
+
+class AccelerationStructure {
+public:
+    VkDeviceAddress deviceAddress;
+    VkDeviceSize size;
+
+    AccelerationStructure() = default;
+    AccelerationStructure(VkDevice device, VkAccelerationStructureTypeKHR type, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size);
+    void destroy(VkDevice device);
+
+    operator VkAccelerationStructureKHR();
+
+private:
+    VkAccelerationStructureKHR accelerationStructure;
+};
+
+struct BlasGeometry {
+    VkDeviceAddress vertexAddress;
+    VkDeviceSize vertexStride;
+    uint32_t vertexCount;
+    VkFormat vertexFormat;
+    VkDeviceAddress indexAddress;
+    uint32_t indexCount;
+
+    // An optional 3x4 transform applied to the vertices during the build, or 0 for none.
+    VkDeviceAddress transformAddress;
+};
+
+// Builds and compacts one bottom-level acceleration structure per geometry. All of them are placed in a single storage
+// buffer, which is created by this function and owned by the caller.
+void buildBottomLevelAccelerationStructures(Device& device, uint32_t geometryCount, const BlasGeometry* geometries,
+                                            AccelerationStructure* blases, Buffer& storageBuffer);
+
+// Reads back a size property, like the compacted or serialized size, of every acceleration structure.
+void queryAccelerationStructureSizes(Device& device, uint32_t count, AccelerationStructure* accelerationStructures,
+                                     VkQueryType queryType, VkDeviceSize* sizes);
@@ -0,0 +1,222 @@
+#include "bindless.h"
+
+static const uint32_t tableCapacities[BINDLESS_BINDING_COUNT] = {
+    16384, // Images
+    256,   // Samplers
+    4096   // Buffers
+};
+
+static const VkDescriptorType tableDescriptorTypes[BINDLESS_BINDING_COUNT] = {
+    VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+    VK_DESCRIPTOR_TYPE_SAMPLER,
+    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+};
+
+BindlessTables::BindlessTables(VkDevice device) {
+    // Create the descriptor set layout.
+    VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[BINDLESS_BINDING_COUNT];
+    VkDescriptorBindingFlags descriptorBindingFlags[BINDLESS_BINDING_COUNT];
+
+    for (uint32_t i = 0; i < BINDLESS_BINDING_COUNT; ++i) {
+        descriptorSetLayoutBindings[i].binding            = i;
+        descriptorSetLayoutBindings[i].descriptorType     = tableDescriptorTypes[i];
+        descriptorSetLayoutBindings[i].descriptorCount    = tableCapacities[i];
+        descriptorSetLayoutBindings[i].stageFlags         = VK_SHADER_STAGE_RAYGEN_BIT_KHR | VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR |
+                                                            VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR |
+                                                            VK_SHADER_STAGE_COMPUTE_BIT;
+        descriptorSetLayoutBindings[i].pImmutableSamplers = nullptr;
+
+        descriptorBindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+                                    VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+    }
+
+    VkDescriptorSetLayoutBindingFlagsCreateInfo descriptorSetLayoutBindingFlagsCreateInfo = {
+        .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO,
+        .pNext         = nullptr,
+        .bindingCount  = BINDLESS_BINDING_COUNT,
+        .pBindingFlags = descriptorBindingFlags
+    };
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
+        .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext        = &descriptorSetLayoutBindingFlagsCreateInfo,
+        .flags        = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+        .bindingCount = BINDLESS_BINDING_COUNT,
+        .pBindings    = descriptorSetLayoutBindings
+    };
+
+    vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout);
+
+    // Create the descriptor pool.
+    VkDescriptorPoolSize descriptorPoolSizes[BINDLESS_BINDING_COUNT];
+
+    for (uint32_t i = 0; i < BINDLESS_BINDING_COUNT; ++i) {
+        descriptorPoolSizes[i].type            = tableDescriptorTypes[i];
+        descriptorPoolSizes[i].descriptorCount = tableCapacities[i];
+    }
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
+        .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext         = nullptr,
+        .flags         = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT,
+        .maxSets       = 1,
+        .poolSizeCount = BINDLESS_BINDING_COUNT,
+        .pPoolSizes    = descriptorPoolSizes
+    };
+
+    vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool);
+
+    // Allocate the descriptor set.
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {
+        .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext              = nullptr,
+        .descriptorPool     = descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts        = &descriptorSetLayout
+    };
+
+    vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet);
+
+    for (uint32_t i = 0; i < BINDLESS_BINDING_COUNT; ++i) {
+        tables[i].capacity       = tableCapacities[i];
+        tables[i].count          = 0;
+        tables[i].freeIndices    = new uint32_t[tableCapacities[i]];
+        tables[i].freeIndexCount = 0;
+    }
+}
+
+void BindlessTables::destroy(VkDevice device) {
+    for (uint32_t i = 0; i < BINDLESS_BINDING_COUNT; ++i) {
+        delete[] tables[i].freeIndices;
+    }
+
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+}
+
+uint32_t BindlessTables::addImage(VkDevice device, VkImageView imageView) {
+    uint32_t index = allocateIndex(BINDLESS_BINDING_IMAGES);
+
+    if (index != BINDLESS_INVALID_INDEX) {
+        setImage(device, index, imageView);
+    }
+
+    return index;
+}
+
+void BindlessTables::setImage(VkDevice device, uint32_t index, VkImageView imageView) {
+    VkDescriptorImageInfo descriptorImageInfo = {
+        .sampler     = VK_NULL_HANDLE,
+        .imageView   = imageView,
+        .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+    };
+
+    VkWriteDescriptorSet writeDescriptorSet = {
+        .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext            = nullptr,
+        .dstSet           = descriptorSet,
+        .dstBinding       = BINDLESS_BINDING_IMAGES,
+        .dstArrayElement  = index,
+        .descriptorCount  = 1,
+        .descriptorType   = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+        .pImageInfo       = &descriptorImageInfo,
+        .pBufferInfo      = nullptr,
+        .pTexelBufferView = nullptr
+    };
+
+    vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+}
+
+void BindlessTables::removeImage(uint32_t index) {
+    freeIndex(BINDLESS_BINDING_IMAGES, index);
+}
+
+uint32_t BindlessTables::addSampler(VkDevice device, VkSampler sampler) {
+    uint32_t index = allocateIndex(BINDLESS_BINDING_SAMPLERS);
+
+    if (index == BINDLESS_INVALID_INDEX) {
+        return index;
+    }
+
+    VkDescriptorImageInfo descriptorImageInfo = {
+        .sampler     = sampler,
+        .imageView   = VK_NULL_HANDLE,
+        .imageLayout = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+
+    VkWriteDescriptorSet writeDescriptorSet = {
+        .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext            = nullptr,
+        .dstSet           = descriptorSet,
+        .dstBinding       = BINDLESS_BINDING_SAMPLERS,
+        .dstArrayElement  = index,
+        .descriptorCount  = 1,
+        .descriptorType   = VK_DESCRIPTOR_TYPE_SAMPLER,
+        .pImageInfo       = &descriptorImageInfo,
+        .pBufferInfo      = nullptr,
+        .pTexelBufferView = nullptr
+    };
+
+    vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+
+    return index;
+}
+
+void BindlessTables::removeSampler(uint32_t index) {
+    freeIndex(BINDLESS_BINDING_SAMPLERS, index);
+}
+
+uint32_t BindlessTables::addBuffer(VkDevice device, VkBuffer buffer) {
+    uint32_t index = allocateIndex(BINDLESS_BINDING_BUFFERS);
+
+    if (index == BINDLESS_INVALID_INDEX) {
+        return index;
+    }
+
+    VkDescriptorBufferInfo descriptorBufferInfo = {
+        .buffer = buffer,
+        .offset = 0,
+        .range  = VK_WHOLE_SIZE
+    };
+
+    VkWriteDescriptorSet writeDescriptorSet = {
+        .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .pNext            = nullptr,
+        .dstSet           = descriptorSet,
+        .dstBinding       = BINDLESS_BINDING_BUFFERS,
+        .dstArrayElement  = index,
+        .descriptorCount  = 1,
+        .descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+        .pImageInfo       = nullptr,
+        .pBufferInfo      = &descriptorBufferInfo,
+        .pTexelBufferView = nullptr
+    };
+
+    vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, nullptr);
+
+    return index;
+}
+
+void BindlessTables::removeBuffer(uint32_t index) {
+    freeIndex(BINDLESS_BINDING_BUFFERS, index);
+}
+
+uint32_t BindlessTables::allocateIndex(BindlessBinding binding) {
+    Table& table = tables[binding];
+
+    if (table.freeIndexCount > 0) {
+        return table.freeIndices[--table.freeIndexCount];
+    }
+
+    if (table.count == table.capacity) {
+        return BINDLESS_INVALID_INDEX;
+    }
+
+    return table.count++;
+}
+
+void BindlessTables::freeIndex(BindlessBinding binding, uint32_t index) {
+    // Freed descriptors are left as they are, they just won't be referenced anymore thanks to partial binding.
+    Table& table = tables[binding];
+    table.freeIndices[table.freeIndexCount++] = index;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "graphics.h"
+
+enum BindlessBinding {
+    BINDLESS_BINDING_IMAGES,
+    BINDLESS_BINDING_SAMPLERS,
+    BINDLESS_BINDING_BUFFERS,
+    BINDLESS_BINDING_COUNT
+};
+
+#define BINDLESS_INVALID_INDEX UINT32_MAX
+
+// Descriptor arrays that every shader indexes into, so resources can be added while frames are in flight.
+class BindlessTables {
+public:
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkDescriptorSet descriptorSet;
+
+    BindlessTables() = default;
+    BindlessTables(VkDevice device);
+    void destroy(VkDevice device);
+
+    uint32_t addImage(VkDevice device, VkImageView imageView);
+    void setImage(VkDevice device, uint32_t index, VkImageView imageView);
+    void removeImage(uint32_t index);
+
+    uint32_t addSampler(VkDevice device, VkSampler sampler);
+    void removeSampler(uint32_t index);
+
+    uint32_t addBuffer(VkDevice device, VkBuffer buffer);
+    void removeBuffer(uint32_t index);
+
+private:
+    struct Table {
+        uint32_t capacity;
+        uint32_t count;
+        uint32_t* freeIndices;
+        uint32_t freeIndexCount;
+    };
+
+    VkDescriptorPool descriptorPool;
+    Table tables[BINDLESS_BINDING_COUNT];
+
+    uint32_t allocateIndex(BindlessBinding binding);
+    void freeIndex(BindlessBinding binding, uint32_t index);
+};
@@ -0,0 +1,275 @@
+#include "blas_cache.h"
+
+#include <string.h>
+
+#include "file_mapping.h"
+
+// Serialized acceleration structures start with the driver and compatibility UUIDs, followed by the serialized and the
+// deserialized sizes.
+static const size_t deserializedSizeOffset = 2 * VK_UUID_SIZE + sizeof(uint64_t);
+
+static VkDeviceSize alignSize(VkDeviceSize size, VkDeviceSize alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+static bool isCompatible(Device& device, const MappedFile& file, uint32_t blasCount, const uint64_t* contentHashes) {
+    if (file.data == nullptr || file.size < sizeof(BlasCacheHeader)) {
+        return false;
+    }
+
+    const BlasCacheHeader& header = *(const BlasCacheHeader*)file.data;
+
+    if (header.magic != BLAS_CACHE_MAGIC || header.version != BLAS_CACHE_VERSION || header.fileSize != file.size ||
+        header.entryCount != blasCount || sizeof(BlasCacheHeader) + blasCount * sizeof(BlasCacheEntry) > file.size) {
+        return false;
+    }
+
+    // Caches written by another device or driver are rebuilt without asking the driver.
+    if (memcmp(header.deviceUUID, device.idProperties.deviceUUID, VK_UUID_SIZE) != 0 ||
+        memcmp(header.driverUUID, device.idProperties.driverUUID, VK_UUID_SIZE) != 0) {
+        return false;
+    }
+
+    const BlasCacheEntry* entries = (const BlasCacheEntry*)(file.data + sizeof(BlasCacheHeader));
+
+    for (uint32_t i = 0; i < blasCount; ++i) {
+        const BlasCacheEntry& entry = entries[i];
+
+        if (entry.contentHash != contentHashes[i] || entry.offset % BLAS_CACHE_ALIGNMENT != 0 || entry.offset > file.size ||
+            entry.size > file.size - entry.offset || entry.size < deserializedSizeOffset + sizeof(uint64_t)) {
+            return false;
+        }
+
+        VkAccelerationStructureVersionInfoKHR versionInfo = {
+            .sType        = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_VERSION_INFO_KHR,
+            .pNext        = nullptr,
+            .pVersionData = file.data + entry.offset
+        };
+
+        VkAccelerationStructureCompatibilityKHR compatibility;
+        vkGetDeviceAccelerationStructureCompatibility(device.logical, &versionInfo, &compatibility);
+
+        if (compatibility != VK_ACCELERATION_STRUCTURE_COMPATIBILITY_COMPATIBLE_KHR) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool loadBlasCache(Device& device, const std::filesystem::path& path, uint32_t blasCount, const uint64_t* contentHashes,
+                   AccelerationStructure* blases, Buffer& storageBuffer) {
+    MappedFile file(path);
+
+    if (!isCompatible(device, file, blasCount, contentHashes)) {
+        file.destroy();
+        return false;
+    }
+
+    const BlasCacheEntry* entries = (const BlasCacheEntry*)(file.data + sizeof(BlasCacheHeader));
+
+    // Create the acceleration structures.
+    VkDeviceSize* deserializedSizes = new VkDeviceSize[blasCount];
+    VkDeviceSize storageSize = 0;
+
+    for (uint32_t i = 0; i < blasCount; ++i) {
+        memcpy(&deserializedSizes[i], file.data + entries[i].offset + deserializedSizeOffset, sizeof(uint64_t));
+        storageSize += alignSize(deserializedSizes[i], 256);
+    }
+
+    storageBuffer = Buffer(device, storageSize,
+                           VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkDeviceSize storageOffset = 0;
+
+    for (uint32_t i = 0; i < blasCount; ++i) {
+        blases[i] = AccelerationStructure(device.logical, VK_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL_KHR, storageBuffer, storageOffset, deserializedSizes[i]);
+        storageOffset += alignSize(deserializedSizes[i], 256);
+    }
+
+    // The serialized data is read by the device once, so it's copied straight from the mapping to host-visible memory
+    // instead of going through staging. The cache keeps every entry at the alignment deserialization requires.
+    Buffer serializedBuffer(device, file.size + BLAS_CACHE_ALIGNMENT,
+                            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    const VkDeviceAddress serializedBufferAddress = serializedBuffer.getDeviceAddress(device.logical);
+    const VkDeviceAddress serializedAddress = alignSize(serializedBufferAddress, BLAS_CACHE_ALIGNMENT);
+
+    uint8_t* serializedData;
+    vkMapMemory(device.logical, serializedBuffer.memory, 0, VK_WHOLE_SIZE, 0, (void**)&serializedData);
+    memcpy(serializedData + (serializedAddress - serializedBufferAddress), file.data, file.size);
+    vkUnmapMemory(device.logical, serializedBuffer.memory);
+
+    // Deserialize the acceleration structures.
+    ImmediateCommandBuffer commandBuffer(device);
+
+    for (uint32_t i = 0; i < blasCount; ++i) {
+        VkCopyMemoryToAccelerationStructureInfoKHR copyMemoryToAccelerationStructureInfo = {
+            .sType = VK_STRUCTURE_TYPE_COPY_MEMORY_TO_ACCELERATION_STRUCTURE_INFO_KHR,
+            .pNext = nullptr,
+            .src   = { .deviceAddress = serializedAddress + entries[i].offset },
+            .dst   = blases[i],
+            .mode  = VK_COPY_ACCELERATION_STRUCTURE_MODE_DESERIALIZE_KHR
+        };
+
+        vkCmdCopyMemoryToAccelerationStructure(commandBuffer, &copyMemoryToAccelerationStructureInfo);
+    }
+
+    VkMemoryBarrier2 memoryBarrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext         = nullptr,
+        .srcStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_COPY_BIT_KHR,
+        .srcAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR,
+        .dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .dstAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR
+    };
+
+    VkDependencyInfo dependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 1,
+        .pMemoryBarriers          = &memoryBarrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = 0,
+        .pImageMemoryBarriers     = nullptr
+    };
+
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    commandBuffer.submit(device);
+
+    serializedBuffer.destroy(device.logical);
+    file.destroy();
+
+    delete[] deserializedSizes;
+
+    return true;
+}
+
+bool saveBlasCache(Device& device, const std::filesystem::path& path, uint32_t blasCount, const uint64_t* contentHashes,
+                   AccelerationStructure* blases) {
+    // Lay out the file.
+    VkDeviceSize* serializedSizes = new VkDeviceSize[blasCount];
+    queryAccelerationStructureSizes(device, blasCount, blases, VK_QUERY_TYPE_ACCELERATION_STRUCTURE_SERIALIZATION_SIZE_KHR, serializedSizes);
+
+    BlasCacheHeader header = {
+        .magic      = BLAS_CACHE_MAGIC,
+        .version    = BLAS_CACHE_VERSION,
+        .fileSize   = 0,
+        .deviceUUID = {},
+        .driverUUID = {},
+        .entryCount = blasCount,
+        .padding    = 0
+    };
+
+    memcpy(header.deviceUUID, device.idProperties.deviceUUID, VK_UUID_SIZE);
+    memcpy(header.driverUUID, device.idProperties.driverUUID, VK_UUID_SIZE);
+
+    BlasCacheEntry* entries = new BlasCacheEntry[blasCount];
+    VkDeviceSize offset = sizeof(BlasCacheHeader) + blasCount * sizeof(BlasCacheEntry);
+
+    for (uint32_t i = 0; i < blasCount; ++i) {
+        offset = alignSize(offset, BLAS_CACHE_ALIGNMENT);
+
+        entries[i].contentHash = contentHashes[i];
+        entries[i].offset = offset;
+        entries[i].size = serializedSizes[i];
+
+        offset += serializedSizes[i];
+    }
+
+    header.fileSize = offset;
+
+    // Serialize the acceleration structures into host-visible memory, at the same offsets they'll have in the file.
+    Buffer serializedBuffer(device, header.fileSize + BLAS_CACHE_ALIGNMENT,
+                            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    const VkDeviceAddress serializedBufferAddress = serializedBuffer.getDeviceAddress(device.logical);
+    const VkDeviceAddress serializedAddress = alignSize(serializedBufferAddress, BLAS_CACHE_ALIGNMENT);
+
+    ImmediateCommandBuffer commandBuffer(device);
+
+    for (uint32_t i = 0; i < blasCount; ++i) {
+        VkCopyAccelerationStructureToMemoryInfoKHR copyAccelerationStructureToMemoryInfo = {
+            .sType = VK_STRUCTURE_TYPE_COPY_ACCELERATION_STRUCTURE_TO_MEMORY_INFO_KHR,
+            .pNext = nullptr,
+            .src   = blases[i],
+            .dst   = { .deviceAddress = serializedAddress + entries[i].offset },
+            .mode  = VK_COPY_ACCELERATION_STRUCTURE_MODE_SERIALIZE_KHR
+        };
+
+        vkCmdCopyAccelerationStructureToMemory(commandBuffer, &copyAccelerationStructureToMemoryInfo);
+    }
+
+    VkMemoryBarrier2 memoryBarrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext         = nullptr,
+        .srcStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_COPY_BIT_KHR,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT,
+        .dstAccessMask = VK_ACCESS_2_HOST_READ_BIT
+    };
+
+    VkDependencyInfo dependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 1,
+        .pMemoryBarriers          = &memoryBarrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = 0,
+        .pImageMemoryBarriers     = nullptr
+    };
+
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    commandBuffer.submit(device);
+
+    // Write the file next to the old one and move it into place once it's complete.
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += ".tmp";
+
+    MappedFile file(temporaryPath, header.fileSize);
+    bool saved = file.data != nullptr;
+
+    if (saved) {
+        uint8_t* serializedData;
+        vkMapMemory(device.logical, serializedBuffer.memory, 0, VK_WHOLE_SIZE, 0, (void**)&serializedData);
+        serializedData += serializedAddress - serializedBufferAddress;
+
+        memcpy(file.data, &header, sizeof(header));
+        memcpy(file.data + sizeof(header), entries, blasCount * sizeof(BlasCacheEntry));
+
+        for (uint32_t i = 0; i < blasCount; ++i) {
+            memcpy(file.data + entries[i].offset, serializedData + entries[i].offset, entries[i].size);
+        }
+
+        vkUnmapMemory(device.logical, serializedBuffer.memory);
+        saved = file.flush();
+        file.destroy();
+
+        std::error_code error;
+
+        if (saved) {
+            std::filesystem::rename(temporaryPath, path, error);
+            saved = !error;
+        }
+
+        if (!saved) {
+            std::filesystem::remove(temporaryPath, error);
+        }
+    }
+
+    serializedBuffer.destroy(device.logical);
+
+    delete[] entries;
+    delete[] serializedSizes;
+
+    return saved;
+}
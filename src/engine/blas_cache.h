@@ -0,0 +1,37 @@
+#pragma once
+
+#include <filesystem>
+
+#include "acceleration_structure.h"
+
+// A BLAS cache holds the serialized acceleration structures of a cooked asset. It is only valid on the device and
+// driver that wrote it, and every entry is tied to the content hash of the mesh it was built from.
+#define BLAS_CACHE_MAGIC 0x43425856 // "VXBC"
+#define BLAS_CACHE_VERSION 1
+#define BLAS_CACHE_EXTENSION ".blas"
+#define BLAS_CACHE_ALIGNMENT 256
+
+struct BlasCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fileSize;
+    uint8_t deviceUUID[VK_UUID_SIZE];
+    uint8_t driverUUID[VK_UUID_SIZE];
+    uint32_t entryCount;
+    uint32_t padding;
+};
+
+struct BlasCacheEntry {
+    uint64_t contentHash;
+    uint64_t offset;
+    uint64_t size;
+};
+
+// Deserializes the acceleration structures into a new storage buffer. Returns false, without creating anything, if the
+// cache is missing, was written by another device or driver, or any of the content hashes don't match.
+bool loadBlasCache(Device& device, const std::filesystem::path& path, uint32_t blasCount, const uint64_t* contentHashes,
+                   AccelerationStructure* blases, Buffer& storageBuffer);
+
+// Serializes the acceleration structures and replaces the cache atomically.
+bool saveBlasCache(Device& device, const std::filesystem::path& path, uint32_t blasCount, const uint64_t* contentHashes,
+                   AccelerationStructure* blases);
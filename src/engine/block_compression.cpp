@@ -0,0 +1,519 @@
+#include "block_compression.h"
+
+#include <math.h>
+#include <string.h>
+
+// Rows of blocks handed to a thread at a time.
+static const uint32_t blockRowGrainSize = 4;
+
+static const uint32_t bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct BlockSettings {
+    uint32_t refineCount;
+    uint32_t bc4SearchRadius;
+    bool bc7SearchPBits;
+};
+
+static BlockSettings getBlockSettings(BlockCompressionQuality quality) {
+    switch (quality) {
+        case BLOCK_COMPRESSION_QUALITY_FAST:   return { 0, 0, false };
+        case BLOCK_COMPRESSION_QUALITY_NORMAL: return { 2, 2, false };
+        default:                               return { 8, 6, true };
+    }
+}
+
+static float clampColor(float value) {
+    return fminf(fmaxf(value, 0.0f), 255.0f);
+}
+
+// Fits a line through the block along its principal axis and returns its extremes.
+static void fitEndpoints(const float (*colors)[4], uint32_t channelCount, float* endpoint0, float* endpoint1) {
+    float mean[4] = {};
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t c = 0; c < channelCount; ++c) {
+            mean[c] += colors[i][c] / 16.0f;
+        }
+    }
+
+    float covariance[4][4] = {};
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t a = 0; a < channelCount; ++a) {
+            for (uint32_t b = 0; b < channelCount; ++b) {
+                covariance[a][b] += (colors[i][a] - mean[a]) * (colors[i][b] - mean[b]);
+            }
+        }
+    }
+
+    // Power iteration converges on the principal axis quickly enough for 16 points.
+    float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+    for (uint32_t iteration = 0; iteration < 8; ++iteration) {
+        float next[4] = {};
+        float length = 0.0f;
+
+        for (uint32_t a = 0; a < channelCount; ++a) {
+            for (uint32_t b = 0; b < channelCount; ++b) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+
+            length = fmaxf(length, fabsf(next[a]));
+        }
+
+        if (length == 0.0f) {
+            break;
+        }
+
+        for (uint32_t c = 0; c < channelCount; ++c) {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    float axisLengthSquared = 0.0f;
+
+    for (uint32_t c = 0; c < channelCount; ++c) {
+        axisLengthSquared += axis[c] * axis[c];
+    }
+
+    float minProjection = 0.0f;
+    float maxProjection = 0.0f;
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        float projection = 0.0f;
+
+        for (uint32_t c = 0; c < channelCount; ++c) {
+            projection += (colors[i][c] - mean[c]) * axis[c];
+        }
+
+        minProjection = fminf(minProjection, projection);
+        maxProjection = fmaxf(maxProjection, projection);
+    }
+
+    for (uint32_t c = 0; c < channelCount; ++c) {
+        endpoint0[c] = clampColor(mean[c] + minProjection * axis[c] / axisLengthSquared);
+        endpoint1[c] = clampColor(mean[c] + maxProjection * axis[c] / axisLengthSquared);
+    }
+}
+
+// Solves for the endpoints that best reproduce the block with the chosen interpolation factors.
+static void refitEndpoints(const float (*colors)[4], uint32_t channelCount, const float* factors, float* endpoint0, float* endpoint1) {
+    float a = 0.0f;
+    float b = 0.0f;
+    float c = 0.0f;
+    float d0[4] = {};
+    float d1[4] = {};
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        const float t = factors[i];
+
+        a += (1.0f - t) * (1.0f - t);
+        b += (1.0f - t) * t;
+        c += t * t;
+
+        for (uint32_t j = 0; j < channelCount; ++j) {
+            d0[j] += (1.0f - t) * colors[i][j];
+            d1[j] += t * colors[i][j];
+        }
+    }
+
+    const float determinant = a * c - b * b;
+
+    // Every pixel picked the same factor, there's nothing to solve.
+    if (fabsf(determinant) < 1e-6f) {
+        return;
+    }
+
+    for (uint32_t j = 0; j < channelCount; ++j) {
+        endpoint0[j] = clampColor((c * d0[j] - b * d1[j]) / determinant);
+        endpoint1[j] = clampColor((a * d1[j] - b * d0[j]) / determinant);
+    }
+}
+
+static void writeBits(uint8_t* block, uint32_t& position, uint32_t value, uint32_t count) {
+    for (uint32_t i = 0; i < count; ++i, ++position) {
+        if (value & (1 << i)) {
+            block[position / 8] |= 1 << (position % 8);
+        }
+    }
+}
+
+static uint16_t packRgb565(const float* color) {
+    const uint32_t r = (uint32_t)(color[0] * 31.0f / 255.0f + 0.5f);
+    const uint32_t g = (uint32_t)(color[1] * 63.0f / 255.0f + 0.5f);
+    const uint32_t b = (uint32_t)(color[2] * 31.0f / 255.0f + 0.5f);
+
+    return (uint16_t)(r << 11 | g << 5 | b);
+}
+
+static void unpackRgb565(uint16_t value, float* color) {
+    const uint32_t r = value >> 11 & 31;
+    const uint32_t g = value >> 5 & 63;
+    const uint32_t b = value & 31;
+
+    color[0] = (float)(r << 3 | r >> 2);
+    color[1] = (float)(g << 2 | g >> 4);
+    color[2] = (float)(b << 3 | b >> 2);
+}
+
+static void encodeBc1(const uint8_t (*pixels)[4], const BlockSettings& settings, uint8_t* block) {
+    float colors[16][4];
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t c = 0; c < 4; ++c) {
+            colors[i][c] = pixels[i][c];
+        }
+    }
+
+    float endpoint0[4], endpoint1[4];
+    fitEndpoints(colors, 3, endpoint0, endpoint1);
+
+    // Palette entries 2 and 3 sit at a third and two thirds of the way from color 0 to color 1.
+    static const float paletteFactors[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+
+    float bestError = INFINITY;
+
+    for (uint32_t iteration = 0; iteration <= settings.refineCount; ++iteration) {
+        uint16_t color0 = packRgb565(endpoint0);
+        uint16_t color1 = packRgb565(endpoint1);
+
+        // Only the four color mode is used, which needs color 0 to be the greater one.
+        const bool swapped = color0 < color1;
+
+        if (swapped) {
+            color0 = packRgb565(endpoint1);
+            color1 = packRgb565(endpoint0);
+        }
+
+        float palette[4][4];
+        unpackRgb565(color0, palette[0]);
+        unpackRgb565(color1, palette[1]);
+
+        for (uint32_t c = 0; c < 3; ++c) {
+            palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+            palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+        }
+
+        uint32_t indices = 0;
+        float factors[16];
+        float error = 0.0f;
+
+        for (uint32_t i = 0; i < 16; ++i) {
+            uint32_t bestIndex = 0;
+            float bestDistance = INFINITY;
+
+            // Equal colors select the three color mode, where index 0 still decodes to color 0.
+            const uint32_t paletteSize = color0 == color1 ? 1 : 4;
+
+            for (uint32_t j = 0; j < paletteSize; ++j) {
+                float distance = 0.0f;
+
+                for (uint32_t c = 0; c < 3; ++c) {
+                    distance += (colors[i][c] - palette[j][c]) * (colors[i][c] - palette[j][c]);
+                }
+
+                if (distance < bestDistance) {
+                    bestDistance = distance;
+                    bestIndex = j;
+                }
+            }
+
+            indices |= bestIndex << (2 * i);
+            factors[i] = swapped ? 1.0f - paletteFactors[bestIndex] : paletteFactors[bestIndex];
+            error += bestDistance;
+        }
+
+        if (error < bestError) {
+            bestError = error;
+
+            memcpy(block, &color0, 2);
+            memcpy(block + 2, &color1, 2);
+            memcpy(block + 4, &indices, 4);
+        }
+
+        if (iteration < settings.refineCount) {
+            refitEndpoints(colors, 3, factors, endpoint0, endpoint1);
+        }
+    }
+}
+
+static void encodeBc4(const uint8_t* values, uint32_t stride, const BlockSettings& settings, uint8_t* block) {
+    uint32_t minValue = 255;
+    uint32_t maxValue = 0;
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        minValue = values[i * stride] < minValue ? values[i * stride] : minValue;
+        maxValue = values[i * stride] > maxValue ? values[i * stride] : maxValue;
+    }
+
+    memset(block, 0, 8);
+
+    // A flat block is encoded exactly by its first endpoint.
+    if (minValue == maxValue) {
+        block[0] = (uint8_t)maxValue;
+        block[1] = (uint8_t)minValue;
+        return;
+    }
+
+    uint32_t bestError = UINT32_MAX;
+
+    // Pulling the endpoints in can lower the error of the values in between.
+    for (uint32_t maxInset = 0; maxInset <= settings.bc4SearchRadius; ++maxInset) {
+        for (uint32_t minInset = 0; minInset <= settings.bc4SearchRadius; ++minInset) {
+            if (maxValue < minValue + maxInset + minInset + 1) {
+                continue;
+            }
+
+            const uint32_t value0 = maxValue - maxInset;
+            const uint32_t value1 = minValue + minInset;
+
+            uint32_t palette[8] = { value0, value1 };
+
+            for (uint32_t i = 2; i < 8; ++i) {
+                palette[i] = ((8 - i) * value0 + (i - 1) * value1 + 3) / 7;
+            }
+
+            uint64_t indices = 0;
+            uint32_t error = 0;
+
+            for (uint32_t i = 0; i < 16; ++i) {
+                const int32_t value = values[i * stride];
+
+                uint32_t bestIndex = 0;
+                uint32_t bestDistance = UINT32_MAX;
+
+                for (uint32_t j = 0; j < 8; ++j) {
+                    const uint32_t distance = (uint32_t)((value - (int32_t)palette[j]) * (value - (int32_t)palette[j]));
+
+                    if (distance < bestDistance) {
+                        bestDistance = distance;
+                        bestIndex = j;
+                    }
+                }
+
+                indices |= (uint64_t)bestIndex << (3 * i);
+                error += bestDistance;
+            }
+
+            if (error < bestError) {
+                bestError = error;
+
+                block[0] = (uint8_t)value0;
+                block[1] = (uint8_t)value1;
+
+                for (uint32_t i = 0; i < 6; ++i) {
+                    block[2 + i] = (uint8_t)(indices >> (8 * i));
+                }
+            }
+        }
+    }
+}
+
+// Quantizes an endpoint to 7 bits per channel plus a shared low bit and returns the squared error.
+static float quantizeBc7Endpoint(const float* endpoint, uint32_t pBit, uint32_t* quantized) {
+    float error = 0.0f;
+
+    for (uint32_t c = 0; c < 4; ++c) {
+        const float value = roundf((endpoint[c] - pBit) / 2.0f);
+        quantized[c] = (uint32_t)fminf(fmaxf(value, 0.0f), 127.0f);
+
+        const float decoded = (float)(quantized[c] << 1 | pBit);
+        error += (decoded - endpoint[c]) * (decoded - endpoint[c]);
+    }
+
+    return error;
+}
+
+// Encodes the block with the quantized endpoints and returns the squared error.
+static float encodeBc7Indices(const float (*colors)[4], const uint32_t* quantized0, uint32_t pBit0, const uint32_t* quantized1, uint32_t pBit1,
+                              uint32_t* indices) {
+    float palette[16][4];
+
+    for (uint32_t c = 0; c < 4; ++c) {
+        const uint32_t value0 = quantized0[c] << 1 | pBit0;
+        const uint32_t value1 = quantized1[c] << 1 | pBit1;
+
+        for (uint32_t i = 0; i < 16; ++i) {
+            palette[i][c] = (float)(((64 - bc7Weights[i]) * value0 + bc7Weights[i] * value1 + 32) >> 6);
+        }
+    }
+
+    float error = 0.0f;
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        float bestDistance = INFINITY;
+
+        for (uint32_t j = 0; j < 16; ++j) {
+            float distance = 0.0f;
+
+            for (uint32_t c = 0; c < 4; ++c) {
+                distance += (colors[i][c] - palette[j][c]) * (colors[i][c] - palette[j][c]);
+            }
+
+            if (distance < bestDistance) {
+                bestDistance = distance;
+                indices[i] = j;
+            }
+        }
+
+        error += bestDistance;
+    }
+
+    return error;
+}
+
+// Only mode 6 is used: a single subset with RGBA endpoints and 4-bit indices, which suits most textures well.
+static void encodeBc7(const uint8_t (*pixels)[4], const BlockSettings& settings, uint8_t* block) {
+    float colors[16][4];
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        for (uint32_t c = 0; c < 4; ++c) {
+            colors[i][c] = pixels[i][c];
+        }
+    }
+
+    float endpoint0[4], endpoint1[4];
+    fitEndpoints(colors, 4, endpoint0, endpoint1);
+
+    float bestError = INFINITY;
+    uint32_t bestQuantized[2][4], bestPBits[2], bestIndices[16];
+
+    for (uint32_t iteration = 0; iteration <= settings.refineCount; ++iteration) {
+        uint32_t quantized[2][4], pBits[2], indices[16];
+        float error;
+
+        if (settings.bc7SearchPBits) {
+            // Try every combination of low bits against the whole block.
+            error = INFINITY;
+
+            for (uint32_t combination = 0; combination < 4; ++combination) {
+                uint32_t candidate[2][4], candidateIndices[16];
+
+                quantizeBc7Endpoint(endpoint0, combination & 1, candidate[0]);
+                quantizeBc7Endpoint(endpoint1, combination >> 1, candidate[1]);
+
+                const float candidateError = encodeBc7Indices(colors, candidate[0], combination & 1, candidate[1], combination >> 1, candidateIndices);
+
+                if (candidateError < error) {
+                    error = candidateError;
+
+                    memcpy(quantized, candidate, sizeof(quantized));
+                    memcpy(indices, candidateIndices, sizeof(indices));
+
+                    pBits[0] = combination & 1;
+                    pBits[1] = combination >> 1;
+                }
+            }
+        } else {
+            // Pick the low bit that best reproduces each endpoint on its own.
+            for (uint32_t i = 0; i < 2; ++i) {
+                const float* endpoint = i == 0 ? endpoint0 : endpoint1;
+                uint32_t candidate[4];
+
+                pBits[i] = quantizeBc7Endpoint(endpoint, 1, candidate) < quantizeBc7Endpoint(endpoint, 0, quantized[i]) ? 1 : 0;
+
+                if (pBits[i] == 1) {
+                    memcpy(quantized[i], candidate, sizeof(candidate));
+                }
+            }
+
+            error = encodeBc7Indices(colors, quantized[0], pBits[0], quantized[1], pBits[1], indices);
+        }
+
+        if (error < bestError) {
+            bestError = error;
+
+            memcpy(bestQuantized, quantized, sizeof(quantized));
+            memcpy(bestPBits, pBits, sizeof(pBits));
+            memcpy(bestIndices, indices, sizeof(indices));
+        }
+
+        if (iteration < settings.refineCount) {
+            float factors[16];
+
+            for (uint32_t i = 0; i < 16; ++i) {
+                factors[i] = bc7Weights[indices[i]] / 64.0f;
+            }
+
+            refitEndpoints(colors, 4, factors, endpoint0, endpoint1);
+        }
+    }
+
+    // The most significant bit of the first index is implied to be zero, which swapping the endpoints guarantees.
+    if (bestIndices[0] >= 8) {
+        uint32_t swapped[4];
+        memcpy(swapped, bestQuantized[0], sizeof(swapped));
+        memcpy(bestQuantized[0], bestQuantized[1], sizeof(swapped));
+        memcpy(bestQuantized[1], swapped, sizeof(swapped));
+
+        const uint32_t swappedPBit = bestPBits[0];
+        bestPBits[0] = bestPBits[1];
+        bestPBits[1] = swappedPBit;
+
+        for (uint32_t& index : bestIndices) {
+            index = 15 - index;
+        }
+    }
+
+    memset(block, 0, 16);
+
+    uint32_t position = 0;
+    writeBits(block, position, 1 << 6, 7);
+
+    for (uint32_t c = 0; c < 4; ++c) {
+        writeBits(block, position, bestQuantized[0][c], 7);
+        writeBits(block, position, bestQuantized[1][c], 7);
+    }
+
+    writeBits(block, position, bestPBits[0], 1);
+    writeBits(block, position, bestPBits[1], 1);
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        writeBits(block, position, bestIndices[i], i == 0 ? 3 : 4);
+    }
+}
+
+uint32_t getBlockSize(BlockCompression compression) {
+    return compression == BLOCK_COMPRESSION_BC1 || compression == BLOCK_COMPRESSION_BC4 ? 8 : 16;
+}
+
+void compressBlocks(JobSystem& jobSystem, const uint8_t* pixels, uint32_t width, uint32_t height, BlockCompression compression,
+                    BlockCompressionQuality quality, uint8_t* blocks) {
+    const uint32_t blockCountX = (width + 3) / 4;
+    const uint32_t blockCountY = (height + 3) / 4;
+    const uint32_t blockSize = getBlockSize(compression);
+    const BlockSettings settings = getBlockSettings(quality);
+
+    jobSystem.parallelFor(blockCountY, blockRowGrainSize, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t blockY = begin; blockY < end; ++blockY) {
+            for (uint32_t blockX = 0; blockX < blockCountX; ++blockX) {
+                uint8_t blockPixels[16][4];
+
+                for (uint32_t i = 0; i < 16; ++i) {
+                    const uint32_t x = 4 * blockX + i % 4 < width ? 4 * blockX + i % 4 : width - 1;
+                    const uint32_t y = 4 * blockY + i / 4 < height ? 4 * blockY + i / 4 : height - 1;
+
+                    memcpy(blockPixels[i], pixels + 4 * ((size_t)y * width + x), 4);
+                }
+
+                uint8_t* block = blocks + ((size_t)blockY * blockCountX + blockX) * blockSize;
+
+                switch (compression) {
+                    case BLOCK_COMPRESSION_BC1:
+                        encodeBc1(blockPixels, settings, block);
+                        break;
+                    case BLOCK_COMPRESSION_BC4:
+                        encodeBc4(&blockPixels[0][0], 4, settings, block);
+                        break;
+                    case BLOCK_COMPRESSION_BC5:
+                        encodeBc4(&blockPixels[0][0], 4, settings, block);
+                        encodeBc4(&blockPixels[0][1], 4, settings, block + 8);
+                        break;
+                    case BLOCK_COMPRESSION_BC7:
+                        encodeBc7(blockPixels, settings, block);
+                        break;
+                }
+            }
+        }
+    });
+}
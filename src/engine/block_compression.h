@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "jobs.h"
+
+enum BlockCompression {
+    BLOCK_COMPRESSION_BC1,
+    BLOCK_COMPRESSION_BC4,
+    BLOCK_COMPRESSION_BC5,
+    BLOCK_COMPRESSION_BC7
+};
+
+// Trades encoding time for quality. Endpoints are always fitted along the principal axis of the block, normal quality
+// refines them by least squares and high quality does so with more iterations and a wider search.
+enum BlockCompressionQuality {
+    BLOCK_COMPRESSION_QUALITY_FAST,
+    BLOCK_COMPRESSION_QUALITY_NORMAL,
+    BLOCK_COMPRESSION_QUALITY_HIGH
+};
+
+// The size of a 4x4 block in bytes.
+uint32_t getBlockSize(BlockCompression compression);
+
+// Compresses RGBA8 pixels into 4x4 blocks, rows of blocks are spread across threads. Partial blocks at the edges repeat
+// the last row and column. BC4 reads the red channel and BC5 the red and green ones.
+void compressBlocks(JobSystem& jobSystem, const uint8_t* pixels, uint32_t width, uint32_t height, BlockCompression compression,
+                    BlockCompressionQuality quality, uint8_t* blocks);
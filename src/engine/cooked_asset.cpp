@@ -0,0 +1,451 @@
+#include "cooked_asset.h"
+
+#include <string.h>
+
+#include "blas_cache.h"
+#include "file_mapping.h"
+#include "mesh_optimizer.h"
+#include "texture_streaming.h"
+#include "upload.h"
+
+static const VkDeviceSize stagingCapacity = 64ull << 20;
+static const VkDeviceSize stagingAlignment = 16;
+
+// Copies to the staging memory are split into ranges of this many bytes and spread across threads.
+static const VkDeviceSize copyGrainSize = 1 << 20;
+
+static bool isSectionInFile(const CookedAssetHeader& header, uint64_t offset, uint64_t size) {
+    return offset % COOKED_ASSET_ALIGNMENT == 0 && offset <= header.fileSize && size <= header.fileSize - offset;
+}
+
+bool isValidCookedAsset(const MappedFile& file) {
+    if (file.data == nullptr || file.size < sizeof(CookedAssetHeader)) {
+        return false;
+    }
+
+    const CookedAssetHeader& header = *(const CookedAssetHeader*)file.data;
+
+    if (header.magic != COOKED_ASSET_MAGIC || header.version != COOKED_ASSET_VERSION || header.fileSize != file.size) {
+        return false;
+    }
+
+    if (!isSectionInFile(header, header.meshesOffset, (uint64_t)header.meshCount * sizeof(CookedMesh)) ||
+        !isSectionInFile(header, header.lodsOffset, (uint64_t)header.lodCount * sizeof(CookedMeshLod)) ||
+        !isSectionInFile(header, header.nodesOffset, (uint64_t)header.nodeCount * sizeof(ModelNode)) ||
+        !isSectionInFile(header, header.materialsOffset, (uint64_t)header.materialCount * sizeof(Material)) ||
+        !isSectionInFile(header, header.samplersOffset, (uint64_t)header.samplerCount * sizeof(SamplerDescription)) ||
+        !isSectionInFile(header, header.texturesOffset, (uint64_t)header.textureCount * sizeof(CookedTexture)) ||
+        !isSectionInFile(header, header.verticesOffset, (uint64_t)header.vertexCount * sizeof(QuantizedVertex)) ||
+        !isSectionInFile(header, header.indicesOffset, (uint64_t)header.indexCount * sizeof(uint32_t))) {
+        return false;
+    }
+
+    // Mesh ranges are read on the host when the BLAS is built from decoded positions.
+    const CookedMesh* meshes = (const CookedMesh*)(file.data + header.meshesOffset);
+    const CookedMeshLod* lods = (const CookedMeshLod*)(file.data + header.lodsOffset);
+
+    // Every LOD belongs to exactly one mesh, in order.
+    uint64_t lodCount = 0;
+
+    for (uint32_t i = 0; i < header.meshCount; ++i) {
+        if ((uint64_t)meshes[i].firstVertex + meshes[i].vertexCount > header.vertexCount ||
+            meshes[i].firstLod != lodCount || meshes[i].lodCount == 0) {
+            return false;
+        }
+
+        lodCount += meshes[i].lodCount;
+    }
+
+    if (lodCount != header.lodCount) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < header.lodCount; ++i) {
+        if ((uint64_t)lods[i].firstIndex + lods[i].indexCount > header.indexCount) {
+            return false;
+        }
+    }
+
+    // Nodes are instanced in order on load, so parents have to come before their children.
+    const ModelNode* nodes = (const ModelNode*)(file.data + header.nodesOffset);
+
+    for (uint32_t i = 0; i < header.nodeCount; ++i) {
+        if (nodes[i].parent >= (int32_t)i || (uint64_t)nodes[i].firstMesh + nodes[i].meshCount > header.meshCount) {
+            return false;
+        }
+    }
+
+    const CookedTexture* textures = (const CookedTexture*)(file.data + header.texturesOffset);
+
+    for (uint32_t i = 0; i < header.textureCount; ++i) {
+        if (textures[i].mipLevels == 0 || textures[i].mipLevels > COOKED_TEXTURE_MAX_MIP_LEVELS) {
+            return false;
+        }
+
+        for (uint32_t j = 0; j < textures[i].mipLevels; ++j) {
+            if (textures[i].mipOffsets[j] > header.fileSize || textures[i].mipSizes[j] > header.fileSize - textures[i].mipOffsets[j]) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+static void copyToStaging(JobSystem& jobSystem, uint8_t* destination, const uint8_t* source, VkDeviceSize size) {
+    const uint32_t rangeCount = (uint32_t)((size + copyGrainSize - 1) / copyGrainSize);
+
+    jobSystem.parallelFor(rangeCount, 1, [&](uint32_t begin, uint32_t end) {
+        const VkDeviceSize beginOffset = begin * copyGrainSize;
+        const VkDeviceSize endOffset = end * copyGrainSize < size ? end * copyGrainSize : size;
+
+        memcpy(destination + beginOffset, source + beginOffset, endOffset - beginOffset);
+    });
+}
+
+static void uploadToBuffer(Device& device, JobSystem& jobSystem, Uploader& uploader, VkBuffer buffer, const uint8_t* source, VkDeviceSize size) {
+    for (VkDeviceSize uploadedSize = 0; uploadedSize < size;) {
+        VkDeviceSize chunkSize = size - uploadedSize;
+
+        if (chunkSize > uploader.capacity) {
+            chunkSize = uploader.capacity;
+        }
+
+        VkDeviceSize stagingOffset;
+
+        if (!uploader.allocate(chunkSize, stagingAlignment, &stagingOffset)) {
+            uploader.flush(device);
+            uploader.allocate(chunkSize, stagingAlignment, &stagingOffset);
+        }
+
+        copyToStaging(jobSystem, uploader.getData() + stagingOffset, source + uploadedSize, chunkSize);
+        uploader.copyToBuffer(buffer, uploadedSize, stagingOffset, chunkSize);
+
+        uploadedSize += chunkSize;
+    }
+}
+
+bool loadCookedAsset(Device& device, JobSystem& jobSystem, BindlessTables& bindlessTables, TextureStreamer& textureStreamer,
+                     SamplerCache& samplerCache, const std::filesystem::path& path, Model& model) {
+    MappedFile file(path);
+
+    if (!isValidCookedAsset(file)) {
+        file.destroy();
+        return false;
+    }
+
+    const CookedAssetHeader& header = *(const CookedAssetHeader*)file.data;
+    const CookedMesh* cookedMeshes = (const CookedMesh*)(file.data + header.meshesOffset);
+    const CookedMeshLod* cookedLods = (const CookedMeshLod*)(file.data + header.lodsOffset);
+    const CookedTexture* cookedTextures = (const CookedTexture*)(file.data + header.texturesOffset);
+    const Material* cookedMaterials = (const Material*)(file.data + header.materialsOffset);
+    const SamplerDescription* cookedSamplers = (const SamplerDescription*)(file.data + header.samplersOffset);
+
+    Uploader uploader(device, stagingCapacity);
+
+    // Upload the vertex and index streams.
+    model.meshCount = header.meshCount;
+    model.meshes = new Mesh[model.meshCount];
+
+    for (uint32_t i = 0; i < model.meshCount; ++i) {
+        model.meshes[i].firstVertex   = cookedMeshes[i].firstVertex;
+        model.meshes[i].vertexCount   = cookedMeshes[i].vertexCount;
+        model.meshes[i].firstLod      = cookedMeshes[i].firstLod;
+        model.meshes[i].lodCount      = cookedMeshes[i].lodCount;
+        model.meshes[i].materialIndex = cookedMeshes[i].materialIndex;
+
+        memcpy(model.meshes[i].positionOffset, cookedMeshes[i].positionOffset, sizeof(float[3]));
+        memcpy(model.meshes[i].positionScale, cookedMeshes[i].positionScale, sizeof(float[3]));
+
+        model.meshes[i].surfaceArea = cookedMeshes[i].surfaceArea;
+        memcpy(model.meshes[i].normalCone, cookedMeshes[i].normalCone, sizeof(float[4]));
+
+        // A diffuse emitter radiates pi times its radiance over its area, textures only ever darken the factor.
+        model.meshes[i].emittedPower = 0.0f;
+
+        if (cookedMeshes[i].materialIndex < header.materialCount) {
+            const float* emissive = cookedMaterials[cookedMeshes[i].materialIndex].emissiveFactor;
+            const float luminance = 0.2126f * emissive[0] + 0.7152f * emissive[1] + 0.0722f * emissive[2];
+
+            model.meshes[i].emittedPower = 3.14159265f * luminance * cookedMeshes[i].surfaceArea;
+        }
+    }
+
+    model.lodCount = header.lodCount;
+    model.lods = new MeshLod[model.lodCount];
+
+    for (uint32_t i = 0; i < model.lodCount; ++i) {
+        model.lods[i].firstIndex = cookedLods[i].firstIndex;
+        model.lods[i].indexCount = cookedLods[i].indexCount;
+        model.lods[i].error      = cookedLods[i].error;
+    }
+
+    if (model.meshCount > 0) {
+        const VkBufferUsageFlags geometryUsage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+                                                 VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT |
+                                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+        const VkDeviceSize vertexBufferSize = (VkDeviceSize)header.vertexCount * sizeof(QuantizedVertex);
+        const VkDeviceSize indexBufferSize = (VkDeviceSize)header.indexCount * sizeof(uint32_t);
+
+        model.vertexBuffer = Buffer(device, vertexBufferSize, geometryUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        model.indexBuffer = Buffer(device, indexBufferSize, geometryUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        uploadToBuffer(device, jobSystem, uploader, model.vertexBuffer, file.data + header.verticesOffset, vertexBufferSize);
+        uploadToBuffer(device, jobSystem, uploader, model.indexBuffer, file.data + header.indicesOffset, indexBufferSize);
+
+        // Upload the geometry table, which is how the hit shaders find and decode the vertices of the mesh they hit.
+        const VkDeviceAddress vertexAddress = model.vertexBuffer.getDeviceAddress(device.logical);
+        const VkDeviceAddress indexAddress = model.indexBuffer.getDeviceAddress(device.logical);
+        const VkDeviceSize geometryBufferSize = (VkDeviceSize)model.lodCount * sizeof(MeshGeometry);
+
+        model.geometryBuffer = Buffer(device, geometryBufferSize,
+                                      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+        model.geometryBufferIndex = bindlessTables.addBuffer(device.logical, model.geometryBuffer);
+
+        VkDeviceSize geometryStagingOffset;
+
+        if (!uploader.allocate(geometryBufferSize, stagingAlignment, &geometryStagingOffset)) {
+            uploader.flush(device);
+            uploader.allocate(geometryBufferSize, stagingAlignment, &geometryStagingOffset);
+        }
+
+        MeshGeometry* geometries = (MeshGeometry*)(uploader.getData() + geometryStagingOffset);
+
+        for (uint32_t i = 0; i < model.meshCount; ++i) {
+            const Mesh& mesh = model.meshes[i];
+
+            for (uint32_t j = mesh.firstLod; j < mesh.firstLod + mesh.lodCount; ++j) {
+                geometries[j] = {
+                    .vertexAddress  = vertexAddress + (VkDeviceSize)mesh.firstVertex * sizeof(QuantizedVertex),
+                    .indexAddress   = indexAddress + (VkDeviceSize)model.lods[j].firstIndex * sizeof(uint32_t),
+                    .positionOffset = { mesh.positionOffset[0], mesh.positionOffset[1], mesh.positionOffset[2] },
+                    .materialIndex  = mesh.materialIndex,
+                    .positionScale  = { mesh.positionScale[0], mesh.positionScale[1], mesh.positionScale[2] },
+                    .padding        = 0
+                };
+            }
+        }
+
+        uploader.copyToBuffer(model.geometryBuffer, 0, geometryStagingOffset, geometryBufferSize);
+    }
+
+    // Register the textures with the streamer, only their smallest mips are uploaded for now.
+    model.textureCount = header.textureCount;
+    model.textureSlots = new uint32_t[model.textureCount];
+
+    uint32_t fileIndex = UINT32_MAX;
+
+    if (model.textureCount > 0) {
+        fileIndex = textureStreamer.addFile(file);
+    }
+
+    for (uint32_t i = 0; i < model.textureCount; ++i) {
+        model.textureSlots[i] = textureStreamer.addTexture(device, bindlessTables, fileIndex, cookedTextures[i]);
+    }
+
+    // Samplers are deduplicated against every other asset's.
+    uint32_t* samplerIndices = new uint32_t[header.samplerCount];
+
+    for (uint32_t i = 0; i < header.samplerCount; ++i) {
+        samplerIndices[i] = samplerCache.getSampler(device, bindlessTables, cookedSamplers[i]);
+    }
+
+    // Upload the materials, with their texture and sampler indices translated to the bindless tables.
+    model.materialCount = header.materialCount;
+
+    const VkDeviceSize materialBufferSize = (VkDeviceSize)model.materialCount * sizeof(Material);
+
+    model.materialBuffer = Buffer(device, materialBufferSize,
+                                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                  VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    model.materialBufferIndex = bindlessTables.addBuffer(device.logical, model.materialBuffer);
+
+    VkDeviceSize materialStagingOffset;
+
+    if (!uploader.allocate(materialBufferSize, stagingAlignment, &materialStagingOffset)) {
+        uploader.flush(device);
+        uploader.allocate(materialBufferSize, stagingAlignment, &materialStagingOffset);
+    }
+
+    Material* materials = (Material*)(uploader.getData() + materialStagingOffset);
+
+    auto getTextureIndex = [&](uint32_t cookedIndex) {
+        return cookedIndex < model.textureCount ? model.textureSlots[cookedIndex] : BINDLESS_INVALID_INDEX;
+    };
+
+    auto getSamplerIndex = [&](uint32_t cookedIndex) {
+        return cookedIndex < header.samplerCount ? samplerIndices[cookedIndex] : samplerCache.getDefaultSampler();
+    };
+
+    for (uint32_t i = 0; i < model.materialCount; ++i) {
+        materials[i] = cookedMaterials[i];
+
+        materials[i].baseColorTexture         = getTextureIndex(cookedMaterials[i].baseColorTexture);
+        materials[i].metallicRoughnessTexture = getTextureIndex(cookedMaterials[i].metallicRoughnessTexture);
+        materials[i].normalTexture            = getTextureIndex(cookedMaterials[i].normalTexture);
+        materials[i].emissiveTexture          = getTextureIndex(cookedMaterials[i].emissiveTexture);
+        materials[i].sampler                  = getSamplerIndex(cookedMaterials[i].sampler);
+    }
+
+    uploader.copyToBuffer(model.materialBuffer, 0, materialStagingOffset, materialBufferSize);
+
+    delete[] samplerIndices;
+
+    // Copy the node hierarchy.
+    model.nodeCount = header.nodeCount;
+    model.nodes = new ModelNode[model.nodeCount];
+    memcpy(model.nodes, file.data + header.nodesOffset, model.nodeCount * sizeof(ModelNode));
+
+    uint64_t* contentHashes = new uint64_t[model.lodCount];
+
+    for (uint32_t i = 0; i < model.lodCount; ++i) {
+        contentHashes[i] = cookedLods[i].contentHash;
+    }
+
+    // Load the acceleration structures from the cache next to the asset, or upload what's needed to build them.
+    std::filesystem::path blasCachePath = path;
+    blasCachePath.replace_extension(BLAS_CACHE_EXTENSION);
+
+    AccelerationStructure* blases = new AccelerationStructure[model.lodCount];
+    BlasGeometry* blasGeometries = nullptr;
+    Buffer blasInputBuffer;
+
+    if (model.lodCount > 0 && !loadBlasCache(device, blasCachePath, model.lodCount, contentHashes, blases, model.blasBuffer)) {
+        blasGeometries = new BlasGeometry[model.lodCount];
+
+        const VkBufferUsageFlags blasInputUsage = VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR |
+                                                  VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+        const VkDeviceAddress vertexAddress = model.vertexBuffer.getDeviceAddress(device.logical);
+        const VkDeviceAddress indexAddress = model.indexBuffer.getDeviceAddress(device.logical);
+
+        if (device.snormBlasVerticesSupported) {
+            // The quantized vertices are built as they are, with a transform per mesh that decodes them for all of its LODs.
+            const VkDeviceSize transformBufferSize = (VkDeviceSize)model.meshCount * sizeof(VkTransformMatrixKHR);
+
+            blasInputBuffer = Buffer(device, transformBufferSize, blasInputUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+            VkDeviceSize transformStagingOffset;
+
+            if (!uploader.allocate(transformBufferSize, stagingAlignment, &transformStagingOffset)) {
+                uploader.flush(device);
+                uploader.allocate(transformBufferSize, stagingAlignment, &transformStagingOffset);
+            }
+
+            VkTransformMatrixKHR* transforms = (VkTransformMatrixKHR*)(uploader.getData() + transformStagingOffset);
+            const VkDeviceAddress transformAddress = blasInputBuffer.getDeviceAddress(device.logical);
+
+            for (uint32_t i = 0; i < model.meshCount; ++i) {
+                const Mesh& mesh = model.meshes[i];
+
+                transforms[i] = {{
+                    { mesh.positionScale[0], 0.0f,                  0.0f,                  mesh.positionOffset[0] },
+                    { 0.0f,                  mesh.positionScale[1], 0.0f,                  mesh.positionOffset[1] },
+                    { 0.0f,                  0.0f,                  mesh.positionScale[2], mesh.positionOffset[2] }
+                }};
+
+                for (uint32_t j = mesh.firstLod; j < mesh.firstLod + mesh.lodCount; ++j) {
+                    blasGeometries[j] = {
+                        .vertexAddress    = vertexAddress + (VkDeviceSize)mesh.firstVertex * sizeof(QuantizedVertex),
+                        .vertexStride     = sizeof(QuantizedVertex),
+                        .vertexCount      = mesh.vertexCount,
+                        .vertexFormat     = VK_FORMAT_R16G16B16A16_SNORM,
+                        .indexAddress     = indexAddress + (VkDeviceSize)model.lods[j].firstIndex * sizeof(uint32_t),
+                        .indexCount       = model.lods[j].indexCount,
+                        .transformAddress = transformAddress + (VkDeviceSize)i * sizeof(VkTransformMatrixKHR)
+                    };
+                }
+            }
+
+            uploader.copyToBuffer(blasInputBuffer, 0, transformStagingOffset, transformBufferSize);
+        } else {
+            // Otherwise the positions are decoded to floats, exactly as the hit shaders decode them.
+            const QuantizedVertex* cookedVertices = (const QuantizedVertex*)(file.data + header.verticesOffset);
+            float* positions = new float[3 * (size_t)header.vertexCount];
+
+            jobSystem.parallelFor(model.meshCount, 1, [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; ++i) {
+                    const Mesh& mesh = model.meshes[i];
+                    dequantizePositions(cookedVertices + mesh.firstVertex, mesh.vertexCount, mesh.positionOffset, mesh.positionScale,
+                                        positions + 3 * (size_t)mesh.firstVertex);
+                }
+            });
+
+            const VkDeviceSize positionBufferSize = (VkDeviceSize)header.vertexCount * 3 * sizeof(float);
+
+            blasInputBuffer = Buffer(device, positionBufferSize, blasInputUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+            uploadToBuffer(device, jobSystem, uploader, blasInputBuffer, (const uint8_t*)positions, positionBufferSize);
+
+            const VkDeviceAddress positionAddress = blasInputBuffer.getDeviceAddress(device.logical);
+
+            for (uint32_t i = 0; i < model.meshCount; ++i) {
+                const Mesh& mesh = model.meshes[i];
+
+                for (uint32_t j = mesh.firstLod; j < mesh.firstLod + mesh.lodCount; ++j) {
+                    blasGeometries[j] = {
+                        .vertexAddress    = positionAddress + (VkDeviceSize)mesh.firstVertex * 3 * sizeof(float),
+                        .vertexStride     = 3 * sizeof(float),
+                        .vertexCount      = mesh.vertexCount,
+                        .vertexFormat     = VK_FORMAT_R32G32B32_SFLOAT,
+                        .indexAddress     = indexAddress + (VkDeviceSize)model.lods[j].firstIndex * sizeof(uint32_t),
+                        .indexCount       = model.lods[j].indexCount,
+                        .transformAddress = 0
+                    };
+                }
+            }
+
+            delete[] positions;
+        }
+    }
+
+    uploader.finish(device);
+    uploader.destroy(device.logical);
+
+    // The streamer owns the mapping once it has textures from it.
+    if (fileIndex != UINT32_MAX) {
+        textureStreamer.releaseFile(fileIndex);
+    } else {
+        file.destroy();
+    }
+
+    if (blasGeometries != nullptr) {
+        buildBottomLevelAccelerationStructures(device, model.lodCount, blasGeometries, blases, model.blasBuffer);
+        saveBlasCache(device, blasCachePath, model.lodCount, contentHashes, blases);
+
+        blasInputBuffer.destroy(device.logical);
+
+        delete[] blasGeometries;
+    }
+
+    for (uint32_t i = 0; i < model.lodCount; ++i) {
+        model.lods[i].blas = blases[i];
+    }
+
+    delete[] blases;
+    delete[] contentHashes;
+
+    return true;
+}
+
+uint32_t loadCookedImage(Device& device, BindlessTables& bindlessTables, TextureStreamer& textureStreamer, const std::filesystem::path& path) {
+    MappedFile file(path);
+
+    if (!isValidCookedAsset(file) || ((const CookedAssetHeader*)file.data)->textureCount != 1) {
+        file.destroy();
+        return BINDLESS_INVALID_INDEX;
+    }
+
+    const CookedAssetHeader& header = *(const CookedAssetHeader*)file.data;
+    const CookedTexture& cookedTexture = *(const CookedTexture*)(file.data + header.texturesOffset);
+
+    const uint32_t fileIndex = textureStreamer.addFile(file);
+    const uint32_t slot = textureStreamer.addTexture(device, bindlessTables, fileIndex, cookedTexture);
+
+    textureStreamer.releaseFile(fileIndex);
+
+    return slot;
+}
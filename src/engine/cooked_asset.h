@@ -0,0 +1,98 @@
+#pragma once
+
+#include <filesystem>
+
+#include "jobs.h"
+#include "model.h"
+#include "sampler_cache.h"
+
+class MappedFile;
+class TextureStreamer;
+
+// A cooked asset is a single file laid out so that it can be mapped and uploaded without any parsing:
+//
+//     header | meshes | LODs | nodes | materials | samplers | textures | vertices | indices | texture data
+//
+// Every section starts at a multiple of COOKED_ASSET_ALIGNMENT. Offsets are relative to the start of the file. Materials
+// are stored as they are uploaded, except that texture indices refer to the asset's texture table and sampler indices
+// to its sampler table, with BINDLESS_INVALID_INDEX for the default sampler. Vertices are quantized against the bounds
+// of their mesh. Every LOD of a mesh has its own range of indices, relative to the mesh's first vertex.
+#define COOKED_ASSET_MAGIC 0x41435856 // "VXCA"
+#define COOKED_ASSET_VERSION 7
+#define COOKED_ASSET_ALIGNMENT 256
+#define COOKED_ASSET_EXTENSION ".vxa"
+
+#define COOKED_TEXTURE_MAX_MIP_LEVELS 16
+#define COOKED_MESH_MAX_LODS 6
+
+struct CookedAssetHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fileSize;
+    uint32_t meshCount;
+    uint32_t nodeCount;
+    uint32_t materialCount;
+    uint32_t samplerCount;
+    uint32_t textureCount;
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t lodCount;
+    uint64_t meshesOffset;
+    uint64_t lodsOffset;
+    uint64_t nodesOffset;
+    uint64_t materialsOffset;
+    uint64_t samplersOffset;
+    uint64_t texturesOffset;
+    uint64_t verticesOffset;
+    uint64_t indicesOffset;
+};
+
+// LODs are ordered from the finest to the coarsest. The surface area and normal cone are measured on the finest LOD,
+// in the units of the positions, so that emissive meshes can be bounded as lights.
+struct CookedMesh {
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    uint32_t firstLod;
+    uint32_t lodCount;
+    uint32_t materialIndex;
+    float positionOffset[3];
+    float positionScale[3];
+    float surfaceArea;
+    float normalCone[4];
+};
+
+// The content hash covers the mesh's vertices and bounds and the LOD's indices, it identifies the LOD in the BLAS cache.
+// The error is how far the LOD's surface may be from the mesh's, in the units of the positions.
+struct CookedMeshLod {
+    uint64_t contentHash;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+    uint32_t padding;
+};
+
+struct CookedTexture {
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint64_t mipOffsets[COOKED_TEXTURE_MAX_MIP_LEVELS];
+    uint64_t mipSizes[COOKED_TEXTURE_MAX_MIP_LEVELS];
+};
+
+inline uint64_t alignCookedOffset(uint64_t offset) {
+    return (offset + COOKED_ASSET_ALIGNMENT - 1) & ~(uint64_t)(COOKED_ASSET_ALIGNMENT - 1);
+}
+
+// Checks that a mapped file is a complete cooked asset of the current version whose sections are all in bounds.
+bool isValidCookedAsset(const MappedFile& file);
+
+// Maps a cooked asset and streams it to the device through the staging memory. Textures are handed to the texture
+// streamer, which keeps the file mapped while they are alive, and samplers are shared through the sampler cache.
+// Returns false if the file is missing, truncated or was cooked by a different version.
+bool loadCookedAsset(Device& device, JobSystem& jobSystem, BindlessTables& bindlessTables, TextureStreamer& textureStreamer,
+                     SamplerCache& samplerCache, const std::filesystem::path& path, Model& model);
+
+// Loads a cooked asset that holds a single texture. Returns the texture's slot in the texture table, or
+// BINDLESS_INVALID_INDEX if the file can't be loaded.
+uint32_t loadCookedImage(Device& device, BindlessTables& bindlessTables, TextureStreamer& textureStreamer, const std::filesystem::path& path);
@@ -0,0 +1,325 @@
+#include "denoiser.h"
+
+#include <math.h>
+
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define DENOISER_USE_SSE2
+#endif
+
+// Passes are split into square tiles of this many pixels.
+static const uint32_t tileSize = 64;
+
+// The temporal variance needs a few frames of history, shorter histories estimate it spatially instead.
+static const float minVarianceHistory = 4.0f;
+static const int32_t varianceRadius = 3;
+
+// The B3 spline taps of the à-trous wavelet, from the center outwards.
+static const float waveletWeights[3] = { 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f };
+
+#ifdef DENOISER_USE_SSE2
+
+typedef __m128 Pixel;
+
+static inline Pixel loadPixel(const float* pixel) {
+    return _mm_loadu_ps(pixel);
+}
+
+static inline void storePixel(float* pixel, Pixel value) {
+    _mm_storeu_ps(pixel, value);
+}
+
+static inline Pixel zeroPixel() {
+    return _mm_setzero_ps();
+}
+
+// The color channels are weighted by the weight and the variance in alpha by its square, as the variance of a weighted
+// sum is.
+static inline Pixel addFiltered(Pixel sum, Pixel value, float weight) {
+    return _mm_add_ps(sum, _mm_mul_ps(value, _mm_set_ps(weight * weight, weight, weight, weight)));
+}
+
+static inline Pixel normalizeFiltered(Pixel sum, float weightSum) {
+    return _mm_div_ps(sum, _mm_set_ps(weightSum * weightSum, weightSum, weightSum, weightSum));
+}
+
+static inline Pixel blend(Pixel from, Pixel to, float alpha) {
+    return _mm_add_ps(from, _mm_mul_ps(_mm_sub_ps(to, from), _mm_set1_ps(alpha)));
+}
+
+#else
+
+struct Pixel {
+    float c[4];
+};
+
+static inline Pixel loadPixel(const float* pixel) {
+    return { pixel[0], pixel[1], pixel[2], pixel[3] };
+}
+
+static inline void storePixel(float* pixel, Pixel value) {
+    for (uint32_t i = 0; i < 4; ++i) {
+        pixel[i] = value.c[i];
+    }
+}
+
+static inline Pixel zeroPixel() {
+    return { 0.0f, 0.0f, 0.0f, 0.0f };
+}
+
+static inline Pixel addFiltered(Pixel sum, Pixel value, float weight) {
+    for (uint32_t i = 0; i < 3; ++i) {
+        sum.c[i] += value.c[i] * weight;
+    }
+
+    sum.c[3] += value.c[3] * weight * weight;
+
+    return sum;
+}
+
+static inline Pixel normalizeFiltered(Pixel sum, float weightSum) {
+    for (uint32_t i = 0; i < 3; ++i) {
+        sum.c[i] /= weightSum;
+    }
+
+    sum.c[3] /= weightSum * weightSum;
+
+    return sum;
+}
+
+static inline Pixel blend(Pixel from, Pixel to, float alpha) {
+    for (uint32_t i = 0; i < 4; ++i) {
+        from.c[i] += (to.c[i] - from.c[i]) * alpha;
+    }
+
+    return from;
+}
+
+#endif
+
+static float getLuminance(const float* pixel) {
+    return 0.2126f * pixel[0] + 0.7152f * pixel[1] + 0.0722f * pixel[2];
+}
+
+static void forEachTile(JobSystem& jobSystem, uint32_t width, uint32_t height,
+                        const std::function<void(uint32_t beginX, uint32_t beginY, uint32_t endX, uint32_t endY)>& function) {
+    const uint32_t tileCountX = (width + tileSize - 1) / tileSize;
+    const uint32_t tileCountY = (height + tileSize - 1) / tileSize;
+
+    jobSystem.parallelFor(tileCountX * tileCountY, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t tile = begin; tile < end; ++tile) {
+            const uint32_t beginX = tileSize * (tile % tileCountX);
+            const uint32_t beginY = tileSize * (tile / tileCountX);
+
+            function(beginX, beginY, beginX + tileSize < width ? beginX + tileSize : width, beginY + tileSize < height ? beginY + tileSize : height);
+        }
+    });
+}
+
+void Denoiser::denoise(JobSystem& jobSystem, const DenoiserFrame& frame, bool sequential, float* output) {
+    if (frame.width != width || frame.height != height) {
+        width = frame.width;
+        height = frame.height;
+        hasHistory = false;
+
+        const size_t pixelCount = (size_t)width * height;
+
+        lighting.resize(4 * pixelCount);
+        filteredLighting.resize(4 * pixelCount);
+        moments.resize(3 * pixelCount);
+        historyLighting.resize(4 * pixelCount);
+        historyMoments.resize(2 * pixelCount);
+    }
+
+    accumulate(jobSystem, frame, sequential && hasHistory);
+    estimateVariance(jobSystem);
+
+    float* source = lighting.data();
+    float* destination = filteredLighting.data();
+
+    for (uint32_t i = 0; i < iterationCount; ++i) {
+        filter(jobSystem, 1u << i, source, destination);
+        std::swap(source, destination);
+
+        // The next frame accumulates onto the first iteration, which is less noisy than the color but hasn't lost any
+        // detail yet.
+        if (i == 0) {
+            storeHistory(jobSystem, source);
+        }
+    }
+
+    if (iterationCount == 0) {
+        storeHistory(jobSystem, source);
+    }
+
+    // Copy the color out, with the frame's alpha in place of the variance.
+    forEachTile(jobSystem, width, height, [&](uint32_t beginX, uint32_t beginY, uint32_t endX, uint32_t endY) {
+        for (uint32_t y = beginY; y < endY; ++y) {
+            for (size_t p = (size_t)width * y + beginX; p < (size_t)width * y + endX; ++p) {
+                storePixel(&output[4 * p], loadPixel(&source[4 * p]));
+
+                output[4 * p + 3] = frame.color[4 * p + 3];
+            }
+        }
+    });
+
+    hasHistory = true;
+}
+
+void Denoiser::reset() {
+    hasHistory = false;
+}
+
+void Denoiser::storeHistory(JobSystem& jobSystem, const float* filtered) {
+    forEachTile(jobSystem, width, height, [&](uint32_t beginX, uint32_t beginY, uint32_t endX, uint32_t endY) {
+        for (uint32_t y = beginY; y < endY; ++y) {
+            for (size_t p = (size_t)width * y + beginX; p < (size_t)width * y + endX; ++p) {
+                storePixel(&historyLighting[4 * p], loadPixel(&filtered[4 * p]));
+
+                historyLighting[4 * p + 3] = moments[3 * p + 2];
+                historyMoments[2 * p + 0] = moments[3 * p + 0];
+                historyMoments[2 * p + 1] = moments[3 * p + 1];
+            }
+        }
+    });
+}
+
+void Denoiser::accumulate(JobSystem& jobSystem, const DenoiserFrame& frame, bool sequential) {
+    forEachTile(jobSystem, width, height, [&](uint32_t beginX, uint32_t beginY, uint32_t endX, uint32_t endY) {
+        for (uint32_t y = beginY; y < endY; ++y) {
+            for (size_t p = (size_t)width * y + beginX; p < (size_t)width * y + endX; ++p) {
+                const Pixel current = loadPixel(&frame.color[4 * p]);
+                const float luminance = getLuminance(&frame.color[4 * p]);
+
+                float length = 1.0f;
+                float firstMoment = luminance;
+                float secondMoment = luminance * luminance;
+                Pixel accumulated = current;
+
+                // Average the first frames evenly, then keep a moving average.
+                if (sequential) {
+                    length = fminf(historyLighting[4 * p + 3] + 1.0f, 255.0f);
+                    const float alpha = fmaxf(temporalAlpha, 1.0f / length);
+
+                    accumulated = blend(loadPixel(&historyLighting[4 * p]), current, alpha);
+                    firstMoment = historyMoments[2 * p + 0] + (firstMoment - historyMoments[2 * p + 0]) * alpha;
+                    secondMoment = historyMoments[2 * p + 1] + (secondMoment - historyMoments[2 * p + 1]) * alpha;
+                }
+
+                storePixel(&lighting[4 * p], accumulated);
+
+                lighting[4 * p + 3] = fmaxf(secondMoment - firstMoment * firstMoment, 0.0f);
+                moments[3 * p + 0] = firstMoment;
+                moments[3 * p + 1] = secondMoment;
+                moments[3 * p + 2] = length;
+            }
+        }
+    });
+}
+
+// Pixels with a short history take the variance of the moments around them, raised the shorter the history is since
+// it's still a poor estimate. Only the variance in alpha is written, which no other pixel reads.
+void Denoiser::estimateVariance(JobSystem& jobSystem) {
+    forEachTile(jobSystem, width, height, [&](uint32_t beginX, uint32_t beginY, uint32_t endX, uint32_t endY) {
+        for (uint32_t y = beginY; y < endY; ++y) {
+            for (uint32_t x = beginX; x < endX; ++x) {
+                const size_t p = (size_t)width * y + x;
+                const float length = moments[3 * p + 2];
+
+                if (length >= minVarianceHistory) {
+                    continue;
+                }
+
+                float firstMoment = 0.0f;
+                float secondMoment = 0.0f;
+                float weightSum = 0.0f;
+
+                for (int32_t dy = -varianceRadius; dy <= varianceRadius; ++dy) {
+                    for (int32_t dx = -varianceRadius; dx <= varianceRadius; ++dx) {
+                        const int32_t tapX = (int32_t)x + dx;
+                        const int32_t tapY = (int32_t)y + dy;
+
+                        if (tapX < 0 || tapY < 0 || tapX >= (int32_t)width || tapY >= (int32_t)height) {
+                            continue;
+                        }
+
+                        const size_t q = (size_t)width * tapY + tapX;
+
+                        firstMoment += moments[3 * q + 0];
+                        secondMoment += moments[3 * q + 1];
+                        weightSum += 1.0f;
+                    }
+                }
+
+                firstMoment /= weightSum;
+                secondMoment /= weightSum;
+
+                lighting[4 * p + 3] = fmaxf(secondMoment - firstMoment * firstMoment, 0.0f) * minVarianceHistory / length;
+            }
+        }
+    });
+}
+
+// One à-trous iteration, with taps stepSize pixels apart. The luminance weight is relative to the noise left at the
+// pixel, its variance blurred over 3x3 pixels first.
+void Denoiser::filter(JobSystem& jobSystem, uint32_t stepSize, const float* source, float* destination) {
+    forEachTile(jobSystem, width, height, [&](uint32_t beginX, uint32_t beginY, uint32_t endX, uint32_t endY) {
+        for (uint32_t y = beginY; y < endY; ++y) {
+            for (uint32_t x = beginX; x < endX; ++x) {
+                const size_t p = (size_t)width * y + x;
+
+                float variance = 0.0f;
+                float varianceWeightSum = 0.0f;
+
+                for (int32_t dy = -1; dy <= 1; ++dy) {
+                    for (int32_t dx = -1; dx <= 1; ++dx) {
+                        const int32_t tapX = (int32_t)x + dx;
+                        const int32_t tapY = (int32_t)y + dy;
+
+                        if (tapX < 0 || tapY < 0 || tapX >= (int32_t)width || tapY >= (int32_t)height) {
+                            continue;
+                        }
+
+                        const float weight = (dx == 0 ? 0.5f : 0.25f) * (dy == 0 ? 0.5f : 0.25f);
+
+                        variance += source[4 * ((size_t)width * tapY + tapX) + 3] * weight;
+                        varianceWeightSum += weight;
+                    }
+                }
+
+                const float luminance = getLuminance(&source[4 * p]);
+                const float luminanceScale = 1.0f / (colorSigma * sqrtf(variance / varianceWeightSum) + 1e-4f);
+
+                Pixel sum = zeroPixel();
+                float weightSum = 0.0f;
+
+                for (int32_t dy = -2; dy <= 2; ++dy) {
+                    const int32_t tapY = (int32_t)y + dy * (int32_t)stepSize;
+
+                    if (tapY < 0 || tapY >= (int32_t)height) {
+                        continue;
+                    }
+
+                    for (int32_t dx = -2; dx <= 2; ++dx) {
+                        const int32_t tapX = (int32_t)x + dx * (int32_t)stepSize;
+
+                        if (tapX < 0 || tapX >= (int32_t)width) {
+                            continue;
+                        }
+
+                        const size_t q = (size_t)width * tapY + tapX;
+                        const float weight = waveletWeights[dx < 0 ? -dx : dx] * waveletWeights[dy < 0 ? -dy : dy] *
+                                             expf(-fabsf(getLuminance(&source[4 * q]) - luminance) * luminanceScale);
+
+                        sum = addFiltered(sum, loadPixel(&source[4 * q]), weight);
+                        weightSum += weight;
+                    }
+                }
+
+                storePixel(&destination[4 * p], weightSum > 0.0f ? normalizeFiltered(sum, weightSum) : loadPixel(&source[4 * p]));
+            }
+        }
+    });
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "jobs.h"
+
+// The color of a frame read back from the trace, width * height RGBA float pixels in rows.
+struct DenoiserFrame {
+    uint32_t width;
+    uint32_t height;
+    const float* color;
+};
+
+// A host-side SVGF-style denoiser, for renders that can't count on a GPU vendor's denoiser. The color is accumulated
+// over sequential frames and filtered by a few iterations of an à-trous wavelet whose weights stop at luminance edges,
+// relative to how noisy each pixel still is. The trace writes no albedo, normals, depth or motion yet, so the filter
+// has no surfaces to follow and frames are taken to be from the same view. Every pass is split into tiles across the
+// job system, and every pixel only reads the previous pass, so the output doesn't depend on how the tiles are
+// scheduled. Pixels are filtered one per SIMD register, color and variance together.
+class Denoiser {
+public:
+    // The à-trous iterations, each one doubles the footprint of the filter.
+    uint32_t iterationCount = 5;
+
+    // Edge stopping, in standard deviations of the noise of the luminance.
+    float colorSigma = 4.0f;
+
+    // The weight of the new frame in the history once enough frames are accumulated.
+    float temporalAlpha = 0.2f;
+
+    Denoiser() = default;
+    Denoiser(const Denoiser&) = delete;
+    Denoiser& operator=(const Denoiser&) = delete;
+
+    // Writes the filtered color into output, RGBA floats. A sequential frame continues the previous one and reuses its
+    // history pixel for pixel, any other frame starts over.
+    void denoise(JobSystem& jobSystem, const DenoiserFrame& frame, bool sequential, float* output);
+
+    void reset();
+
+private:
+    uint32_t width = 0;
+    uint32_t height = 0;
+    bool hasHistory = false;
+
+    // Color with the variance in alpha, ping-ponged between the à-trous iterations.
+    std::vector<float> lighting;
+    std::vector<float> filteredLighting;
+
+    // The first two moments of the luminance with the history length.
+    std::vector<float> moments;
+
+    // Color with the history length in alpha, and its moments.
+    std::vector<float> historyLighting;
+    std::vector<float> historyMoments;
+
+    void accumulate(JobSystem& jobSystem, const DenoiserFrame& frame, bool sequential);
+    void estimateVariance(JobSystem& jobSystem);
+    void filter(JobSystem& jobSystem, uint32_t stepSize, const float* source, float* destination);
+    void storeHistory(JobSystem& jobSystem, const float* filtered);
+};
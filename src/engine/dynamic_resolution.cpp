@@ -0,0 +1,52 @@
+#include "dynamic_resolution.h"
+
+#include <math.h>
+
+void DynamicResolution::update(float frameTime) {
+    if (!enabled || frameTime <= 0.0f) {
+        scale = 1.0f;
+        filteredFrameTime = frameTime;
+        return;
+    }
+
+    // Smooth out the measurements so single slow frames don't make the resolution oscillate.
+    filteredFrameTime = filteredFrameTime == 0.0f ? frameTime : filteredFrameTime + 0.1f * (frameTime - filteredFrameTime);
+
+    // Leave some headroom below the target and don't react to small deviations.
+    const float ratio = 0.9f * targetFrameTime / filteredFrameTime;
+
+    if (ratio > 0.95f && ratio < 1.05f) {
+        return;
+    }
+
+    // The trace cost is proportional to the pixel count, which grows with the square of the scale.
+    float newScale = scale * sqrtf(ratio);
+
+    // Limit how fast the resolution can change between frames.
+    newScale = fminf(newScale, scale * 1.05f);
+    newScale = fmaxf(newScale, scale * 0.9f);
+
+    scale = fminf(fmaxf(newScale, minScale), 1.0f);
+}
+
+static uint32_t scaleDimension(uint32_t dimension, float scale) {
+    // Round to multiples of 8 so that tiny scale changes don't alter the resolution every frame.
+    uint32_t scaled = ((uint32_t)(dimension * scale) + 7) & ~7u;
+
+    if (scaled == 0) {
+        scaled = 1;
+    }
+
+    return scaled < dimension ? scaled : dimension;
+}
+
+VkExtent2D DynamicResolution::getExtent(VkExtent2D maxExtent) {
+    if (scale >= 1.0f) {
+        return maxExtent;
+    }
+
+    return {
+        .width  = scaleDimension(maxExtent.width, scale),
+        .height = scaleDimension(maxExtent.height, scale)
+    };
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+class DynamicResolution {
+public:
+    bool enabled = false;
+    float targetFrameTime = 16.0f;
+    float minScale = 0.25f;
+    float scale = 1.0f;
+
+    // Feeds the measured GPU time of the last completed frame, in milliseconds.
+    void update(float frameTime);
+
+    VkExtent2D getExtent(VkExtent2D maxExtent);
+
+private:
+    float filteredFrameTime = 0.0f;
+};
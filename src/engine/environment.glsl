@@ -0,0 +1,87 @@
+// Importance samples the environment map through the alias tables built by the environment map, and evaluates the pdf
+// of any direction for multiple importance sampling. Directions are in the map's space, with Y up, so a rotated map only
+// needs its directions rotated. Radiance is read with texelFetch from the map's image in the bindless images, which the
+// including shader declares, so that it's constant over each pixel like the pdf.
+
+#extension GL_EXT_buffer_reference : enable
+#extension GL_EXT_nonuniform_qualifier : enable
+#extension GL_EXT_samplerless_texture_functions : enable
+
+#define ENVIRONMENT_PI 3.14159265358979323846
+
+struct EnvironmentAliasEntry {
+    float threshold;
+    uint alias;
+    float probability;
+    float aliasProbability;
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer EnvironmentTable {
+    uint width;
+    uint height;
+    uint imageIndex;
+    uint padding;
+    EnvironmentAliasEntry entries[];
+};
+
+// Picks an entry of the table that starts at offset with one uniform number, and tests its threshold with another.
+uint sampleAliasTable(EnvironmentTable table, uint offset, uint count, vec2 u, out float probability) {
+    uint index = min(uint(u.x * float(count)), count - 1);
+    EnvironmentAliasEntry entry = table.entries[offset + index];
+
+    if (u.y < entry.threshold) {
+        probability = entry.probability;
+        return index;
+    }
+
+    probability = entry.aliasProbability;
+    return entry.alias;
+}
+
+vec2 getEnvironmentUv(vec3 direction) {
+    return vec2(atan(direction.x, -direction.z) / (2.0 * ENVIRONMENT_PI) + 0.5, acos(clamp(direction.y, -1.0, 1.0)) / ENVIRONMENT_PI);
+}
+
+ivec2 getEnvironmentPixel(EnvironmentTable table, vec3 direction) {
+    vec2 uv = getEnvironmentUv(direction);
+    return ivec2(min(uvec2(uv * vec2(table.width, table.height)), uvec2(table.width - 1, table.height - 1)));
+}
+
+// The pdf per unit solid angle of a pixel with the given probability, in a row at the given polar angle.
+float getEnvironmentSolidAnglePdf(EnvironmentTable table, float probability, float sinTheta) {
+    return sinTheta > 0.0 ? probability * float(table.width * table.height) / (2.0 * ENVIRONMENT_PI * ENVIRONMENT_PI * sinTheta) : 0.0;
+}
+
+// Returns a direction with a probability proportional to the luminance of the map, and its pdf per unit solid angle. The
+// first two numbers pick the row, the other two the pixel within it, and the position within the pixel is reused from
+// both.
+vec3 sampleEnvironment(EnvironmentTable table, vec4 u, out float pdf) {
+    float rowProbability, pixelProbability;
+    uint y = sampleAliasTable(table, 0, table.height, u.xy, rowProbability);
+    uint x = sampleAliasTable(table, table.height + y * table.width, table.width, u.zw, pixelProbability);
+
+    // What's left of the numbers that picked the entries is still uniform, and places the direction within the pixel.
+    vec2 jitter = fract(vec2(u.z * float(table.width), u.x * float(table.height)));
+    vec2 uv = (vec2(x, y) + jitter) / vec2(table.width, table.height);
+
+    float phi = (uv.x - 0.5) * 2.0 * ENVIRONMENT_PI;
+    float theta = uv.y * ENVIRONMENT_PI;
+    float sinTheta = sin(theta);
+
+    pdf = getEnvironmentSolidAnglePdf(table, rowProbability * pixelProbability, sinTheta);
+
+    return vec3(sinTheta * sin(phi), cos(theta), -sinTheta * cos(phi));
+}
+
+float getEnvironmentPdf(EnvironmentTable table, vec3 direction) {
+    ivec2 pixel = getEnvironmentPixel(table, direction);
+
+    float rowProbability = table.entries[pixel.y].probability;
+    float pixelProbability = table.entries[table.height + pixel.y * table.width + pixel.x].probability;
+
+    return getEnvironmentSolidAnglePdf(table, rowProbability * pixelProbability, sqrt(max(1.0 - direction.y * direction.y, 0.0)));
+}
+
+vec3 getEnvironmentRadiance(EnvironmentTable table, vec3 direction) {
+    return texelFetch(images[nonuniformEXT(table.imageIndex)], getEnvironmentPixel(table, direction), 0).rgb;
+}
@@ -0,0 +1,357 @@
+#include "environment_map.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+
+#include "file_mapping.h"
+#include "hash.h"
+#include "image.h"
+#include "image_import.h"
+
+static const VkDeviceSize stagingCapacity = 16ull << 20;
+static const VkDeviceSize stagingAlignment = 16;
+
+// Larger maps are rejected, a row of half float pixels has to fit in the staging memory.
+static const uint32_t maxEnvironmentSize = 16384;
+
+// Rows are built in batches of this many.
+static const uint32_t rowGrainSize = 8;
+
+// The largest finite half float, brighter pixels are clamped to it.
+static const float maxHalf = 65504.0f;
+
+static const double pi = 3.14159265358979323846;
+
+static float getLuminance(const float* pixel) {
+    return 0.2126f * pixel[0] + 0.7152f * pixel[1] + 0.0722f * pixel[2];
+}
+
+// Builds an alias table over the weights with Vose's method. Entries whose scaled weight is below one are paired with
+// an entry above one, which gives up the difference and goes back to either list. Weights that are all zero make the
+// table uniform. The worklist has room for one index per entry, the small list grows from its front and the large one
+// from its back.
+static void buildAliasTable(const float* weights, uint32_t count, double weightSum, EnvironmentAliasEntry* entries, uint32_t* worklist) {
+    if (!(weightSum > 0.0)) {
+        for (uint32_t i = 0; i < count; ++i) {
+            entries[i] = {
+                .threshold        = 1.0f,
+                .alias            = i,
+                .probability      = 1.0f / count,
+                .aliasProbability = 1.0f / count
+            };
+        }
+
+        return;
+    }
+
+    uint32_t smallCount = 0;
+    uint32_t largeCount = 0;
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const double probability = weights[i] / weightSum;
+
+        entries[i].threshold = (float)(probability * count);
+        entries[i].alias = i;
+        entries[i].probability = (float)probability;
+
+        if (entries[i].threshold < 1.0f) {
+            worklist[smallCount++] = i;
+        } else {
+            worklist[count - ++largeCount] = i;
+        }
+    }
+
+    while (smallCount > 0 && largeCount > 0) {
+        const uint32_t small = worklist[--smallCount];
+        const uint32_t large = worklist[count - largeCount];
+
+        entries[small].alias = large;
+        entries[large].threshold -= 1.0f - entries[small].threshold;
+
+        if (entries[large].threshold < 1.0f) {
+            --largeCount;
+            worklist[smallCount++] = large;
+        }
+    }
+
+    // Whatever is left over is within rounding of one.
+    while (smallCount > 0) {
+        entries[worklist[--smallCount]].threshold = 1.0f;
+    }
+
+    while (largeCount > 0) {
+        entries[worklist[count - largeCount--]].threshold = 1.0f;
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        entries[i].aliasProbability = entries[entries[i].alias].probability;
+    }
+}
+
+void EnvironmentDistribution::build(JobSystem& jobSystem, const float* pixels, uint32_t width, uint32_t height) {
+    // Row tables can only be kept if the map has the same size.
+    const bool keepRows = width == this->width && height == this->height && !rowHashes.empty();
+
+    if (!keepRows) {
+        this->width = width;
+        this->height = height;
+
+        entries.resize(height + (size_t)width * height);
+        rowHashes.resize(height);
+        rowWeights.resize(height);
+    }
+
+    std::atomic<uint32_t> rowCount = 0;
+
+    jobSystem.parallelFor(height, rowGrainSize, [&](uint32_t begin, uint32_t end) {
+        float* weights = new float[width];
+        uint32_t* worklist = new uint32_t[width];
+
+        for (uint32_t y = begin; y < end; ++y) {
+            const float* row = pixels + 4 * (size_t)width * y;
+            const uint64_t rowHash = hashData(row, 4 * sizeof(float) * width);
+
+            if (keepRows && rowHash == rowHashes[y]) {
+                continue;
+            }
+
+            // The solid angle of a pixel only depends on its row, so within a row pixels are weighted by luminance alone.
+            double weightSum = 0.0;
+
+            for (uint32_t x = 0; x < width; ++x) {
+                weights[x] = getLuminance(row + 4 * x);
+                weightSum += weights[x];
+            }
+
+            buildAliasTable(weights, width, weightSum, entries.data() + height + (size_t)width * y, worklist);
+
+            rowHashes[y] = rowHash;
+            rowWeights[y] = weightSum;
+
+            ++rowCount;
+        }
+
+        delete[] worklist;
+        delete[] weights;
+    });
+
+    builtRowCount = rowCount;
+
+    // Rows are weighted by the solid angle they cover, which shrinks towards the poles.
+    float* weights = new float[height];
+    uint32_t* worklist = new uint32_t[height];
+    double weightSum = 0.0;
+
+    for (uint32_t y = 0; y < height; ++y) {
+        weights[y] = (float)(rowWeights[y] * sin(pi * (y + 0.5) / height));
+        weightSum += weights[y];
+    }
+
+    buildAliasTable(weights, height, weightSum, entries.data(), worklist);
+
+    delete[] worklist;
+    delete[] weights;
+}
+
+EnvironmentMap::EnvironmentMap(Device& device, JobSystem& jobSystem, uint32_t framesInFlight)
+        : jobSystem(&jobSystem), framesInFlight(framesInFlight), frame(0), hasCurrent(false), loading(false), loadedPixels(nullptr) {
+    jobCounter = new JobCounter(0);
+    uploader = Uploader(device, stagingCapacity);
+}
+
+void EnvironmentMap::destroy(VkDevice device, BindlessTables& bindlessTables) {
+    jobSystem->wait(*jobCounter);
+
+    delete[] loadedPixels;
+
+    for (RetiredResources& retired : retiredResources) {
+        destroyResources(device, bindlessTables, retired.resources);
+    }
+
+    if (hasCurrent) {
+        destroyResources(device, bindlessTables, current);
+    }
+
+    uploader.destroy(device);
+
+    delete jobCounter;
+}
+
+bool EnvironmentMap::load(const std::filesystem::path& path) {
+    if (loading) {
+        return false;
+    }
+
+    loading = true;
+
+    jobSystem->submit([this, path]() {
+        SourceImage image = {};
+        image.file = MappedFile(path);
+        image.data = image.file.data;
+        image.size = image.file.size;
+
+        int width = 0, height = 0;
+        float* pixels = nullptr;
+
+        if (image.data != nullptr) {
+            pixels = decodeLinearImage(image, width, height);
+        }
+
+        image.file.destroy();
+
+        if (pixels == nullptr || width > (int)maxEnvironmentSize || height > (int)maxEnvironmentSize) {
+            free(pixels);
+            return;
+        }
+
+        const size_t pixelCount = (size_t)width * height;
+
+        // The texture holds half floats. Pixels are clamped to what it can hold before the tables are built, so that
+        // they sample what the shaders see, and negative or NaN pixels, which some encoders produce, get no samples.
+        jobSystem->parallelFor(height, rowGrainSize, [&](uint32_t begin, uint32_t end) {
+            for (size_t i = 4 * (size_t)begin * width; i < 4 * (size_t)end * width; ++i) {
+                pixels[i] = pixels[i] > 0.0f ? fminf(pixels[i], maxHalf) : 0.0f;
+            }
+        });
+
+        distribution.build(*jobSystem, pixels, width, height);
+
+        loadedPixels = new uint16_t[4 * pixelCount];
+        convertToHalf(pixels, 4 * pixelCount, loadedPixels);
+
+        free(pixels);
+    }, jobCounter);
+
+    return true;
+}
+
+bool EnvironmentMap::isLoading() {
+    return loading;
+}
+
+bool EnvironmentMap::update(Device& device, BindlessTables& bindlessTables) {
+    ++frame;
+
+    // Destroy the maps that no frame in flight can use anymore.
+    for (size_t i = 0; i < retiredResources.size();) {
+        if (retiredResources[i].frame + framesInFlight > frame) {
+            ++i;
+            continue;
+        }
+
+        destroyResources(device.logical, bindlessTables, retiredResources[i].resources);
+
+        retiredResources[i] = retiredResources.back();
+        retiredResources.pop_back();
+    }
+
+    if (!loading || *jobCounter > 0) {
+        return false;
+    }
+
+    loading = false;
+    loadFailed = loadedPixels == nullptr;
+
+    if (loadFailed) {
+        return false;
+    }
+
+    const uint32_t width = distribution.width;
+    const uint32_t height = distribution.height;
+
+    MapResources resources;
+    resources.texture = Texture(device, VK_FORMAT_R16G16B16A16_SFLOAT, width, height, 1);
+    resources.imageIndex = bindlessTables.addImage(device.logical, resources.texture.view);
+
+    // Upload the pixels in strips of as many rows as fit in the staging memory.
+    const VkDeviceSize rowSize = 4 * sizeof(uint16_t) * (VkDeviceSize)width;
+    const uint32_t stripHeight = (uint32_t)(uploader.capacity / rowSize);
+
+    for (uint32_t y = 0; y < height; y += stripHeight) {
+        const uint32_t rowCount = height - y < stripHeight ? height - y : stripHeight;
+        VkDeviceSize stagingOffset;
+
+        if (!uploader.allocate(rowSize * rowCount, stagingAlignment, &stagingOffset)) {
+            uploader.flush(device);
+            uploader.allocate(rowSize * rowCount, stagingAlignment, &stagingOffset);
+        }
+
+        memcpy(uploader.getData() + stagingOffset, (const uint8_t*)loadedPixels + rowSize * y, rowSize * rowCount);
+
+        const VkImageLayout oldLayout = y == 0 ? VK_IMAGE_LAYOUT_UNDEFINED : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        uploader.copyToImageRegion(resources.texture, oldLayout, { 0, (int32_t)y }, { width, rowCount }, stagingOffset);
+    }
+
+    delete[] loadedPixels;
+    loadedPixels = nullptr;
+
+    // Upload the header and the tables after it.
+    const VkDeviceSize entriesSize = distribution.entries.size() * sizeof(EnvironmentAliasEntry);
+
+    resources.tableBuffer = Buffer(device, sizeof(EnvironmentTableHeader) + entriesSize,
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    const EnvironmentTableHeader header = {
+        .width      = width,
+        .height     = height,
+        .imageIndex = resources.imageIndex,
+        .padding    = 0
+    };
+
+    VkDeviceSize headerStagingOffset;
+
+    if (!uploader.allocate(sizeof(header), stagingAlignment, &headerStagingOffset)) {
+        uploader.flush(device);
+        uploader.allocate(sizeof(header), stagingAlignment, &headerStagingOffset);
+    }
+
+    memcpy(uploader.getData() + headerStagingOffset, &header, sizeof(header));
+    uploader.copyToBuffer(resources.tableBuffer, 0, headerStagingOffset, sizeof(header));
+
+    for (VkDeviceSize uploadedSize = 0; uploadedSize < entriesSize;) {
+        VkDeviceSize chunkSize = entriesSize - uploadedSize;
+
+        if (chunkSize > uploader.capacity) {
+            chunkSize = uploader.capacity;
+        }
+
+        VkDeviceSize stagingOffset;
+
+        if (!uploader.allocate(chunkSize, stagingAlignment, &stagingOffset)) {
+            uploader.flush(device);
+            uploader.allocate(chunkSize, stagingAlignment, &stagingOffset);
+        }
+
+        memcpy(uploader.getData() + stagingOffset, (const uint8_t*)distribution.entries.data() + uploadedSize, chunkSize);
+        uploader.copyToBuffer(resources.tableBuffer, sizeof(header) + uploadedSize, stagingOffset, chunkSize);
+
+        uploadedSize += chunkSize;
+    }
+
+    uploader.flush(device);
+
+    // The previous map may still be used by the frames in flight.
+    if (hasCurrent) {
+        retiredResources.push_back({ current, frame });
+    }
+
+    current = resources;
+    hasCurrent = true;
+
+    this->width = width;
+    this->height = height;
+    imageIndex = resources.imageIndex;
+    tableAddress = resources.tableBuffer.getDeviceAddress(device.logical);
+
+    return true;
+}
+
+void EnvironmentMap::destroyResources(VkDevice device, BindlessTables& bindlessTables, MapResources& resources) {
+    bindlessTables.removeImage(resources.imageIndex);
+    resources.texture.destroy(device);
+    resources.tableBuffer.destroy(device);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+#include "bindless.h"
+#include "jobs.h"
+#include "texture.h"
+#include "upload.h"
+
+// An entry of an alias table. A sample picks an entry uniformly and keeps it if a second uniform number falls below the
+// threshold, or takes its alias otherwise. The probabilities of both are stored, so the pdf of the sample needs no
+// other lookup.
+struct EnvironmentAliasEntry {
+    float threshold;
+    uint32_t alias;
+    float probability;
+    float aliasProbability;
+};
+
+// The start of the table shaders sample the environment with, by device address. The header is followed by the
+// marginal table over the rows of the equirectangular map, then by a table per row over its pixels. Row probabilities
+// include the solid angle of the row, pixel probabilities are conditional on their row.
+struct EnvironmentTableHeader {
+    uint32_t width;
+    uint32_t height;
+    uint32_t imageIndex;
+    uint32_t padding;
+};
+
+// The alias tables of an equirectangular map, built from its linear RGBA pixels with pixels weighted by luminance. Row
+// tables are built in parallel, and rows whose pixels are the same as in the previous build keep their tables.
+class EnvironmentDistribution {
+public:
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    // The marginal table followed by the row tables, as they are laid out after the header.
+    std::vector<EnvironmentAliasEntry> entries;
+
+    // How many row tables the last build had to build.
+    uint32_t builtRowCount = 0;
+
+    void build(JobSystem& jobSystem, const float* pixels, uint32_t width, uint32_t height);
+
+private:
+    std::vector<uint64_t> rowHashes;
+    std::vector<double> rowWeights;
+};
+
+// The environment map that lights the scene, with the table to importance sample it. Maps are decoded and their tables
+// built on the job system while the current map stays in use, and the resources of a replaced map are destroyed once
+// no frame in flight can use them. Rotating the map needs no new table: shaders rotate directions into the map's space.
+class EnvironmentMap {
+public:
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    // BINDLESS_INVALID_INDEX and 0 until the first map is loaded.
+    uint32_t imageIndex = BINDLESS_INVALID_INDEX;
+    VkDeviceAddress tableAddress = 0;
+
+    // Set when the last load couldn't decode its file.
+    bool loadFailed = false;
+
+    EnvironmentMap() = default;
+    EnvironmentMap(Device& device, JobSystem& jobSystem, uint32_t framesInFlight);
+    void destroy(VkDevice device, BindlessTables& bindlessTables);
+
+    // Starts loading an HDR, EXR or LDR image. Returns false if another load is still running.
+    bool load(const std::filesystem::path& path);
+    bool isLoading();
+
+    // Swaps in a finished load. Call once per frame, once the frame that last used these resources has completed.
+    // Returns true if the map changed.
+    bool update(Device& device, BindlessTables& bindlessTables);
+
+private:
+    struct MapResources {
+        Texture texture;
+        Buffer tableBuffer;
+        uint32_t imageIndex;
+    };
+
+    struct RetiredResources {
+        MapResources resources;
+        uint64_t frame;
+    };
+
+    JobSystem* jobSystem;
+    JobCounter* jobCounter;
+    uint32_t framesInFlight;
+    uint64_t frame;
+    Uploader uploader;
+
+    MapResources current;
+    bool hasCurrent;
+    std::vector<RetiredResources> retiredResources;
+
+    // Written by the load job, and only read once it has completed. The distribution keeps the row tables of the
+    // previous load for the next one to reuse.
+    bool loading;
+    uint16_t* loadedPixels;
+    EnvironmentDistribution distribution;
+
+    void destroyResources(VkDevice device, BindlessTables& bindlessTables, MapResources& resources);
+};
@@ -0,0 +1,131 @@
+#include "file_mapping.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    LARGE_INTEGER fileSize;
+
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) {
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+
+        if (mapping != nullptr) {
+            data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            size = data != nullptr ? (size_t)fileSize.QuadPart : 0;
+
+            // The view keeps the mapping alive.
+            CloseHandle(mapping);
+        }
+    }
+
+    CloseHandle(file);
+}
+
+MappedFile::MappedFile(const std::filesystem::path& path, size_t size) {
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READWRITE, (DWORD)((uint64_t)size >> 32), (DWORD)size, nullptr);
+
+    if (mapping != nullptr) {
+        data = (uint8_t*)MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0);
+        this->size = data != nullptr ? size : 0;
+
+        CloseHandle(mapping);
+    }
+
+    CloseHandle(file);
+}
+
+bool MappedFile::flush() {
+    return data == nullptr || FlushViewOfFile(data, 0);
+}
+
+void MappedFile::destroy() {
+    if (data != nullptr) {
+        UnmapViewOfFile(data);
+    }
+
+    data = nullptr;
+    size = 0;
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path& path) {
+    int file = open(path.c_str(), O_RDONLY);
+
+    if (file == -1) {
+        return;
+    }
+
+    struct stat fileStatus;
+
+    if (fstat(file, &fileStatus) == 0 && fileStatus.st_size > 0) {
+        void* mapping = mmap(nullptr, fileStatus.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+
+        if (mapping != MAP_FAILED) {
+            data = (uint8_t*)mapping;
+            size = fileStatus.st_size;
+
+            // Start reading the file in the background and let the kernel read ahead aggressively.
+            madvise(mapping, size, MADV_SEQUENTIAL);
+            madvise(mapping, size, MADV_WILLNEED);
+        }
+    }
+
+    // The mapping keeps the file alive.
+    close(file);
+}
+
+MappedFile::MappedFile(const std::filesystem::path& path, size_t size) {
+    int file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (file == -1) {
+        return;
+    }
+
+    if (size > 0 && ftruncate(file, size) == 0) {
+        void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+
+        if (mapping != MAP_FAILED) {
+            data = (uint8_t*)mapping;
+            this->size = size;
+        }
+    }
+
+    close(file);
+}
+
+bool MappedFile::flush() {
+    return data == nullptr || msync(data, size, MS_SYNC) == 0;
+}
+
+void MappedFile::destroy() {
+    if (data != nullptr) {
+        munmap(data, size);
+    }
+
+    data = nullptr;
+    size = 0;
+}
+
+#endif
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <filesystem>
+
+class MappedFile {
+public:
+    uint8_t* data = nullptr;
+    size_t size = 0;
+
+    MappedFile() = default;
+
+    // Maps an existing file read-only. data is null if the file couldn't be mapped.
+    MappedFile(const std::filesystem::path& path);
+
+    // Creates the file, or truncates it, with the given size and maps it read-write.
+    MappedFile(const std::filesystem::path& path, size_t size);
+
+    // Writes the modified pages of a read-write mapping back to the file and waits until they are on disk.
+    bool flush();
+
+    void destroy();
+};
@@ -0,0 +1,456 @@
+#include "frame_capture.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <tinyexr.h>
+
+#include "file_mapping.h"
+#include "image.h"
+#include "png_writer.h"
+
+// The trace is RGBA16F.
+#define CAPTURE_PIXEL_SIZE 8
+
+// PNG rows are converted in bands of this many rows per job.
+#define CAPTURE_ROW_GRAIN 32
+
+static const char* getExtension(CaptureFormat format) {
+    return format == CAPTURE_FORMAT_EXR ? ".exr" : ".png";
+}
+
+bool writeCaptureFile(const std::filesystem::path& path, const std::vector<uint8_t>& data) {
+    if (data.empty()) {
+        return false;
+    }
+
+    std::filesystem::path temporaryPath = path;
+    temporaryPath += ".tmp";
+
+    MappedFile file(temporaryPath, data.size());
+
+    if (file.data == nullptr) {
+        return false;
+    }
+
+    memcpy(file.data, data.data(), data.size());
+    bool written = file.flush();
+    file.destroy();
+
+    std::error_code error;
+
+    if (written) {
+        std::filesystem::rename(temporaryPath, path, error);
+        written = !error;
+    }
+
+    if (!written) {
+        std::filesystem::remove(temporaryPath, error);
+    }
+
+    return written;
+}
+
+double compareToReference(const std::filesystem::path& referencePath, VkExtent2D extent, const uint16_t* pixels) {
+    float* reference = nullptr;
+    int width;
+    int height;
+    const char* error = nullptr;
+
+    if (LoadEXR(&reference, &width, &height, referencePath.string().c_str(), &error) != TINYEXR_SUCCESS) {
+        FreeEXRErrorMessage(error);
+        return -1.0;
+    }
+
+    if (width != (int)extent.width || height != (int)extent.height) {
+        free(reference);
+        return -1.0;
+    }
+
+    // The reference's rows are top to bottom.
+    float* linearRow = new float[4 * (size_t)extent.width];
+    double squaredErrorSum = 0.0;
+
+    for (uint32_t y = 0; y < extent.height; ++y) {
+        convertFromHalf(pixels + 4 * (size_t)extent.width * (extent.height - 1 - y), 4 * (size_t)extent.width, linearRow);
+
+        const float* referenceRow = reference + 4 * (size_t)extent.width * y;
+
+        for (uint32_t x = 0; x < extent.width; ++x) {
+            for (uint32_t c = 0; c < 3; ++c) {
+                const double difference = (double)linearRow[4 * x + c] - referenceRow[4 * x + c];
+                squaredErrorSum += difference * difference;
+            }
+        }
+    }
+
+    delete[] linearRow;
+    free(reference);
+
+    return squaredErrorSum / (3.0 * extent.width * extent.height);
+}
+
+// EXR viewers expect the channels in alphabetical order. The trace's rows are flipped on the way, it's upside down
+// relative to the display.
+static std::vector<uint8_t> encodeExr(VkExtent2D extent, const uint16_t* pixels, ExrCompression compression) {
+    const size_t pixelCount = (size_t)extent.width * extent.height;
+    uint16_t* planes = new uint16_t[3 * pixelCount];
+
+    for (uint32_t y = 0; y < extent.height; ++y) {
+        const uint16_t* sourceRow = pixels + 4 * (size_t)extent.width * (extent.height - 1 - y);
+        const size_t rowOffset = (size_t)extent.width * y;
+
+        for (uint32_t x = 0; x < extent.width; ++x) {
+            for (uint32_t c = 0; c < 3; ++c) {
+                planes[(2 - c) * pixelCount + rowOffset + x] = sourceRow[4 * x + c];
+            }
+        }
+    }
+
+    EXRChannelInfo channels[3] = {};
+    strcpy(channels[0].name, "B");
+    strcpy(channels[1].name, "G");
+    strcpy(channels[2].name, "R");
+
+    int pixelTypes[3] = { TINYEXR_PIXELTYPE_HALF, TINYEXR_PIXELTYPE_HALF, TINYEXR_PIXELTYPE_HALF };
+
+    unsigned char* images[3] = {
+        (unsigned char*)planes,
+        (unsigned char*)(planes + pixelCount),
+        (unsigned char*)(planes + 2 * pixelCount)
+    };
+
+    EXRHeader exrHeader;
+    InitEXRHeader(&exrHeader);
+
+    exrHeader.num_channels = 3;
+    exrHeader.channels = channels;
+    exrHeader.pixel_types = pixelTypes;
+    exrHeader.requested_pixel_types = pixelTypes;
+    exrHeader.compression_type = compression == EXR_COMPRESSION_PIZ ? TINYEXR_COMPRESSIONTYPE_PIZ : TINYEXR_COMPRESSIONTYPE_ZIP;
+
+    EXRImage exrImage;
+    InitEXRImage(&exrImage);
+
+    exrImage.num_channels = 3;
+    exrImage.images = images;
+    exrImage.width = (int)extent.width;
+    exrImage.height = (int)extent.height;
+
+    unsigned char* memory = nullptr;
+    const char* error = nullptr;
+
+    size_t size = SaveEXRImageToMemory(&exrImage, &exrHeader, &memory, &error);
+
+    std::vector<uint8_t> data;
+
+    if (size != 0) {
+        data.assign(memory, memory + size);
+    }
+
+    free(memory);
+    FreeEXRErrorMessage(error);
+
+    delete[] planes;
+
+    return data;
+}
+
+// Applies the exposure, then clamps and encodes to sRGB. Bands of rows are converted across the job system.
+static std::vector<uint8_t> encodeCapturePng(JobSystem& jobSystem, VkExtent2D extent, const uint16_t* pixels, float exposureScale) {
+    uint8_t* rgbPixels = new uint8_t[3 * (size_t)extent.width * extent.height];
+
+    jobSystem.parallelFor(extent.height, CAPTURE_ROW_GRAIN, [&](uint32_t begin, uint32_t end) {
+        float* linearRow = new float[4 * (size_t)extent.width];
+        uint8_t* encodedRow = new uint8_t[4 * (size_t)extent.width];
+
+        for (uint32_t y = begin; y < end; ++y) {
+            const uint16_t* sourceRow = pixels + 4 * (size_t)extent.width * (extent.height - 1 - y);
+            convertFromHalf(sourceRow, 4 * (size_t)extent.width, linearRow);
+
+            for (uint32_t x = 0; x < extent.width; ++x) {
+                linearRow[4 * x + 0] *= exposureScale;
+                linearRow[4 * x + 1] *= exposureScale;
+                linearRow[4 * x + 2] *= exposureScale;
+            }
+
+            convertFromLinear(linearRow, extent.width, true, encodedRow);
+
+            uint8_t* destinationRow = rgbPixels + 3 * (size_t)extent.width * y;
+
+            for (uint32_t x = 0; x < extent.width; ++x) {
+                destinationRow[3 * x + 0] = encodedRow[4 * x + 0];
+                destinationRow[3 * x + 1] = encodedRow[4 * x + 1];
+                destinationRow[3 * x + 2] = encodedRow[4 * x + 2];
+            }
+        }
+
+        delete[] encodedRow;
+        delete[] linearRow;
+    });
+
+    std::vector<uint8_t> data = encodePng(jobSystem, extent.width, extent.height, 3, rgbPixels);
+
+    delete[] rgbPixels;
+
+    return data;
+}
+
+std::vector<uint8_t> encodeCapture(JobSystem& jobSystem, CaptureFormat format, ExrCompression exrCompression, VkExtent2D extent, const uint16_t* pixels, float exposureScale) {
+    if (format == CAPTURE_FORMAT_EXR) {
+        return encodeExr(extent, pixels, exrCompression);
+    }
+
+    return encodeCapturePng(jobSystem, extent, pixels, exposureScale);
+}
+
+void FrameCapture::flush(VkDevice device, JobSystem& jobSystem) {
+    update(device, jobSystem, UINT64_MAX);
+    jobSystem.wait(jobCounter);
+}
+
+void FrameCapture::destroy(VkDevice device, JobSystem& jobSystem) {
+    flush(device, jobSystem);
+
+    for (uint32_t i = 0; i < FRAME_CAPTURE_READBACK_COUNT; ++i) {
+        if (readbacks[i].size != 0) {
+            vkUnmapMemory(device, readbacks[i].buffer.memory);
+            readbacks[i].buffer.destroy(device);
+            readbacks[i].size = 0;
+        }
+    }
+}
+
+void FrameCapture::requestCapture(const std::filesystem::path& path) {
+    captureRequested = true;
+    requestedPath = path;
+}
+
+bool FrameCapture::hasFreeReadback() {
+    for (uint32_t i = 0; i < FRAME_CAPTURE_READBACK_COUNT; ++i) {
+        if (readbacks[i].state.load(std::memory_order_acquire) == READBACK_STATE_FREE) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void FrameCapture::startSequence() {
+    // Every sequence gets the first unused directory, frames are numbered from the frame it started on.
+    for (uint32_t i = 0;; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "sequence_%03u", i);
+
+        sequenceDirectory = directory / name;
+
+        if (!std::filesystem::exists(sequenceDirectory)) {
+            break;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(sequenceDirectory, error);
+
+    recordingSequence = true;
+    sequenceFirstFrame = UINT64_MAX;
+}
+
+void FrameCapture::stopSequence() {
+    recordingSequence = false;
+}
+
+bool FrameCapture::isRecordingSequence() {
+    return recordingSequence;
+}
+
+void FrameCapture::record(Device& device, VkCommandBuffer commandBuffer, VkImage image, VkExtent2D extent, uint64_t frameNumber, float exposureScale) {
+    if (!captureRequested && !recordingSequence) {
+        return;
+    }
+
+    captureRequested = false;
+
+    if (recordingSequence && sequenceFirstFrame == UINT64_MAX) {
+        sequenceFirstFrame = frameNumber;
+    }
+
+    Readback* readback = nullptr;
+
+    for (uint32_t i = 0; i < FRAME_CAPTURE_READBACK_COUNT; ++i) {
+        if (readbacks[i].state.load(std::memory_order_acquire) == READBACK_STATE_FREE) {
+            readback = &readbacks[i];
+            break;
+        }
+    }
+
+    // Every readback is still being copied or encoded. Waiting for one would stall the editor, so the frame is dropped.
+    if (readback == nullptr) {
+        ++droppedFrameCount;
+        requestedPath.clear();
+        return;
+    }
+
+    // (Re)create the readback buffer if the frame doesn't fit. Cached memory keeps the encoder's reads fast, it's only
+    // missing on a few integrated GPUs.
+    const VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * CAPTURE_PIXEL_SIZE;
+
+    if (readback->size < size) {
+        if (readback->size != 0) {
+            vkUnmapMemory(device.logical, readback->buffer.memory);
+            readback->buffer.destroy(device.logical);
+        }
+
+        VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+        if (device.getMemoryTypeIndex(UINT32_MAX, memoryProperties) == UINT32_MAX) {
+            memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        }
+
+        readback->buffer = Buffer(device, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryProperties);
+        readback->size = size;
+
+        vkMapMemory(device.logical, readback->buffer.memory, 0, VK_WHOLE_SIZE, 0, (void**)&readback->data);
+    }
+
+    // Copy the trace. It was last read by the post-processing passes, its writes are already available.
+    VkImageMemoryBarrier2 imageMemoryBarrier = {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext               = nullptr,
+        .srcStageMask        = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask       = VK_ACCESS_2_NONE,
+        .dstStageMask        = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .dstAccessMask       = VK_ACCESS_2_TRANSFER_READ_BIT,
+        .oldLayout           = VK_IMAGE_LAYOUT_GENERAL,
+        .newLayout           = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = image,
+        .subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+    };
+
+    VkDependencyInfo dependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 0,
+        .pMemoryBarriers          = nullptr,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = 1,
+        .pImageMemoryBarriers     = &imageMemoryBarrier
+    };
+
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    VkBufferImageCopy region = {
+        .bufferOffset      = 0,
+        .bufferRowLength   = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource  = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .imageOffset       = { 0, 0, 0 },
+        .imageExtent       = { extent.width, extent.height, 1 }
+    };
+
+    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_GENERAL, readback->buffer, 1, &region);
+
+    VkBufferMemoryBarrier2 bufferMemoryBarrier = {
+        .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+        .pNext               = nullptr,
+        .srcStageMask        = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask       = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask        = VK_PIPELINE_STAGE_2_HOST_BIT,
+        .dstAccessMask       = VK_ACCESS_2_HOST_READ_BIT,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .buffer              = readback->buffer,
+        .offset              = 0,
+        .size                = size
+    };
+
+    dependencyInfo.bufferMemoryBarrierCount = 1;
+    dependencyInfo.pBufferMemoryBarriers    = &bufferMemoryBarrier;
+    dependencyInfo.imageMemoryBarrierCount  = 0;
+    dependencyInfo.pImageMemoryBarriers     = nullptr;
+
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    readback->extent = extent;
+    readback->frameNumber = frameNumber;
+    readback->exposureScale = exposureScale;
+    readback->format = format;
+    readback->exrCompression = exrCompression;
+    readback->path = captureCallback ? std::filesystem::path() : getCapturePath(frameNumber);
+    readback->state.store(READBACK_STATE_COPYING, std::memory_order_relaxed);
+}
+
+void FrameCapture::update(VkDevice device, JobSystem& jobSystem, uint64_t completedFrameCount) {
+    for (uint32_t i = 0; i < FRAME_CAPTURE_READBACK_COUNT; ++i) {
+        Readback& readback = readbacks[i];
+
+        if (readback.state.load(std::memory_order_relaxed) != READBACK_STATE_COPYING || readback.frameNumber >= completedFrameCount) {
+            continue;
+        }
+
+        VkMappedMemoryRange memoryRange = {
+            .sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE,
+            .pNext  = nullptr,
+            .memory = readback.buffer.memory,
+            .offset = 0,
+            .size   = VK_WHOLE_SIZE
+        };
+
+        vkInvalidateMappedMemoryRanges(device, 1, &memoryRange);
+
+        readback.state.store(READBACK_STATE_ENCODING, std::memory_order_relaxed);
+
+        jobSystem.submit([this, &jobSystem, &readback]() {
+            encode(jobSystem, readback);
+        }, &jobCounter);
+    }
+}
+
+std::filesystem::path FrameCapture::getCapturePath(uint64_t frameNumber) {
+    char name[32];
+
+    if (!requestedPath.empty()) {
+        std::filesystem::path path = requestedPath;
+        path += getExtension(format);
+
+        requestedPath.clear();
+        return path;
+    }
+
+    if (recordingSequence) {
+        snprintf(name, sizeof(name), "frame_%05llu%s", (unsigned long long)(frameNumber - sequenceFirstFrame), getExtension(format));
+        return sequenceDirectory / name;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    // Single captures take the first unused number, so earlier ones are never overwritten.
+    std::filesystem::path path;
+
+    do {
+        snprintf(name, sizeof(name), "capture_%05u%s", nextCaptureIndex++, getExtension(format));
+        path = directory / name;
+    } while (std::filesystem::exists(path));
+
+    return path;
+}
+
+void FrameCapture::encode(JobSystem& jobSystem, Readback& readback) {
+    if (captureCallback) {
+        captureCallback(readback.frameNumber, readback.extent, readback.data);
+        writtenFrameCount.fetch_add(1, std::memory_order_relaxed);
+    } else if (writeCaptureFile(readback.path, encodeCapture(jobSystem, readback.format, readback.exrCompression, readback.extent, readback.data, readback.exposureScale))) {
+        writtenFrameCount.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        failedFrameCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The render thread may reuse the readback from here on.
+    readback.state.store(READBACK_STATE_FREE, std::memory_order_release);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+#include "graphics.h"
+#include "jobs.h"
+
+// Captures are read back through a ring of this many buffers. A frame is dropped when every buffer is still busy.
+#define FRAME_CAPTURE_READBACK_COUNT 4
+
+enum CaptureFormat {
+    CAPTURE_FORMAT_EXR,
+    CAPTURE_FORMAT_PNG
+};
+
+enum ExrCompression {
+    EXR_COMPRESSION_ZIP,
+    EXR_COMPRESSION_PIZ
+};
+
+// Encodes RGBA16F rows the way captures are, the rows are bottom to top as in the trace.
+std::vector<uint8_t> encodeCapture(JobSystem& jobSystem, CaptureFormat format, ExrCompression exrCompression, VkExtent2D extent, const uint16_t* pixels, float exposureScale);
+
+// Writes next to the path and renames once the file is complete, so a reader never sees a partial image.
+bool writeCaptureFile(const std::filesystem::path& path, const std::vector<uint8_t>& data);
+
+// The mean squared error of the RGB of RGBA16F rows, bottom to top as in the trace, against the EXR at the path, such as
+// a capture of a converged render. Returns a negative error if the EXR can't be read or has a different extent.
+double compareToReference(const std::filesystem::path& referencePath, VkExtent2D extent, const uint16_t* pixels);
+
+// Saves traced frames to disk without stalling the renderer. The trace is copied into a host-visible readback buffer at
+// the end of the frame's command buffer. Once the renderer's timeline shows the frame is complete, the buffer goes to a
+// job that encodes and writes it, and only returns to the ring when that job is done. EXRs hold the linear trace as half
+// floats, PNGs the trace with the exposure applied, clamped and sRGB encoded.
+class FrameCapture {
+public:
+    CaptureFormat format = CAPTURE_FORMAT_EXR;
+    ExrCompression exrCompression = EXR_COMPRESSION_ZIP;
+    std::filesystem::path directory = "captures";
+
+    std::atomic<uint32_t> writtenFrameCount = 0;
+    std::atomic<uint32_t> failedFrameCount = 0;
+    uint32_t droppedFrameCount = 0;
+
+    // When set, captures are handed to this function from a job instead of being written, with the frame's number and
+    // the trace's RGBA16F rows. The pixels are only valid during the call.
+    std::function<void(uint64_t frameNumber, VkExtent2D extent, const uint16_t* pixels)> captureCallback;
+
+    FrameCapture() = default;
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // Writes what's still pending and waits for it, the renderer must be idle.
+    void flush(VkDevice device, JobSystem& jobSystem);
+    void destroy(VkDevice device, JobSystem& jobSystem);
+
+    // Captures the next frame. Without a path it's numbered after the captures already in the directory, otherwise the
+    // path gets the format's extension.
+    void requestCapture(const std::filesystem::path& path = {});
+
+    // Whether a readback can take the next capture. When all of them are busy, captures are dropped.
+    bool hasFreeReadback();
+
+    // Captures every frame into a numbered image sequence in a directory of its own, until it's stopped. Frames are
+    // numbered from the first one, so a dropped frame leaves a gap instead of shifting the rest.
+    void startSequence();
+    void stopSequence();
+    bool isRecordingSequence();
+
+    // Records the copy of the trace if this frame is captured. The image must be in the general layout, with its
+    // writes already visible to compute shaders.
+    void record(Device& device, VkCommandBuffer commandBuffer, VkImage image, VkExtent2D extent, uint64_t frameNumber, float exposureScale);
+
+    // Hands the readbacks of every frame before completedFrameCount to the job system.
+    void update(VkDevice device, JobSystem& jobSystem, uint64_t completedFrameCount);
+
+private:
+    enum ReadbackState {
+        READBACK_STATE_FREE,
+        READBACK_STATE_COPYING,
+        READBACK_STATE_ENCODING
+    };
+
+    struct Readback {
+        Buffer buffer;
+        VkDeviceSize size = 0;
+        uint16_t* data;
+        VkExtent2D extent;
+        uint64_t frameNumber;
+        float exposureScale;
+        CaptureFormat format;
+        ExrCompression exrCompression;
+        std::filesystem::path path;
+        std::atomic<uint32_t> state = READBACK_STATE_FREE;
+    };
+
+    Readback readbacks[FRAME_CAPTURE_READBACK_COUNT];
+    JobCounter jobCounter = 0;
+    bool captureRequested = false;
+    std::filesystem::path requestedPath;
+    bool recordingSequence = false;
+    std::filesystem::path sequenceDirectory;
+    uint64_t sequenceFirstFrame;
+    uint32_t nextCaptureIndex = 0;
+
+    std::filesystem::path getCapturePath(uint64_t frameNumber);
+    void encode(JobSystem& jobSystem, Readback& readback);
+};
@@ -0,0 +1,79 @@
+// Decodes the quantized vertices of the mesh that was hit, which the geometry table points to by device address.
+
+#extension GL_EXT_buffer_reference : enable
+
+// Vertices are read as 32-bit words and unpacked, so that no 16-bit storage features are needed:
+// x and y hold the snorm position and the normal flag, z the octahedral snorm normal and w the half float UV.
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer QuantizedVertices {
+    uvec4 vertices[];
+};
+
+layout(buffer_reference, std430, buffer_reference_align = 4) readonly buffer Indices {
+    uint indices[];
+};
+
+struct MeshGeometry {
+    QuantizedVertices vertices;
+    Indices indices;
+    vec3 positionOffset;
+    uint materialIndex;
+    vec3 positionScale;
+    uint padding;
+};
+
+struct DecodedVertex {
+    vec3 position;
+    vec3 normal;
+    vec2 uv;
+    bool hasNormal;
+};
+
+vec3 decodeOctahedral(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+
+    if (normal.z < 0.0) {
+        normal.xy = (1.0 - abs(normal.yx)) * vec2(normal.x >= 0.0 ? 1.0 : -1.0, normal.y >= 0.0 ? 1.0 : -1.0);
+    }
+
+    return normalize(normal);
+}
+
+DecodedVertex decodeVertex(MeshGeometry geometry, uint index) {
+    uvec4 vertex = geometry.vertices.vertices[index];
+    vec4 position = vec4(unpackSnorm2x16(vertex.x), unpackSnorm2x16(vertex.y));
+
+    DecodedVertex decoded;
+    decoded.position = geometry.positionOffset + geometry.positionScale * position.xyz;
+    decoded.normal = decodeOctahedral(unpackSnorm2x16(vertex.z));
+    decoded.uv = unpackHalf2x16(vertex.w);
+    decoded.hasNormal = position.w > 0.0;
+
+    return decoded;
+}
+
+// Interpolates the vertices of a triangle with the barycentrics of the hit. Vertices without a normal get the geometric
+// one, in object space.
+DecodedVertex decodeHit(MeshGeometry geometry, uint primitiveIndex, vec2 barycentrics) {
+    uint i0 = geometry.indices.indices[3 * primitiveIndex];
+    uint i1 = geometry.indices.indices[3 * primitiveIndex + 1];
+    uint i2 = geometry.indices.indices[3 * primitiveIndex + 2];
+
+    DecodedVertex v0 = decodeVertex(geometry, i0);
+    DecodedVertex v1 = decodeVertex(geometry, i1);
+    DecodedVertex v2 = decodeVertex(geometry, i2);
+
+    vec3 weights = vec3(1.0 - barycentrics.x - barycentrics.y, barycentrics);
+
+    DecodedVertex hit;
+    hit.position = weights.x * v0.position + weights.y * v1.position + weights.z * v2.position;
+    hit.uv = weights.x * v0.uv + weights.y * v1.uv + weights.z * v2.uv;
+    hit.hasNormal = v0.hasNormal && v1.hasNormal && v2.hasNormal;
+
+    if (hit.hasNormal) {
+        hit.normal = normalize(weights.x * v0.normal + weights.y * v1.normal + weights.z * v2.normal);
+    } else {
+        hit.normal = normalize(cross(v1.position - v0.position, v2.position - v0.position));
+    }
+
+    return hit;
+}
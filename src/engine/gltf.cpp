@@ -0,0 +1,695 @@
+#include "gltf.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <cgltf.h>
+
+#include "cooked_asset.h"
+#include "file_mapping.h"
+#include "hash.h"
+#include "image_import.h"
+#include "mesh_optimizer.h"
+
+// Large meshes are split into ranges of this many elements so that a single mesh can be decoded by several threads.
+static const uint32_t decodeGrainSize = 1 << 16;
+
+// LODs stop once they get this small, or once simplifying a LOD doesn't at least take it down to the fraction.
+static const uint32_t minLodTriangleCount = 64;
+static const float maxLodReduction = 0.85f;
+
+// The indices of every LOD of a mesh, finest first, one after the other.
+struct MeshLods {
+    std::vector<uint32_t> indices;
+    uint32_t lodCount;
+    uint32_t indexCounts[COOKED_MESH_MAX_LODS];
+    float errors[COOKED_MESH_MAX_LODS];
+};
+
+static bool mapBuffers(cgltf_data* data, const cgltf_options& options, const std::filesystem::path& directory, MappedFile* bufferFiles) {
+    for (cgltf_size i = 0; i < data->buffers_count; ++i) {
+        cgltf_buffer& buffer = data->buffers[i];
+
+        if (buffer.data != nullptr) {
+            continue;
+        }
+
+        if (buffer.uri == nullptr) {
+            // The binary chunk of a .glb file is already part of the mapped file.
+            if (data->bin == nullptr || data->bin_size < buffer.size) {
+                return false;
+            }
+
+            buffer.data = (void*)data->bin;
+            buffer.data_free_method = cgltf_data_free_method_none;
+        } else if (strncmp(buffer.uri, "data:", 5) == 0) {
+            const char* base64 = strstr(buffer.uri, ";base64,");
+
+            if (base64 == nullptr || cgltf_load_buffer_base64(&options, buffer.size, base64 + 8, &buffer.data) != cgltf_result_success) {
+                return false;
+            }
+
+            buffer.data_free_method = cgltf_data_free_method_memory_free;
+        } else {
+            std::string uri = buffer.uri;
+            cgltf_decode_uri(uri.data());
+
+            bufferFiles[i] = MappedFile(directory / uri.c_str());
+
+            if (bufferFiles[i].data == nullptr || bufferFiles[i].size < buffer.size) {
+                return false;
+            }
+
+            buffer.data = bufferFiles[i].data;
+            buffer.data_free_method = cgltf_data_free_method_none;
+        }
+    }
+
+    return true;
+}
+
+static const cgltf_accessor* findAttribute(const cgltf_primitive& primitive, cgltf_attribute_type type) {
+    for (cgltf_size i = 0; i < primitive.attributes_count; ++i) {
+        if (primitive.attributes[i].type == type && primitive.attributes[i].index == 0) {
+            return primitive.attributes[i].data;
+        }
+    }
+
+    return nullptr;
+}
+
+// Returns a pointer to the accessor's elements in the mapped buffer, or null if they can't be read directly.
+static const uint8_t* getAccessorData(const cgltf_accessor* accessor) {
+    if (accessor->is_sparse || accessor->buffer_view == nullptr || accessor->buffer_view->buffer->data == nullptr) {
+        return nullptr;
+    }
+
+    return (const uint8_t*)accessor->buffer_view->buffer->data + accessor->buffer_view->offset + accessor->offset;
+}
+
+static void readFloats(const cgltf_accessor* accessor, uint32_t begin, uint32_t end, uint32_t componentCount,
+                       uint8_t* destination, size_t destinationStride) {
+    const uint8_t* source = getAccessorData(accessor);
+
+    if (source != nullptr && accessor->component_type == cgltf_component_type_r_32f) {
+        for (uint32_t i = begin; i < end; ++i) {
+            memcpy(destination + i * destinationStride, source + i * accessor->stride, componentCount * sizeof(float));
+        }
+    } else {
+        // Normalized integers and sparse accessors go through the generic path.
+        for (uint32_t i = begin; i < end; ++i) {
+            cgltf_accessor_read_float(accessor, i, (float*)(destination + i * destinationStride), componentCount);
+        }
+    }
+}
+
+static void readIndices(const cgltf_accessor* accessor, uint32_t begin, uint32_t end, uint32_t* destination) {
+    const uint8_t* source = getAccessorData(accessor);
+
+    if (source == nullptr) {
+        for (uint32_t i = begin; i < end; ++i) {
+            destination[i] = (uint32_t)cgltf_accessor_read_index(accessor, i);
+        }
+
+        return;
+    }
+
+    switch (accessor->component_type) {
+    case cgltf_component_type_r_8u:
+        for (uint32_t i = begin; i < end; ++i) {
+            destination[i] = source[i * accessor->stride];
+        }
+        break;
+    case cgltf_component_type_r_16u:
+        for (uint32_t i = begin; i < end; ++i) {
+            uint16_t index;
+            memcpy(&index, source + i * accessor->stride, sizeof(index));
+            destination[i] = index;
+        }
+        break;
+    default:
+        for (uint32_t i = begin; i < end; ++i) {
+            memcpy(&destination[i], source + i * accessor->stride, sizeof(uint32_t));
+        }
+        break;
+    }
+}
+
+static void decodePrimitive(JobSystem& jobSystem, const cgltf_primitive& primitive, uint32_t vertexCount, uint32_t indexCount, Vertex* vertices, uint32_t* indices) {
+    const cgltf_accessor* positions = findAttribute(primitive, cgltf_attribute_type_position);
+    const cgltf_accessor* normals = findAttribute(primitive, cgltf_attribute_type_normal);
+    const cgltf_accessor* uvs = findAttribute(primitive, cgltf_attribute_type_texcoord);
+
+    jobSystem.parallelFor(vertexCount, decodeGrainSize, [&](uint32_t begin, uint32_t end) {
+        uint8_t* destination = (uint8_t*)vertices;
+
+        readFloats(positions, begin, end, 3, destination + offsetof(Vertex, position), sizeof(Vertex));
+
+        // Missing attributes are zeroed, the hit shaders fall back to the geometric normal.
+        if (normals != nullptr) {
+            readFloats(normals, begin, end, 3, destination + offsetof(Vertex, normal), sizeof(Vertex));
+        } else {
+            for (uint32_t i = begin; i < end; ++i) {
+                memset(vertices[i].normal, 0, sizeof(vertices[i].normal));
+            }
+        }
+
+        if (uvs != nullptr) {
+            readFloats(uvs, begin, end, 2, destination + offsetof(Vertex, uv), sizeof(Vertex));
+        } else {
+            for (uint32_t i = begin; i < end; ++i) {
+                memset(vertices[i].uv, 0, sizeof(vertices[i].uv));
+            }
+        }
+    });
+
+    jobSystem.parallelFor(indexCount, decodeGrainSize, [&](uint32_t begin, uint32_t end) {
+        if (primitive.indices != nullptr) {
+            readIndices(primitive.indices, begin, end, indices);
+        } else {
+            for (uint32_t i = begin; i < end; ++i) {
+                indices[i] = i;
+            }
+        }
+    });
+}
+
+// Each LOD is simplified from the previous one to about half of its triangles, so errors add up along the chain.
+static void generateLods(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount, MeshLods& lods) {
+    lods.indices.assign(indices, indices + indexCount);
+    lods.lodCount = 1;
+    lods.indexCounts[0] = indexCount;
+    lods.errors[0] = 0.0f;
+
+    size_t previousFirstIndex = 0;
+    float error = 0.0f;
+
+    while (lods.lodCount < COOKED_MESH_MAX_LODS && lods.indexCounts[lods.lodCount - 1] / 3 >= 2 * minLodTriangleCount) {
+        const uint32_t previousIndexCount = lods.indexCounts[lods.lodCount - 1];
+        const size_t firstIndex = lods.indices.size();
+
+        lods.indices.resize(firstIndex + previousIndexCount);
+
+        const uint32_t lodIndexCount = simplifyMesh(vertices, vertexCount, &lods.indices[previousFirstIndex], previousIndexCount,
+                                                    previousIndexCount / 2, &lods.indices[firstIndex], error);
+
+        if (lodIndexCount > previousIndexCount * maxLodReduction) {
+            lods.indices.resize(firstIndex);
+            break;
+        }
+
+        lods.indices.resize(firstIndex + lodIndexCount);
+        sortTriangles(vertices, &lods.indices[firstIndex], lodIndexCount / 3);
+
+        lods.indexCounts[lods.lodCount] = lodIndexCount;
+        lods.errors[lods.lodCount] = error;
+        ++lods.lodCount;
+
+        previousFirstIndex = firstIndex;
+    }
+}
+
+// Every node is added at most once, even if the file lists it under several parents or as a root and a child, so there
+// are never more nodes than the file has.
+static void addNode(const cgltf_data* data, const cgltf_node* node, int32_t parent, const uint32_t* firstMeshes,
+                    const uint32_t* meshCounts, bool* addedNodes, ModelNode* nodes, uint32_t& nodeCount) {
+    if (addedNodes[node - data->nodes]) {
+        return;
+    }
+
+    addedNodes[node - data->nodes] = true;
+
+    const uint32_t nodeIndex = nodeCount++;
+    ModelNode& modelNode = nodes[nodeIndex];
+
+    modelNode.parent = parent;
+    cgltf_node_transform_local(node, modelNode.transform);
+
+    if (node->mesh != nullptr) {
+        const cgltf_size meshIndex = node->mesh - data->meshes;
+        modelNode.firstMesh = firstMeshes[meshIndex];
+        modelNode.meshCount = meshCounts[meshIndex];
+    } else {
+        modelNode.firstMesh = 0;
+        modelNode.meshCount = 0;
+    }
+
+    for (cgltf_size i = 0; i < node->children_count; ++i) {
+        addNode(data, node->children[i], nodeIndex, firstMeshes, meshCounts, addedNodes, nodes, nodeCount);
+    }
+}
+
+static void prepareImages(JobSystem& jobSystem, const cgltf_data* data, const std::filesystem::path& directory, SourceImage* images) {
+    for (cgltf_size i = 0; i < data->images_count; ++i) {
+        const cgltf_image& image = data->images[i];
+
+        images[i].data = nullptr;
+        images[i].size = 0;
+        images[i].usage = TEXTURE_USAGE_DATA;
+
+        if (image.buffer_view != nullptr) {
+            const cgltf_buffer_view* bufferView = image.buffer_view;
+
+            if (bufferView->buffer->data != nullptr) {
+                images[i].data = (const uint8_t*)bufferView->buffer->data + bufferView->offset;
+                images[i].size = bufferView->size;
+            }
+        } else if (image.uri != nullptr && strncmp(image.uri, "data:", 5) != 0) {
+            // Embedded base64 images aren't supported, they don't show up in scenes big enough to matter.
+            std::string uri = image.uri;
+            cgltf_decode_uri(uri.data());
+
+            images[i].file = MappedFile(directory / uri.c_str());
+            images[i].data = images[i].file.data;
+            images[i].size = images[i].file.size;
+        }
+    }
+
+    // Every other texture holds data, which decides how it's compressed.
+    for (cgltf_size i = 0; i < data->materials_count; ++i) {
+        const cgltf_material& material = data->materials[i];
+        const cgltf_texture* colorTextures[] = {
+            material.pbr_metallic_roughness.base_color_texture.texture,
+            material.emissive_texture.texture
+        };
+
+        for (const cgltf_texture* texture : colorTextures) {
+            if (texture != nullptr && texture->image != nullptr) {
+                images[texture->image - data->images].usage = TEXTURE_USAGE_COLOR;
+            }
+        }
+
+        const cgltf_texture* normalTexture = material.normal_texture.texture;
+
+        if (normalTexture != nullptr && normalTexture->image != nullptr) {
+            images[normalTexture->image - data->images].usage = TEXTURE_USAGE_NORMAL;
+        }
+    }
+
+    // Only read the image headers, the size of every texture has to be known to lay out the cooked file.
+    jobSystem.parallelFor(data->images_count, 16, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            readSourceImageInfo(images[i]);
+        }
+    });
+}
+
+static uint32_t getTextureIndex(const cgltf_data* data, const cgltf_texture_view& textureView) {
+    if (textureView.texture == nullptr || textureView.texture->image == nullptr) {
+        return BINDLESS_INVALID_INDEX;
+    }
+
+    return textureView.texture->image - data->images;
+}
+
+// glTF uses the OpenGL enums.
+static void cookSamplers(const cgltf_data* data, SamplerDescription* samplers) {
+    for (cgltf_size i = 0; i < data->samplers_count; ++i) {
+        const cgltf_sampler& gltfSampler = data->samplers[i];
+        const int minFilter = (int)gltfSampler.min_filter;
+
+        auto getAddressMode = [](int wrap) {
+            switch (wrap) {
+                case 33071: return VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+                case 33648: return VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT;
+                default:    return VK_SAMPLER_ADDRESS_MODE_REPEAT;
+            }
+        };
+
+        SamplerDescription& sampler = samplers[i];
+        sampler = getDefaultSamplerDescription();
+
+        // NEAREST, NEAREST_MIPMAP_NEAREST and NEAREST_MIPMAP_LINEAR.
+        if ((int)gltfSampler.mag_filter == 9728) {
+            sampler.magFilter = VK_FILTER_NEAREST;
+        }
+
+        if (minFilter == 9728 || minFilter == 9984 || minFilter == 9986) {
+            sampler.minFilter = VK_FILTER_NEAREST;
+            sampler.maxAnisotropy = 1.0f;
+        }
+
+        // NEAREST, NEAREST_MIPMAP_NEAREST and LINEAR_MIPMAP_NEAREST.
+        if (minFilter == 9728 || minFilter == 9984 || minFilter == 9985) {
+            sampler.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        }
+
+        sampler.addressModeU = getAddressMode((int)gltfSampler.wrap_s);
+        sampler.addressModeV = getAddressMode((int)gltfSampler.wrap_t);
+    }
+}
+
+// A material has a single sampler, taken from the first of its textures that has one.
+static uint32_t getSamplerIndex(const cgltf_data* data, const cgltf_material& material) {
+    const cgltf_texture* textures[] = {
+        material.pbr_metallic_roughness.base_color_texture.texture,
+        material.pbr_metallic_roughness.metallic_roughness_texture.texture,
+        material.normal_texture.texture,
+        material.emissive_texture.texture
+    };
+
+    for (const cgltf_texture* texture : textures) {
+        if (texture != nullptr && texture->sampler != nullptr) {
+            return texture->sampler - data->samplers;
+        }
+    }
+
+    return BINDLESS_INVALID_INDEX;
+}
+
+static void cookMaterials(const cgltf_data* data, Material* materials) {
+    // The last material is used by primitives that don't have one.
+    for (cgltf_size i = 0; i <= data->materials_count; ++i) {
+        Material& material = materials[i];
+
+        material = {
+            .baseColorFactor          = { 1.0f, 1.0f, 1.0f, 1.0f },
+            .emissiveFactor           = { 0.0f, 0.0f, 0.0f },
+            .metallicFactor           = 1.0f,
+            .roughnessFactor          = 1.0f,
+            .baseColorTexture         = BINDLESS_INVALID_INDEX,
+            .metallicRoughnessTexture = BINDLESS_INVALID_INDEX,
+            .normalTexture            = BINDLESS_INVALID_INDEX,
+            .emissiveTexture          = BINDLESS_INVALID_INDEX,
+            .sampler                  = BINDLESS_INVALID_INDEX,
+            .padding                  = { 0, 0 }
+        };
+
+        if (i == data->materials_count) {
+            break;
+        }
+
+        const cgltf_material& gltfMaterial = data->materials[i];
+        const cgltf_pbr_metallic_roughness& pbr = gltfMaterial.pbr_metallic_roughness;
+
+        memcpy(material.baseColorFactor, pbr.base_color_factor, sizeof(material.baseColorFactor));
+        memcpy(material.emissiveFactor, gltfMaterial.emissive_factor, sizeof(material.emissiveFactor));
+
+        material.metallicFactor           = pbr.metallic_factor;
+        material.roughnessFactor          = pbr.roughness_factor;
+        material.baseColorTexture         = getTextureIndex(data, pbr.base_color_texture);
+        material.metallicRoughnessTexture = getTextureIndex(data, pbr.metallic_roughness_texture);
+        material.normalTexture            = getTextureIndex(data, gltfMaterial.normal_texture);
+        material.emissiveTexture          = getTextureIndex(data, gltfMaterial.emissive_texture);
+        material.sampler                  = getSamplerIndex(data, gltfMaterial);
+    }
+}
+
+static bool cookData(JobSystem& jobSystem, const TextureImportSettings& settings, const cgltf_data* data,
+                     const std::filesystem::path& directory, const std::filesystem::path& cookedPath) {
+    // Every triangle primitive becomes a mesh.
+    uint32_t* firstMeshes = new uint32_t[data->meshes_count];
+    uint32_t* meshCounts = new uint32_t[data->meshes_count];
+
+    uint32_t primitiveCount = 0;
+
+    for (cgltf_size i = 0; i < data->meshes_count; ++i) {
+        primitiveCount += data->meshes[i].primitives_count;
+    }
+
+    const cgltf_primitive** primitives = new const cgltf_primitive*[primitiveCount];
+    CookedMesh* meshes = new CookedMesh[primitiveCount];
+
+    CookedAssetHeader header = {
+        .magic   = COOKED_ASSET_MAGIC,
+        .version = COOKED_ASSET_VERSION
+    };
+
+    uint32_t decodedVertexCount = 0;
+    uint32_t decodedIndexCount = 0;
+
+    // Until the meshes are optimized, the vertex ranges are into the decoded vertices.
+    uint32_t* decodedFirstIndices = new uint32_t[primitiveCount];
+    uint32_t* decodedIndexCounts = new uint32_t[primitiveCount];
+
+    for (cgltf_size i = 0; i < data->meshes_count; ++i) {
+        firstMeshes[i] = header.meshCount;
+
+        for (cgltf_size j = 0; j < data->meshes[i].primitives_count; ++j) {
+            const cgltf_primitive& primitive = data->meshes[i].primitives[j];
+            const cgltf_accessor* positions = findAttribute(primitive, cgltf_attribute_type_position);
+
+            if (primitive.type != cgltf_primitive_type_triangles || positions == nullptr || positions->count == 0) {
+                continue;
+            }
+
+            const uint32_t indexCount = primitive.indices != nullptr ? primitive.indices->count : positions->count;
+
+            CookedMesh& mesh = meshes[header.meshCount];
+            mesh.firstVertex = decodedVertexCount;
+            mesh.vertexCount = positions->count;
+            mesh.materialIndex = primitive.material != nullptr ? primitive.material - data->materials : data->materials_count;
+
+            decodedFirstIndices[header.meshCount] = decodedIndexCount;
+            decodedIndexCounts[header.meshCount] = indexCount - indexCount % 3;
+
+            decodedVertexCount += mesh.vertexCount;
+            decodedIndexCount += decodedIndexCounts[header.meshCount];
+
+            primitives[header.meshCount++] = &primitive;
+        }
+
+        meshCounts[i] = header.meshCount - firstMeshes[i];
+    }
+
+    // Decode and optimize the meshes, which shrinks them before they are laid out, and simplify them into LODs.
+    Vertex* decodedVertices = new Vertex[decodedVertexCount];
+    uint32_t* decodedIndices = new uint32_t[decodedIndexCount];
+    MeshLods* meshLods = new MeshLods[header.meshCount];
+
+    jobSystem.parallelFor(header.meshCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            CookedMesh& mesh = meshes[i];
+            Vertex* vertices = decodedVertices + mesh.firstVertex;
+            uint32_t* indices = decodedIndices + decodedFirstIndices[i];
+
+            decodePrimitive(jobSystem, *primitives[i], mesh.vertexCount, decodedIndexCounts[i], vertices, indices);
+            optimizeMesh(vertices, mesh.vertexCount, indices, decodedIndexCounts[i]);
+            measureSurface(vertices, indices, decodedIndexCounts[i], mesh.surfaceArea, mesh.normalCone);
+            generateLods(vertices, mesh.vertexCount, indices, decodedIndexCounts[i], meshLods[i]);
+        }
+    });
+
+    uint32_t* decodedFirstVertices = new uint32_t[header.meshCount];
+
+    for (uint32_t i = 0; i < header.meshCount; ++i) {
+        CookedMesh& mesh = meshes[i];
+
+        decodedFirstVertices[i] = mesh.firstVertex;
+
+        mesh.firstVertex = header.vertexCount;
+        mesh.firstLod = header.lodCount;
+        mesh.lodCount = meshLods[i].lodCount;
+
+        header.vertexCount += mesh.vertexCount;
+        header.lodCount += mesh.lodCount;
+    }
+
+    CookedMeshLod* lods = new CookedMeshLod[header.lodCount];
+
+    for (uint32_t i = 0; i < header.meshCount; ++i) {
+        for (uint32_t j = 0; j < meshLods[i].lodCount; ++j) {
+            CookedMeshLod& lod = lods[meshes[i].firstLod + j];
+            lod.firstIndex = header.indexCount;
+            lod.indexCount = meshLods[i].indexCounts[j];
+            lod.error = meshLods[i].errors[j];
+            lod.padding = 0;
+
+            header.indexCount += lod.indexCount;
+        }
+    }
+
+    // Flatten the node hierarchy.
+    const cgltf_scene* scene = data->scene != nullptr ? data->scene : data->scenes_count > 0 ? &data->scenes[0] : nullptr;
+    ModelNode* nodes = new ModelNode[data->nodes_count];
+    bool* addedNodes = new bool[data->nodes_count]();
+
+    // Scenes may only list roots, nodes with a parent are reached through it.
+    if (scene != nullptr) {
+        for (cgltf_size i = 0; i < scene->nodes_count; ++i) {
+            if (scene->nodes[i]->parent == nullptr) {
+                addNode(data, scene->nodes[i], -1, firstMeshes, meshCounts, addedNodes, nodes, header.nodeCount);
+            }
+        }
+    } else {
+        for (cgltf_size i = 0; i < data->nodes_count; ++i) {
+            if (data->nodes[i].parent == nullptr) {
+                addNode(data, &data->nodes[i], -1, firstMeshes, meshCounts, addedNodes, nodes, header.nodeCount);
+            }
+        }
+    }
+
+    delete[] addedNodes;
+
+    SourceImage* images = new SourceImage[data->images_count];
+    prepareImages(jobSystem, data, directory, images);
+
+    // Lay out the file.
+    header.materialCount = data->materials_count + 1;
+    header.samplerCount = data->samplers_count;
+    header.textureCount = data->images_count;
+
+    CookedTexture* textures = new CookedTexture[header.textureCount];
+
+    uint64_t offset = sizeof(CookedAssetHeader);
+
+    header.meshesOffset = alignCookedOffset(offset);
+    offset = header.meshesOffset + header.meshCount * sizeof(CookedMesh);
+
+    header.lodsOffset = alignCookedOffset(offset);
+    offset = header.lodsOffset + header.lodCount * sizeof(CookedMeshLod);
+
+    header.nodesOffset = alignCookedOffset(offset);
+    offset = header.nodesOffset + header.nodeCount * sizeof(ModelNode);
+
+    header.materialsOffset = alignCookedOffset(offset);
+    offset = header.materialsOffset + header.materialCount * sizeof(Material);
+
+    header.samplersOffset = alignCookedOffset(offset);
+    offset = header.samplersOffset + header.samplerCount * sizeof(SamplerDescription);
+
+    header.texturesOffset = alignCookedOffset(offset);
+    offset = header.texturesOffset + header.textureCount * sizeof(CookedTexture);
+
+    header.verticesOffset = alignCookedOffset(offset);
+    offset = header.verticesOffset + (uint64_t)header.vertexCount * sizeof(QuantizedVertex);
+
+    header.indicesOffset = alignCookedOffset(offset);
+    offset = header.indicesOffset + (uint64_t)header.indexCount * sizeof(uint32_t);
+
+    offset = alignCookedOffset(offset);
+
+    for (uint32_t i = 0; i < header.textureCount; ++i) {
+        offset = layOutCookedTexture(images[i], settings, offset, textures[i]);
+    }
+
+    header.fileSize = alignCookedOffset(offset);
+
+    // Write everything straight into the mapped file, which is only moved into place once it's complete.
+    std::filesystem::path temporaryPath = cookedPath;
+    temporaryPath += ".tmp";
+
+    MappedFile file(temporaryPath, header.fileSize);
+    bool written = file.data != nullptr;
+
+    if (written) {
+        memcpy(file.data, &header, sizeof(header));
+        memcpy(file.data + header.nodesOffset, nodes, header.nodeCount * sizeof(ModelNode));
+        memcpy(file.data + header.texturesOffset, textures, header.textureCount * sizeof(CookedTexture));
+
+        cookMaterials(data, (Material*)(file.data + header.materialsOffset));
+        cookSamplers(data, (SamplerDescription*)(file.data + header.samplersOffset));
+
+        QuantizedVertex* vertices = (QuantizedVertex*)(file.data + header.verticesOffset);
+        uint32_t* indices = (uint32_t*)(file.data + header.indicesOffset);
+
+        jobSystem.parallelFor(header.meshCount, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i) {
+                CookedMesh& mesh = meshes[i];
+
+                quantizeVertices(decodedVertices + decodedFirstVertices[i], mesh.vertexCount, vertices + mesh.firstVertex,
+                                 mesh.positionOffset, mesh.positionScale);
+
+                uint64_t meshHash = hashData(vertices + mesh.firstVertex, mesh.vertexCount * sizeof(QuantizedVertex));
+                meshHash = hashData(mesh.positionOffset, sizeof(mesh.positionOffset), meshHash);
+                meshHash = hashData(mesh.positionScale, sizeof(mesh.positionScale), meshHash);
+
+                const uint32_t* lodIndices = meshLods[i].indices.data();
+
+                for (uint32_t j = 0; j < mesh.lodCount; ++j) {
+                    CookedMeshLod& lod = lods[mesh.firstLod + j];
+
+                    memcpy(indices + lod.firstIndex, lodIndices, lod.indexCount * sizeof(uint32_t));
+                    lodIndices += lod.indexCount;
+
+                    lod.contentHash = hashData(indices + lod.firstIndex, lod.indexCount * sizeof(uint32_t), meshHash);
+                }
+            }
+        });
+
+        memcpy(file.data + header.meshesOffset, meshes, header.meshCount * sizeof(CookedMesh));
+        memcpy(file.data + header.lodsOffset, lods, header.lodCount * sizeof(CookedMeshLod));
+
+        jobSystem.parallelFor(header.textureCount, 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; ++i) {
+                cookTexture(jobSystem, images[i], settings, textures[i], file.data);
+            }
+        });
+
+        written = file.flush();
+        file.destroy();
+    }
+
+    for (uint32_t i = 0; i < header.textureCount; ++i) {
+        images[i].file.destroy();
+    }
+
+    delete[] textures;
+    delete[] images;
+    delete[] lods;
+    delete[] decodedFirstVertices;
+    delete[] meshLods;
+    delete[] decodedIndices;
+    delete[] decodedVertices;
+    delete[] decodedIndexCounts;
+    delete[] decodedFirstIndices;
+    delete[] nodes;
+    delete[] meshes;
+    delete[] primitives;
+    delete[] meshCounts;
+    delete[] firstMeshes;
+
+    return written;
+}
+
+bool cookGltf(JobSystem& jobSystem, const TextureImportSettings& settings, const std::filesystem::path& sourcePath,
+              const std::filesystem::path& cookedPath) {
+    MappedFile file(sourcePath);
+
+    if (file.data == nullptr) {
+        return false;
+    }
+
+    // Parse the JSON. Buffers are mapped instead of loaded, so vertex data is only ever read once.
+    cgltf_options options = {};
+    cgltf_data* data;
+
+    if (cgltf_parse(&options, file.data, file.size, &data) != cgltf_result_success) {
+        file.destroy();
+        return false;
+    }
+
+    MappedFile* bufferFiles = new MappedFile[data->buffers_count];
+
+    bool cooked = mapBuffers(data, options, sourcePath.parent_path(), bufferFiles) && cgltf_validate(data) == cgltf_result_success &&
+                  cookData(jobSystem, settings, data, sourcePath.parent_path(), cookedPath);
+
+    for (cgltf_size i = 0; i < data->buffers_count; ++i) {
+        bufferFiles[i].destroy();
+    }
+
+    cgltf_free(data);
+
+    delete[] bufferFiles;
+    file.destroy();
+
+    // Replace the previous cooked file atomically, a failed cook never leaves a truncated one behind.
+    std::filesystem::path temporaryPath = cookedPath;
+    temporaryPath += ".tmp";
+
+    std::error_code error;
+
+    if (cooked) {
+        std::filesystem::rename(temporaryPath, cookedPath, error);
+        cooked = !error;
+    }
+
+    if (!cooked) {
+        std::filesystem::remove(temporaryPath, error);
+    }
+
+    return cooked;
+}
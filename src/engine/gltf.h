@@ -0,0 +1,12 @@
+#pragma once
+
+#include <filesystem>
+
+#include "image_import.h"
+#include "jobs.h"
+
+// Cooks a glTF 2.0 scene (.gltf or .glb) into a cooked asset. The source buffers are mapped and meshes and textures are
+// decoded in parallel straight into the mapped output file, with every mip level generated and compressed as the
+// settings ask. Returns false if the file couldn't be read or written.
+bool cookGltf(JobSystem& jobSystem, const TextureImportSettings& settings, const std::filesystem::path& sourcePath,
+              const std::filesystem::path& cookedPath);
@@ -1,15 +1,23 @@
 #include "graphics.h"
 
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
+#include <algorithm>
 #include <fstream>
+#include <vector>
 
 #include <imgui_impl_vulkan.h>
 
+#include "frame_capture.h"
+
 static PFN_vkCreateRayTracingPipelinesKHR vkCreateRayTracingPipelines;
-static PFN_vkCmdTraceRaysKHR vkCmdTraceRays;
+static PFN_vkCmdTraceRaysIndirectKHR vkCmdTraceRaysIndirect;
 
-VkInstance createInstance() {
+VkInstance createInstance(bool headless) {
     VkApplicationInfo applicationInfo = {
         .sType              = VK_STRUCTURE_TYPE_APPLICATION_INFO,
         .pNext              = nullptr,
@@ -20,8 +28,12 @@ VkInstance createInstance() {
         .apiVersion         = VK_API_VERSION_1_3
     };
 
-    uint32_t extensionCount;
-    const char** extensions = glfwGetRequiredInstanceExtensions(&extensionCount);
+    uint32_t extensionCount = 0;
+    const char** extensions = nullptr;
+
+    if (!headless) {
+        extensions = glfwGetRequiredInstanceExtensions(&extensionCount);
+    }
 
     VkInstanceCreateInfo instanceCreateInfo = {
         .sType                   = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
@@ -48,32 +60,25 @@ VkQueue* Queue::operator&() {
     return &queue;
 }
 
-static bool isDiscrete(VkPhysicalDevice physicalDevice) {
-    VkPhysicalDeviceProperties properties;
-    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
-
-    return properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU;
-}
-
-static bool supportsRayTracing(VkPhysicalDevice physicalDevice) {
+static bool supportsExtension(VkPhysicalDevice physicalDevice, const char* extensionName) {
     uint32_t extensionPropertyCount;
     vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionPropertyCount, nullptr);
 
     VkExtensionProperties* extensionProperties = new VkExtensionProperties[extensionPropertyCount];
     vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionPropertyCount, extensionProperties);
 
-    bool supportsRayTracing = false;
+    bool supported = false;
 
     for (uint32_t i = 0; i < extensionPropertyCount; ++i) {
-        if (strcmp(extensionProperties[i].extensionName, VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME) == 0) {
-            supportsRayTracing = true;
+        if (strcmp(extensionProperties[i].extensionName, extensionName) == 0) {
+            supported = true;
             break;
         }
     }
 
     delete[] extensionProperties;
 
-    return supportsRayTracing;
+    return supported;
 }
 
 static VkDeviceSize getPhysicalDeviceMemorySize(VkPhysicalDevice physicalDevice) {
@@ -93,21 +98,332 @@ static VkDeviceSize getPhysicalDeviceMemorySize(VkPhysicalDevice physicalDevice)
     return memorySize;
 }
 
-Device::Device(VkInstance instance, VkSurfaceKHR surface) {
-    // Select a physical device.
-    uint32_t physicalDeviceCount;
+// The first queue family that can trace and post-process, and present to the surface if there is one. Returns UINT32_MAX
+// if there's none.
+static uint32_t findRenderQueueFamily(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface) {
+    uint32_t queueFamilyPropertyCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyPropertyCount, nullptr);
+
+    VkQueueFamilyProperties* queueFamilyProperties = new VkQueueFamilyProperties[queueFamilyPropertyCount];
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyPropertyCount, queueFamilyProperties);
+
+    VkQueueFlags renderQueueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    uint32_t familyIndex = UINT32_MAX;
+
+    for (uint32_t i = 0; i < queueFamilyPropertyCount; ++i) {
+        if ((queueFamilyProperties[i].queueFlags & renderQueueFlags) == renderQueueFlags) {
+            VkBool32 surfaceSupported = VK_TRUE;
+
+            if (surface != VK_NULL_HANDLE) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &surfaceSupported);
+            }
+
+            if (surfaceSupported) {
+                familyIndex = i;
+                break;
+            }
+        }
+    }
+
+    delete[] queueFamilyProperties;
+
+    return familyIndex;
+}
+
+// Whether the device has everything Device enables. If not, the reason is written to the buffer.
+static bool isUsable(VkPhysicalDevice physicalDevice, VkSurfaceKHR surface, char* reason, size_t reasonSize) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    if (properties.apiVersion < VK_API_VERSION_1_3) {
+        snprintf(reason, reasonSize, "Vulkan %u.%u, 1.3 is required", VK_API_VERSION_MAJOR(properties.apiVersion), VK_API_VERSION_MINOR(properties.apiVersion));
+        return false;
+    }
+
+    const char* requiredExtensions[] = {
+        VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
+        VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
+        VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME,
+        VK_KHR_SWAPCHAIN_EXTENSION_NAME
+    };
+
+    // Headless devices don't need the swapchain, it's last.
+    const uint32_t requiredExtensionCount = surface != VK_NULL_HANDLE ? ARRAY_SIZE(requiredExtensions) : ARRAY_SIZE(requiredExtensions) - 1;
+
+    for (uint32_t i = 0; i < requiredExtensionCount; ++i) {
+        if (!supportsExtension(physicalDevice, requiredExtensions[i])) {
+            snprintf(reason, reasonSize, "%s is missing", requiredExtensions[i]);
+            return false;
+        }
+    }
+
+    VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_FEATURES_KHR,
+        .pNext = nullptr
+    };
+
+    VkPhysicalDeviceRayTracingPipelineFeaturesKHR rayTracingPipelineFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR,
+        .pNext = &accelerationStructureFeatures
+    };
+
+    VkPhysicalDeviceVulkan12Features vulkan12Features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext = &rayTracingPipelineFeatures
+    };
+
+    VkPhysicalDeviceVulkan13Features vulkan13Features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES,
+        .pNext = &vulkan12Features
+    };
+
+    VkPhysicalDeviceFeatures2 features = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &vulkan13Features
+    };
+
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+
+    struct RequiredFeature {
+        VkBool32 supported;
+        const char* name;
+    };
+
+    const RequiredFeature requiredFeatures[] = {
+        { accelerationStructureFeatures.accelerationStructure,            "accelerationStructure" },
+        { rayTracingPipelineFeatures.rayTracingPipeline,                  "rayTracingPipeline" },
+        { rayTracingPipelineFeatures.rayTracingPipelineTraceRaysIndirect, "rayTracingPipelineTraceRaysIndirect" },
+        { vulkan12Features.descriptorIndexing,                            "descriptorIndexing" },
+        { vulkan12Features.shaderSampledImageArrayNonUniformIndexing,     "shaderSampledImageArrayNonUniformIndexing" },
+        { vulkan12Features.shaderStorageBufferArrayNonUniformIndexing,    "shaderStorageBufferArrayNonUniformIndexing" },
+        { vulkan12Features.descriptorBindingSampledImageUpdateAfterBind,  "descriptorBindingSampledImageUpdateAfterBind" },
+        { vulkan12Features.descriptorBindingStorageBufferUpdateAfterBind, "descriptorBindingStorageBufferUpdateAfterBind" },
+        { vulkan12Features.descriptorBindingUpdateUnusedWhilePending,     "descriptorBindingUpdateUnusedWhilePending" },
+        { vulkan12Features.descriptorBindingPartiallyBound,               "descriptorBindingPartiallyBound" },
+        { vulkan12Features.runtimeDescriptorArray,                        "runtimeDescriptorArray" },
+        { vulkan12Features.hostQueryReset,                                "hostQueryReset" },
+        { vulkan12Features.timelineSemaphore,                             "timelineSemaphore" },
+        { vulkan12Features.bufferDeviceAddress,                           "bufferDeviceAddress" },
+        { vulkan13Features.synchronization2,                              "synchronization2" },
+        { features.features.samplerAnisotropy,                            "samplerAnisotropy" },
+        { features.features.textureCompressionBC,                         "textureCompressionBC" },
+        { features.features.shaderStorageImageWriteWithoutFormat,         "shaderStorageImageWriteWithoutFormat" },
+        { features.features.shaderStorageImageArrayDynamicIndexing,       "shaderStorageImageArrayDynamicIndexing" }
+    };
+
+    for (const RequiredFeature& feature : requiredFeatures) {
+        if (!feature.supported) {
+            snprintf(reason, reasonSize, "the %s feature is missing", feature.name);
+            return false;
+        }
+    }
+
+    if (findRenderQueueFamily(physicalDevice, surface) == UINT32_MAX) {
+        snprintf(reason, reasonSize, "no queue can trace%s", surface != VK_NULL_HANDLE ? " and present" : "");
+        return false;
+    }
+
+    return true;
+}
+
+// The device type outweighs everything else, tracing on an integrated GPU or on the CPU is several times slower. Memory
+// then decides between devices of a type, and the optional extensions and queue layout between otherwise equal ones.
+static uint64_t getScore(VkPhysicalDevice physicalDevice) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+
+    uint64_t typeScore = 0;
+
+    switch (properties.deviceType) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:   typeScore = 3; break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: typeScore = 2; break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:    typeScore = 1; break;
+        default:                                     typeScore = 0; break;
+    }
+
+    const uint64_t memoryGibibytes = std::min<uint64_t>(getPhysicalDeviceMemorySize(physicalDevice) >> 30, 999);
+
+    const char* rayTracingExtensions[] = {
+        VK_KHR_RAY_QUERY_EXTENSION_NAME,
+        VK_KHR_RAY_TRACING_MAINTENANCE_1_EXTENSION_NAME,
+        VK_NV_RAY_TRACING_INVOCATION_REORDER_EXTENSION_NAME
+    };
+
+    uint64_t rayTracingScore = 0;
+
+    for (const char* extension : rayTracingExtensions) {
+        rayTracingScore += supportsExtension(physicalDevice, extension);
+    }
+
+    // Dedicated compute and transfer queues let uploads and builds run beside the trace.
+    uint32_t queueFamilyPropertyCount;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyPropertyCount, nullptr);
+
+    VkQueueFamilyProperties* queueFamilyProperties = new VkQueueFamilyProperties[queueFamilyPropertyCount];
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyPropertyCount, queueFamilyProperties);
+
+    bool dedicatedComputeQueue = false;
+    bool dedicatedTransferQueue = false;
+
+    for (uint32_t i = 0; i < queueFamilyPropertyCount; ++i) {
+        const VkQueueFlags queueFlags = queueFamilyProperties[i].queueFlags;
+
+        dedicatedComputeQueue |= (queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFlags & VK_QUEUE_GRAPHICS_BIT);
+        dedicatedTransferQueue |= (queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT));
+    }
+
+    delete[] queueFamilyProperties;
+
+    return typeScore * 1000000 + memoryGibibytes * 1000 + rayTracingScore * 10 + dedicatedComputeQueue + dedicatedTransferQueue;
+}
+
+// Whether the override names the device, by its index in the instance's list or by its UUID. UUIDs are matched as hex
+// digits, ignoring case and dashes.
+static bool matchesOverride(const char* override, uint32_t index, const uint8_t* uuid) {
+    char* end;
+    const unsigned long overrideIndex = strtoul(override, &end, 10);
+
+    if (end != override && *end == '\0') {
+        return overrideIndex == index;
+    }
+
+    char uuidDigits[2 * VK_UUID_SIZE + 1];
+
+    for (uint32_t i = 0; i < VK_UUID_SIZE; ++i) {
+        snprintf(uuidDigits + 2 * i, 3, "%02x", uuid[i]);
+    }
+
+    uint32_t digitCount = 0;
+
+    for (const char* c = override; *c != '\0'; ++c) {
+        if (*c == '-') {
+            continue;
+        }
+
+        if (digitCount == 2 * VK_UUID_SIZE || tolower(*c) != uuidDigits[digitCount]) {
+            return false;
+        }
+
+        ++digitCount;
+    }
+
+    return digitCount == 2 * VK_UUID_SIZE;
+}
+
+static void getUuid(VkPhysicalDevice physicalDevice, uint8_t* uuid) {
+    VkPhysicalDeviceIDProperties idProperties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+        .pNext = nullptr
+    };
+
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+        .pNext = &idProperties
+    };
+
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+    memcpy(uuid, idProperties.deviceUUID, VK_UUID_SIZE);
+}
+
+static VkPhysicalDevice selectPhysicalDevice(VkInstance instance, VkSurfaceKHR surface, const DeviceSelection& selection) {
+    uint32_t physicalDeviceCount = 0;
     vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, nullptr);
 
+    // There's nothing to trace on without a device, and nothing to report that further on.
+    if (physicalDeviceCount == 0) {
+        fprintf(stderr, "No Vulkan devices found.\n");
+        exit(EXIT_FAILURE);
+    }
+
     VkPhysicalDevice* physicalDevices = new VkPhysicalDevice[physicalDeviceCount];
     vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, physicalDevices);
 
-    physical = physicalDevices[0]; // TODO
+    const char* override = selection.override != nullptr ? selection.override : getenv("VORTEX_DEVICE");
+
+    struct Candidate {
+        VkPhysicalDevice physicalDevice;
+        uint64_t score;
+    };
+
+    std::vector<Candidate> candidates;
+    VkPhysicalDevice selected = VK_NULL_HANDLE;
+    bool overrideMatched = false;
+
+    for (uint32_t i = 0; i < physicalDeviceCount; ++i) {
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physicalDevices[i], &properties);
+
+        uint8_t uuid[VK_UUID_SIZE];
+        getUuid(physicalDevices[i], uuid);
+
+        const bool overridden = override != nullptr && matchesOverride(override, i, uuid);
+        overrideMatched |= overridden;
+
+        char reason[256];
+
+        if (!isUsable(physicalDevices[i], surface, reason, sizeof(reason))) {
+            fprintf(stderr, "Vulkan device %u (%s) rejected: %s.\n", i, properties.deviceName, reason);
+            continue;
+        }
+
+        const uint64_t score = getScore(physicalDevices[i]);
+        fprintf(stderr, "Vulkan device %u (%s) scored %llu.\n", i, properties.deviceName, (unsigned long long)score);
+
+        candidates.push_back({ physicalDevices[i], score });
+
+        if (overridden) {
+            selected = physicalDevices[i];
+        }
+    }
+
+    if (override != nullptr && selected == VK_NULL_HANDLE) {
+        if (overrideMatched) {
+            fprintf(stderr, "Vulkan device %s can't be used, ignoring it.\n", override);
+        } else {
+            fprintf(stderr, "No Vulkan device matches %s, ignoring it.\n", override);
+        }
+    }
+
+    // Rank the usable devices. Devices with the same score stay in the instance's order, so every process ranks them alike.
+    std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.score > b.score;
+    });
+
+    if (selected == VK_NULL_HANDLE && !candidates.empty()) {
+        selected = candidates[selection.rank % candidates.size()].physicalDevice;
+    }
+
+    // Every device has been rejected above, along with the reason.
+    if (selected == VK_NULL_HANDLE) {
+        fprintf(stderr, "None of the %u Vulkan devices can be used.\n", physicalDeviceCount);
+        delete[] physicalDevices;
+        exit(EXIT_FAILURE);
+    }
+
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(selected, &properties);
+
+    fprintf(stderr, "Selected Vulkan device %s.\n", properties.deviceName);
 
     delete[] physicalDevices;
 
-    // Get the ray tracing pipeline properties.
+    return selected;
+}
+
+Device::Device(VkInstance instance, VkSurfaceKHR surface, const DeviceSelection& selection) {
+    // Select a physical device.
+    physical = selectPhysicalDevice(instance, surface, selection);
+
+    // Get the ray tracing pipeline, acceleration structure and identification properties.
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    idProperties.pNext = nullptr;
+
+    asProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ACCELERATION_STRUCTURE_PROPERTIES_KHR;
+    asProperties.pNext = &idProperties;
+
     rtProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_PROPERTIES_KHR;
-    rtProperties.pNext = nullptr;
+    rtProperties.pNext = &asProperties;
 
     VkPhysicalDeviceProperties2 physicalDeviceProperties = {
         .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
@@ -116,28 +432,16 @@ Device::Device(VkInstance instance, VkSurfaceKHR surface) {
 
     vkGetPhysicalDeviceProperties2(physical, &physicalDeviceProperties);
 
-    // Select a queue family.
-    uint32_t queueFamilyPropertyCount;
-    vkGetPhysicalDeviceQueueFamilyProperties(physical, &queueFamilyPropertyCount, nullptr);
-
-    VkQueueFamilyProperties* queueFamilyProperties = new VkQueueFamilyProperties[queueFamilyPropertyCount];
-    vkGetPhysicalDeviceQueueFamilyProperties(physical, &queueFamilyPropertyCount, queueFamilyProperties);
-
-    VkQueueFlags renderQueueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+    properties = physicalDeviceProperties.properties;
 
-    for (uint32_t i = 0; i < queueFamilyPropertyCount; ++i) {
-        if ((queueFamilyProperties[i].queueFlags & renderQueueFlags) == renderQueueFlags) {
-            VkBool32 surfaceSupported;
-            vkGetPhysicalDeviceSurfaceSupportKHR(physical, i, surface, &surfaceSupported);
+    // Quantized positions can only be built into a BLAS directly where the device supports them as vertices.
+    VkFormatProperties snormFormatProperties;
+    vkGetPhysicalDeviceFormatProperties(physical, VK_FORMAT_R16G16B16A16_SNORM, &snormFormatProperties);
 
-            if (surfaceSupported) {
-                renderQueue.familyIndex = i;
-                break;
-            }
-        }
-    }
+    snormBlasVerticesSupported = (snormFormatProperties.bufferFeatures & VK_FORMAT_FEATURE_ACCELERATION_STRUCTURE_VERTEX_BUFFER_BIT_KHR) != 0;
 
-    delete[] queueFamilyProperties;
+    // Select a queue family.
+    renderQueue.familyIndex = findRenderQueueFamily(physical, surface);
 
     // Create the device.
     VkPhysicalDeviceAccelerationStructureFeaturesKHR accelerationStructureFeatures = {
@@ -147,15 +451,26 @@ Device::Device(VkInstance instance, VkSurfaceKHR surface) {
     };
 
     VkPhysicalDeviceRayTracingPipelineFeaturesKHR rayTracingPipelineFeatures = {
-        .sType              = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR,
-        .pNext              = &accelerationStructureFeatures,
-        .rayTracingPipeline = VK_TRUE
+        .sType                               = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_RAY_TRACING_PIPELINE_FEATURES_KHR,
+        .pNext                               = &accelerationStructureFeatures,
+        .rayTracingPipeline                  = VK_TRUE,
+        .rayTracingPipelineTraceRaysIndirect = VK_TRUE
     };
 
     VkPhysicalDeviceVulkan12Features vulkan12Features = {
-        .sType               = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
-        .pNext               = &rayTracingPipelineFeatures,
-        .bufferDeviceAddress = VK_TRUE
+        .sType                                         = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES,
+        .pNext                                         = &rayTracingPipelineFeatures,
+        .descriptorIndexing                            = VK_TRUE,
+        .shaderSampledImageArrayNonUniformIndexing     = VK_TRUE,
+        .shaderStorageBufferArrayNonUniformIndexing    = VK_TRUE,
+        .descriptorBindingSampledImageUpdateAfterBind  = VK_TRUE,
+        .descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE,
+        .descriptorBindingUpdateUnusedWhilePending     = VK_TRUE,
+        .descriptorBindingPartiallyBound               = VK_TRUE,
+        .runtimeDescriptorArray                        = VK_TRUE,
+        .hostQueryReset                                = VK_TRUE,
+        .timelineSemaphore                             = VK_TRUE,
+        .bufferDeviceAddress                           = VK_TRUE
     };
 
     VkPhysicalDeviceVulkan13Features vulkan13Features = {
@@ -164,6 +479,15 @@ Device::Device(VkInstance instance, VkSurfaceKHR surface) {
         .synchronization2 = VK_TRUE
     };
 
+    // Imported textures are block compressed and sampled anisotropically. Post-processing indexes its images with push
+    // constants and writes the swapchain, whose format it doesn't know.
+    VkPhysicalDeviceFeatures features = {
+        .samplerAnisotropy                      = VK_TRUE,
+        .textureCompressionBC                   = VK_TRUE,
+        .shaderStorageImageWriteWithoutFormat   = VK_TRUE,
+        .shaderStorageImageArrayDynamicIndexing = VK_TRUE
+    };
+
     const float queuePriority = 1.0f;
 
     VkDeviceQueueCreateInfo deviceQueueCreateInfo = {
@@ -175,13 +499,58 @@ Device::Device(VkInstance instance, VkSurfaceKHR surface) {
         .pQueuePriorities = &queuePriority
     };
 
-    const char* deviceExtensions[] = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
+    const char* deviceExtensions[7] = {
         VK_KHR_RAY_TRACING_PIPELINE_EXTENSION_NAME,
         VK_KHR_ACCELERATION_STRUCTURE_EXTENSION_NAME,
         VK_KHR_DEFERRED_HOST_OPERATIONS_EXTENSION_NAME
     };
 
+    uint32_t deviceExtensionCount = 3;
+
+    // Headless devices never present.
+    if (surface != VK_NULL_HANDLE) {
+        deviceExtensions[deviceExtensionCount++] = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
+    }
+
+    // The memory budget is optional, texture streaming falls back to the heap sizes without it.
+    memoryBudgetSupported = supportsExtension(physical, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+    if (memoryBudgetSupported) {
+        deviceExtensions[deviceExtensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+    }
+
+    // Present waits pace the editor's frames and measure their latency, they are optional too.
+    VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+        .pNext = nullptr
+    };
+
+    VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+        .pNext = &presentWaitFeatures
+    };
+
+    presentWaitSupported = false;
+
+    if (surface != VK_NULL_HANDLE && supportsExtension(physical, VK_KHR_PRESENT_ID_EXTENSION_NAME) && supportsExtension(physical, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+        VkPhysicalDeviceFeatures2 supportedFeatures = {
+            .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+            .pNext = &presentIdFeatures
+        };
+
+        vkGetPhysicalDeviceFeatures2(physical, &supportedFeatures);
+
+        presentWaitSupported = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+    }
+
+    if (presentWaitSupported) {
+        deviceExtensions[deviceExtensionCount++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+        deviceExtensions[deviceExtensionCount++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+
+        presentWaitFeatures.pNext = vulkan13Features.pNext;
+        vulkan13Features.pNext = &presentIdFeatures;
+    }
+
     VkDeviceCreateInfo deviceCreateInfo = {
         .sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
         .pNext                   = &vulkan13Features,
@@ -190,9 +559,9 @@ Device::Device(VkInstance instance, VkSurfaceKHR surface) {
         .pQueueCreateInfos       = &deviceQueueCreateInfo,
         .enabledLayerCount       = 0,
         .ppEnabledLayerNames     = nullptr,
-        .enabledExtensionCount   = ARRAY_SIZE(deviceExtensions),
+        .enabledExtensionCount   = deviceExtensionCount,
         .ppEnabledExtensionNames = deviceExtensions,
-        .pEnabledFeatures        = nullptr
+        .pEnabledFeatures        = &features
     };
 
     vkCreateDevice(physical, &deviceCreateInfo, nullptr, &logical);
@@ -210,12 +579,12 @@ static uint32_t clamp(int d, uint32_t min, uint32_t max) {
     return t > max ? max : t;
 }
 
-VkSurfaceCapabilitiesKHR Device::getSurfaceCapabilities(VkSurfaceKHR surface, GLFWwindow* window) {
+VkSurfaceCapabilitiesKHR Device::getSurfaceCapabilities(VkSurfaceKHR surface, GLFWwindow* window, uint32_t imageCount) {
     VkSurfaceCapabilitiesKHR surfaceCapabilities;
     vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical, surface, &surfaceCapabilities);
 
     uint32_t maxImageCount = surfaceCapabilities.maxImageCount != 0 ? surfaceCapabilities.maxImageCount : UINT32_MAX;
-    surfaceCapabilities.minImageCount = clamp(3, surfaceCapabilities.minImageCount, maxImageCount);
+    surfaceCapabilities.minImageCount = clamp(imageCount, surfaceCapabilities.minImageCount, maxImageCount);
 
     VkExtent2D& currentExtent = surfaceCapabilities.currentExtent;
 
@@ -264,6 +633,27 @@ exit:
     return surfaceFormat;
 }
 
+bool Device::supportsPresentMode(VkSurfaceKHR surface, VkPresentModeKHR presentMode) {
+    uint32_t presentModeCount;
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physical, surface, &presentModeCount, nullptr);
+
+    VkPresentModeKHR* presentModes = new VkPresentModeKHR[presentModeCount];
+    vkGetPhysicalDeviceSurfacePresentModesKHR(physical, surface, &presentModeCount, presentModes);
+
+    bool supported = false;
+
+    for (uint32_t i = 0; i < presentModeCount; ++i) {
+        if (presentModes[i] == presentMode) {
+            supported = true;
+            break;
+        }
+    }
+
+    delete[] presentModes;
+
+    return supported;
+}
+
 uint32_t Device::getMemoryTypeIndex(uint32_t memoryTypeBits, VkMemoryPropertyFlags memoryProperties) {
     VkPhysicalDeviceMemoryProperties physicalDeviceMemoryProperties;
     vkGetPhysicalDeviceMemoryProperties(physical, &physicalDeviceMemoryProperties);
@@ -281,8 +671,19 @@ uint32_t Device::getMemoryTypeIndex(uint32_t memoryTypeBits, VkMemoryPropertyFla
 
 void loadFunctionPointers(VkDevice device) {
     vkCreateRayTracingPipelines = (PFN_vkCreateRayTracingPipelinesKHR)vkGetDeviceProcAddr(device, "vkCreateRayTracingPipelinesKHR");
-    vkCmdTraceRays = (PFN_vkCmdTraceRaysKHR)vkGetDeviceProcAddr(device, "vkCmdTraceRaysKHR");
+    vkCmdTraceRaysIndirect = (PFN_vkCmdTraceRaysIndirectKHR)vkGetDeviceProcAddr(device, "vkCmdTraceRaysIndirectKHR");
     vkGetRayTracingShaderGroupHandles = (PFN_vkGetRayTracingShaderGroupHandlesKHR)vkGetDeviceProcAddr(device, "vkGetRayTracingShaderGroupHandlesKHR");
+    vkCreateAccelerationStructure = (PFN_vkCreateAccelerationStructureKHR)vkGetDeviceProcAddr(device, "vkCreateAccelerationStructureKHR");
+    vkDestroyAccelerationStructure = (PFN_vkDestroyAccelerationStructureKHR)vkGetDeviceProcAddr(device, "vkDestroyAccelerationStructureKHR");
+    vkGetAccelerationStructureBuildSizes = (PFN_vkGetAccelerationStructureBuildSizesKHR)vkGetDeviceProcAddr(device, "vkGetAccelerationStructureBuildSizesKHR");
+    vkGetAccelerationStructureDeviceAddress = (PFN_vkGetAccelerationStructureDeviceAddressKHR)vkGetDeviceProcAddr(device, "vkGetAccelerationStructureDeviceAddressKHR");
+    vkCmdBuildAccelerationStructures = (PFN_vkCmdBuildAccelerationStructuresKHR)vkGetDeviceProcAddr(device, "vkCmdBuildAccelerationStructuresKHR");
+    vkCmdWriteAccelerationStructuresProperties = (PFN_vkCmdWriteAccelerationStructuresPropertiesKHR)vkGetDeviceProcAddr(device, "vkCmdWriteAccelerationStructuresPropertiesKHR");
+    vkCmdCopyAccelerationStructure = (PFN_vkCmdCopyAccelerationStructureKHR)vkGetDeviceProcAddr(device, "vkCmdCopyAccelerationStructureKHR");
+    vkCmdCopyAccelerationStructureToMemory = (PFN_vkCmdCopyAccelerationStructureToMemoryKHR)vkGetDeviceProcAddr(device, "vkCmdCopyAccelerationStructureToMemoryKHR");
+    vkCmdCopyMemoryToAccelerationStructure = (PFN_vkCmdCopyMemoryToAccelerationStructureKHR)vkGetDeviceProcAddr(device, "vkCmdCopyMemoryToAccelerationStructureKHR");
+    vkGetDeviceAccelerationStructureCompatibility = (PFN_vkGetDeviceAccelerationStructureCompatibilityKHR)vkGetDeviceProcAddr(device, "vkGetDeviceAccelerationStructureCompatibilityKHR");
+    vkWaitForPresent = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(device, "vkWaitForPresentKHR");
 }
 
 Buffer::Buffer(Device& device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags memoryProperties) {
@@ -345,6 +746,78 @@ Buffer::operator VkBuffer() {
     return buffer;
 }
 
+ImmediateCommandBuffer::ImmediateCommandBuffer(Device& device) {
+    VkCommandPoolCreateInfo commandPoolCreateInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+        .queueFamilyIndex = device.renderQueue.familyIndex
+    };
+
+    vkCreateCommandPool(device.logical, &commandPoolCreateInfo, nullptr, &commandPool);
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext              = nullptr,
+        .commandPool        = commandPool,
+        .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+    };
+
+    vkAllocateCommandBuffers(device.logical, &commandBufferAllocateInfo, &commandBuffer);
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr
+    };
+
+    vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+}
+
+void ImmediateCommandBuffer::submit(Device& device) {
+    vkEndCommandBuffer(commandBuffer);
+
+    VkFenceCreateInfo fenceCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = 0
+    };
+
+    VkFence fence;
+    vkCreateFence(device.logical, &fenceCreateInfo, nullptr, &fence);
+
+    VkCommandBufferSubmitInfo commandBufferSubmitInfo = {
+        .sType         = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .pNext         = nullptr,
+        .commandBuffer = commandBuffer,
+        .deviceMask    = 0
+    };
+
+    VkSubmitInfo2 submitInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .pNext                    = nullptr,
+        .flags                    = 0,
+        .waitSemaphoreInfoCount   = 0,
+        .pWaitSemaphoreInfos      = nullptr,
+        .commandBufferInfoCount   = 1,
+        .pCommandBufferInfos      = &commandBufferSubmitInfo,
+        .signalSemaphoreInfoCount = 0,
+        .pSignalSemaphoreInfos    = nullptr
+    };
+
+    vkQueueSubmit2(device.renderQueue, 1, &submitInfo, fence);
+    vkWaitForFences(device.logical, 1, &fence, VK_TRUE, UINT64_MAX);
+
+    vkDestroyFence(device.logical, fence, nullptr);
+    vkDestroyCommandPool(device.logical, commandPool, nullptr);
+}
+
+ImmediateCommandBuffer::operator VkCommandBuffer() {
+    return commandBuffer;
+}
+
 VkRenderPass createRenderPass(VkDevice device, VkFormat format, bool clear) {
     VkAttachmentDescription2 attachmentDescription = {
         .sType          = VK_STRUCTURE_TYPE_ATTACHMENT_DESCRIPTION_2,
@@ -448,14 +921,14 @@ VkRenderPass createRenderPass(VkDevice device, VkFormat format, bool clear) {
 
 VkDescriptorPool createGuiDescriptorPool(VkDevice device) {
     VkDescriptorPoolSize descriptorPoolSizes[] = {
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 }
+        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 }
     };
 
     VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
         .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
         .pNext         = nullptr,
         .flags         = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT,
-        .maxSets       = 1,
+        .maxSets       = 2,
         .poolSizeCount = ARRAY_SIZE(descriptorPoolSizes),
         .pPoolSizes    = descriptorPoolSizes
     };
@@ -619,6 +1092,28 @@ VkPipeline createRayTracingPipeline(VkDevice device, uint32_t entryCount, const
     return pipeline;
 }
 
+VkPipeline createComputePipeline(VkDevice device, const char* shader, VkPipelineLayout pipelineLayout) {
+    VkShaderModule shaderModule = createShaderModule(device, shader);
+
+    VkComputePipelineCreateInfo computePipelineCreateInfo = {
+        .sType              = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .pNext              = nullptr,
+        .flags              = 0,
+        .layout             = pipelineLayout,
+        .basePipelineHandle = VK_NULL_HANDLE,
+        .basePipelineIndex  = -1
+    };
+
+    populateShaderStageCreateInfo(computePipelineCreateInfo.stage, VK_SHADER_STAGE_COMPUTE_BIT, shaderModule);
+
+    VkPipeline pipeline;
+    vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &pipeline);
+
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+
+    return pipeline;
+}
+
 static uint32_t alignNumber(uint32_t number, uint32_t alignment) {
     return (number + alignment - 1) & ~(alignment - 1);
 }
@@ -630,27 +1125,36 @@ ShaderBindingTable::ShaderBindingTable(Device& device, uint32_t entryCount, cons
     const uint32_t baseAlignment = rtProperties.shaderGroupBaseAlignment;
     const uint32_t handleAlignment = rtProperties.shaderGroupHandleAlignment;
 
-    const uint32_t handleSizeAligned = alignNumber(handleSize, handleAlignment);
-
-    raygen.size = alignNumber(handleSizeAligned, baseAlignment);
-    raygen.stride = raygen.size;
-
     uint32_t hitGroupCount = 0;
     uint32_t missGroupCount = 0;
 
+    // Every record of a region has the same stride, which fits the largest one.
+    uint32_t raygenRecordSize = handleSize;
+    uint32_t hitRecordSize = handleSize;
+    uint32_t missRecordSize = handleSize;
+
     for (uint32_t i = 0; i < entryCount; ++i) {
-        if (entries[i].stage == SHADER_BINDING_TABLE_STAGE_HIT) {
+        const uint32_t recordSize = handleSize + entries[i].recordDataSize;
+
+        if (entries[i].stage == SHADER_BINDING_TABLE_STAGE_RAYGEN) {
+            raygenRecordSize = recordSize > raygenRecordSize ? recordSize : raygenRecordSize;
+        } else if (entries[i].stage == SHADER_BINDING_TABLE_STAGE_HIT) {
+            hitRecordSize = recordSize > hitRecordSize ? recordSize : hitRecordSize;
             ++hitGroupCount;
-        } else if (entries[i].stage == SHADER_BINDING_TABLE_STAGE_MISS) {
+        } else {
+            missRecordSize = recordSize > missRecordSize ? recordSize : missRecordSize;
             ++missGroupCount;
         }
     }
 
-    hit.stride = handleSizeAligned;
-    hit.size = alignNumber(hitGroupCount * handleSizeAligned, baseAlignment);
+    raygen.size = alignNumber(alignNumber(raygenRecordSize, handleAlignment), baseAlignment);
+    raygen.stride = raygen.size;
+
+    hit.stride = alignNumber(hitRecordSize, handleAlignment);
+    hit.size = alignNumber(hitGroupCount * hit.stride, baseAlignment);
 
-    miss.stride = handleSizeAligned;
-    miss.size = alignNumber(missGroupCount * handleSizeAligned, baseAlignment);
+    miss.stride = alignNumber(missRecordSize, handleAlignment);
+    miss.size = alignNumber(missGroupCount * miss.stride, baseAlignment);
 
     size = raygen.size + hit.size + miss.size;
 
@@ -667,8 +1171,135 @@ void ShaderBindingTable::destroy(VkDevice device) {
     buffer.destroy(device);
 }
 
+void ShaderBindingTable::writeRecords(Device& device, VkPipeline pipeline, uint32_t entryCount, const ShaderBindingTableEntry* entries, uint8_t* data) {
+    const uint32_t handleSize = device.rtProperties.shaderGroupHandleSize;
+
+    uint8_t* handles = new uint8_t[entryCount * handleSize];
+    vkGetRayTracingShaderGroupHandles(device.logical, pipeline, 0, entryCount, entryCount * handleSize, handles);
+
+    memset(data, 0, size);
+
+    VkDeviceSize hitOffset = raygen.size;
+    VkDeviceSize missOffset = raygen.size + hit.size;
+
+    for (uint32_t i = 0; i < entryCount; ++i) {
+        uint8_t* record;
+
+        if (entries[i].stage == SHADER_BINDING_TABLE_STAGE_RAYGEN) {
+            record = data;
+        } else if (entries[i].stage == SHADER_BINDING_TABLE_STAGE_HIT) {
+            record = data + hitOffset;
+            hitOffset += hit.stride;
+        } else {
+            record = data + missOffset;
+            missOffset += miss.stride;
+        }
+
+        memcpy(record, handles + i * handleSize, handleSize);
+
+        if (entries[i].recordDataSize > 0) {
+            memcpy(record + handleSize, entries[i].recordData, entries[i].recordDataSize);
+        }
+    }
+
+    delete[] handles;
+}
+
+PresentTimer::PresentTimer(VkDevice device) : device(device) {
+    thread = std::thread(&PresentTimer::run, this);
+}
+
+PresentTimer::~PresentTimer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+
+    condition.notify_all();
+    thread.join();
+}
+
+void PresentTimer::queue(VkSwapchainKHR swapchain, uint64_t presentId, std::chrono::steady_clock::time_point frameStartTime) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    // Presents that are still pending once the history is full are no longer measured.
+    if (queuedPresents.size() == PRESENT_LATENCY_HISTORY) {
+        queuedPresents.pop_front();
+    }
+
+    queuedPresents.push_back({ swapchain, presentId, frameStartTime });
+    condition.notify_all();
+}
+
+void PresentTimer::waitForPresents(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait_for(lock, timeout, [this]() { return queuedPresents.empty(); });
+}
+
+void PresentTimer::reset() {
+    std::unique_lock<std::mutex> lock(mutex);
+    queuedPresents.clear();
+    condition.wait(lock, [this]() { return !waiting; });
+}
+
+float PresentTimer::getLatency() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return latency;
+}
+
+void PresentTimer::run() {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        condition.wait(lock, [this]() { return stopping || !queuedPresents.empty(); });
+
+        if (stopping) {
+            break;
+        }
+
+        const QueuedPresent present = queuedPresents.front();
+        waiting = true;
+        lock.unlock();
+
+        // The timeout lets the thread be stopped or reset while a minimized window's presents never complete.
+        const VkResult result = vkWaitForPresent(device, present.swapchain, present.presentId, 100000000);
+        const auto completionTime = std::chrono::steady_clock::now();
+
+        lock.lock();
+        waiting = false;
+        condition.notify_all();
+
+        // Timed out presents are waited for again, unless they were dropped meanwhile.
+        if (result == VK_TIMEOUT || queuedPresents.empty() || queuedPresents.front().presentId != present.presentId) {
+            continue;
+        }
+
+        queuedPresents.pop_front();
+
+        if (result == VK_SUCCESS || result == VK_SUBOPTIMAL_KHR) {
+            const std::chrono::duration<float, std::milli> presentLatency = completionTime - present.frameStartTime;
+            latency = latency == 0.0f ? presentLatency.count() : 0.9f * latency + 0.1f * presentLatency.count();
+        }
+
+        // Wake up the pacing once every queued present is done.
+        condition.notify_all();
+    }
+}
+
 Renderer::Renderer(Device& device, const RendererCreateInfo& createInfo) : framesInFlight(createInfo.framesInFlight) {
-    createSwapchain(device.logical, createInfo, VK_NULL_HANDLE);
+    headless = createInfo.surface == VK_NULL_HANDLE;
+    presentWaitSupported = device.presentWaitSupported;
+    swapchain = VK_NULL_HANDLE;
+    swapchainImageCount = 0;
+
+    if (!headless) {
+        createSwapchain(device, createInfo, VK_NULL_HANDLE);
+    }
+
+    // The renderer is copied, the timer lives on the heap so its thread keeps a stable address.
+    if (!headless && presentWaitSupported) {
+        presentTimer = new PresentTimer(device.logical);
+    }
 
     // Create the command pools.
     VkCommandPoolCreateInfo commandPoolCreateInfo = {
@@ -684,31 +1315,58 @@ Renderer::Renderer(Device& device, const RendererCreateInfo& createInfo) : frame
 
     vkCreateCommandPool(device.logical, &commandPoolCreateInfo, nullptr, &transientCommandPool);
 
-    // Create the descriptor set layout.
-    VkDescriptorSetLayoutBinding descriptorSetLayoutBinding = {
-        .binding            = 0,
-        .descriptorType     = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
-        .descriptorCount    = 1,
-        .stageFlags         = VK_SHADER_STAGE_RAYGEN_BIT_KHR,
-        .pImmutableSamplers = nullptr
+    // Create the timeline semaphore, every submission signals the number of frames rendered so far.
+    VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo = {
+        .sType         = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+        .pNext         = nullptr,
+        .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+        .initialValue  = 0
+    };
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+        .pNext = &semaphoreTypeCreateInfo,
+        .flags = 0
+    };
+
+    vkCreateSemaphore(device.logical, &semaphoreCreateInfo, nullptr, &timelineSemaphore);
+
+    // Create the descriptor set layout. Binding 1 is the texture feedback buffer, binding 2 the texture table, binding 3
+    // the frame constants and binding 4 the accumulation image.
+    const VkShaderStageFlags textureStageFlags = VK_SHADER_STAGE_CLOSEST_HIT_BIT_KHR | VK_SHADER_STAGE_ANY_HIT_BIT_KHR | VK_SHADER_STAGE_MISS_BIT_KHR;
+
+    VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR, nullptr },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, textureStageFlags, nullptr },
+        { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, textureStageFlags, nullptr },
+        { 3, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR | textureStageFlags, nullptr },
+        { 4, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_RAYGEN_BIT_KHR, nullptr }
     };
 
     VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
         .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
         .pNext        = nullptr,
         .flags        = 0,
-        .bindingCount = 1,
-        .pBindings    = &descriptorSetLayoutBinding
+        .bindingCount = ARRAY_SIZE(descriptorSetLayoutBindings),
+        .pBindings    = descriptorSetLayoutBindings
     };
 
     vkCreateDescriptorSetLayout(device.logical, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout);
 
-    // Get the swapchain image count.
-    vkGetSwapchainImagesKHR(device.logical, swapchain, &swapchainImageCount, nullptr);
+    // Create the post processor.
+    postProcessor = PostProcessor(device.logical, createInfo.bindlessDescriptorSetLayout);
+
+    // Get the swapchain image count, headless renderers have no swapchain images.
+    if (!headless) {
+        vkGetSwapchainImagesKHR(device.logical, swapchain, &swapchainImageCount, nullptr);
+    }
 
     allocateSwapchainResourcesMemory();
-    createSwapchainResources(device.logical, createInfo);
-    createFrameResources(device.logical);
+
+    if (!headless) {
+        createSwapchainResources(device.logical, createInfo);
+    }
+    createFrameResources(device);
     allocateOffscreenResourcesMemory();
     createOffscreenResources(device, createInfo);
 }
@@ -720,14 +1378,32 @@ void Renderer::destroy(VkDevice device) {
     destroySwapchainResources(device);
     freeSwapchainResourcesMemory();
 
+    postProcessor.destroy(device);
+
     vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    vkDestroySemaphore(device, timelineSemaphore, nullptr);
     vkDestroyCommandPool(device, transientCommandPool, nullptr);
     vkDestroyCommandPool(device, normalCommandPool, nullptr);
-    vkDestroySwapchainKHR(device, swapchain, nullptr);
+
+    // Stops waiting for presents before the swapchain goes.
+    delete presentTimer;
+    presentTimer = nullptr;
+
+    if (!headless) {
+        vkDestroySwapchainKHR(device, swapchain, nullptr);
+    }
 }
 
 void Renderer::recordCommandBuffers(VkDevice device, VkPipelineLayout pipelineLayout,
-        VkPipeline rayTracingPipeline, const ShaderBindingTable& sbt, VkExtent2D extent) {
+        VkPipeline rayTracingPipeline, const ShaderBindingTable& sbt, VkDescriptorSet bindlessDescriptorSet) {
+    const VkDeviceAddress traceRaysCommandsAddress = traceRaysCommandsBuffer.getDeviceAddress(device);
+
+    // The post-processing passes are recorded every frame, they bind the same bindless tables.
+    this->bindlessDescriptorSet = bindlessDescriptorSet;
+
+    // Only hit and miss shaders sample textures, without them there's no feedback to reset or read back.
+    textureFeedback = sbt.hit.size > 0 || sbt.miss.size > 0;
+
     vkResetCommandPool(device, normalCommandPool, 0);
 
     for (uint32_t i = 0; i < framesInFlight; ++i) {
@@ -740,6 +1416,30 @@ void Renderer::recordCommandBuffers(VkDevice device, VkPipelineLayout pipelineLa
 
         vkBeginCommandBuffer(normalCommandBuffers[i], &commandBufferBeginInfo);
 
+        profiler.reset(normalCommandBuffers[i], i);
+
+        // Reset the texture feedback, the shaders lower each entry to the finest mip they sampled.
+        const VkDeviceSize feedbackOffset = i * 2 * TEXTURE_TABLE_CAPACITY * sizeof(uint32_t);
+        const VkDeviceSize feedbackSize = TEXTURE_TABLE_CAPACITY * sizeof(uint32_t);
+
+        if (textureFeedback) {
+            vkCmdFillBuffer(normalCommandBuffers[i], streamingBuffer, feedbackOffset, feedbackSize, UINT32_MAX);
+        }
+
+        VkBufferMemoryBarrier2 bufferMemoryBarrier = {
+            .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+            .pNext               = nullptr,
+            .srcStageMask        = VK_PIPELINE_STAGE_2_CLEAR_BIT,
+            .srcAccessMask       = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+            .dstStageMask        = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+            .dstAccessMask       = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .buffer              = streamingBuffer,
+            .offset              = feedbackOffset,
+            .size                = feedbackSize
+        };
+
         VkImageMemoryBarrier2 imageMemoryBarrier = {
             .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
             .pNext               = nullptr,
@@ -755,33 +1455,59 @@ void Renderer::recordCommandBuffers(VkDevice device, VkPipelineLayout pipelineLa
             .subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
         };
 
+        // The accumulation image is written by the previous frame's trace, whichever command buffer that was.
+        VkMemoryBarrier2 memoryBarrier = {
+            .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+            .pNext         = nullptr,
+            .srcStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+            .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+            .dstStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+            .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+        };
+
         VkDependencyInfo dependencyInfo = {
             .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
             .pNext                    = nullptr,
             .dependencyFlags          = 0,
-            .memoryBarrierCount       = 0,
-            .pMemoryBarriers          = nullptr,
-            .bufferMemoryBarrierCount = 0,
-            .pBufferMemoryBarriers    = nullptr,
+            .memoryBarrierCount       = 1,
+            .pMemoryBarriers          = &memoryBarrier,
+            .bufferMemoryBarrierCount = textureFeedback ? 1u : 0u,
+            .pBufferMemoryBarriers    = &bufferMemoryBarrier,
             .imageMemoryBarrierCount  = 1,
             .pImageMemoryBarriers     = &imageMemoryBarrier
         };
 
         vkCmdPipelineBarrier2(normalCommandBuffers[i], &dependencyInfo);
 
-        vkCmdBindDescriptorSets(normalCommandBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipelineLayout, 0, 1, &descriptorSets[i], 0, nullptr);
+        VkDescriptorSet boundDescriptorSets[] = { descriptorSets[i], bindlessDescriptorSet };
+
+        vkCmdBindDescriptorSets(normalCommandBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, pipelineLayout, 0, ARRAY_SIZE(boundDescriptorSets), boundDescriptorSets, 0, nullptr);
         vkCmdBindPipeline(normalCommandBuffers[i], VK_PIPELINE_BIND_POINT_RAY_TRACING_KHR, rayTracingPipeline);
 
         VkStridedDeviceAddressRegionKHR callable = {};
 
-        vkCmdTraceRays(normalCommandBuffers[i], &sbt.raygen, &sbt.miss, &sbt.hit, &callable, extent.width, extent.height, 1);
+        // The trace resolution is read from a host-visible buffer so that it can change without re-recording.
+        VkDeviceAddress traceRaysCommandAddress = traceRaysCommandsAddress + i * sizeof(VkTraceRaysIndirectCommandKHR);
+
+        profiler.begin(normalCommandBuffers[i], i, PROFILER_SECTION_TRACE, VK_PIPELINE_STAGE_2_TOP_OF_PIPE_BIT);
+        vkCmdTraceRaysIndirect(normalCommandBuffers[i], &sbt.raygen, &sbt.miss, &sbt.hit, &callable, traceRaysCommandAddress);
+        profiler.end(normalCommandBuffers[i], i, PROFILER_SECTION_TRACE, VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR);
 
         imageMemoryBarrier.srcStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
         imageMemoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
-        imageMemoryBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_BLIT_BIT;
-        imageMemoryBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+        imageMemoryBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        imageMemoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
         imageMemoryBarrier.oldLayout     = VK_IMAGE_LAYOUT_GENERAL;
-        imageMemoryBarrier.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        imageMemoryBarrier.newLayout     = VK_IMAGE_LAYOUT_GENERAL;
+
+        // Make the texture feedback visible to the host once the frame's fence is signaled.
+        bufferMemoryBarrier.srcStageMask  = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR;
+        bufferMemoryBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+        bufferMemoryBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_HOST_BIT;
+        bufferMemoryBarrier.dstAccessMask = VK_ACCESS_2_HOST_READ_BIT;
+
+        dependencyInfo.memoryBarrierCount = 0;
+        dependencyInfo.pMemoryBarriers    = nullptr;
 
         vkCmdPipelineBarrier2(normalCommandBuffers[i], &dependencyInfo);
 
@@ -789,9 +1515,25 @@ void Renderer::recordCommandBuffers(VkDevice device, VkPipelineLayout pipelineLa
     }
 }
 
-bool Renderer::render(Device& device, VkRenderPass renderPass, VkExtent2D extent) {
+void Renderer::beginFrame() {
+    // Pacing waits for every present up to the last frame's. The timeout keeps a minimized window, whose presents never
+    // complete, from hanging the editor.
+    if (presentTimer != nullptr && lowLatencyPacing) {
+        presentTimer->waitForPresents(std::chrono::milliseconds(100));
+    }
+
+    frameStartTime = std::chrono::steady_clock::now();
+}
+
+bool Renderer::render(Device& device, VkRenderPass renderPass, VkExtent2D extent, FrameCapture& frameCapture) {
     vkWaitForFences(device.logical, 1, &fences[frameIndex], VK_TRUE, UINT64_MAX);
 
+    // Adjust the trace resolution based on how long the GPU took the last time this frame was rendered.
+    profiler.collect(device.logical, frameIndex);
+    dynamicResolution.update(profiler.getTotalTime());
+
+    VkExtent2D traceExtent = dynamicResolution.getExtent(extent);
+
     uint32_t imageIndex;
 
     if (vkAcquireNextImageKHR(device.logical, swapchain, UINT64_MAX, imageAvailableSemaphores[frameIndex], VK_NULL_HANDLE, &imageIndex) ==
@@ -801,6 +1543,24 @@ bool Renderer::render(Device& device, VkRenderPass renderPass, VkExtent2D extent
 
     vkResetFences(device.logical, 1, &fences[frameIndex]);
 
+    traceRaysCommands[frameIndex] = {
+        .width  = traceExtent.width,
+        .height = traceExtent.height,
+        .depth  = 1
+    };
+
+    *(FrameConstants*)(frameConstantsData + frameIndex * frameConstantsStride) = {
+        .frameNumber             = (uint32_t)frameNumber,
+        .sobolBufferIndex        = sobolBufferIndex,
+        .blueNoiseImageIndex     = blueNoiseImageIndex,
+        .sampleIndex             = 0,
+        .sampleCount             = 1,
+        .firstSample             = 0,
+        .tileOffset              = { 0, 0 },
+        .imageExtent             = { traceExtent.width, traceExtent.height },
+        .environmentTableAddress = environmentTableAddress
+    };
+
     VkCommandBufferBeginInfo commandBufferBeginInfo = {
         .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
         .pNext            = nullptr,
@@ -810,57 +1570,14 @@ bool Renderer::render(Device& device, VkRenderPass renderPass, VkExtent2D extent
 
     vkBeginCommandBuffer(transientCommandBuffers[frameIndex], &commandBufferBeginInfo);
 
-    VkImageMemoryBarrier2 imageMemoryBarrier = {
-        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-        .pNext               = nullptr,
-        .srcStageMask        = VK_PIPELINE_STAGE_2_BLIT_BIT,
-        .srcAccessMask       = VK_ACCESS_2_NONE,
-        .dstStageMask        = VK_PIPELINE_STAGE_2_BLIT_BIT,
-        .dstAccessMask       = VK_ACCESS_2_TRANSFER_WRITE_BIT,
-        .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
-        .newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image               = swapchainImages[imageIndex],
-        .subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
-    };
+    postProcessor.record(transientCommandBuffers[frameIndex], profiler, frameIndex, imageIndex, swapchainImages[imageIndex], traceExtent, extent,
+                         bindlessDescriptorSet, (uint32_t)frameNumber, blueNoiseImageIndex);
 
-    VkDependencyInfo dependencyInfo = {
-        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
-        .pNext                    = nullptr,
-        .dependencyFlags          = 0,
-        .memoryBarrierCount       = 0,
-        .pMemoryBarriers          = nullptr,
-        .bufferMemoryBarrierCount = 0,
-        .pBufferMemoryBarriers    = nullptr,
-        .imageMemoryBarrierCount  = 1,
-        .pImageMemoryBarriers     = &imageMemoryBarrier
-    };
+    // Captures read the trace, before the exposure and tonemapping, so they can be graded offline.
+    float exposureScale = postProcessor.exposureEnabled ? exp2f(postProcessor.exposure) : 1.0f;
+    frameCapture.record(device, transientCommandBuffers[frameIndex], offscreenImages[frameIndex], traceExtent, frameNumber, exposureScale);
 
-    vkCmdPipelineBarrier2(transientCommandBuffers[frameIndex], &dependencyInfo);
-
-    VkImageBlit2 imageBlit = {
-        .sType          = VK_STRUCTURE_TYPE_IMAGE_BLIT_2,
-        .pNext          = nullptr,
-        .srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
-        .srcOffsets     = { { 0, 0, 0 }, { (int32_t)extent.width, (int32_t)extent.height, 1 } },
-        .dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
-        .dstOffsets     = { { 0, (int32_t)extent.height, 0 }, { (int32_t)extent.width, 0, 1 } }
-    };
-
-    VkBlitImageInfo2 blitImageInfo = {
-        .sType          = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2,
-        .pNext          = nullptr,
-        .srcImage       = offscreenImages[frameIndex],
-        .srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        .dstImage       = swapchainImages[imageIndex],
-        .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        .regionCount    = 1,
-        .pRegions       = &imageBlit,
-        .filter         = VK_FILTER_NEAREST
-    };
-
-    vkCmdBlitImage2(transientCommandBuffers[frameIndex], &blitImageInfo);
+    profiler.begin(transientCommandBuffers[frameIndex], frameIndex, PROFILER_SECTION_GUI, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
 
     VkClearValue clearValue = {
         0.0f, 0.0f, 0.0f, 1.0f
@@ -883,6 +1600,8 @@ bool Renderer::render(Device& device, VkRenderPass renderPass, VkExtent2D extent
 
     vkCmdEndRenderPass(transientCommandBuffers[frameIndex]);
 
+    profiler.end(transientCommandBuffers[frameIndex], frameIndex, PROFILER_SECTION_GUI, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT);
+
     vkEndCommandBuffer(transientCommandBuffers[frameIndex]);
 
     VkSemaphoreSubmitInfo waitSemaphoreInfo = {
@@ -890,17 +1609,27 @@ bool Renderer::render(Device& device, VkRenderPass renderPass, VkExtent2D extent
         .pNext       = nullptr,
         .semaphore   = imageAvailableSemaphores[frameIndex],
         .value       = 0,
-        .stageMask   = VK_PIPELINE_STAGE_2_BLIT_BIT,
+        .stageMask   = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT,
         .deviceIndex = 0
     };
 
-    VkSemaphoreSubmitInfo signalSemaphoreInfo = {
-        .sType       = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
-        .pNext       = nullptr,
-        .semaphore   = renderFinishedSemaphores[frameIndex],
-        .value       = 0,
-        .stageMask   = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
-        .deviceIndex = 0
+    VkSemaphoreSubmitInfo signalSemaphoreInfos[] = {
+        {
+            .sType       = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .pNext       = nullptr,
+            .semaphore   = renderFinishedSemaphores[frameIndex],
+            .value       = 0,
+            .stageMask   = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+            .deviceIndex = 0
+        },
+        {
+            .sType       = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+            .pNext       = nullptr,
+            .semaphore   = timelineSemaphore,
+            .value       = frameNumber + 1,
+            .stageMask   = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+            .deviceIndex = 0
+        }
     };
 
     VkCommandBufferSubmitInfo normalCommandBufferInfo = {
@@ -936,14 +1665,24 @@ bool Renderer::render(Device& device, VkRenderPass renderPass, VkExtent2D extent
     submitInfos[1].pWaitSemaphoreInfos      = &waitSemaphoreInfo;
     submitInfos[1].commandBufferInfoCount   = 1;
     submitInfos[1].pCommandBufferInfos      = &transientCommandBufferInfo;
-    submitInfos[1].signalSemaphoreInfoCount = 1;
-    submitInfos[1].pSignalSemaphoreInfos    = &signalSemaphoreInfo;
+    submitInfos[1].signalSemaphoreInfoCount = ARRAY_SIZE(signalSemaphoreInfos);
+    submitInfos[1].pSignalSemaphoreInfos    = signalSemaphoreInfos;
 
     vkQueueSubmit2(device.renderQueue, ARRAY_SIZE(submitInfos), submitInfos, fences[frameIndex]);
 
+    // Presents are identified by the number of their frame plus one, 0 isn't a valid ID.
+    const uint64_t presentId = frameNumber + 1;
+
+    VkPresentIdKHR presentIdInfo = {
+        .sType          = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+        .pNext          = nullptr,
+        .swapchainCount = 1,
+        .pPresentIds    = &presentId
+    };
+
     VkPresentInfoKHR presentInfo = {
         .sType              = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-        .pNext              = nullptr,
+        .pNext              = presentWaitSupported ? &presentIdInfo : nullptr,
         .waitSemaphoreCount = 1,
         .pWaitSemaphores    = &renderFinishedSemaphores[frameIndex],
         .swapchainCount     = 1,
@@ -954,11 +1693,150 @@ bool Renderer::render(Device& device, VkRenderPass renderPass, VkExtent2D extent
 
     vkQueuePresentKHR(device.renderQueue, &presentInfo);
 
+    if (presentTimer != nullptr) {
+        presentTimer->queue(swapchain, presentId, frameStartTime);
+    }
+
     frameIndex = (frameIndex + 1) % framesInFlight;
+    ++frameNumber;
 
     return true;
 }
 
+void Renderer::renderHeadless(Device& device, const HeadlessFrameInfo& frameInfo, FrameCapture& frameCapture) {
+    vkWaitForFences(device.logical, 1, &fences[frameIndex], VK_TRUE, UINT64_MAX);
+    vkResetFences(device.logical, 1, &fences[frameIndex]);
+
+    profiler.collect(device.logical, frameIndex);
+
+    traceRaysCommands[frameIndex] = {
+        .width  = frameInfo.tileExtent.width,
+        .height = frameInfo.tileExtent.height,
+        .depth  = 1
+    };
+
+    *(FrameConstants*)(frameConstantsData + frameIndex * frameConstantsStride) = {
+        .frameNumber             = (uint32_t)frameNumber,
+        .sobolBufferIndex        = sobolBufferIndex,
+        .blueNoiseImageIndex     = blueNoiseImageIndex,
+        .sampleIndex             = frameInfo.sampleIndex,
+        .sampleCount             = frameInfo.sampleCount,
+        .firstSample             = frameInfo.firstSample,
+        .tileOffset              = { (uint32_t)frameInfo.tileOffset.x, (uint32_t)frameInfo.tileOffset.y },
+        .imageExtent             = { frameInfo.imageExtent.width, frameInfo.imageExtent.height },
+        .environmentTableAddress = environmentTableAddress
+    };
+
+    // The trace is all there is, the transient command buffer only holds the capture's copy.
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr
+    };
+
+    vkBeginCommandBuffer(transientCommandBuffers[frameIndex], &commandBufferBeginInfo);
+    frameCapture.record(device, transientCommandBuffers[frameIndex], offscreenImages[frameIndex], frameInfo.tileExtent, frameNumber, 1.0f);
+    vkEndCommandBuffer(transientCommandBuffers[frameIndex]);
+
+    VkSemaphoreSubmitInfo signalSemaphoreInfo = {
+        .sType       = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO,
+        .pNext       = nullptr,
+        .semaphore   = timelineSemaphore,
+        .value       = frameNumber + 1,
+        .stageMask   = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .deviceIndex = 0
+    };
+
+    VkCommandBufferSubmitInfo commandBufferInfos[] = {
+        {
+            .sType         = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+            .pNext         = nullptr,
+            .commandBuffer = normalCommandBuffers[frameIndex],
+            .deviceMask    = 0
+        },
+        {
+            .sType         = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+            .pNext         = nullptr,
+            .commandBuffer = transientCommandBuffers[frameIndex],
+            .deviceMask    = 0
+        }
+    };
+
+    VkSubmitInfo2 submitInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .pNext                    = nullptr,
+        .flags                    = 0,
+        .waitSemaphoreInfoCount   = 0,
+        .pWaitSemaphoreInfos      = nullptr,
+        .commandBufferInfoCount   = ARRAY_SIZE(commandBufferInfos),
+        .pCommandBufferInfos      = commandBufferInfos,
+        .signalSemaphoreInfoCount = 1,
+        .pSignalSemaphoreInfos    = &signalSemaphoreInfo
+    };
+
+    vkQueueSubmit2(device.renderQueue, 1, &submitInfo, fences[frameIndex]);
+
+    frameIndex = (frameIndex + 1) % framesInFlight;
+    ++frameNumber;
+}
+
+uint64_t Renderer::getCompletedFrameCount(VkDevice device) {
+    uint64_t completedFrameCount;
+    vkGetSemaphoreCounterValue(device, timelineSemaphore, &completedFrameCount);
+
+    return completedFrameCount;
+}
+
+uint32_t Renderer::getFrameIndex() {
+    return frameIndex;
+}
+
+uint64_t Renderer::getFrameNumber() {
+    return frameNumber;
+}
+
+uint32_t Renderer::getFramesInFlight() {
+    return framesInFlight;
+}
+
+VkPresentModeKHR Renderer::getPresentMode() {
+    return presentMode;
+}
+
+bool Renderer::supportsPresentWait() {
+    return presentWaitSupported;
+}
+
+float Renderer::getPresentLatency() {
+    return presentTimer != nullptr ? presentTimer->getLatency() : 0.0f;
+}
+
+void Renderer::waitForFrame(VkDevice device) {
+    vkWaitForFences(device, 1, &fences[frameIndex], VK_TRUE, UINT64_MAX);
+}
+
+const uint32_t* Renderer::getTextureFeedback() {
+    return streamingData + frameIndex * 2 * TEXTURE_TABLE_CAPACITY;
+}
+
+bool Renderer::hasTextureFeedback() {
+    return textureFeedback;
+}
+
+uint32_t* Renderer::getTextureTable() {
+    return streamingData + frameIndex * 2 * TEXTURE_TABLE_CAPACITY + TEXTURE_TABLE_CAPACITY;
+}
+
+void Renderer::setSamplingTables(uint32_t sobolBufferIndex, uint32_t blueNoiseImageIndex) {
+    this->sobolBufferIndex = sobolBufferIndex;
+    this->blueNoiseImageIndex = blueNoiseImageIndex;
+}
+
+void Renderer::setEnvironmentTable(VkDeviceAddress tableAddress) {
+    environmentTableAddress = tableAddress;
+}
+
 void Renderer::waitIdle(VkDevice device) {
     vkWaitForFences(device, framesInFlight, fences, VK_TRUE, UINT64_MAX);
 }
@@ -971,9 +1849,13 @@ void Renderer::resize(Device& device, const RendererCreateInfo& createInfo) {
     VkSwapchainKHR oldSwapchain = swapchain;
 
     // Create the new swapchain.
-    createSwapchain(device.logical, createInfo, oldSwapchain);
+    createSwapchain(device, createInfo, oldSwapchain);
+
+    // Destroy the old swapchain. Its presents can't be waited for anymore.
+    if (presentTimer != nullptr) {
+        presentTimer->reset();
+    }
 
-    // Destroy the old swapchain.
     vkDestroySwapchainKHR(device.logical, oldSwapchain, nullptr);
 
     // Reallocate the host memory only if the number of swapchain images has changed.
@@ -1000,15 +1882,32 @@ void Renderer::setFramesInFlight(Device& device, const RendererCreateInfo& creat
     framesInFlight = createInfo.framesInFlight;
     frameIndex = 0;
 
-    createFrameResources(device.logical);
+    createFrameResources(device);
     allocateOffscreenResourcesMemory();
     createOffscreenResources(device, createInfo);
 }
 
-void Renderer::createSwapchain(VkDevice device, const RendererCreateInfo& createInfo, VkSwapchainKHR oldSwapchain) {
+void Renderer::createSwapchain(Device& device, const RendererCreateInfo& createInfo, VkSwapchainKHR oldSwapchain) {
     const VkSurfaceCapabilitiesKHR* surfaceCapabilities = createInfo.surfaceCapabilities;
     VkSurfaceFormatKHR surfaceFormat = createInfo.surfaceFormat;
 
+    // Post-processing writes the swapchain images directly when they can be storage images.
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(device.physical, surfaceFormat.format, &formatProperties);
+
+    swapchainFormat = surfaceFormat.format;
+    storageSwapchain = (surfaceCapabilities->supportedUsageFlags & VK_IMAGE_USAGE_STORAGE_BIT) != 0 &&
+                       (formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT) != 0;
+
+    VkImageUsageFlags imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+
+    if (storageSwapchain) {
+        imageUsage |= VK_IMAGE_USAGE_STORAGE_BIT;
+    }
+
+    // FIFO is the only mode every surface supports.
+    presentMode = device.supportsPresentMode(createInfo.surface, createInfo.presentMode) ? createInfo.presentMode : VK_PRESENT_MODE_FIFO_KHR;
+
     VkSwapchainCreateInfoKHR swapchainCreateInfo = {
         .sType                 = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
         .pNext                 = nullptr,
@@ -1019,18 +1918,18 @@ void Renderer::createSwapchain(VkDevice device, const RendererCreateInfo& create
         .imageColorSpace       = surfaceFormat.colorSpace,
         .imageExtent           = surfaceCapabilities->currentExtent,
         .imageArrayLayers      = 1,
-        .imageUsage            = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+        .imageUsage            = imageUsage,
         .imageSharingMode      = VK_SHARING_MODE_EXCLUSIVE,
         .queueFamilyIndexCount = 0,
         .pQueueFamilyIndices   = nullptr,
         .preTransform          = surfaceCapabilities->currentTransform,
         .compositeAlpha        = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-        .presentMode           = VK_PRESENT_MODE_FIFO_KHR, // TODO
+        .presentMode           = presentMode,
         .clipped               = VK_TRUE,
         .oldSwapchain          = oldSwapchain
     };
 
-    vkCreateSwapchainKHR(device, &swapchainCreateInfo, nullptr, &swapchain);
+    vkCreateSwapchainKHR(device.logical, &swapchainCreateInfo, nullptr, &swapchain);
 }
 
 void Renderer::allocateSwapchainResourcesMemory() {
@@ -1077,10 +1976,12 @@ void Renderer::createSwapchainResources(VkDevice device, const RendererCreateInf
     }
 }
 
-void Renderer::createFrameResources(VkDevice device) {
+void Renderer::createFrameResources(Device& device) {
     // Create the descriptor pool.
     VkDescriptorPoolSize descriptorPoolSizes[] = {
-        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, framesInFlight }
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2 * framesInFlight },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 * framesInFlight },
+        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, framesInFlight }
     };
 
     VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
@@ -1092,7 +1993,7 @@ void Renderer::createFrameResources(VkDevice device) {
         .pPoolSizes    = descriptorPoolSizes
     };
 
-    vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &descriptorPool);
+    vkCreateDescriptorPool(device.logical, &descriptorPoolCreateInfo, nullptr, &descriptorPool);
 
     // Allocate the descriptor sets.
     descriptorSets = new VkDescriptorSet[framesInFlight];
@@ -1111,7 +2012,7 @@ void Renderer::createFrameResources(VkDevice device) {
         .pSetLayouts        = descriptorSetLayouts
     };
 
-    vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, descriptorSets);
+    vkAllocateDescriptorSets(device.logical, &descriptorSetAllocateInfo, descriptorSets);
 
     delete[] descriptorSetLayouts;
 
@@ -1127,11 +2028,11 @@ void Renderer::createFrameResources(VkDevice device) {
         .commandBufferCount = framesInFlight
     };
 
-    vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, normalCommandBuffers);
+    vkAllocateCommandBuffers(device.logical, &commandBufferAllocateInfo, normalCommandBuffers);
 
     commandBufferAllocateInfo.commandPool = transientCommandPool;
 
-    vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, transientCommandBuffers);
+    vkAllocateCommandBuffers(device.logical, &commandBufferAllocateInfo, transientCommandBuffers);
 
     // Create the semaphores and fences.
     imageAvailableSemaphores = new VkSemaphore[framesInFlight];
@@ -1145,8 +2046,8 @@ void Renderer::createFrameResources(VkDevice device) {
             .flags = 0
         };
 
-        vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &imageAvailableSemaphores[i]);
-        vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &renderFinishedSemaphores[i]);
+        vkCreateSemaphore(device.logical, &semaphoreCreateInfo, nullptr, &imageAvailableSemaphores[i]);
+        vkCreateSemaphore(device.logical, &semaphoreCreateInfo, nullptr, &renderFinishedSemaphores[i]);
 
         VkFenceCreateInfo fenceCreateInfo = {
             .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
@@ -1154,7 +2055,90 @@ void Renderer::createFrameResources(VkDevice device) {
             .flags = VK_FENCE_CREATE_SIGNALED_BIT
         };
 
-        vkCreateFence(device, &fenceCreateInfo, nullptr, &fences[i]);
+        vkCreateFence(device.logical, &fenceCreateInfo, nullptr, &fences[i]);
+    }
+
+    // Create the profiler.
+    profiler = Profiler(device.logical, device.properties.limits.timestampPeriod, framesInFlight);
+
+    // Create the trace rays commands buffer.
+    traceRaysCommandsBuffer = Buffer(device, framesInFlight * sizeof(VkTraceRaysIndirectCommandKHR),
+                                     VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    vkMapMemory(device.logical, traceRaysCommandsBuffer.memory, 0, VK_WHOLE_SIZE, 0, (void**)&traceRaysCommands);
+
+    // Create the streaming buffer, each frame gets the texture feedback followed by the texture table.
+    const VkDeviceSize streamingSliceSize = 2 * TEXTURE_TABLE_CAPACITY * sizeof(uint32_t);
+
+    streamingBuffer = Buffer(device, framesInFlight * streamingSliceSize,
+                             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                             VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    vkMapMemory(device.logical, streamingBuffer.memory, 0, VK_WHOLE_SIZE, 0, (void**)&streamingData);
+
+    // Start with every texture unsampled and pointing at the default texture.
+    for (uint32_t i = 0; i < framesInFlight * 2 * TEXTURE_TABLE_CAPACITY; ++i) {
+        streamingData[i] = i % (2 * TEXTURE_TABLE_CAPACITY) < TEXTURE_TABLE_CAPACITY ? UINT32_MAX : 0;
+    }
+
+    // Point the descriptor sets at their slices of the streaming buffer.
+    VkDescriptorBufferInfo* descriptorBufferInfos = new VkDescriptorBufferInfo[2 * framesInFlight];
+    VkWriteDescriptorSet* writeDescriptorSets = new VkWriteDescriptorSet[2 * framesInFlight];
+
+    for (uint32_t i = 0; i < 2 * framesInFlight; ++i) {
+        descriptorBufferInfos[i].buffer = streamingBuffer;
+        descriptorBufferInfos[i].offset = i * TEXTURE_TABLE_CAPACITY * sizeof(uint32_t);
+        descriptorBufferInfos[i].range  = TEXTURE_TABLE_CAPACITY * sizeof(uint32_t);
+
+        writeDescriptorSets[i].sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writeDescriptorSets[i].pNext            = nullptr;
+        writeDescriptorSets[i].dstSet           = descriptorSets[i / 2];
+        writeDescriptorSets[i].dstBinding       = 1 + i % 2;
+        writeDescriptorSets[i].dstArrayElement  = 0;
+        writeDescriptorSets[i].descriptorCount  = 1;
+        writeDescriptorSets[i].descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writeDescriptorSets[i].pImageInfo       = nullptr;
+        writeDescriptorSets[i].pBufferInfo      = &descriptorBufferInfos[i];
+        writeDescriptorSets[i].pTexelBufferView = nullptr;
+    }
+
+    vkUpdateDescriptorSets(device.logical, 2 * framesInFlight, writeDescriptorSets, 0, nullptr);
+
+    delete[] writeDescriptorSets;
+    delete[] descriptorBufferInfos;
+
+    // Create the frame constants buffer, with a slice per frame at the alignment uniform buffers need.
+    const VkDeviceSize frameConstantsAlignment = device.properties.limits.minUniformBufferOffsetAlignment;
+    frameConstantsStride = (sizeof(FrameConstants) + frameConstantsAlignment - 1) & ~(frameConstantsAlignment - 1);
+
+    frameConstantsBuffer = Buffer(device, framesInFlight * frameConstantsStride,
+                                  VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    vkMapMemory(device.logical, frameConstantsBuffer.memory, 0, VK_WHOLE_SIZE, 0, (void**)&frameConstantsData);
+
+    for (uint32_t i = 0; i < framesInFlight; ++i) {
+        VkDescriptorBufferInfo descriptorBufferInfo = {
+            .buffer = frameConstantsBuffer,
+            .offset = i * frameConstantsStride,
+            .range  = sizeof(FrameConstants)
+        };
+
+        VkWriteDescriptorSet writeDescriptorSet = {
+            .sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .pNext            = nullptr,
+            .dstSet           = descriptorSets[i],
+            .dstBinding       = 3,
+            .dstArrayElement  = 0,
+            .descriptorCount  = 1,
+            .descriptorType   = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+            .pImageInfo       = nullptr,
+            .pBufferInfo      = &descriptorBufferInfo,
+            .pTexelBufferView = nullptr
+        };
+
+        vkUpdateDescriptorSets(device.logical, 1, &writeDescriptorSet, 0, nullptr);
     }
 }
 
@@ -1164,7 +2148,7 @@ void Renderer::allocateOffscreenResourcesMemory() {
 }
 
 void Renderer::createOffscreenResources(Device& device, const RendererCreateInfo& createInfo) {
-    // Create the off-screen images.
+    // Create the off-screen images, frame captures copy them to host memory.
     VkExtent2D extent = createInfo.surfaceCapabilities->currentExtent;
 
     for (uint32_t i = 0; i < framesInFlight; ++i) {
@@ -1173,7 +2157,7 @@ void Renderer::createOffscreenResources(Device& device, const RendererCreateInfo
             .pNext                 = nullptr,
             .flags                 = 0,
             .imageType             = VK_IMAGE_TYPE_2D,
-            .format                = VK_FORMAT_A2B10G10R10_UNORM_PACK32,
+            .format                = VK_FORMAT_R16G16B16A16_SFLOAT,
             .extent                = { extent.width, extent.height, 1 },
             .mipLevels             = 1,
             .arrayLayers           = 1,
@@ -1227,7 +2211,7 @@ void Renderer::createOffscreenResources(Device& device, const RendererCreateInfo
             .flags            = 0,
             .image            = offscreenImages[i],
             .viewType         = VK_IMAGE_VIEW_TYPE_2D,
-            .format           = VK_FORMAT_A2B10G10R10_UNORM_PACK32,
+            .format           = VK_FORMAT_R16G16B16A16_SFLOAT,
             .components       = { VK_COMPONENT_SWIZZLE_IDENTITY },
             .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
         };
@@ -1235,19 +2219,99 @@ void Renderer::createOffscreenResources(Device& device, const RendererCreateInfo
         vkCreateImageView(device.logical, &imageViewCreateInfo, nullptr, &offscreenImageViews[i]);
     }
 
+    // Create the accumulation image. It's shared by every frame, consecutive frames average into it when they trace
+    // several samples of the same image. Only headless frames do, the editor traces one sample per frame and never reads
+    // it, so it only gets a texel to keep the descriptor valid.
+    const VkExtent2D accumulationExtent = headless ? extent : VkExtent2D{ 1, 1 };
+
+    VkImageCreateInfo imageCreateInfo = {
+        .sType                 = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext                 = nullptr,
+        .flags                 = 0,
+        .imageType             = VK_IMAGE_TYPE_2D,
+        .format                = VK_FORMAT_R32G32B32A32_SFLOAT,
+        .extent                = { accumulationExtent.width, accumulationExtent.height, 1 },
+        .mipLevels             = 1,
+        .arrayLayers           = 1,
+        .samples               = VK_SAMPLE_COUNT_1_BIT,
+        .tiling                = VK_IMAGE_TILING_OPTIMAL,
+        .usage                 = VK_IMAGE_USAGE_STORAGE_BIT,
+        .sharingMode           = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices   = nullptr,
+        .initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+
+    vkCreateImage(device.logical, &imageCreateInfo, nullptr, &accumulationImage);
+
+    vkGetImageMemoryRequirements(device.logical, accumulationImage, &memoryRequirements);
+
+    memoryAllocateInfo.allocationSize  = memoryRequirements.size;
+    memoryAllocateInfo.memoryTypeIndex = device.getMemoryTypeIndex(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    vkAllocateMemory(device.logical, &memoryAllocateInfo, nullptr, &accumulationImageMemory);
+    vkBindImageMemory(device.logical, accumulationImage, accumulationImageMemory, 0);
+
+    VkImageViewCreateInfo imageViewCreateInfo = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext            = nullptr,
+        .flags            = 0,
+        .image            = accumulationImage,
+        .viewType         = VK_IMAGE_VIEW_TYPE_2D,
+        .format           = VK_FORMAT_R32G32B32A32_SFLOAT,
+        .components       = { VK_COMPONENT_SWIZZLE_IDENTITY },
+        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+    };
+
+    vkCreateImageView(device.logical, &imageViewCreateInfo, nullptr, &accumulationImageView);
+
+    // The frames keep its contents, so it's moved to the general layout once here.
+    ImmediateCommandBuffer commandBuffer(device);
+
+    VkImageMemoryBarrier2 imageMemoryBarrier = {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext               = nullptr,
+        .srcStageMask        = VK_PIPELINE_STAGE_2_NONE,
+        .srcAccessMask       = VK_ACCESS_2_NONE,
+        .dstStageMask        = VK_PIPELINE_STAGE_2_RAY_TRACING_SHADER_BIT_KHR,
+        .dstAccessMask       = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout           = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = accumulationImage,
+        .subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+    };
+
+    VkDependencyInfo dependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 0,
+        .pMemoryBarriers          = nullptr,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = 1,
+        .pImageMemoryBarriers     = &imageMemoryBarrier
+    };
+
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    commandBuffer.submit(device);
+
     // Update the descriptor sets.
-    VkDescriptorImageInfo* descriptorImageInfos = new VkDescriptorImageInfo[framesInFlight];
-    VkWriteDescriptorSet* writeDescriptorSets = new VkWriteDescriptorSet[framesInFlight];
+    VkDescriptorImageInfo* descriptorImageInfos = new VkDescriptorImageInfo[2 * framesInFlight];
+    VkWriteDescriptorSet* writeDescriptorSets = new VkWriteDescriptorSet[2 * framesInFlight];
 
-    for (uint32_t i = 0; i < framesInFlight; ++i) {
+    for (uint32_t i = 0; i < 2 * framesInFlight; ++i) {
         descriptorImageInfos[i].sampler     = VK_NULL_HANDLE;
-        descriptorImageInfos[i].imageView   = offscreenImageViews[i];
+        descriptorImageInfos[i].imageView   = i % 2 == 0 ? offscreenImageViews[i / 2] : accumulationImageView;
         descriptorImageInfos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
 
         writeDescriptorSets[i].sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         writeDescriptorSets[i].pNext            = nullptr;
-        writeDescriptorSets[i].dstSet           = descriptorSets[i];
-        writeDescriptorSets[i].dstBinding       = 0;
+        writeDescriptorSets[i].dstSet           = descriptorSets[i / 2];
+        writeDescriptorSets[i].dstBinding       = i % 2 == 0 ? 0 : 4;
         writeDescriptorSets[i].dstArrayElement  = 0;
         writeDescriptorSets[i].descriptorCount  = 1;
         writeDescriptorSets[i].descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
@@ -1256,10 +2320,19 @@ void Renderer::createOffscreenResources(Device& device, const RendererCreateInfo
         writeDescriptorSets[i].pTexelBufferView = nullptr;
     }
 
-    vkUpdateDescriptorSets(device.logical, framesInFlight, writeDescriptorSets, 0, nullptr);
+    vkUpdateDescriptorSets(device.logical, 2 * framesInFlight, writeDescriptorSets, 0, nullptr);
 
     delete[] writeDescriptorSets;
     delete[] descriptorImageInfos;
+
+    // Create the post-processing resources, which depend on both the off-screen images and the swapchain. Headless
+    // renderers only trace.
+    if (headless) {
+        return;
+    }
+
+    postProcessor.createResources(device, extent, framesInFlight, offscreenImageViews, swapchainImageCount, swapchainImageViews,
+                                  swapchainFormat, storageSwapchain);
 }
 
 void Renderer::freeSwapchainResourcesMemory() {
@@ -1276,6 +2349,11 @@ void Renderer::destroySwapchainResources(VkDevice device) {
 }
 
 void Renderer::destroyFrameResources(VkDevice device) {
+    frameConstantsBuffer.destroy(device);
+    streamingBuffer.destroy(device);
+    traceRaysCommandsBuffer.destroy(device);
+    profiler.destroy(device);
+
     for (uint32_t i = 0; i < framesInFlight; ++i) {
         vkDestroyFence(device, fences[i], nullptr);
         vkDestroySemaphore(device, renderFinishedSemaphores[i], nullptr);
@@ -1302,6 +2380,14 @@ void Renderer::freeOffscreenResourcesMemory() {
 }
 
 void Renderer::destroyOffscreenResources(VkDevice device) {
+    if (!headless) {
+        postProcessor.destroyResources(device);
+    }
+
+    vkDestroyImageView(device, accumulationImageView, nullptr);
+    vkFreeMemory(device, accumulationImageMemory, nullptr);
+    vkDestroyImage(device, accumulationImage, nullptr);
+
     for (uint32_t i = 0; i < framesInFlight; ++i) {
         vkDestroyImageView(device, offscreenImageViews[i], nullptr);
     }
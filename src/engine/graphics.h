@@ -3,11 +3,41 @@
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
 
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "profiler.h"
+#include "dynamic_resolution.h"
+#include "post_processing.h"
+
+class FrameCapture;
+
 #define ARRAY_SIZE(array) (sizeof(array) / sizeof(array[0]))
 
-inline PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandles;
+// The maximum number of streamed textures the shaders can see through the texture table and report in the feedback buffer.
+#define TEXTURE_TABLE_CAPACITY 4096
+
+// The number of presents whose latency can be pending at once, older ones are no longer measured.
+#define PRESENT_LATENCY_HISTORY 8
 
-VkInstance createInstance();
+inline PFN_vkGetRayTracingShaderGroupHandlesKHR vkGetRayTracingShaderGroupHandles;
+inline PFN_vkCreateAccelerationStructureKHR vkCreateAccelerationStructure;
+inline PFN_vkDestroyAccelerationStructureKHR vkDestroyAccelerationStructure;
+inline PFN_vkGetAccelerationStructureBuildSizesKHR vkGetAccelerationStructureBuildSizes;
+inline PFN_vkGetAccelerationStructureDeviceAddressKHR vkGetAccelerationStructureDeviceAddress;
+inline PFN_vkCmdBuildAccelerationStructuresKHR vkCmdBuildAccelerationStructures;
+inline PFN_vkCmdWriteAccelerationStructuresPropertiesKHR vkCmdWriteAccelerationStructuresProperties;
+inline PFN_vkCmdCopyAccelerationStructureKHR vkCmdCopyAccelerationStructure;
+inline PFN_vkCmdCopyAccelerationStructureToMemoryKHR vkCmdCopyAccelerationStructureToMemory;
+inline PFN_vkCmdCopyMemoryToAccelerationStructureKHR vkCmdCopyMemoryToAccelerationStructure;
+inline PFN_vkGetDeviceAccelerationStructureCompatibilityKHR vkGetDeviceAccelerationStructureCompatibility;
+inline PFN_vkWaitForPresentKHR vkWaitForPresent;
+
+// Headless instances enable no surface extensions, GLFW doesn't have to be initialized for them.
+VkInstance createInstance(bool headless);
 
 class Queue {
 public:
@@ -20,19 +50,40 @@ private:
     VkQueue queue;
 };
 
+// Devices missing an extension, feature or queue the renderer needs are rejected, the rest are ranked by score: the device
+// type first, then device-local memory, optional ray tracing extensions and dedicated compute and transfer queues. The
+// override, an index into the instance's devices or a device UUID in hex, is taken over the ranking if the device is
+// usable. Without one, the VORTEX_DEVICE environment variable stands in for it. Otherwise the device at rank is taken,
+// wrapping around so that any number of processes can be spread over the devices, best first.
+struct DeviceSelection {
+    const char* override = nullptr;
+    uint32_t rank = 0;
+};
+
 class Device {
 public:
     VkPhysicalDevice physical;
+    VkPhysicalDeviceProperties properties;
     VkPhysicalDeviceRayTracingPipelinePropertiesKHR rtProperties;
+    VkPhysicalDeviceAccelerationStructurePropertiesKHR asProperties;
+    VkPhysicalDeviceIDProperties idProperties;
+    bool memoryBudgetSupported;
+    bool snormBlasVerticesSupported;
+    bool presentWaitSupported;
     Queue renderQueue;
     VkDevice logical;
 
     Device() = default;
-    Device(VkInstance instance, VkSurfaceKHR surface);
+
+    // The surface is null for headless devices, which can't present. Why each physical device was rejected, and which one
+    // was selected, is written to stderr.
+    Device(VkInstance instance, VkSurfaceKHR surface, const DeviceSelection& selection = {});
     void destroy();
 
-    VkSurfaceCapabilitiesKHR getSurfaceCapabilities(VkSurfaceKHR surface, GLFWwindow* window);
+    // The image count is clamped to what the surface allows and returned as minImageCount.
+    VkSurfaceCapabilitiesKHR getSurfaceCapabilities(VkSurfaceKHR surface, GLFWwindow* window, uint32_t imageCount);
     VkSurfaceFormatKHR getSurfaceFormat(VkSurfaceKHR surface);
+    bool supportsPresentMode(VkSurfaceKHR surface, VkPresentModeKHR presentMode);
 
     uint32_t getMemoryTypeIndex(uint32_t memoryTypeBits, VkMemoryPropertyFlags memoryProperties);
 };
@@ -55,6 +106,20 @@ private:
     VkBuffer buffer;
 };
 
+// Records commands that are submitted and waited for right away, for one-off work like uploads and builds.
+class ImmediateCommandBuffer {
+public:
+    ImmediateCommandBuffer(Device& device);
+
+    void submit(Device& device);
+
+    operator VkCommandBuffer();
+
+private:
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+};
+
 VkRenderPass createRenderPass(VkDevice device, VkFormat format, bool clear);
 VkDescriptorPool createGuiDescriptorPool(VkDevice device);
 VkPipelineLayout createPipelineLayout(VkDevice device, uint32_t setLayoutCount, const VkDescriptorSetLayout* setLayouts);
@@ -65,15 +130,20 @@ enum ShaderBindingTableStage {
     SHADER_BINDING_TABLE_STAGE_MISS
 };
 
+// Records can carry data after the shader group handle, which the shaders read through shaderRecordEXT. Hit records are
+// selected by the instance's SBT offset, so instances that share geometry also share its record.
 struct ShaderBindingTableEntry {
     ShaderBindingTableStage stage;
     const char* generalShader;
     const char* closestHitShader;
     const char* anyHitShader;
     const char* intersectionShader;
+    const void* recordData;
+    uint32_t recordDataSize;
 };
 
 VkPipeline createRayTracingPipeline(VkDevice device, uint32_t entryCount, const ShaderBindingTableEntry* entries, VkPipelineLayout pipelineLayout);
+VkPipeline createComputePipeline(VkDevice device, const char* shader, VkPipelineLayout pipelineLayout);
 
 class ShaderBindingTable {
 public:
@@ -86,26 +156,146 @@ public:
     ShaderBindingTable() = default;
     ShaderBindingTable(Device& device, uint32_t entryCount, const ShaderBindingTableEntry* entries);
     void destroy(VkDevice device);
+
+    // Lays out every record, its shader group handle followed by its data, in size bytes of host memory that are then
+    // copied to the buffer. The entries must be the ones the pipeline was created from.
+    void writeRecords(Device& device, VkPipeline pipeline, uint32_t entryCount, const ShaderBindingTableEntry* entries, uint8_t* data);
 };
 
+// Matches the std140 layout of the frame constants read by the shaders. Command buffers are recorded once, so they are
+// written into host-visible memory every frame instead of being pushed.
+struct FrameConstants {
+    uint32_t frameNumber;
+    uint32_t sobolBufferIndex;
+    uint32_t blueNoiseImageIndex;
+    uint32_t sampleIndex;
+    uint32_t sampleCount;
+    uint32_t firstSample;
+    uint32_t tileOffset[2];
+    uint32_t imageExtent[2];
+    VkDeviceAddress environmentTableAddress;
+};
+
+// The part of an image a headless frame traces, and which of its samples. Frames that trace the samples from
+// firstSample to firstSample + sampleCount - 1 in order average them, so tiles and sample ranges of an image can be
+// traced apart and merged weighted by their sample counts.
+struct HeadlessFrameInfo {
+    VkOffset2D tileOffset;
+    VkExtent2D tileExtent;
+    VkExtent2D imageExtent;
+    uint32_t firstSample;
+    uint32_t sampleIndex;
+    uint32_t sampleCount;
+};
+
+// A null surface makes the renderer headless. It then has no swapchain and no post-processing, it traces at the extent
+// of the surface capabilities and frames are only seen through captures.
 struct RendererCreateInfo {
     VkSurfaceKHR surface;
     const VkSurfaceCapabilitiesKHR* surfaceCapabilities;
     VkSurfaceFormatKHR surfaceFormat;
     VkRenderPass renderPass;
+    VkDescriptorSetLayout bindlessDescriptorSetLayout;
     uint32_t framesInFlight;
+
+    // Presents with FIFO if the surface doesn't support it.
+    VkPresentModeKHR presentMode;
+};
+
+// Waits for presents on a thread of its own, which blocks on each one in turn and times it as it completes, so the
+// latency reads the same whether frames are paced or not. The latency is the smoothed time from the start of a frame to
+// its present, in milliseconds.
+class PresentTimer {
+public:
+    PresentTimer(VkDevice device);
+    ~PresentTimer();
+
+    // Call once the present is queued.
+    void queue(VkSwapchainKHR swapchain, uint64_t presentId, std::chrono::steady_clock::time_point frameStartTime);
+
+    // Waits until every queued present has completed, or the timeout has passed.
+    void waitForPresents(std::chrono::milliseconds timeout);
+
+    // Forgets the queued presents, and waits until their swapchain is no longer waited on so it can be destroyed.
+    void reset();
+
+    float getLatency();
+
+private:
+    struct QueuedPresent {
+        VkSwapchainKHR swapchain;
+        uint64_t presentId;
+        std::chrono::steady_clock::time_point frameStartTime;
+    };
+
+    VkDevice device;
+    std::thread thread;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::deque<QueuedPresent> queuedPresents;
+    bool waiting = false;
+    bool stopping = false;
+    float latency = 0.0f;
+
+    void run();
 };
 
 class Renderer {
 public:
     VkDescriptorSetLayout descriptorSetLayout;
+    Profiler profiler;
+    DynamicResolution dynamicResolution;
+    PostProcessor postProcessor;
+
+    // With present waits, frames start once the last one is on screen, so no frame queues behind it.
+    bool lowLatencyPacing = false;
 
     Renderer() = default;
     Renderer(Device& device, const RendererCreateInfo& createInfo);
     void destroy(VkDevice device);
 
-    void recordCommandBuffers(VkDevice device, VkPipelineLayout pipelineLayout, VkPipeline rayTracingPipeline, const ShaderBindingTable& sbt, VkExtent2D extent);
-    bool render(Device& device, VkRenderPass renderPass, VkExtent2D extent);
+    void recordCommandBuffers(VkDevice device, VkPipelineLayout pipelineLayout, VkPipeline rayTracingPipeline, const ShaderBindingTable& sbt,
+                              VkDescriptorSet bindlessDescriptorSet);
+    // Paces the next frame, whose latency is measured from here. Input should be polled after it.
+    void beginFrame();
+    bool render(Device& device, VkRenderPass renderPass, VkExtent2D extent, FrameCapture& frameCapture);
+
+    // Traces one sample of a tile on a headless renderer, whose extent the tile must fit in. Each frame's trace holds the
+    // average of the samples traced so far.
+    void renderHeadless(Device& device, const HeadlessFrameInfo& frameInfo, FrameCapture& frameCapture);
+
+    // The frame the next call to render will use, and whose timings the profiler will then hold.
+    uint32_t getFrameIndex();
+
+    // The number the next frame will have, its captures carry it.
+    uint64_t getFrameNumber();
+
+    uint32_t getFramesInFlight();
+
+    // The present mode the swapchain was created with, which falls back to FIFO.
+    VkPresentModeKHR getPresentMode();
+    bool supportsPresentWait();
+
+    // The time from the start of a frame to its present, 0 without present waits.
+    float getPresentLatency();
+
+    // Waits until the GPU is done with the next frame, after that its texture feedback can be read and its texture table
+    // written.
+    void waitForFrame(VkDevice device);
+    const uint32_t* getTextureFeedback();
+    uint32_t* getTextureTable();
+
+    // Whether the recorded frames have shaders that report texture feedback.
+    bool hasTextureFeedback();
+
+    // The number of frames the GPU has finished, read from the timeline semaphore without waiting.
+    uint64_t getCompletedFrameCount(VkDevice device);
+
+    // The bindless indices of the sampling tables, passed to the shaders through the frame constants.
+    void setSamplingTables(uint32_t sobolBufferIndex, uint32_t blueNoiseImageIndex);
+
+    // The address of the environment map's tables, which the rays that leave the scene read, or 0 without a map.
+    void setEnvironmentTable(VkDeviceAddress tableAddress);
 
     void waitIdle(VkDevice device);
 
@@ -113,9 +303,15 @@ public:
     void setFramesInFlight(Device& device, const RendererCreateInfo& createInfo);
 
 private:
+    bool headless;
+    bool presentWaitSupported;
     VkSwapchainKHR swapchain;
+    VkPresentModeKHR presentMode;
+    VkFormat swapchainFormat;
+    bool storageSwapchain;
     VkCommandPool normalCommandPool;
     VkCommandPool transientCommandPool;
+    VkSemaphore timelineSemaphore;
     uint32_t swapchainImageCount;
     VkImage* swapchainImages;
     VkImageView* swapchainImageViews;
@@ -128,15 +324,33 @@ private:
     VkSemaphore* imageAvailableSemaphores;
     VkSemaphore* renderFinishedSemaphores;
     VkFence* fences;
+    Buffer traceRaysCommandsBuffer;
+    VkTraceRaysIndirectCommandKHR* traceRaysCommands;
+    Buffer streamingBuffer;
+    uint32_t* streamingData;
+    bool textureFeedback = false;
+    Buffer frameConstantsBuffer;
+    uint8_t* frameConstantsData;
+    VkDeviceSize frameConstantsStride;
+    uint64_t frameNumber = 0;
+    std::chrono::steady_clock::time_point frameStartTime;
+    PresentTimer* presentTimer = nullptr;
+    uint32_t sobolBufferIndex = UINT32_MAX;
+    uint32_t blueNoiseImageIndex = UINT32_MAX;
+    VkDeviceAddress environmentTableAddress = 0;
     VkImage* offscreenImages;
     VkDeviceMemory offscreenImagesMemory;
     VkImageView* offscreenImageViews;
+    VkImage accumulationImage;
+    VkDeviceMemory accumulationImageMemory;
+    VkImageView accumulationImageView;
+    VkDescriptorSet bindlessDescriptorSet;
     uint32_t frameIndex = 0;
 
-    void createSwapchain(VkDevice device, const RendererCreateInfo& createInfo, VkSwapchainKHR oldSwapchain);
+    void createSwapchain(Device& device, const RendererCreateInfo& createInfo, VkSwapchainKHR oldSwapchain);
     void allocateSwapchainResourcesMemory();
     void createSwapchainResources(VkDevice device, const RendererCreateInfo& createInfo);
-    void createFrameResources(VkDevice device);
+    void createFrameResources(Device& device);
     void allocateOffscreenResourcesMemory();
     void createOffscreenResources(Device& device, const RendererCreateInfo& createInfo);
 
@@ -0,0 +1,41 @@
+#include "hash.h"
+
+#include <string.h>
+
+static const uint64_t prime0 = 0x9e3779b185ebca87ull;
+static const uint64_t prime1 = 0xc2b2ae3d27d4eb4full;
+
+static uint64_t rotateLeft(uint64_t value, uint32_t count) {
+    return (value << count) | (value >> (64 - count));
+}
+
+static uint64_t mix(uint64_t hash, uint64_t value) {
+    return rotateLeft(hash ^ (value * prime1), 31) * prime0;
+}
+
+uint64_t hashData(const void* data, size_t size, uint64_t seed) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    uint64_t hash = seed ^ (size * prime0);
+
+    // Consume the data in 8 byte words, the tail is padded with zeros.
+    size_t i = 0;
+
+    for (; i + 8 <= size; i += 8) {
+        uint64_t word;
+        memcpy(&word, bytes + i, sizeof(word));
+        hash = mix(hash, word);
+    }
+
+    if (i < size) {
+        uint64_t word = 0;
+        memcpy(&word, bytes + i, size - i);
+        hash = mix(hash, word);
+    }
+
+    // Spread every input bit over the whole result.
+    hash ^= hash >> 33;
+    hash *= prime1;
+    hash ^= hash >> 29;
+
+    return hash;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A fast non-cryptographic 64-bit hash, used to detect when cached data is out of date.
+uint64_t hashData(const void* data, size_t size, uint64_t seed = 0);
@@ -0,0 +1,306 @@
+#include "image.h"
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define IMAGE_USE_SSE2
+#endif
+
+// Destination rows are filtered in bands, each one only keeps the source rows it needs.
+static const uint32_t bandSize = 16;
+
+// Kaiser-windowed sinc, with the width in destination pixels.
+static const float kaiserWidth = 3.0f;
+static const float kaiserAlpha = 4.0f;
+
+static const float pi = 3.14159265f;
+
+#ifdef IMAGE_USE_SSE2
+
+typedef __m128 Pixel;
+
+static inline Pixel loadPixel(const float* pixel) {
+    return _mm_loadu_ps(pixel);
+}
+
+static inline void storePixel(float* pixel, Pixel value) {
+    // Negative lobes can ring below zero.
+    _mm_storeu_ps(pixel, _mm_max_ps(value, _mm_setzero_ps()));
+}
+
+static inline Pixel multiplyAdd(Pixel sum, Pixel value, float weight) {
+    return _mm_add_ps(sum, _mm_mul_ps(value, _mm_set1_ps(weight)));
+}
+
+static inline Pixel zeroPixel() {
+    return _mm_setzero_ps();
+}
+
+#else
+
+struct Pixel {
+    float c[4];
+};
+
+static inline Pixel loadPixel(const float* pixel) {
+    return { pixel[0], pixel[1], pixel[2], pixel[3] };
+}
+
+static inline void storePixel(float* pixel, Pixel value) {
+    for (uint32_t i = 0; i < 4; ++i) {
+        pixel[i] = fmaxf(value.c[i], 0.0f);
+    }
+}
+
+static inline Pixel multiplyAdd(Pixel sum, Pixel value, float weight) {
+    for (uint32_t i = 0; i < 4; ++i) {
+        sum.c[i] += value.c[i] * weight;
+    }
+
+    return sum;
+}
+
+static inline Pixel zeroPixel() {
+    return { 0.0f, 0.0f, 0.0f, 0.0f };
+}
+
+#endif
+
+static float srgbToLinear(uint8_t value) {
+    const float c = value / 255.0f;
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t linearToSrgb(float value) {
+    const float c = value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+    return (uint8_t)(fminf(fmaxf(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// Decoding is done through a table, there are only 256 possible values.
+static const struct SrgbTable {
+    float values[256];
+
+    SrgbTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            values[i] = srgbToLinear(i);
+        }
+    }
+} srgbTable;
+
+static float bessel0(float x) {
+    float sum = 1.0f;
+    float term = 1.0f;
+
+    for (uint32_t i = 1; i < 16; ++i) {
+        term *= (0.5f * x / i) * (0.5f * x / i);
+        sum += term;
+    }
+
+    return sum;
+}
+
+static float evaluateFilter(MipFilter filter, float x) {
+    if (filter == MIP_FILTER_BOX) {
+        return fabsf(x) < 0.5f ? 1.0f : 0.0f;
+    }
+
+    if (fabsf(x) >= kaiserWidth) {
+        return 0.0f;
+    }
+
+    const float t = x / kaiserWidth;
+    const float window = bessel0(kaiserAlpha * sqrtf(1.0f - t * t)) / bessel0(kaiserAlpha);
+    const float sinc = x == 0.0f ? 1.0f : sinf(pi * x) / (pi * x);
+
+    return sinc * window;
+}
+
+// The taps of every destination pixel along one axis. Taps past the edges are clamped when they are applied.
+struct FilterWeights {
+    uint32_t tapCount;
+    int32_t* firstTaps;
+    float* weights;
+
+    FilterWeights(uint32_t sourceSize, uint32_t destinationSize, MipFilter filter) {
+        const float scale = (float)sourceSize / destinationSize;
+        const float radius = (filter == MIP_FILTER_BOX ? 0.5f : kaiserWidth) * scale;
+
+        tapCount = (uint32_t)ceilf(2.0f * radius) + 1;
+        firstTaps = new int32_t[destinationSize];
+        weights = new float[destinationSize * tapCount];
+
+        for (uint32_t i = 0; i < destinationSize; ++i) {
+            const float center = (i + 0.5f) * scale;
+
+            firstTaps[i] = (int32_t)floorf(center - radius);
+
+            float weightSum = 0.0f;
+
+            for (uint32_t j = 0; j < tapCount; ++j) {
+                weights[i * tapCount + j] = evaluateFilter(filter, (firstTaps[i] + j + 0.5f - center) / scale);
+                weightSum += weights[i * tapCount + j];
+            }
+
+            for (uint32_t j = 0; j < tapCount; ++j) {
+                weights[i * tapCount + j] /= weightSum;
+            }
+        }
+    }
+
+    ~FilterWeights() {
+        delete[] weights;
+        delete[] firstTaps;
+    }
+};
+
+static inline uint32_t clampTap(int32_t tap, uint32_t size) {
+    return tap < 0 ? 0 : (uint32_t)tap >= size ? size - 1 : (uint32_t)tap;
+}
+
+// Filters horizontally into a band of rows and then vertically into the destination. loadRow converts a source row to
+// linear floats.
+template <typename LoadRow>
+static void downsample(JobSystem& jobSystem, uint32_t width, uint32_t height, float* destination, MipFilter filter, const LoadRow& loadRow) {
+    const uint32_t mipWidth = getNextMipSize(width);
+    const uint32_t mipHeight = getNextMipSize(height);
+
+    const FilterWeights columns(width, mipWidth, filter);
+    const FilterWeights rows(height, mipHeight, filter);
+
+    jobSystem.parallelFor(mipHeight, bandSize, [&](uint32_t begin, uint32_t end) {
+        const uint32_t firstRow = clampTap(rows.firstTaps[begin], height);
+        const uint32_t lastRow = clampTap(rows.firstTaps[end - 1] + rows.tapCount - 1, height);
+
+        float* sourceRow = new float[4 * (size_t)width];
+        float* filteredRows = new float[4 * (size_t)mipWidth * (lastRow - firstRow + 1)];
+
+        for (uint32_t y = firstRow; y <= lastRow; ++y) {
+            loadRow(y, sourceRow);
+
+            float* filteredRow = filteredRows + 4 * (size_t)mipWidth * (y - firstRow);
+
+            for (uint32_t x = 0; x < mipWidth; ++x) {
+                const float* weights = columns.weights + x * columns.tapCount;
+                Pixel sum = zeroPixel();
+
+                for (uint32_t i = 0; i < columns.tapCount; ++i) {
+                    const uint32_t column = clampTap(columns.firstTaps[x] + i, width);
+                    sum = multiplyAdd(sum, loadPixel(sourceRow + 4 * column), weights[i]);
+                }
+
+                storePixel(filteredRow + 4 * x, sum);
+            }
+        }
+
+        for (uint32_t y = begin; y < end; ++y) {
+            const float* weights = rows.weights + y * rows.tapCount;
+
+            for (uint32_t x = 0; x < mipWidth; ++x) {
+                Pixel sum = zeroPixel();
+
+                for (uint32_t i = 0; i < rows.tapCount; ++i) {
+                    const uint32_t row = clampTap(rows.firstTaps[y] + i, height) - firstRow;
+                    sum = multiplyAdd(sum, loadPixel(filteredRows + 4 * ((size_t)mipWidth * row + x)), weights[i]);
+                }
+
+                storePixel(destination + 4 * ((size_t)y * mipWidth + x), sum);
+            }
+        }
+
+        delete[] filteredRows;
+        delete[] sourceRow;
+    });
+}
+
+void convertToLinear(const uint8_t* source, size_t pixelCount, bool srgb, float* destination) {
+    for (size_t i = 0; i < 4 * pixelCount; ++i) {
+        destination[i] = srgb && i % 4 < 3 ? srgbTable.values[source[i]] : source[i] / 255.0f;
+    }
+}
+
+void convertFromLinear(const float* source, size_t pixelCount, bool srgb, uint8_t* destination) {
+    for (size_t i = 0; i < 4 * pixelCount; ++i) {
+        if (srgb && i % 4 < 3) {
+            destination[i] = linearToSrgb(source[i]);
+        } else {
+            destination[i] = (uint8_t)(fminf(fmaxf(source[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+    }
+}
+
+void convertToHalf(const float* source, size_t valueCount, uint16_t* destination) {
+    for (size_t i = 0; i < valueCount; ++i) {
+        uint32_t bits;
+        memcpy(&bits, &source[i], sizeof(bits));
+
+        const uint32_t sign = (bits >> 16) & 0x8000;
+        const int32_t exponent = (int32_t)((bits >> 23) & 0xff) - 127 + 15;
+        const uint32_t mantissa = bits & 0x7fffff;
+
+        if (((bits >> 23) & 0xff) == 0xff) {
+            // Infinity stays infinity, NaN stays NaN.
+            destination[i] = (uint16_t)(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+        } else if (exponent >= 31) {
+            destination[i] = (uint16_t)(sign | 0x7c00);
+        } else if (exponent <= 0) {
+            // Denormals, or zero once they are too small.
+            if (exponent < -10) {
+                destination[i] = (uint16_t)sign;
+            } else {
+                const uint32_t shift = 14 - exponent;
+                const uint32_t value = mantissa | 0x800000;
+                destination[i] = (uint16_t)(sign | ((value + (1 << (shift - 1))) >> shift));
+            }
+        } else {
+            // Round to nearest, a carry into the exponent is still correct.
+            destination[i] = (uint16_t)((sign | (exponent << 10) | (mantissa >> 13)) + ((mantissa >> 12) & 1));
+        }
+    }
+}
+
+void convertFromHalf(const uint16_t* source, size_t valueCount, float* destination) {
+    for (size_t i = 0; i < valueCount; ++i) {
+        const uint32_t sign = (uint32_t)(source[i] & 0x8000) << 16;
+        uint32_t exponent = (source[i] >> 10) & 0x1f;
+        uint32_t mantissa = source[i] & 0x3ff;
+        uint32_t bits;
+
+        if (exponent == 0x1f) {
+            bits = sign | 0x7f800000 | (mantissa << 13);
+        } else if (exponent != 0) {
+            bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+        } else if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // Denormals are normalized, every shift halves the exponent.
+            exponent = 127 - 15 + 1;
+
+            while ((mantissa & 0x400) == 0) {
+                mantissa <<= 1;
+                --exponent;
+            }
+
+            bits = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+        }
+
+        memcpy(&destination[i], &bits, sizeof(bits));
+    }
+}
+
+void generateMip(JobSystem& jobSystem, const uint8_t* source, bool srgb, uint32_t width, uint32_t height, float* destination, MipFilter filter) {
+    downsample(jobSystem, width, height, destination, filter, [&](uint32_t y, float* row) {
+        convertToLinear(source + 4 * (size_t)width * y, width, srgb, row);
+    });
+}
+
+void generateMip(JobSystem& jobSystem, const float* source, uint32_t width, uint32_t height, float* destination, MipFilter filter) {
+    downsample(jobSystem, width, height, destination, filter, [&](uint32_t y, float* row) {
+        memcpy(row, source + 4 * (size_t)width * y, 4 * sizeof(float) * width);
+    });
+}
+
+uint32_t getNextMipSize(uint32_t size) {
+    return size > 1 ? size / 2 : 1;
+}
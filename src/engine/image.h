@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "jobs.h"
+
+enum MipFilter {
+    MIP_FILTER_BOX,
+    MIP_FILTER_KAISER
+};
+
+// Mips are filtered as linear RGBA floats, one pixel per SIMD register. The color channels of sRGB images are decoded
+// before filtering, alpha is always linear.
+void convertToLinear(const uint8_t* source, size_t pixelCount, bool srgb, float* destination);
+void convertFromLinear(const float* source, size_t pixelCount, bool srgb, uint8_t* destination);
+void convertToHalf(const float* source, size_t valueCount, uint16_t* destination);
+void convertFromHalf(const uint16_t* source, size_t valueCount, float* destination);
+
+// Downsamples an image to the next mip level into linear RGBA floats. Rows are spread across threads and the kernel
+// clamps at the edges, so any size works.
+void generateMip(JobSystem& jobSystem, const uint8_t* source, bool srgb, uint32_t width, uint32_t height, float* destination, MipFilter filter);
+void generateMip(JobSystem& jobSystem, const float* source, uint32_t width, uint32_t height, float* destination, MipFilter filter);
+
+uint32_t getNextMipSize(uint32_t size);
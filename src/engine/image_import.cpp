@@ -0,0 +1,396 @@
+#include "image_import.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <stb_image.h>
+#include <tinyexr.h>
+
+#include "texture.h"
+
+static const uint64_t mipAlignment = 16;
+
+// Rows converted at a time when a mip level is encoded.
+static const uint32_t encodeGrainSize = 64;
+
+// Images that can't be decoded are filled with white.
+static const uint8_t fallbackTexel[4] = { 0xff, 0xff, 0xff, 0xff };
+
+static bool isSrgb(const SourceImage& image) {
+    return image.usage == TEXTURE_USAGE_COLOR;
+}
+
+static bool getBlockCompression(VkFormat format, BlockCompression* compression) {
+    switch (format) {
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            *compression = BLOCK_COMPRESSION_BC1;
+            return true;
+        case VK_FORMAT_BC4_UNORM_BLOCK:
+            *compression = BLOCK_COMPRESSION_BC4;
+            return true;
+        case VK_FORMAT_BC5_UNORM_BLOCK:
+            *compression = BLOCK_COMPRESSION_BC5;
+            return true;
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+            *compression = BLOCK_COMPRESSION_BC7;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static VkFormat chooseFormat(const SourceImage& image, const TextureImportSettings& settings) {
+    if (image.width == 0) {
+        return VK_FORMAT_R8G8B8A8_UNORM;
+    }
+
+    if (image.hdr) {
+        return VK_FORMAT_R16G16B16A16_SFLOAT;
+    }
+
+    if (image.usage == TEXTURE_USAGE_NORMAL) {
+        return VK_FORMAT_BC5_UNORM_BLOCK;
+    }
+
+    // Grayscale color is kept in sRGB, which BC4 doesn't have.
+    if (image.usage == TEXTURE_USAGE_DATA && image.channelCount == 1) {
+        return VK_FORMAT_BC4_UNORM_BLOCK;
+    }
+
+    const bool hasAlpha = image.channelCount == 2 || image.channelCount == 4;
+
+    if (!hasAlpha && settings.quality == BLOCK_COMPRESSION_QUALITY_FAST) {
+        return isSrgb(image) ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+    }
+
+    return isSrgb(image) ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+}
+
+static uint64_t getMipSize(VkFormat format, uint32_t width, uint32_t height) {
+    BlockCompression compression;
+
+    if (getBlockCompression(format, &compression)) {
+        return (uint64_t)((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(compression);
+    }
+
+    return (uint64_t)width * height * (format == VK_FORMAT_R16G16B16A16_SFLOAT ? 8 : 4);
+}
+
+// Filtering shortens normals, so they are brought back to unit length.
+static void renormalize(float* pixels, size_t pixelCount) {
+    for (size_t i = 0; i < pixelCount; ++i) {
+        float* pixel = pixels + 4 * i;
+
+        const float x = 2.0f * pixel[0] - 1.0f;
+        const float y = 2.0f * pixel[1] - 1.0f;
+        const float z = 2.0f * pixel[2] - 1.0f;
+        const float length = sqrtf(x * x + y * y + z * z);
+
+        if (length > 0.0f) {
+            pixel[0] = 0.5f * x / length + 0.5f;
+            pixel[1] = 0.5f * y / length + 0.5f;
+            pixel[2] = 0.5f * z / length + 0.5f;
+        }
+    }
+}
+
+// Encodes a mip level into the file from either RGBA8 pixels or linear floats, whichever the level was produced as.
+static void encodeMip(JobSystem& jobSystem, const SourceImage& image, const TextureImportSettings& settings, const CookedTexture& texture,
+                      uint32_t mipLevel, const uint8_t* pixels, float* linearPixels, uint8_t* fileData) {
+    const uint32_t width = texture.width >> mipLevel > 0 ? texture.width >> mipLevel : 1;
+    const uint32_t height = texture.height >> mipLevel > 0 ? texture.height >> mipLevel : 1;
+    uint8_t* destination = fileData + texture.mipOffsets[mipLevel];
+
+    if (texture.format == VK_FORMAT_R16G16B16A16_SFLOAT) {
+        jobSystem.parallelFor(height, encodeGrainSize, [&](uint32_t begin, uint32_t end) {
+            const size_t offset = 4 * (size_t)width * begin;
+            convertToHalf(linearPixels + offset, 4 * (size_t)width * (end - begin), (uint16_t*)destination + offset);
+        });
+
+        return;
+    }
+
+    BlockCompression compression;
+    const bool compressed = getBlockCompression((VkFormat)texture.format, &compression);
+
+    // Generated levels are converted back to RGBA8, straight into the file if they aren't compressed.
+    uint8_t* convertedPixels = nullptr;
+
+    if (pixels == nullptr) {
+        convertedPixels = compressed ? new uint8_t[4 * (size_t)width * height] : destination;
+
+        jobSystem.parallelFor(height, encodeGrainSize, [&](uint32_t begin, uint32_t end) {
+            const size_t offset = 4 * (size_t)width * begin;
+            const size_t pixelCount = (size_t)width * (end - begin);
+
+            if (image.usage == TEXTURE_USAGE_NORMAL) {
+                renormalize(linearPixels + offset, pixelCount);
+            }
+
+            convertFromLinear(linearPixels + offset, pixelCount, isSrgb(image), convertedPixels + offset);
+        });
+
+        pixels = convertedPixels;
+    }
+
+    if (compressed) {
+        compressBlocks(jobSystem, pixels, width, height, compression, settings.quality, destination);
+    } else if (pixels != destination) {
+        memcpy(destination, pixels, texture.mipSizes[mipLevel]);
+    }
+
+    if (compressed) {
+        delete[] convertedPixels;
+    }
+}
+
+static bool isExr(const SourceImage& image) {
+    return IsEXRFromMemory(image.data, image.size) == TINYEXR_SUCCESS;
+}
+
+void readSourceImageInfo(SourceImage& image) {
+    image.width = 0;
+    image.height = 0;
+    image.channelCount = 0;
+    image.hdr = false;
+
+    if (image.data == nullptr) {
+        return;
+    }
+
+    if (isExr(image)) {
+        EXRVersion exrVersion;
+        EXRHeader exrHeader;
+        const char* error = nullptr;
+
+        InitEXRHeader(&exrHeader);
+
+        if (ParseEXRVersionFromMemory(&exrVersion, image.data, image.size) == TINYEXR_SUCCESS &&
+            ParseEXRHeaderFromMemory(&exrHeader, &exrVersion, image.data, image.size, &error) == TINYEXR_SUCCESS) {
+            image.width = exrHeader.data_window.max_x - exrHeader.data_window.min_x + 1;
+            image.height = exrHeader.data_window.max_y - exrHeader.data_window.min_y + 1;
+            image.channelCount = 4;
+            image.hdr = true;
+
+            FreeEXRHeader(&exrHeader);
+        }
+
+        FreeEXRErrorMessage(error);
+        return;
+    }
+
+    if (!stbi_info_from_memory(image.data, (int)image.size, &image.width, &image.height, &image.channelCount)) {
+        image.width = 0;
+        image.height = 0;
+        return;
+    }
+
+    image.hdr = stbi_is_hdr_from_memory(image.data, (int)image.size);
+}
+
+float* decodeLinearImage(const SourceImage& image, int& width, int& height) {
+    width = 0;
+    height = 0;
+
+    if (isExr(image)) {
+        float* pixels = nullptr;
+        const char* error = nullptr;
+
+        if (LoadEXRFromMemory(&pixels, &width, &height, image.data, image.size, &error) != TINYEXR_SUCCESS) {
+            FreeEXRErrorMessage(error);
+            return nullptr;
+        }
+
+        return pixels;
+    }
+
+    int channelCount;
+    return stbi_loadf_from_memory(image.data, (int)image.size, &width, &height, &channelCount, 4);
+}
+
+uint64_t layOutCookedTexture(const SourceImage& image, const TextureImportSettings& settings, uint64_t offset, CookedTexture& texture) {
+    texture.format = chooseFormat(image, settings);
+    texture.width = image.width > 0 ? image.width : 1;
+    texture.height = image.height > 0 ? image.height : 1;
+    texture.mipLevels = getMipLevelCount(texture.width, texture.height);
+
+    if (texture.mipLevels > COOKED_TEXTURE_MAX_MIP_LEVELS) {
+        texture.mipLevels = COOKED_TEXTURE_MAX_MIP_LEVELS;
+    }
+
+    uint32_t width = texture.width;
+    uint32_t height = texture.height;
+
+    for (uint32_t i = 0; i < COOKED_TEXTURE_MAX_MIP_LEVELS; ++i) {
+        if (i < texture.mipLevels) {
+            offset = (offset + mipAlignment - 1) & ~(mipAlignment - 1);
+
+            texture.mipOffsets[i] = offset;
+            texture.mipSizes[i] = getMipSize((VkFormat)texture.format, width, height);
+
+            offset += texture.mipSizes[i];
+
+            width = getNextMipSize(width);
+            height = getNextMipSize(height);
+        } else {
+            texture.mipOffsets[i] = 0;
+            texture.mipSizes[i] = 0;
+        }
+    }
+
+    return offset;
+}
+
+void cookTexture(JobSystem& jobSystem, const SourceImage& image, const TextureImportSettings& settings, const CookedTexture& texture,
+                 uint8_t* fileData) {
+    const size_t pixelCount = (size_t)texture.width * texture.height;
+
+    // HDR images are decoded to linear floats, everything else to RGBA8.
+    uint8_t* pixels = nullptr;
+    float* linearPixels = nullptr;
+
+    if (image.width > 0) {
+        int width = 0, height = 0, channelCount;
+
+        if (image.hdr) {
+            linearPixels = decodeLinearImage(image, width, height);
+        } else {
+            pixels = stbi_load_from_memory(image.data, (int)image.size, &width, &height, &channelCount, 4);
+        }
+
+        if ((uint32_t)width != texture.width || (uint32_t)height != texture.height) {
+            free(pixels);
+            free(linearPixels);
+
+            pixels = nullptr;
+            linearPixels = nullptr;
+        }
+    }
+
+    if (pixels == nullptr && linearPixels == nullptr) {
+        if (texture.format == VK_FORMAT_R16G16B16A16_SFLOAT) {
+            linearPixels = (float*)malloc(4 * sizeof(float) * pixelCount);
+
+            for (size_t i = 0; i < 4 * pixelCount; ++i) {
+                linearPixels[i] = 1.0f;
+            }
+        } else {
+            pixels = (uint8_t*)malloc(4 * pixelCount);
+
+            for (size_t i = 0; i < pixelCount; ++i) {
+                memcpy(pixels + 4 * i, fallbackTexel, 4);
+            }
+        }
+    }
+
+    encodeMip(jobSystem, image, settings, texture, 0, pixels, linearPixels, fileData);
+
+    // Every mip level is filtered from the previous one, the first one straight from the decoded pixels.
+    uint32_t width = texture.width;
+    uint32_t height = texture.height;
+
+    for (uint32_t i = 1; i < texture.mipLevels; ++i) {
+        float* mipPixels = new float[4 * (size_t)getNextMipSize(width) * getNextMipSize(height)];
+
+        if (pixels != nullptr) {
+            generateMip(jobSystem, pixels, isSrgb(image), width, height, mipPixels, settings.mipFilter);
+
+            free(pixels);
+            pixels = nullptr;
+        } else {
+            generateMip(jobSystem, linearPixels, width, height, mipPixels, settings.mipFilter);
+
+            if (i == 1) {
+                free(linearPixels);
+            } else {
+                delete[] linearPixels;
+            }
+        }
+
+        linearPixels = mipPixels;
+
+        encodeMip(jobSystem, image, settings, texture, i, nullptr, linearPixels, fileData);
+
+        width = getNextMipSize(width);
+        height = getNextMipSize(height);
+    }
+
+    free(pixels);
+
+    if (texture.mipLevels > 1) {
+        delete[] linearPixels;
+    } else {
+        free(linearPixels);
+    }
+}
+
+bool cookImage(JobSystem& jobSystem, const TextureImportSettings& settings, const std::filesystem::path& sourcePath,
+               const std::filesystem::path& cookedPath) {
+    SourceImage image = {};
+    image.file = MappedFile(sourcePath);
+    image.data = image.file.data;
+    image.size = image.file.size;
+    image.usage = TEXTURE_USAGE_COLOR;
+
+    readSourceImageInfo(image);
+
+    if (image.width == 0) {
+        image.file.destroy();
+        return false;
+    }
+
+    // Every other section is empty.
+    CookedAssetHeader header = {
+        .magic        = COOKED_ASSET_MAGIC,
+        .version      = COOKED_ASSET_VERSION,
+        .textureCount = 1
+    };
+
+    const uint64_t sectionsOffset = alignCookedOffset(sizeof(CookedAssetHeader));
+
+    header.meshesOffset    = sectionsOffset;
+    header.nodesOffset     = sectionsOffset;
+    header.materialsOffset = sectionsOffset;
+    header.samplersOffset  = sectionsOffset;
+    header.texturesOffset  = sectionsOffset;
+    header.verticesOffset  = sectionsOffset;
+    header.indicesOffset   = sectionsOffset;
+
+    CookedTexture texture;
+    header.fileSize = alignCookedOffset(layOutCookedTexture(image, settings, alignCookedOffset(sectionsOffset + sizeof(CookedTexture)), texture));
+
+    // Write the texture into a temporary file and only move it into place once it's complete.
+    std::filesystem::path temporaryPath = cookedPath;
+    temporaryPath += ".tmp";
+
+    MappedFile file(temporaryPath, header.fileSize);
+    bool cooked = file.data != nullptr;
+
+    if (cooked) {
+        memcpy(file.data, &header, sizeof(header));
+        memcpy(file.data + header.texturesOffset, &texture, sizeof(texture));
+
+        cookTexture(jobSystem, image, settings, texture, file.data);
+
+        cooked = file.flush();
+        file.destroy();
+    }
+
+    image.file.destroy();
+
+    std::error_code error;
+
+    if (cooked) {
+        std::filesystem::rename(temporaryPath, cookedPath, error);
+        cooked = !error;
+    }
+
+    if (!cooked) {
+        std::filesystem::remove(temporaryPath, error);
+    }
+
+    return cooked;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <filesystem>
+
+#include "block_compression.h"
+#include "cooked_asset.h"
+#include "file_mapping.h"
+#include "image.h"
+
+// Color textures are stored in sRGB, normal maps keep only X and Y.
+enum TextureUsage {
+    TEXTURE_USAGE_COLOR,
+    TEXTURE_USAGE_DATA,
+    TEXTURE_USAGE_NORMAL
+};
+
+struct TextureImportSettings {
+    MipFilter mipFilter;
+    BlockCompressionQuality quality;
+};
+
+// An encoded PNG, JPEG, HDR or EXR image, either inside a mapped file of its own or inside some other buffer.
+struct SourceImage {
+    const uint8_t* data;
+    size_t size;
+    int width;
+    int height;
+    int channelCount;
+    bool hdr;
+    TextureUsage usage;
+    MappedFile file;
+};
+
+// Reads only the image header, width and height are 0 if the image can't be decoded.
+void readSourceImageInfo(SourceImage& image);
+
+// Decodes the image to linear RGBA floats, LDR images included. Returns null if it can't be decoded, the pixels are
+// freed with free().
+float* decodeLinearImage(const SourceImage& image, int& width, int& height);
+
+// Picks the texture's format and places its mip levels in the cooked file starting at offset. LDR images are block
+// compressed: BC5 for normal maps, BC4 for single channel data, BC7 otherwise, or BC1 for opaque images at fast quality.
+// HDR images are stored as half floats. Returns the offset past the last mip level.
+uint64_t layOutCookedTexture(const SourceImage& image, const TextureImportSettings& settings, uint64_t offset, CookedTexture& texture);
+
+// Decodes the image into the texture's first mip level, generates the rest of them and encodes them all.
+void cookTexture(JobSystem& jobSystem, const SourceImage& image, const TextureImportSettings& settings, const CookedTexture& texture,
+                 uint8_t* fileData);
+
+// Cooks a standalone image into a cooked asset that holds a single color texture. Returns false if the file couldn't
+// be read or written.
+bool cookImage(JobSystem& jobSystem, const TextureImportSettings& settings, const std::filesystem::path& sourcePath,
+               const std::filesystem::path& cookedPath);
@@ -0,0 +1,15 @@
+// Single-header libraries are compiled here once.
+#define CGLTF_IMPLEMENTATION
+#include <cgltf.h>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+// tinyexr inflates and deflates through stb's zlib instead of bundling miniz.
+#define TINYEXR_IMPLEMENTATION
+#define TINYEXR_USE_MINIZ 0
+#define TINYEXR_USE_STB_ZLIB 1
+#include <tinyexr.h>
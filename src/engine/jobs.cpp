@@ -0,0 +1,178 @@
+#include "jobs.h"
+
+#include <algorithm>
+
+// Whether the job running on this thread is a background job, whose own jobs are background jobs too.
+static thread_local bool inBackgroundJob = false;
+
+JobSystem::JobSystem() {
+    // Leave one hardware thread for the main thread.
+    uint32_t hardwareThreadCount = std::thread::hardware_concurrency();
+    threadCount = hardwareThreadCount > 1 ? hardwareThreadCount - 1 : 1;
+
+    createThreads();
+}
+
+JobSystem::JobSystem(uint32_t threadCount) : threadCount(threadCount > 0 ? threadCount : 1) {
+    createThreads();
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+
+    condition.notify_all();
+
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        threads[i].join();
+    }
+
+    delete[] threads;
+}
+
+uint32_t JobSystem::getThreadCount() {
+    return threadCount;
+}
+
+void JobSystem::submit(std::function<void()> function, JobCounter* counter) {
+    push({ std::move(function), counter, inBackgroundJob });
+}
+
+void JobSystem::submitBackground(std::function<void()> function, JobCounter* counter) {
+    push({ std::move(function), counter, true });
+}
+
+void JobSystem::push(Job job) {
+    JobCounter* counter = job.counter;
+
+    if (counter != nullptr) {
+        counter->fetch_add(1);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        (job.background ? backgroundJobs : jobs).push_back(std::move(job));
+    }
+
+    condition.notify_one();
+
+    // Someone may be waiting on the counter with nothing left to run.
+    if (counter != nullptr) {
+        waitCondition.notify_all();
+    }
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    auto isPending = [&](const Job& job) { return job.counter == &counter; };
+
+    while (counter.load() != 0) {
+        std::deque<Job>* queue = &jobs;
+        auto pendingJob = std::find_if(jobs.begin(), jobs.end(), isPending);
+
+        if (pendingJob == jobs.end()) {
+            queue = &backgroundJobs;
+            pendingJob = std::find_if(backgroundJobs.begin(), backgroundJobs.end(), isPending);
+        }
+
+        if (pendingJob == queue->end()) {
+            waitCondition.wait(lock);
+            continue;
+        }
+
+        Job job = std::move(*pendingJob);
+        queue->erase(pendingJob);
+
+        lock.unlock();
+        runJob(job);
+        lock.lock();
+    }
+}
+
+void JobSystem::parallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& function) {
+    if (count == 0) {
+        return;
+    }
+
+    if (grainSize == 0) {
+        grainSize = 1;
+    }
+
+    const uint32_t rangeCount = (count + grainSize - 1) / grainSize;
+
+    if (rangeCount == 1) {
+        function(0, count);
+        return;
+    }
+
+    // Ranges are claimed dynamically so that uneven work gets balanced across threads.
+    std::atomic<uint32_t> nextRange = 0;
+
+    auto runRanges = [&]() {
+        for (uint32_t range = nextRange.fetch_add(1); range < rangeCount; range = nextRange.fetch_add(1)) {
+            const uint32_t begin = range * grainSize;
+            const uint32_t end = begin + grainSize < count ? begin + grainSize : count;
+
+            function(begin, end);
+        }
+    };
+
+    JobCounter counter = 0;
+    const uint32_t helperCount = rangeCount - 1 < threadCount ? rangeCount - 1 : threadCount;
+
+    for (uint32_t i = 0; i < helperCount; ++i) {
+        submit(runRanges, &counter);
+    }
+
+    runRanges();
+    wait(counter);
+}
+
+void JobSystem::createThreads() {
+    running = true;
+    threads = new std::thread[threadCount];
+
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        threads[i] = std::thread(&JobSystem::workerMain, this);
+    }
+}
+
+void JobSystem::workerMain() {
+    while (true) {
+        Job job;
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this]() { return !running || !jobs.empty() || !backgroundJobs.empty(); });
+
+            std::deque<Job>& queue = !jobs.empty() ? jobs : backgroundJobs;
+
+            if (queue.empty()) {
+                return;
+            }
+
+            job = std::move(queue.front());
+            queue.pop_front();
+        }
+
+        runJob(job);
+    }
+}
+
+void JobSystem::runJob(Job& job) {
+    const bool wasInBackgroundJob = inBackgroundJob;
+
+    inBackgroundJob = job.background;
+    job.function();
+    inBackgroundJob = wasInBackgroundJob;
+
+    // Waiters check the counter under the lock, so notifying under it too means none of them misses the last job. The
+    // counter may be gone as soon as it reaches zero.
+    if (job.counter != nullptr && job.counter->fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(mutex);
+        waitCondition.notify_all();
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+typedef std::atomic<uint32_t> JobCounter;
+
+class JobSystem {
+public:
+    JobSystem();
+    JobSystem(uint32_t threadCount);
+    ~JobSystem();
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    uint32_t getThreadCount();
+
+    // The counter, if any, is incremented on submission and decremented once the job has run.
+    void submit(std::function<void()> function, JobCounter* counter = nullptr);
+
+    // Background jobs only run once no other job is queued, and so do the jobs they submit, so that long work like
+    // generating tables doesn't hold up the jobs of a frame.
+    void submitBackground(std::function<void()> function, JobCounter* counter = nullptr);
+
+    // Runs the counter's own pending jobs on the calling thread and otherwise sleeps until the counter reaches zero, so
+    // it's safe to wait from inside a job. Other jobs are left to the workers, a waiter never picks up unrelated work.
+    void wait(JobCounter& counter);
+
+    // Splits [0, count) into ranges of at most grainSize elements and runs them on every thread, including the caller.
+    void parallelFor(uint32_t count, uint32_t grainSize, const std::function<void(uint32_t begin, uint32_t end)>& function);
+
+private:
+    struct Job {
+        std::function<void()> function;
+        JobCounter* counter;
+        bool background;
+    };
+
+    uint32_t threadCount;
+    std::thread* threads;
+    std::deque<Job> jobs;
+    std::deque<Job> backgroundJobs;
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::condition_variable waitCondition;
+    bool running;
+
+    void createThreads();
+    void workerMain();
+    void push(Job job);
+    void runJob(Job& job);
+};
@@ -0,0 +1,615 @@
+#include "light_tree.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "mesh_optimizer.h"
+
+// Refitting lets the tree degrade as lights move, so it's rebuilt from scratch every so often.
+static const uint32_t maxRefitCount = 64;
+
+// Splits are chosen among this many buckets along each axis.
+static const uint32_t bucketCount = 12;
+
+// Subtrees with at least this many lights are built on another thread.
+static const uint32_t parallelBuildLightCount = 1024;
+
+// Bit trails have 64 bits. Below this depth, lights are split in halves, which bounds the depth by 32 + log2(lights).
+static const uint32_t maxSplitDepth = 32;
+
+// Nodes are quantized in batches of this many.
+static const uint32_t quantizeGrainSize = 1024;
+
+// The octahedral axis is off by less than this many radians, which widens the quantized cones.
+static const float axisQuantizationError = 1e-3f;
+
+static const float pi = 3.14159265f;
+
+static const VkDeviceSize initialCapacity = 1 << 16;
+
+// Cones that hold both cones, the whole sphere if one of them does.
+static void unionCones(const float* axisA, float cosA, const float* axisB, float cosB, float* axis, float& cosSpread) {
+    memcpy(axis, axisA, sizeof(float[3]));
+    cosSpread = -1.0f;
+
+    if (cosA <= -1.0f || cosB <= -1.0f) {
+        return;
+    }
+
+    const float thetaA = acosf(cosA);
+    const float thetaB = acosf(cosB);
+    const float thetaD = acosf(fminf(fmaxf(axisA[0] * axisB[0] + axisA[1] * axisB[1] + axisA[2] * axisB[2], -1.0f), 1.0f));
+
+    if (fminf(thetaD + thetaB, pi) <= thetaA) {
+        cosSpread = cosA;
+        return;
+    }
+
+    if (fminf(thetaD + thetaA, pi) <= thetaB) {
+        memcpy(axis, axisB, sizeof(float[3]));
+        cosSpread = cosB;
+        return;
+    }
+
+    const float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+
+    if (thetaO >= pi) {
+        return;
+    }
+
+    // Rotate the first axis towards the second one, around the axis perpendicular to both.
+    float rotationAxis[3] = {
+        axisA[1] * axisB[2] - axisA[2] * axisB[1],
+        axisA[2] * axisB[0] - axisA[0] * axisB[2],
+        axisA[0] * axisB[1] - axisA[1] * axisB[0]
+    };
+
+    const float rotationAxisLength = sqrtf(rotationAxis[0] * rotationAxis[0] + rotationAxis[1] * rotationAxis[1] + rotationAxis[2] * rotationAxis[2]);
+
+    if (!(rotationAxisLength > 0.0f)) {
+        return;
+    }
+
+    for (uint32_t c = 0; c < 3; ++c) {
+        rotationAxis[c] /= rotationAxisLength;
+    }
+
+    const float thetaR = thetaO - thetaA;
+    const float perpendicular[3] = {
+        rotationAxis[1] * axisA[2] - rotationAxis[2] * axisA[1],
+        rotationAxis[2] * axisA[0] - rotationAxis[0] * axisA[2],
+        rotationAxis[0] * axisA[1] - rotationAxis[1] * axisA[0]
+    };
+
+    for (uint32_t c = 0; c < 3; ++c) {
+        axis[c] = axisA[c] * cosf(thetaR) + perpendicular[c] * sinf(thetaR);
+    }
+
+    cosSpread = cosf(thetaO);
+}
+
+// Lights without power are left out, they can't be picked anyway.
+static LightBounds unionLightBounds(const LightBounds& a, const LightBounds& b) {
+    if (!(a.power > 0.0f)) {
+        return b;
+    }
+
+    if (!(b.power > 0.0f)) {
+        return a;
+    }
+
+    LightBounds bounds;
+
+    for (uint32_t c = 0; c < 3; ++c) {
+        bounds.boundsMin[c] = fminf(a.boundsMin[c], b.boundsMin[c]);
+        bounds.boundsMax[c] = fmaxf(a.boundsMax[c], b.boundsMax[c]);
+    }
+
+    unionCones(a.axis, a.cosNormalSpread, b.axis, b.cosNormalSpread, bounds.axis, bounds.cosNormalSpread);
+
+    bounds.cosEmissionSpread = fminf(a.cosEmissionSpread, b.cosEmissionSpread);
+    bounds.power = a.power + b.power;
+
+    return bounds;
+}
+
+static float getCentroid(const LightBounds& bounds, uint32_t axis) {
+    return 0.5f * (bounds.boundsMin[axis] + bounds.boundsMax[axis]);
+}
+
+// The surface area heuristic weighted by power and by the solid angle the normal and emission cones can reach, with
+// boxes that are thin along the split axis penalized.
+static float getSplitCost(const LightBounds& bounds, float aspectPenalty) {
+    if (!(bounds.power > 0.0f)) {
+        return 0.0f;
+    }
+
+    const float thetaO = acosf(fminf(fmaxf(bounds.cosNormalSpread, -1.0f), 1.0f));
+    const float thetaE = acosf(fminf(fmaxf(bounds.cosEmissionSpread, -1.0f), 1.0f));
+    const float thetaW = fminf(thetaO + thetaE, pi);
+    const float sinThetaO = sinf(thetaO);
+
+    const float orientationMeasure = 2.0f * pi * (1.0f - cosf(thetaO)) +
+                                     0.5f * pi * (2.0f * thetaW * sinThetaO - cosf(thetaO - 2.0f * thetaW) - 2.0f * thetaO * sinThetaO + cosf(thetaO));
+
+    const float extent[3] = {
+        bounds.boundsMax[0] - bounds.boundsMin[0],
+        bounds.boundsMax[1] - bounds.boundsMin[1],
+        bounds.boundsMax[2] - bounds.boundsMin[2]
+    };
+
+    const float surfaceArea = 2.0f * (extent[0] * extent[1] + extent[1] * extent[2] + extent[2] * extent[0]);
+
+    return bounds.power * orientationMeasure * aspectPenalty * surfaceArea;
+}
+
+struct LightTreeBuild {
+    JobSystem* jobSystem;
+    const LightBounds* lights;
+    LightBounds* nodeBounds;
+    LightTreeNode* nodes;
+    uint32_t* parents;
+    uint32_t* leaves;
+    uint64_t* bitTrails;
+};
+
+// Builds the subtree of the lights into the 2 * lightCount - 1 nodes that start at nodeIndex, first child first, and
+// returns its depth.
+static uint32_t buildSubtree(const LightTreeBuild& build, uint32_t* lightIndices, uint32_t lightCount, uint32_t nodeIndex,
+                             uint32_t parent, uint64_t bitTrail, uint32_t depth) {
+    build.parents[nodeIndex] = parent;
+
+    if (lightCount == 1) {
+        const uint32_t light = lightIndices[0];
+
+        build.nodeBounds[nodeIndex] = build.lights[light];
+        build.nodes[nodeIndex].child = LIGHT_TREE_LEAF | light;
+        build.leaves[light] = nodeIndex;
+        build.bitTrails[light] = bitTrail;
+
+        return 0;
+    }
+
+    // Bound the lights and their centroids.
+    LightBounds bounds = build.lights[lightIndices[0]];
+    float centroidMin[3], centroidMax[3];
+
+    for (uint32_t c = 0; c < 3; ++c) {
+        centroidMin[c] = centroidMax[c] = getCentroid(bounds, c);
+    }
+
+    for (uint32_t i = 1; i < lightCount; ++i) {
+        const LightBounds& light = build.lights[lightIndices[i]];
+        bounds = unionLightBounds(bounds, light);
+
+        for (uint32_t c = 0; c < 3; ++c) {
+            centroidMin[c] = fminf(centroidMin[c], getCentroid(light, c));
+            centroidMax[c] = fmaxf(centroidMax[c], getCentroid(light, c));
+        }
+    }
+
+    for (uint32_t c = 0; c < 3; ++c) {
+        bounds.boundsMin[c] = fminf(bounds.boundsMin[c], centroidMin[c]);
+        bounds.boundsMax[c] = fmaxf(bounds.boundsMax[c], centroidMax[c]);
+    }
+
+    const float extent[3] = {
+        bounds.boundsMax[0] - bounds.boundsMin[0],
+        bounds.boundsMax[1] - bounds.boundsMin[1],
+        bounds.boundsMax[2] - bounds.boundsMin[2]
+    };
+
+    const float maxExtent = fmaxf(extent[0], fmaxf(extent[1], extent[2]));
+
+    // Find the cheapest split between buckets.
+    float bestCost = INFINITY;
+    uint32_t bestAxis = 0;
+    uint32_t bestBucket = 0;
+
+    for (uint32_t axis = 0; axis < 3 && depth < maxSplitDepth; ++axis) {
+        const float centroidExtent = centroidMax[axis] - centroidMin[axis];
+
+        if (!(centroidExtent > 0.0f)) {
+            continue;
+        }
+
+        LightBounds buckets[bucketCount];
+        uint32_t bucketLightCounts[bucketCount] = {};
+
+        for (uint32_t i = 0; i < lightCount; ++i) {
+            const LightBounds& light = build.lights[lightIndices[i]];
+            uint32_t bucket = (uint32_t)((getCentroid(light, axis) - centroidMin[axis]) / centroidExtent * bucketCount);
+            bucket = bucket < bucketCount ? bucket : bucketCount - 1;
+
+            buckets[bucket] = bucketLightCounts[bucket] == 0 ? light : unionLightBounds(buckets[bucket], light);
+            ++bucketLightCounts[bucket];
+        }
+
+        const float aspectPenalty = extent[axis] > 0.0f ? maxExtent / extent[axis] : 1.0f;
+
+        // The costs of everything below each split, then of everything above it.
+        float belowCosts[bucketCount - 1];
+        LightBounds below = {};
+        uint32_t belowCount = 0;
+
+        for (uint32_t i = 0; i < bucketCount - 1; ++i) {
+            if (bucketLightCounts[i] > 0) {
+                below = belowCount == 0 ? buckets[i] : unionLightBounds(below, buckets[i]);
+                belowCount += bucketLightCounts[i];
+            }
+
+            belowCosts[i] = belowCount > 0 ? getSplitCost(below, aspectPenalty) : 0.0f;
+        }
+
+        LightBounds above = {};
+        uint32_t aboveCount = 0;
+
+        for (uint32_t i = bucketCount - 1; i > 0; --i) {
+            if (bucketLightCounts[i] > 0) {
+                above = aboveCount == 0 ? buckets[i] : unionLightBounds(above, buckets[i]);
+                aboveCount += bucketLightCounts[i];
+            }
+
+            const float cost = belowCosts[i - 1] + (aboveCount > 0 ? getSplitCost(above, aspectPenalty) : 0.0f);
+
+            if (aboveCount > 0 && aboveCount < lightCount && cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBucket = i - 1;
+            }
+        }
+    }
+
+    uint32_t firstCount;
+
+    if (bestCost < INFINITY) {
+        const float centroidExtent = centroidMax[bestAxis] - centroidMin[bestAxis];
+
+        uint32_t* middle = std::partition(lightIndices, lightIndices + lightCount, [&](uint32_t light) {
+            uint32_t bucket = (uint32_t)((getCentroid(build.lights[light], bestAxis) - centroidMin[bestAxis]) / centroidExtent * bucketCount);
+            bucket = bucket < bucketCount ? bucket : bucketCount - 1;
+            return bucket <= bestBucket;
+        });
+
+        firstCount = (uint32_t)(middle - lightIndices);
+    } else {
+        // Too deep, or every centroid is in the same place: split in halves along the widest spread of centroids.
+        uint32_t axis = 0;
+
+        for (uint32_t c = 1; c < 3; ++c) {
+            if (centroidMax[c] - centroidMin[c] > centroidMax[axis] - centroidMin[axis]) {
+                axis = c;
+            }
+        }
+
+        firstCount = lightCount / 2;
+
+        std::nth_element(lightIndices, lightIndices + firstCount, lightIndices + lightCount, [&](uint32_t a, uint32_t b) {
+            return getCentroid(build.lights[a], axis) < getCentroid(build.lights[b], axis);
+        });
+    }
+
+    // The first child follows the node, the second one follows the first child's subtree.
+    const uint32_t firstChild = nodeIndex + 1;
+    const uint32_t secondChild = nodeIndex + 2 * firstCount;
+    const uint32_t secondCount = lightCount - firstCount;
+
+    uint32_t secondDepth = 0;
+    JobCounter counter(0);
+
+    if (secondCount >= parallelBuildLightCount) {
+        build.jobSystem->submit([&]() {
+            secondDepth = buildSubtree(build, lightIndices + firstCount, secondCount, secondChild, nodeIndex, bitTrail | 1ull << depth, depth + 1);
+        }, &counter);
+    } else {
+        secondDepth = buildSubtree(build, lightIndices + firstCount, secondCount, secondChild, nodeIndex, bitTrail | 1ull << depth, depth + 1);
+    }
+
+    const uint32_t firstDepth = buildSubtree(build, lightIndices, firstCount, firstChild, nodeIndex, bitTrail, depth + 1);
+
+    build.jobSystem->wait(counter);
+
+    build.nodeBounds[nodeIndex] = unionLightBounds(build.nodeBounds[firstChild], build.nodeBounds[secondChild]);
+    build.nodes[nodeIndex].child = secondChild;
+
+    return 1 + (firstDepth > secondDepth ? firstDepth : secondDepth);
+}
+
+LightBounds getMeshLightBounds(const Mesh& mesh, const SceneTransform& transform) {
+    LightBounds bounds;
+
+    // Transform the box around the mesh's positions.
+    for (uint32_t row = 0; row < 3; ++row) {
+        float center = transform.m[row][3];
+        float extent = 0.0f;
+
+        for (uint32_t column = 0; column < 3; ++column) {
+            center += transform.m[row][column] * mesh.positionOffset[column];
+            extent += fabsf(transform.m[row][column]) * mesh.positionScale[column];
+        }
+
+        bounds.boundsMin[row] = center - extent;
+        bounds.boundsMax[row] = center + extent;
+    }
+
+    float scaleSquared[3];
+
+    for (uint32_t column = 0; column < 3; ++column) {
+        scaleSquared[column] = transform.m[0][column] * transform.m[0][column] + transform.m[1][column] * transform.m[1][column] +
+                               transform.m[2][column] * transform.m[2][column];
+    }
+
+    const float maxScaleSquared = fmaxf(scaleSquared[0], fmaxf(scaleSquared[1], scaleSquared[2]));
+    const float minScaleSquared = fminf(scaleSquared[0], fminf(scaleSquared[1], scaleSquared[2]));
+
+    // Normals only keep their angles under uniform scales, otherwise the cone is the whole sphere. Mirroring
+    // transforms flip the triangles, and with them the normals.
+    bounds.axis[0] = 0.0f;
+    bounds.axis[1] = 0.0f;
+    bounds.axis[2] = 1.0f;
+    bounds.cosNormalSpread = -1.0f;
+
+    if (mesh.normalCone[3] > -1.0f && maxScaleSquared > 0.0f && minScaleSquared > 0.999f * maxScaleSquared) {
+        const float (*m)[4] = transform.m;
+        const float determinant = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                                  m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+
+        const float sign = determinant < 0.0f ? -1.0f : 1.0f;
+        const float scale = sqrtf(maxScaleSquared);
+
+        for (uint32_t row = 0; row < 3; ++row) {
+            bounds.axis[row] = sign * (m[row][0] * mesh.normalCone[0] + m[row][1] * mesh.normalCone[1] + m[row][2] * mesh.normalCone[2]) / scale;
+        }
+
+        bounds.cosNormalSpread = mesh.normalCone[3];
+    }
+
+    // The area grows with the square of the scale, the largest axis bounds it for non-uniform scales.
+    bounds.cosEmissionSpread = 0.0f;
+    bounds.power = mesh.emittedPower * maxScaleSquared;
+
+    return bounds;
+}
+
+LightBounds getPointLightBounds(const float* position, float power) {
+    return {
+        .boundsMin         = { position[0], position[1], position[2] },
+        .boundsMax         = { position[0], position[1], position[2] },
+        .axis              = { 0.0f, 0.0f, 1.0f },
+        .cosNormalSpread   = -1.0f,
+        .cosEmissionSpread = 0.0f,
+        .power             = power
+    };
+}
+
+LightTree::LightTree(Device& device, uint32_t framesInFlight)
+        : framesInFlight(framesInFlight), frameIndex(0), version(1), rebuildNeeded(false), refitCount(0) {
+    frameBuffers = new FrameBuffer[framesInFlight];
+    createBuffers(device, initialCapacity);
+}
+
+void LightTree::destroy(VkDevice device) {
+    destroyBuffers(device);
+    delete[] frameBuffers;
+}
+
+uint32_t LightTree::addLight(const LightBounds& bounds) {
+    lights.push_back(bounds);
+    rebuildNeeded = true;
+
+    return (uint32_t)lights.size() - 1;
+}
+
+void LightTree::setLight(uint32_t light, const LightBounds& bounds) {
+    if (memcmp(&lights[light], &bounds, sizeof(LightBounds)) == 0) {
+        return;
+    }
+
+    lights[light] = bounds;
+    changedLights.push_back(light);
+}
+
+void LightTree::clear() {
+    lights.clear();
+    changedLights.clear();
+    rebuildNeeded = true;
+}
+
+bool LightTree::needsUpdate() {
+    return rebuildNeeded || !changedLights.empty();
+}
+
+void LightTree::update(Device& device, JobSystem& jobSystem) {
+    if (rebuildNeeded || (!changedLights.empty() && refitCount >= maxRefitCount)) {
+        build(jobSystem);
+    } else if (!changedLights.empty()) {
+        refit();
+        quantizeNodes(jobSystem);
+    }
+
+    frameIndex = (frameIndex + 1) % framesInFlight;
+
+    if (lightCount == 0) {
+        return;
+    }
+
+    const VkDeviceSize size = sizeof(LightTreeHeader) + nodeCount * sizeof(LightTreeNode) + lightCount * sizeof(uint64_t);
+
+    if (size > capacity) {
+        // Frames in flight may still read the other copies.
+        vkQueueWaitIdle(device.renderQueue);
+
+        VkDeviceSize newCapacity = capacity;
+
+        while (newCapacity < size) {
+            newCapacity *= 2;
+        }
+
+        destroyBuffers(device.logical);
+        createBuffers(device, newCapacity);
+    }
+
+    FrameBuffer& frameBuffer = frameBuffers[frameIndex];
+
+    if (frameBuffer.version == version) {
+        return;
+    }
+
+    const LightTreeHeader header = {
+        .boundsMin    = { boundsMin[0], boundsMin[1], boundsMin[2] },
+        .nodeCount    = nodeCount,
+        .boundsExtent = { boundsExtent[0], boundsExtent[1], boundsExtent[2] },
+        .lightCount   = lightCount
+    };
+
+    uint8_t* data = frameBuffer.data;
+
+    memcpy(data, &header, sizeof(header));
+    data += sizeof(header);
+
+    memcpy(data, nodes.data(), nodeCount * sizeof(LightTreeNode));
+    data += nodeCount * sizeof(LightTreeNode);
+
+    memcpy(data, bitTrails.data(), lightCount * sizeof(uint64_t));
+
+    frameBuffer.version = version;
+}
+
+VkDeviceAddress LightTree::getDeviceAddress() {
+    return lightCount > 0 ? frameBuffers[frameIndex].address : 0;
+}
+
+void LightTree::build(JobSystem& jobSystem) {
+    lightCount = (uint32_t)lights.size();
+    nodeCount = lightCount > 0 ? 2 * lightCount - 1 : 0;
+
+    nodeBounds.resize(nodeCount);
+    nodes.resize(nodeCount);
+    parents.resize(nodeCount);
+    leaves.resize(lightCount);
+    bitTrails.resize(lightCount);
+
+    depth = 0;
+
+    if (lightCount > 0) {
+        uint32_t* lightIndices = new uint32_t[lightCount];
+
+        for (uint32_t i = 0; i < lightCount; ++i) {
+            lightIndices[i] = i;
+        }
+
+        const LightTreeBuild build = {
+            .jobSystem  = &jobSystem,
+            .lights     = lights.data(),
+            .nodeBounds = nodeBounds.data(),
+            .nodes      = nodes.data(),
+            .parents    = parents.data(),
+            .leaves     = leaves.data(),
+            .bitTrails  = bitTrails.data()
+        };
+
+        depth = buildSubtree(build, lightIndices, lightCount, 0, UINT32_MAX, 0, 0);
+
+        delete[] lightIndices;
+    }
+
+    changedLights.clear();
+    rebuildNeeded = false;
+    refitCount = 0;
+
+    quantizeNodes(jobSystem);
+}
+
+void LightTree::refit() {
+    // Children always come after their parent, so refitting in reverse order refits children first.
+    std::vector<uint32_t> changedNodes;
+
+    for (uint32_t light : changedLights) {
+        const uint32_t leaf = leaves[light];
+
+        nodeBounds[leaf] = lights[light];
+        changedNodes.push_back(leaf);
+
+        for (uint32_t node = parents[leaf]; node != UINT32_MAX; node = parents[node]) {
+            changedNodes.push_back(node);
+        }
+    }
+
+    std::sort(changedNodes.begin(), changedNodes.end(), std::greater<uint32_t>());
+    changedNodes.erase(std::unique(changedNodes.begin(), changedNodes.end()), changedNodes.end());
+
+    for (uint32_t node : changedNodes) {
+        if (!(nodes[node].child & LIGHT_TREE_LEAF)) {
+            nodeBounds[node] = unionLightBounds(nodeBounds[node + 1], nodeBounds[nodes[node].child]);
+        }
+    }
+
+    changedLights.clear();
+    ++refitCount;
+}
+
+void LightTree::quantizeNodes(JobSystem& jobSystem) {
+    if (nodeCount == 0) {
+        ++version;
+        return;
+    }
+
+    // Nodes are quantized against the root's bounds, which hold every light with power.
+    for (uint32_t c = 0; c < 3; ++c) {
+        boundsMin[c] = nodeBounds[0].boundsMin[c];
+        boundsExtent[c] = nodeBounds[0].boundsMax[c] - nodeBounds[0].boundsMin[c];
+    }
+    jobSystem.parallelFor(nodeCount, quantizeGrainSize, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            const LightBounds& bounds = nodeBounds[i];
+            LightTreeNode& node = nodes[i];
+
+            for (uint32_t c = 0; c < 3; ++c) {
+                const float scale = boundsExtent[c] > 0.0f ? 65535.0f / boundsExtent[c] : 0.0f;
+
+                node.boundsMin[c] = (uint16_t)fminf(fmaxf(floorf((bounds.boundsMin[c] - boundsMin[c]) * scale), 0.0f), 65535.0f);
+                node.boundsMax[c] = (uint16_t)fminf(fmaxf(ceilf((bounds.boundsMax[c] - boundsMin[c]) * scale), 0.0f), 65535.0f);
+            }
+
+            encodeOctahedral(bounds.axis, node.axis);
+
+            // Widen the normal cone by the axis' error, unless it's already the whole sphere.
+            float cosNormalSpread = bounds.cosNormalSpread;
+
+            if (cosNormalSpread > -1.0f) {
+                cosNormalSpread = cosf(fminf(acosf(fminf(cosNormalSpread, 1.0f)) + axisQuantizationError, pi));
+            }
+
+            node.cosNormalSpread = (uint16_t)fmaxf(floorf((cosNormalSpread + 1.0f) * 0.5f * 65535.0f), 0.0f);
+            node.cosEmissionSpread = (uint16_t)fmaxf(floorf((bounds.cosEmissionSpread + 1.0f) * 0.5f * 65535.0f), 0.0f);
+            node.power = bounds.power;
+            node.padding = 0;
+        }
+    });
+
+    ++version;
+}
+
+void LightTree::createBuffers(Device& device, VkDeviceSize capacity) {
+    this->capacity = capacity;
+
+    for (uint32_t i = 0; i < framesInFlight; ++i) {
+        FrameBuffer& frameBuffer = frameBuffers[i];
+
+        frameBuffer.buffer = Buffer(device, capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        vkMapMemory(device.logical, frameBuffer.buffer.memory, 0, VK_WHOLE_SIZE, 0, (void**)&frameBuffer.data);
+
+        frameBuffer.address = frameBuffer.buffer.getDeviceAddress(device.logical);
+        frameBuffer.version = 0;
+    }
+}
+
+void LightTree::destroyBuffers(VkDevice device) {
+    for (uint32_t i = 0; i < framesInFlight; ++i) {
+        frameBuffers[i].buffer.destroy(device);
+    }
+}
@@ -0,0 +1,176 @@
+// Picks a light by walking the light tree from the root, choosing between the two children of every node in proportion
+// to how much they may contribute to the shaded point, and evaluates the probability of a given light by following its
+// bit trail, for multiple importance sampling. Include after geometry.glsl, which decodes the octahedral axis.
+
+#extension GL_EXT_buffer_reference : enable
+
+#define LIGHT_TREE_LEAF 0x80000000u
+#define LIGHT_TREE_NO_LIGHT 0xffffffffu
+
+// Nodes take two words each, the bit trails of the lights come after them, two per word.
+layout(buffer_reference, std430, buffer_reference_align = 16) readonly buffer LightTree {
+    vec3 boundsMin;
+    uint nodeCount;
+    vec3 boundsExtent;
+    uint lightCount;
+    uvec4 words[];
+};
+
+struct LightTreeNode {
+    vec3 boundsMin;
+    vec3 boundsMax;
+    vec3 axis;
+    float cosNormalSpread;
+    float cosEmissionSpread;
+    float power;
+    uint child;
+};
+
+LightTreeNode decodeLightTreeNode(LightTree tree, uint index) {
+    uvec4 first = tree.words[2 * index];
+    uvec4 second = tree.words[2 * index + 1];
+
+    vec3 boundsMin = vec3(first.x & 0xffff, first.x >> 16, first.y & 0xffff);
+    vec3 boundsMax = vec3(first.y >> 16, first.z & 0xffff, first.z >> 16);
+    vec2 cosines = unpackUnorm2x16(second.x) * 2.0 - 1.0;
+
+    LightTreeNode node;
+    node.boundsMin = tree.boundsMin + tree.boundsExtent * boundsMin / 65535.0;
+    node.boundsMax = tree.boundsMin + tree.boundsExtent * boundsMax / 65535.0;
+    node.axis = decodeOctahedral(unpackSnorm2x16(first.w));
+    node.cosNormalSpread = cosines.x;
+    node.cosEmissionSpread = cosines.y;
+    node.power = uintBitsToFloat(second.y);
+    node.child = second.z;
+
+    return node;
+}
+
+// cos(max(0, a - b)) and sin(max(0, a - b)) from the sines and cosines of the angles.
+float cosSubtractClamped(float sinA, float cosA, float sinB, float cosB) {
+    return cosA > cosB ? 1.0 : cosA * cosB + sinA * sinB;
+}
+
+float sinSubtractClamped(float sinA, float cosA, float sinB, float cosB) {
+    return cosA > cosB ? 0.0 : sinA * cosB - cosA * sinB;
+}
+
+// An upper bound of what the node's lights may contribute to the point, relative to other nodes. The angles are those
+// between the node's axis and the point, the node's normal spread, the spread of the box seen from the point and the
+// point's normal. A zero normal skips the cosine at the point, for volumes.
+float getLightImportance(LightTreeNode node, vec3 position, vec3 normal) {
+    vec3 center = 0.5 * (node.boundsMin + node.boundsMax);
+    vec3 toPoint = position - center;
+    float distanceSquared = dot(toPoint, toPoint);
+    float radiusSquared = dot(node.boundsMax - center, node.boundsMax - center);
+
+    // Points inside or near the box would get an unbounded importance.
+    float clampedDistanceSquared = max(distanceSquared, length(node.boundsMax - node.boundsMin) * 0.5);
+
+    vec3 direction = distanceSquared > 0.0 ? toPoint * inversesqrt(distanceSquared) : vec3(0.0);
+
+    float cosThetaW = dot(node.axis, direction);
+    float sinThetaW = sqrt(max(1.0 - cosThetaW * cosThetaW, 0.0));
+
+    float cosThetaB = distanceSquared < radiusSquared ? -1.0 : sqrt(max(1.0 - radiusSquared / distanceSquared, 0.0));
+    float sinThetaB = sqrt(max(1.0 - cosThetaB * cosThetaB, 0.0));
+
+    float sinThetaO = sqrt(max(1.0 - node.cosNormalSpread * node.cosNormalSpread, 0.0));
+
+    float cosThetaX = cosSubtractClamped(sinThetaW, cosThetaW, sinThetaO, node.cosNormalSpread);
+    float sinThetaX = sinSubtractClamped(sinThetaW, cosThetaW, sinThetaO, node.cosNormalSpread);
+    float cosThetaP = cosSubtractClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+
+    if (cosThetaP <= node.cosEmissionSpread) {
+        return 0.0;
+    }
+
+    float importance = node.power * cosThetaP / clampedDistanceSquared;
+
+    if (normal != vec3(0.0)) {
+        float cosThetaI = abs(dot(direction, normal));
+        float sinThetaI = sqrt(max(1.0 - cosThetaI * cosThetaI, 0.0));
+
+        importance *= cosSubtractClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+    }
+
+    return max(importance, 0.0);
+}
+
+// Returns the picked light, or LIGHT_TREE_NO_LIGHT if no light can reach the point, and the probability it was picked
+// with. The uniform number is rescaled at every node and reused for the next one.
+uint sampleLightTree(LightTree tree, vec3 position, vec3 normal, float u, out float probability) {
+    probability = 0.0;
+
+    if (tree.nodeCount == 0) {
+        return LIGHT_TREE_NO_LIGHT;
+    }
+
+    uint index = 0;
+    float pmf = 1.0;
+    LightTreeNode node = decodeLightTreeNode(tree, 0);
+
+    while ((node.child & LIGHT_TREE_LEAF) == 0) {
+        LightTreeNode firstChild = decodeLightTreeNode(tree, index + 1);
+        LightTreeNode secondChild = decodeLightTreeNode(tree, node.child);
+
+        float firstImportance = getLightImportance(firstChild, position, normal);
+        float secondImportance = getLightImportance(secondChild, position, normal);
+
+        if (firstImportance == 0.0 && secondImportance == 0.0) {
+            return LIGHT_TREE_NO_LIGHT;
+        }
+
+        float firstProbability = firstImportance / (firstImportance + secondImportance);
+
+        if (u < firstProbability) {
+            u = min(u / firstProbability, 0.99999994);
+            pmf *= firstProbability;
+            index = index + 1;
+            node = firstChild;
+        } else {
+            u = min((u - firstProbability) / (1.0 - firstProbability), 0.99999994);
+            pmf *= 1.0 - firstProbability;
+            index = node.child;
+            node = secondChild;
+        }
+    }
+
+    // A single light is only checked here, as there was no choice to make on the way.
+    if (index == 0 && getLightImportance(node, position, normal) == 0.0) {
+        return LIGHT_TREE_NO_LIGHT;
+    }
+
+    probability = pmf;
+    return node.child & ~LIGHT_TREE_LEAF;
+}
+
+float getLightTreeProbability(LightTree tree, uint light, vec3 position, vec3 normal) {
+    uvec4 trailWords = tree.words[2 * tree.nodeCount + light / 2];
+    uvec2 bitTrail = (light & 1) == 0 ? trailWords.xy : trailWords.zw;
+
+    uint index = 0;
+    float pmf = 1.0;
+    LightTreeNode node = decodeLightTreeNode(tree, 0);
+
+    while ((node.child & LIGHT_TREE_LEAF) == 0) {
+        LightTreeNode firstChild = decodeLightTreeNode(tree, index + 1);
+        LightTreeNode secondChild = decodeLightTreeNode(tree, node.child);
+
+        float firstImportance = getLightImportance(firstChild, position, normal);
+        float secondImportance = getLightImportance(secondChild, position, normal);
+
+        if (firstImportance == 0.0 && secondImportance == 0.0) {
+            return 0.0;
+        }
+
+        bool second = (bitTrail.x & 1) != 0;
+        bitTrail = uvec2((bitTrail.x >> 1) | (bitTrail.y << 31), bitTrail.y >> 1);
+
+        pmf *= (second ? secondImportance : firstImportance) / (firstImportance + secondImportance);
+        index = second ? node.child : index + 1;
+        node = second ? secondChild : firstChild;
+    }
+
+    return pmf;
+}
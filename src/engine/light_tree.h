@@ -0,0 +1,113 @@
+#pragma once
+
+#include <vector>
+
+#include "graphics.h"
+#include "jobs.h"
+#include "model.h"
+#include "scene.h"
+
+#define LIGHT_TREE_LEAF 0x80000000u
+
+// How a light or a group of lights is bounded: the box around the points that emit, the cone around their normals and
+// how far past those normals they emit, both as cosines of half angles, and the total power. Point lights have no
+// normals, their normal cone covers the whole sphere.
+struct LightBounds {
+    float boundsMin[3];
+    float boundsMax[3];
+    float axis[3];
+    float cosNormalSpread;
+    float cosEmissionSpread;
+    float power;
+};
+
+// Bounds an emissive mesh placed with the transform. Meshes emit like diffuse surfaces, from the front of their triangles.
+LightBounds getMeshLightBounds(const Mesh& mesh, const SceneTransform& transform);
+
+LightBounds getPointLightBounds(const float* position, float power);
+
+// Matches the std430 layout read by light_tree.glsl. Bounds are quantized against the tree's bounds, rounded outwards,
+// the axis is octahedral and the cosines are unorm16s of (cos + 1) / 2, rounded to a wider cone. Interior nodes are
+// followed by their first child, the child field holds the second one. Leaves hold LIGHT_TREE_LEAF | the light index.
+struct LightTreeNode {
+    uint16_t boundsMin[3];
+    uint16_t boundsMax[3];
+    int16_t axis[2];
+    uint16_t cosNormalSpread;
+    uint16_t cosEmissionSpread;
+    float power;
+    uint32_t child;
+    uint32_t padding;
+};
+
+// Precedes the nodes in the tree's buffer, which are followed by the bit trail of every light: the branches from the
+// root to its leaf, a set bit for the second child, starting from the least significant bit.
+struct LightTreeHeader {
+    float boundsMin[3];
+    uint32_t nodeCount;
+    float boundsExtent[3];
+    uint32_t lightCount;
+};
+
+// A bounding-cone BVH over the scene's lights, for shaders to pick a light with a probability that follows how much it
+// may contribute to the point being shaded. It's built on the job system with binned splits that weigh the power, box
+// and orientation of each side, and refit when lights move, walking up from the leaves of the lights that changed.
+// Every frame in flight has its own copy of the nodes, in host-visible memory.
+class LightTree {
+public:
+    uint32_t lightCount = 0;
+    uint32_t nodeCount = 0;
+    uint32_t depth = 0;
+
+    LightTree() = default;
+    LightTree(Device& device, uint32_t framesInFlight);
+    void destroy(VkDevice device);
+
+    // Adding lights rebuilds the tree on the next update, setting them only refits it if their bounds changed.
+    uint32_t addLight(const LightBounds& bounds);
+    void setLight(uint32_t light, const LightBounds& bounds);
+    void clear();
+
+    // Rebuilds or refits the tree and writes it into the next frame's copy. Only needed when lights were added, cleared
+    // or moved, until then frames keep using the last copy written. Call once the frame that last used the next copy
+    // has completed.
+    bool needsUpdate();
+    void update(Device& device, JobSystem& jobSystem);
+
+    // The address of the header in the copy written by the last update, 0 if there are no lights.
+    VkDeviceAddress getDeviceAddress();
+
+private:
+    struct FrameBuffer {
+        Buffer buffer;
+        uint8_t* data;
+        VkDeviceAddress address;
+        uint64_t version;
+    };
+
+    uint32_t framesInFlight;
+    uint32_t frameIndex;
+    FrameBuffer* frameBuffers;
+    VkDeviceSize capacity;
+
+    std::vector<LightBounds> lights;
+    std::vector<LightBounds> nodeBounds;
+    std::vector<LightTreeNode> nodes;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> leaves;
+    std::vector<uint64_t> bitTrails;
+    std::vector<uint32_t> changedLights;
+    float boundsMin[3];
+    float boundsExtent[3];
+
+    // Bumped whenever the nodes change, so that every frame's copy is brought up to date once.
+    uint64_t version;
+    bool rebuildNeeded;
+    uint32_t refitCount;
+
+    void build(JobSystem& jobSystem);
+    void refit();
+    void quantizeNodes(JobSystem& jobSystem);
+    void createBuffers(Device& device, VkDeviceSize capacity);
+    void destroyBuffers(VkDevice device);
+};
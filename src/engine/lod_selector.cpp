@@ -0,0 +1,173 @@
+#include "lod_selector.h"
+
+#include <math.h>
+
+// Instances are selected in batches of this many.
+static const uint32_t instanceGrainSize = 256;
+
+uint32_t LodSelector::addMesh(const Model& model, uint32_t meshIndex) {
+    const Mesh& mesh = model.meshes[meshIndex];
+
+    // The bounds the positions are quantized against are a box, the sphere around it is what's measured.
+    LodMesh lodMesh = {
+        .firstLod = (uint32_t)lods.size(),
+        .lodCount = mesh.lodCount,
+        .center   = { mesh.positionOffset[0], mesh.positionOffset[1], mesh.positionOffset[2] },
+        .radius   = sqrtf(mesh.positionScale[0] * mesh.positionScale[0] + mesh.positionScale[1] * mesh.positionScale[1] +
+                          mesh.positionScale[2] * mesh.positionScale[2])
+    };
+
+    for (uint32_t i = mesh.firstLod; i < mesh.firstLod + mesh.lodCount; ++i) {
+        const MeshLod& meshLod = model.lods[i];
+
+        lods.push_back({
+            .blasAddress = meshLod.blas.deviceAddress,
+            .size        = meshLod.blas.size,
+            .error       = meshLod.error
+        });
+
+        lodStamps.push_back(stamp);
+    }
+
+    if (mesh.lodCount > maxLodCount) {
+        maxLodCount = mesh.lodCount;
+    }
+
+    meshes.push_back(lodMesh);
+
+    return (uint32_t)meshes.size() - 1;
+}
+
+uint32_t LodSelector::getFirstLod(uint32_t mesh) {
+    return meshes[mesh].firstLod;
+}
+
+void LodSelector::addInstance(uint32_t mesh, uint32_t entity, uint32_t instance) {
+    lodInstances.push_back({
+        .mesh        = mesh,
+        .entity      = entity,
+        .instance    = instance,
+        .selectedLod = 0,
+        .lod         = 0
+    });
+}
+
+uint32_t LodSelector::update(JobSystem& jobSystem, Scene& scene, const LodView& view, VkAccelerationStructureInstanceKHR* instances) {
+    const uint32_t instanceCount = (uint32_t)lodInstances.size();
+
+    // Errors are compared in world units at the instance's distance, which saves a division per LOD.
+    const float errorPerDistance = errorThreshold / view.pixelsPerRadian;
+
+    jobSystem.parallelFor(instanceCount, instanceGrainSize, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            LodInstance& lodInstance = lodInstances[i];
+            const LodMesh& mesh = meshes[lodInstance.mesh];
+            const SceneTransform& transform = scene.getWorldTransform(lodInstance.entity);
+
+            float distanceSquared = 0.0f;
+            float scaleSquared = 0.0f;
+
+            for (uint32_t row = 0; row < 3; ++row) {
+                const float center = transform.m[row][0] * mesh.center[0] + transform.m[row][1] * mesh.center[1] +
+                                     transform.m[row][2] * mesh.center[2] + transform.m[row][3];
+
+                distanceSquared += (center - view.position[row]) * (center - view.position[row]);
+            }
+
+            // Errors scale with the largest axis of the transform.
+            for (uint32_t column = 0; column < 3; ++column) {
+                const float lengthSquared = transform.m[0][column] * transform.m[0][column] + transform.m[1][column] * transform.m[1][column] +
+                                            transform.m[2][column] * transform.m[2][column];
+
+                scaleSquared = fmaxf(scaleSquared, lengthSquared);
+            }
+
+            const float scale = sqrtf(scaleSquared);
+            const float distance = sqrtf(distanceSquared) - mesh.radius * scale;
+
+            // Inside the bounds, any error could be right in front of the view.
+            if (!(distance > 0.0f)) {
+                lodInstance.selectedLod = 0;
+                continue;
+            }
+
+            const float maxError = errorPerDistance * distance / scale;
+            const float maxCoarserError = maxError * (1.0f - hysteresis);
+
+            // Errors only grow along the chain.
+            uint32_t finestAllowed = 0;
+            uint32_t coarsestAllowed = 0;
+
+            for (uint32_t lod = 1; lod < mesh.lodCount; ++lod) {
+                const float error = lods[mesh.firstLod + lod].error;
+
+                if (error <= maxError) {
+                    finestAllowed = lod;
+                }
+
+                if (error <= maxCoarserError) {
+                    coarsestAllowed = lod;
+                }
+            }
+
+            // Refine as soon as the current LOD is too coarse, coarsen only once the next one is well within the threshold.
+            if (lodInstance.selectedLod > finestAllowed) {
+                lodInstance.selectedLod = finestAllowed;
+            } else if (lodInstance.selectedLod < coarsestAllowed) {
+                lodInstance.selectedLod = coarsestAllowed;
+            }
+        }
+    });
+
+    // Drop the finest levels until the LODs in use fit in the budget.
+    finestLevel = 0;
+    selectedSize = getSelectedSize(finestLevel);
+
+    while (selectedSize > memoryBudget && finestLevel + 1 < maxLodCount) {
+        selectedSize = getSelectedSize(++finestLevel);
+    }
+
+    // Only the instances whose LOD changed are written.
+    uint32_t changedCount = 0;
+
+    for (LodInstance& lodInstance : lodInstances) {
+        const LodMesh& mesh = meshes[lodInstance.mesh];
+
+        uint32_t lod = lodInstance.selectedLod > finestLevel ? lodInstance.selectedLod : finestLevel;
+        lod = lod < mesh.lodCount ? lod : mesh.lodCount - 1;
+
+        if (lod == lodInstance.lod) {
+            continue;
+        }
+
+        VkAccelerationStructureInstanceKHR& instance = instances[lodInstance.instance];
+        instance.accelerationStructureReference = lods[mesh.firstLod + lod].blasAddress;
+        instance.instanceCustomIndex = mesh.firstLod + lod;
+
+        lodInstance.lod = lod;
+        ++changedCount;
+    }
+
+    return changedCount;
+}
+
+VkDeviceSize LodSelector::getSelectedSize(uint32_t level) {
+    ++stamp;
+
+    VkDeviceSize size = 0;
+
+    // Instances that share a LOD share its BLAS, so it's only counted once.
+    for (const LodInstance& lodInstance : lodInstances) {
+        const LodMesh& mesh = meshes[lodInstance.mesh];
+
+        uint32_t lod = lodInstance.selectedLod > level ? lodInstance.selectedLod : level;
+        lod = mesh.firstLod + (lod < mesh.lodCount ? lod : mesh.lodCount - 1);
+
+        if (lodStamps[lod] != stamp) {
+            lodStamps[lod] = stamp;
+            size += lods[lod].size;
+        }
+    }
+
+    return size;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <vector>
+
+#include "model.h"
+#include "scene.h"
+
+#define LOD_NO_BUDGET UINT64_MAX
+
+// Where LODs are seen from. Pixels per radian is the viewport height over the vertical field of view.
+struct LodView {
+    float position[3];
+    float pixelsPerRadian;
+};
+
+// Picks the LOD of every instance each frame from how many pixels its error would cover on screen, measured from the
+// nearest point of the mesh's bounding sphere, and points the TLAS instances whose LOD changed at the new BLAS.
+class LodSelector {
+public:
+    // Instances get the coarsest LOD whose error covers at most this many pixels.
+    float errorThreshold = 1.0f;
+
+    // Moving to a coarser LOD needs its error to be this fraction below the threshold, so instances near the distance
+    // where LODs change don't keep popping between them.
+    float hysteresis = 0.25f;
+
+    // Over budget, the finest LOD level still in use is dropped from every instance, then the next one, until the BLASes
+    // the instances use fit.
+    VkDeviceSize memoryBudget = LOD_NO_BUDGET;
+
+    // The BLAS memory of the LODs the last update selected, and the finest level the budget allowed.
+    VkDeviceSize selectedSize = 0;
+    uint32_t finestLevel = 0;
+
+    // Registers a mesh of a loaded model. Returns the handle instances of it are added with.
+    uint32_t addMesh(const Model& model, uint32_t meshIndex);
+
+    // LODs are numbered across every mesh added so far, in order, and instances get the number of their LOD as their
+    // custom index. Returns the number of the mesh's finest LOD.
+    uint32_t getFirstLod(uint32_t mesh);
+
+    // The TLAS instance has to start out with the mesh's finest LOD, the next update picks its LOD.
+    void addInstance(uint32_t mesh, uint32_t entity, uint32_t instance);
+
+    // Call after the scene's world transforms are updated. Returns the number of instances written.
+    uint32_t update(JobSystem& jobSystem, Scene& scene, const LodView& view, VkAccelerationStructureInstanceKHR* instances);
+
+private:
+    struct LodMesh {
+        uint32_t firstLod;
+        uint32_t lodCount;
+        float center[3];
+        float radius;
+    };
+
+    struct Lod {
+        VkDeviceAddress blasAddress;
+        VkDeviceSize size;
+        float error;
+    };
+
+    // The selected LOD is what the view asks for, which the budget may make coarser.
+    struct LodInstance {
+        uint32_t mesh;
+        uint32_t entity;
+        uint32_t instance;
+        uint32_t selectedLod;
+        uint32_t lod;
+    };
+
+    std::vector<LodMesh> meshes;
+    std::vector<Lod> lods;
+    std::vector<LodInstance> lodInstances;
+
+    // Marks the LODs already counted towards the budget, with a different stamp for every pass.
+    std::vector<uint32_t> lodStamps;
+    uint32_t stamp = 0;
+
+    uint32_t maxLodCount = 0;
+
+    VkDeviceSize getSelectedSize(uint32_t level);
+};
@@ -0,0 +1,579 @@
+#include "mesh_optimizer.h"
+
+#include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+
+#include "hash.h"
+#include "image.h"
+
+static const uint32_t emptySlot = UINT32_MAX;
+
+// Border planes count this many times more than the planes of the triangles, so that open edges keep their shape.
+static const double borderWeight = 10.0;
+
+// A symmetric 4x4 matrix that sums the squared distances to a set of planes, stored as its upper triangle.
+struct Quadric {
+    double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+};
+
+// A candidate collapse of one vertex onto another. It's stale once either vertex has been collapsed onto since.
+struct Collapse {
+    float cost;
+    uint32_t from;
+    uint32_t to;
+    uint32_t fromVersion;
+    uint32_t toVersion;
+};
+
+// Spreads the low 10 bits of the value so that there are two zero bits between each of them.
+static uint32_t spreadBits(uint32_t value) {
+    value &= 0x3ff;
+    value = (value | (value << 16)) & 0x030000ff;
+    value = (value | (value << 8)) & 0x0300f00f;
+    value = (value | (value << 4)) & 0x030c30c3;
+    value = (value | (value << 2)) & 0x09249249;
+    return value;
+}
+
+static int16_t quantizeSnorm(float value) {
+    const float clamped = fminf(fmaxf(value, -1.0f), 1.0f);
+    return (int16_t)lrintf(clamped * 32767.0f);
+}
+
+static float dequantizeSnorm(int16_t value) {
+    return fmaxf(value / 32767.0f, -1.0f);
+}
+
+void encodeOctahedral(const float* normal, int16_t* destination) {
+    const float length = fabsf(normal[0]) + fabsf(normal[1]) + fabsf(normal[2]);
+    float x = normal[0] / length;
+    float y = normal[1] / length;
+
+    if (normal[2] < 0.0f) {
+        const float foldedX = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float foldedY = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+
+        x = foldedX;
+        y = foldedY;
+    }
+
+    destination[0] = quantizeSnorm(x);
+    destination[1] = quantizeSnorm(y);
+}
+
+static void weldVertices(const Vertex* vertices, uint32_t vertexCount, uint32_t* remap) {
+    uint32_t tableSize = 1;
+
+    while (tableSize < 2 * vertexCount) {
+        tableSize *= 2;
+    }
+
+    uint32_t* table = new uint32_t[tableSize];
+
+    for (uint32_t i = 0; i < tableSize; ++i) {
+        table[i] = emptySlot;
+    }
+
+    for (uint32_t i = 0; i < vertexCount; ++i) {
+        uint32_t slot = (uint32_t)hashData(&vertices[i], sizeof(Vertex)) & (tableSize - 1);
+
+        // Linear probing, the table is never more than half full.
+        while (table[slot] != emptySlot && memcmp(&vertices[table[slot]], &vertices[i], sizeof(Vertex)) != 0) {
+            slot = (slot + 1) & (tableSize - 1);
+        }
+
+        if (table[slot] == emptySlot) {
+            table[slot] = i;
+        }
+
+        remap[i] = table[slot];
+    }
+
+    delete[] table;
+}
+
+void sortTriangles(const Vertex* vertices, uint32_t* indices, uint32_t triangleCount) {
+    float* centroids = new float[3 * triangleCount];
+    float min[3] = { INFINITY, INFINITY, INFINITY };
+    float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+    for (uint32_t i = 0; i < triangleCount; ++i) {
+        for (uint32_t c = 0; c < 3; ++c) {
+            const float centroid = (vertices[indices[3 * i]].position[c] + vertices[indices[3 * i + 1]].position[c] +
+                                    vertices[indices[3 * i + 2]].position[c]) / 3.0f;
+
+            centroids[3 * i + c] = centroid;
+            min[c] = fminf(min[c], centroid);
+            max[c] = fmaxf(max[c], centroid);
+        }
+    }
+
+    // Keys hold the Morton code in the high bits and the triangle in the low bits, so sorting them keeps ties in order.
+    uint64_t* keys = new uint64_t[triangleCount];
+
+    for (uint32_t i = 0; i < triangleCount; ++i) {
+        uint32_t code = 0;
+
+        for (uint32_t c = 0; c < 3; ++c) {
+            const float extent = max[c] - min[c];
+            const float t = extent > 0.0f ? (centroids[3 * i + c] - min[c]) / extent : 0.0f;
+
+            // Non-finite positions end up wherever the comparisons put them, they only cost locality.
+            const uint32_t cell = t >= 0.0f ? (uint32_t)fminf(t * 1023.0f, 1023.0f) : 0;
+            code |= spreadBits(cell) << c;
+        }
+
+        keys[i] = (uint64_t)code << 32 | i;
+    }
+
+    std::sort(keys, keys + triangleCount);
+
+    uint32_t* sortedIndices = new uint32_t[3 * triangleCount];
+
+    for (uint32_t i = 0; i < triangleCount; ++i) {
+        memcpy(&sortedIndices[3 * i], &indices[3 * (uint32_t)keys[i]], 3 * sizeof(uint32_t));
+    }
+
+    memcpy(indices, sortedIndices, 3 * triangleCount * sizeof(uint32_t));
+
+    delete[] sortedIndices;
+    delete[] keys;
+    delete[] centroids;
+}
+
+static void addPlane(Quadric& quadric, const double* normal, double distance, double weight) {
+    quadric.xx += weight * normal[0] * normal[0];
+    quadric.xy += weight * normal[0] * normal[1];
+    quadric.xz += weight * normal[0] * normal[2];
+    quadric.xw += weight * normal[0] * distance;
+    quadric.yy += weight * normal[1] * normal[1];
+    quadric.yz += weight * normal[1] * normal[2];
+    quadric.yw += weight * normal[1] * distance;
+    quadric.zz += weight * normal[2] * normal[2];
+    quadric.zw += weight * normal[2] * distance;
+    quadric.ww += weight * distance * distance;
+}
+
+static void addQuadric(Quadric& quadric, const Quadric& other) {
+    quadric.xx += other.xx;
+    quadric.xy += other.xy;
+    quadric.xz += other.xz;
+    quadric.xw += other.xw;
+    quadric.yy += other.yy;
+    quadric.yz += other.yz;
+    quadric.yw += other.yw;
+    quadric.zz += other.zz;
+    quadric.zw += other.zw;
+    quadric.ww += other.ww;
+}
+
+static double evaluateQuadric(const Quadric& quadric, const float* position) {
+    const double x = position[0], y = position[1], z = position[2];
+
+    return quadric.xx * x * x + 2.0 * quadric.xy * x * y + 2.0 * quadric.xz * x * z + 2.0 * quadric.xw * x +
+           quadric.yy * y * y + 2.0 * quadric.yz * y * z + 2.0 * quadric.yw * y +
+           quadric.zz * z * z + 2.0 * quadric.zw * z + quadric.ww;
+}
+
+static void getTriangleNormal(const float* a, const float* b, const float* c, double* normal) {
+    const double ab[3] = { (double)b[0] - a[0], (double)b[1] - a[1], (double)b[2] - a[2] };
+    const double ac[3] = { (double)c[0] - a[0], (double)c[1] - a[1], (double)c[2] - a[2] };
+
+    normal[0] = ab[1] * ac[2] - ab[2] * ac[1];
+    normal[1] = ab[2] * ac[0] - ab[0] * ac[2];
+    normal[2] = ab[0] * ac[1] - ab[1] * ac[0];
+}
+
+static bool normalize(double* vector) {
+    const double length = sqrt(vector[0] * vector[0] + vector[1] * vector[1] + vector[2] * vector[2]);
+
+    if (!(length > 0.0)) {
+        return false;
+    }
+
+    vector[0] /= length;
+    vector[1] /= length;
+    vector[2] /= length;
+
+    return true;
+}
+
+void optimizeMesh(Vertex* vertices, uint32_t& vertexCount, uint32_t* indices, uint32_t& indexCount) {
+    uint32_t* remap = new uint32_t[vertexCount];
+    weldVertices(vertices, vertexCount, remap);
+
+    // Point the triangles at the welded vertices, dropping the ones that are left without an area.
+    uint32_t triangleCount = 0;
+
+    for (uint32_t i = 0; i + 2 < indexCount; i += 3) {
+        if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount) {
+            continue;
+        }
+
+        const uint32_t a = remap[indices[i]];
+        const uint32_t b = remap[indices[i + 1]];
+        const uint32_t c = remap[indices[i + 2]];
+
+        if (a == b || b == c || c == a) {
+            continue;
+        }
+
+        indices[3 * triangleCount]     = a;
+        indices[3 * triangleCount + 1] = b;
+        indices[3 * triangleCount + 2] = c;
+
+        ++triangleCount;
+    }
+
+    indexCount = 3 * triangleCount;
+
+    sortTriangles(vertices, indices, triangleCount);
+
+    // Renumber the vertices in the order they are first used, which also drops the ones that no triangle uses.
+    for (uint32_t i = 0; i < vertexCount; ++i) {
+        remap[i] = emptySlot;
+    }
+
+    Vertex* orderedVertices = new Vertex[vertexCount];
+    uint32_t orderedCount = 0;
+
+    for (uint32_t i = 0; i < indexCount; ++i) {
+        if (remap[indices[i]] == emptySlot) {
+            orderedVertices[orderedCount] = vertices[indices[i]];
+            remap[indices[i]] = orderedCount++;
+        }
+
+        indices[i] = remap[indices[i]];
+    }
+
+    memcpy(vertices, orderedVertices, orderedCount * sizeof(Vertex));
+    vertexCount = orderedCount;
+
+    delete[] orderedVertices;
+    delete[] remap;
+}
+
+uint32_t simplifyMesh(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+                      uint32_t targetIndexCount, uint32_t* destination, float& error) {
+    const uint32_t triangleCount = indexCount / 3;
+
+    std::vector<uint32_t> triangles(indices, indices + 3 * triangleCount);
+    std::vector<Quadric> quadrics(vertexCount, Quadric{});
+    std::vector<std::vector<uint32_t>> vertexTriangles(vertexCount);
+    std::unordered_map<uint64_t, uint32_t> edgeTriangles;
+
+    auto getEdgeKey = [](uint32_t a, uint32_t b) {
+        return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+    };
+
+    // Every vertex starts with the planes of the triangles around it.
+    for (uint32_t i = 0; i < triangleCount; ++i) {
+        const uint32_t* triangle = &triangles[3 * i];
+        double normal[3];
+        getTriangleNormal(vertices[triangle[0]].position, vertices[triangle[1]].position, vertices[triangle[2]].position, normal);
+
+        if (normalize(normal)) {
+            const float* p = vertices[triangle[0]].position;
+            const double distance = -(normal[0] * p[0] + normal[1] * p[1] + normal[2] * p[2]);
+
+            for (uint32_t j = 0; j < 3; ++j) {
+                addPlane(quadrics[triangle[j]], normal, distance, 1.0);
+            }
+        }
+
+        for (uint32_t j = 0; j < 3; ++j) {
+            vertexTriangles[triangle[j]].push_back(i);
+            ++edgeTriangles[getEdgeKey(triangle[j], triangle[(j + 1) % 3])];
+        }
+    }
+
+    // Edges with a single triangle are borders, they get a plane through them that's perpendicular to the triangle.
+    for (uint32_t i = 0; i < triangleCount; ++i) {
+        const uint32_t* triangle = &triangles[3 * i];
+        double normal[3];
+        getTriangleNormal(vertices[triangle[0]].position, vertices[triangle[1]].position, vertices[triangle[2]].position, normal);
+
+        for (uint32_t j = 0; j < 3; ++j) {
+            const uint32_t a = triangle[j];
+            const uint32_t b = triangle[(j + 1) % 3];
+
+            if (edgeTriangles[getEdgeKey(a, b)] != 1) {
+                continue;
+            }
+
+            const float* pa = vertices[a].position;
+            const float* pb = vertices[b].position;
+            const double edge[3] = { (double)pb[0] - pa[0], (double)pb[1] - pa[1], (double)pb[2] - pa[2] };
+
+            double borderNormal[3] = {
+                edge[1] * normal[2] - edge[2] * normal[1],
+                edge[2] * normal[0] - edge[0] * normal[2],
+                edge[0] * normal[1] - edge[1] * normal[0]
+            };
+
+            if (normalize(borderNormal)) {
+                const double distance = -(borderNormal[0] * pa[0] + borderNormal[1] * pa[1] + borderNormal[2] * pa[2]);
+
+                addPlane(quadrics[a], borderNormal, distance, borderWeight);
+                addPlane(quadrics[b], borderNormal, distance, borderWeight);
+            }
+        }
+    }
+
+    edgeTriangles.clear();
+
+    std::vector<bool> removedTriangles(triangleCount, false);
+    std::vector<bool> removedVertices(vertexCount, false);
+    std::vector<uint32_t> versions(vertexCount, 0);
+
+    auto compareCollapses = [](const Collapse& a, const Collapse& b) {
+        return a.cost > b.cost;
+    };
+
+    std::priority_queue<Collapse, std::vector<Collapse>, decltype(compareCollapses)> collapses(compareCollapses);
+
+    // Either end of an edge can be collapsed onto the other, whichever moves the surface the least.
+    auto addCollapse = [&](uint32_t a, uint32_t b) {
+        Quadric quadric = quadrics[a];
+        addQuadric(quadric, quadrics[b]);
+
+        const double costToB = evaluateQuadric(quadric, vertices[b].position);
+        const double costToA = evaluateQuadric(quadric, vertices[a].position);
+
+        if (costToB <= costToA) {
+            collapses.push({ (float)costToB, a, b, versions[a], versions[b] });
+        } else {
+            collapses.push({ (float)costToA, b, a, versions[b], versions[a] });
+        }
+    };
+
+    // Interior edges are queued from both of their triangles, the copy is stale by the time it comes up if the edge collapsed.
+    for (uint32_t i = 0; i < 3 * triangleCount; ++i) {
+        addCollapse(triangles[i], triangles[i - i % 3 + (i + 1) % 3]);
+    }
+
+    uint32_t remainingCount = triangleCount;
+    double maxCost = 0.0;
+
+    while (3 * remainingCount > targetIndexCount && !collapses.empty()) {
+        const Collapse collapse = collapses.top();
+        collapses.pop();
+
+        if (removedVertices[collapse.from] || removedVertices[collapse.to] ||
+            versions[collapse.from] != collapse.fromVersion || versions[collapse.to] != collapse.toVersion) {
+            continue;
+        }
+
+        // Triangles that don't contain both vertices stay, and must not be turned over by the move.
+        bool flips = false;
+
+        for (uint32_t triangleIndex : vertexTriangles[collapse.from]) {
+            const uint32_t* triangle = &triangles[3 * triangleIndex];
+
+            if (removedTriangles[triangleIndex] || triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                continue;
+            }
+
+            const float* positions[3];
+            const float* movedPositions[3];
+
+            for (uint32_t j = 0; j < 3; ++j) {
+                positions[j] = vertices[triangle[j]].position;
+                movedPositions[j] = triangle[j] == collapse.from ? vertices[collapse.to].position : positions[j];
+            }
+
+            double normal[3], movedNormal[3];
+            getTriangleNormal(positions[0], positions[1], positions[2], normal);
+            getTriangleNormal(movedPositions[0], movedPositions[1], movedPositions[2], movedNormal);
+
+            if (normal[0] * movedNormal[0] + normal[1] * movedNormal[1] + normal[2] * movedNormal[2] <= 0.0) {
+                flips = true;
+                break;
+            }
+        }
+
+        if (flips) {
+            continue;
+        }
+
+        // Move the triangles over, the ones along the edge disappear.
+        for (uint32_t triangleIndex : vertexTriangles[collapse.from]) {
+            uint32_t* triangle = &triangles[3 * triangleIndex];
+
+            if (removedTriangles[triangleIndex]) {
+                continue;
+            }
+
+            if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                removedTriangles[triangleIndex] = true;
+                --remainingCount;
+                continue;
+            }
+
+            for (uint32_t j = 0; j < 3; ++j) {
+                if (triangle[j] == collapse.from) {
+                    triangle[j] = collapse.to;
+                }
+            }
+
+            vertexTriangles[collapse.to].push_back(triangleIndex);
+        }
+
+        addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+        removedVertices[collapse.from] = true;
+        ++versions[collapse.to];
+
+        std::vector<uint32_t>().swap(vertexTriangles[collapse.from]);
+
+        if (collapse.cost > maxCost) {
+            maxCost = collapse.cost;
+        }
+
+        // Drop the triangles that are gone and queue the edges around the vertex again.
+        std::vector<uint32_t>& toTriangles = vertexTriangles[collapse.to];
+
+        toTriangles.erase(std::remove_if(toTriangles.begin(), toTriangles.end(), [&](uint32_t triangleIndex) {
+            return removedTriangles[triangleIndex];
+        }), toTriangles.end());
+
+        for (uint32_t triangleIndex : toTriangles) {
+            for (uint32_t j = 0; j < 3; ++j) {
+                const uint32_t vertex = triangles[3 * triangleIndex + j];
+
+                if (vertex != collapse.to) {
+                    addCollapse(collapse.to, vertex);
+                }
+            }
+        }
+    }
+
+    uint32_t writtenCount = 0;
+
+    for (uint32_t i = 0; i < triangleCount; ++i) {
+        if (!removedTriangles[i]) {
+            memcpy(&destination[3 * writtenCount++], &triangles[3 * i], 3 * sizeof(uint32_t));
+        }
+    }
+
+    const float distance = (float)sqrt(maxCost);
+
+    if (distance > error) {
+        error = distance;
+    }
+
+    return 3 * writtenCount;
+}
+
+void quantizeVertices(const Vertex* vertices, uint32_t vertexCount, QuantizedVertex* destination, float* positionOffset, float* positionScale) {
+    float min[3] = { INFINITY, INFINITY, INFINITY };
+    float max[3] = { -INFINITY, -INFINITY, -INFINITY };
+
+    for (uint32_t i = 0; i < vertexCount; ++i) {
+        for (uint32_t c = 0; c < 3; ++c) {
+            min[c] = fminf(min[c], vertices[i].position[c]);
+            max[c] = fmaxf(max[c], vertices[i].position[c]);
+        }
+    }
+
+    for (uint32_t c = 0; c < 3; ++c) {
+        positionOffset[c] = vertexCount > 0 ? 0.5f * (min[c] + max[c]) : 0.0f;
+        positionScale[c] = vertexCount > 0 ? 0.5f * (max[c] - min[c]) : 0.0f;
+    }
+
+    for (uint32_t i = 0; i < vertexCount; ++i) {
+        const Vertex& vertex = vertices[i];
+        QuantizedVertex& quantizedVertex = destination[i];
+
+        for (uint32_t c = 0; c < 3; ++c) {
+            // Flat meshes have no extent along one of the axes, their positions are all the offset.
+            quantizedVertex.position[c] = positionScale[c] > 0.0f ? quantizeSnorm((vertex.position[c] - positionOffset[c]) / positionScale[c]) : 0;
+        }
+
+        // Vertices without a normal have it zeroed, the hit shaders fall back to the geometric normal.
+        const bool hasNormal = vertex.normal[0] != 0.0f || vertex.normal[1] != 0.0f || vertex.normal[2] != 0.0f;
+
+        quantizedVertex.position[3] = hasNormal ? 32767 : 0;
+
+        if (hasNormal) {
+            encodeOctahedral(vertex.normal, quantizedVertex.normal);
+        } else {
+            quantizedVertex.normal[0] = 0;
+            quantizedVertex.normal[1] = 0;
+        }
+
+        convertToHalf(vertex.uv, 2, quantizedVertex.uv);
+    }
+}
+
+void dequantizePositions(const QuantizedVertex* vertices, uint32_t vertexCount, const float* positionOffset, const float* positionScale, float* destination) {
+    for (uint32_t i = 0; i < vertexCount; ++i) {
+        for (uint32_t c = 0; c < 3; ++c) {
+            destination[3 * i + c] = positionOffset[c] + positionScale[c] * dequantizeSnorm(vertices[i].position[c]);
+        }
+    }
+}
+
+void measureSurface(const Vertex* vertices, const uint32_t* indices, uint32_t indexCount, float& surfaceArea, float* normalCone) {
+    double area = 0.0;
+    double axis[3] = { 0.0, 0.0, 0.0 };
+
+    // The cross product of two edges is the triangle's normal scaled by twice its area.
+    auto getScaledNormal = [&](uint32_t triangle, float* normal) {
+        const float* p0 = vertices[indices[3 * triangle]].position;
+        const float* p1 = vertices[indices[3 * triangle + 1]].position;
+        const float* p2 = vertices[indices[3 * triangle + 2]].position;
+
+        const float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        const float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+
+        normal[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        normal[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        normal[2] = e1[0] * e2[1] - e1[1] * e2[0];
+
+        return sqrtf(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+    };
+
+    for (uint32_t i = 0; i < indexCount / 3; ++i) {
+        float normal[3];
+        area += 0.5 * getScaledNormal(i, normal);
+
+        for (uint32_t c = 0; c < 3; ++c) {
+            axis[c] += normal[c];
+        }
+    }
+
+    surfaceArea = (float)area;
+
+    // The axis is the area-weighted average normal, and the cone widens until it holds every triangle's normal.
+    const double axisLength = sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+
+    if (!(axisLength > 0.0)) {
+        normalCone[0] = 0.0f;
+        normalCone[1] = 0.0f;
+        normalCone[2] = 1.0f;
+        normalCone[3] = -1.0f;
+        return;
+    }
+
+    float cosAngle = 1.0f;
+
+    for (uint32_t c = 0; c < 3; ++c) {
+        normalCone[c] = (float)(axis[c] / axisLength);
+    }
+
+    for (uint32_t i = 0; i < indexCount / 3; ++i) {
+        float normal[3];
+        const float length = getScaledNormal(i, normal);
+
+        if (length > 0.0f) {
+            cosAngle = fminf(cosAngle, (normal[0] * normalCone[0] + normal[1] * normalCone[1] + normal[2] * normalCone[2]) / length);
+        }
+    }
+
+    normalCone[3] = cosAngle;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "model.h"
+
+// Welds vertices that are bitwise identical, drops degenerate triangles and triangles with out of range indices, and
+// reorders what's left for locality. Triangles are sorted along a Morton curve through their centroids, so that rays
+// hitting nearby triangles fetch nearby memory, and vertices are renumbered in the order the triangles first reference
+// them. The vertex and index counts are updated in place.
+void optimizeMesh(Vertex* vertices, uint32_t& vertexCount, uint32_t* indices, uint32_t& indexCount);
+
+// Collapses edges in order of their quadric error until the mesh has at most targetIndexCount indices, or no edge can
+// be collapsed without flipping a triangle. Vertices are only collapsed onto other vertices, so the simplified indices
+// still refer to the same vertices, and borders are weighted to stay in place. Writes the indices to the destination,
+// which may be the source, and returns how many there are. The error is raised to an estimate of the largest distance
+// the surface moved, in the units of the positions.
+uint32_t simplifyMesh(const Vertex* vertices, uint32_t vertexCount, const uint32_t* indices, uint32_t indexCount,
+                      uint32_t targetIndexCount, uint32_t* destination, float& error);
+
+// Sorts triangles along a Morton curve through their centroids.
+void sortTriangles(const Vertex* vertices, uint32_t* indices, uint32_t triangleCount);
+
+// Quantizes the vertices against the bounds of their positions, which are returned as the offset and scale that decode
+// them.
+void quantizeVertices(const Vertex* vertices, uint32_t vertexCount, QuantizedVertex* destination, float* positionOffset, float* positionScale);
+void dequantizePositions(const QuantizedVertex* vertices, uint32_t vertexCount, const float* positionOffset, const float* positionScale, float* destination);
+
+// Maps the unit sphere onto an octahedron, which is unfolded into the [-1, 1] square.
+void encodeOctahedral(const float* normal, int16_t* destination);
+
+// Sums the area of the triangles and bounds their normals with a cone, as its axis followed by the cosine of its half
+// angle, which is -1 when the normals point every way.
+void measureSurface(const Vertex* vertices, const uint32_t* indices, uint32_t indexCount, float& surfaceArea, float* normalCone);
@@ -0,0 +1,37 @@
+#include "model.h"
+
+#include "texture_streaming.h"
+
+void Model::destroy(VkDevice device, BindlessTables& bindlessTables, TextureStreamer& textureStreamer) {
+    for (uint32_t i = 0; i < lodCount; ++i) {
+        lods[i].blas.destroy(device);
+    }
+
+    for (uint32_t i = 0; i < textureCount; ++i) {
+        if (textureSlots[i] != BINDLESS_INVALID_INDEX) {
+            textureStreamer.removeTexture(textureSlots[i]);
+        }
+    }
+
+    if (materialBufferIndex != BINDLESS_INVALID_INDEX) {
+        bindlessTables.removeBuffer(materialBufferIndex);
+    }
+
+    if (geometryBufferIndex != BINDLESS_INVALID_INDEX) {
+        bindlessTables.removeBuffer(geometryBufferIndex);
+    }
+
+    if (meshCount > 0) {
+        blasBuffer.destroy(device);
+        geometryBuffer.destroy(device);
+        indexBuffer.destroy(device);
+        vertexBuffer.destroy(device);
+    }
+
+    materialBuffer.destroy(device);
+
+    delete[] nodes;
+    delete[] textureSlots;
+    delete[] lods;
+    delete[] meshes;
+}
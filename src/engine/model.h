@@ -0,0 +1,102 @@
+#pragma once
+
+#include "acceleration_structure.h"
+#include "bindless.h"
+
+// Vertices as they are decoded from the source asset, before the mesh optimizer quantizes them.
+struct Vertex {
+    float position[3];
+    float normal[3];
+    float uv[2];
+};
+
+// Vertices as they are stored and read by the hit shaders. Positions are snorm within the bounds of their mesh, and W is
+// 1 when the vertex has a normal so that they can be built into a BLAS as VK_FORMAT_R16G16B16A16_SNORM. Normals are
+// octahedral snorm and UVs are half floats.
+struct QuantizedVertex {
+    int16_t position[4];
+    int16_t normal[2];
+    uint16_t uv[2];
+};
+
+class TextureStreamer;
+
+// Matches the std430 layout of the material buffer read by the hit shaders. Textures are slots in the texture table,
+// normal textures only store X and Y so Z has to be reconstructed.
+struct Material {
+    float baseColorFactor[4];
+    float emissiveFactor[3];
+    float metallicFactor;
+    float roughnessFactor;
+    uint32_t baseColorTexture;
+    uint32_t metallicRoughnessTexture;
+    uint32_t normalTexture;
+    uint32_t emissiveTexture;
+    uint32_t sampler;
+    uint32_t padding[2];
+};
+
+// Matches the std430 layout of the geometry buffer read by the hit shaders, which is indexed by LOD, the same index
+// instances are given as their custom index. Positions are decoded as positionOffset + positionScale * position.
+struct MeshGeometry {
+    VkDeviceAddress vertexAddress;
+    VkDeviceAddress indexAddress;
+    float positionOffset[3];
+    uint32_t materialIndex;
+    float positionScale[3];
+    uint32_t padding;
+};
+
+// A range of the model's index buffer over the vertices of its mesh, with its own BLAS.
+struct MeshLod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    float error;
+    AccelerationStructure blas;
+};
+
+// A range of the model's vertex buffer and the LODs that index it, from the finest to the coarsest.
+struct Mesh {
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    uint32_t firstLod;
+    uint32_t lodCount;
+    uint32_t materialIndex;
+    float positionOffset[3];
+    float positionScale[3];
+    float surfaceArea;
+    float normalCone[4];
+
+    // What the mesh emits with its material's emissive factor, in object space, 0 for meshes that don't emit.
+    float emittedPower;
+};
+
+// Nodes are sorted so that parents always come before their children.
+struct ModelNode {
+    int32_t parent;
+    float transform[16];
+    uint32_t firstMesh;
+    uint32_t meshCount;
+};
+
+class Model {
+public:
+    uint32_t meshCount = 0;
+    Mesh* meshes = nullptr;
+    uint32_t lodCount = 0;
+    MeshLod* lods = nullptr;
+    uint32_t textureCount = 0;
+    uint32_t* textureSlots = nullptr;
+    uint32_t materialCount = 0;
+    uint32_t materialBufferIndex = BINDLESS_INVALID_INDEX;
+    uint32_t geometryBufferIndex = BINDLESS_INVALID_INDEX;
+    uint32_t nodeCount = 0;
+    ModelNode* nodes = nullptr;
+    Buffer vertexBuffer;
+    Buffer indexBuffer;
+    Buffer materialBuffer;
+    Buffer geometryBuffer;
+    Buffer blasBuffer;
+
+    void destroy(VkDevice device, BindlessTables& bindlessTables, TextureStreamer& textureStreamer);
+};
@@ -0,0 +1,495 @@
+#include "png_writer.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Matches can reach 32 KiB back, and are looked up through chains of earlier positions with the same 3 bytes.
+#define DEFLATE_WINDOW_SIZE 32768
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_MAX_CHAIN 8
+
+// Matches at least this long are taken without searching the rest of the chain.
+#define DEFLATE_GOOD_MATCH 32
+
+// Strips of about this many filtered bytes are deflated by one job.
+#define PNG_STRIP_SIZE (256 * 1024)
+
+#define ADLER_MODULUS 65521
+
+static const uint16_t lengthBases[29] = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+
+static const uint8_t lengthExtraBits[29] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const uint16_t distanceBases[30] = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193,
+    12289, 16385, 24577
+};
+
+static const uint8_t distanceExtraBits[30] = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+static const struct CrcTable {
+    uint32_t values[256];
+
+    CrcTable() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+
+            for (uint32_t j = 0; j < 8; ++j) {
+                crc = crc & 1 ? 0xedb88320 ^ (crc >> 1) : crc >> 1;
+            }
+
+            values[i] = crc;
+        }
+    }
+} crcTable;
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        crc = crcTable.values[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return crc;
+}
+
+static uint32_t computeAdler(const uint8_t* data, size_t size) {
+    uint32_t a = 1;
+    uint32_t b = 0;
+
+    // 5552 bytes is the most that can be summed before b could overflow.
+    while (size > 0) {
+        const size_t blockSize = size < 5552 ? size : 5552;
+
+        for (size_t i = 0; i < blockSize; ++i) {
+            a += data[i];
+            b += a;
+        }
+
+        a %= ADLER_MODULUS;
+        b %= ADLER_MODULUS;
+
+        data += blockSize;
+        size -= blockSize;
+    }
+
+    return (b << 16) | a;
+}
+
+// The checksum of two pieces of data from the checksums of each, as in zlib's adler32_combine.
+static uint32_t combineAdler(uint32_t first, uint32_t second, size_t secondSize) {
+    const uint32_t remainder = secondSize % ADLER_MODULUS;
+
+    uint32_t a = first & 0xffff;
+    uint32_t b = (remainder * a) % ADLER_MODULUS;
+
+    a += (second & 0xffff) + ADLER_MODULUS - 1;
+    b += (first >> 16) + (second >> 16) + ADLER_MODULUS - remainder;
+
+    if (a >= ADLER_MODULUS) a -= ADLER_MODULUS;
+    if (a >= ADLER_MODULUS) a -= ADLER_MODULUS;
+    if (b >= 2 * ADLER_MODULUS) b -= 2 * ADLER_MODULUS;
+    if (b >= ADLER_MODULUS) b -= ADLER_MODULUS;
+
+    return (b << 16) | a;
+}
+
+// Huffman codes are packed starting from their most significant bit, so the fixed codes are kept reversed.
+static uint32_t reverseBits(uint32_t code, uint32_t length) {
+    uint32_t reversed = 0;
+
+    for (uint32_t i = 0; i < length; ++i) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+
+    return reversed;
+}
+
+static const struct FixedCodeTable {
+    uint16_t symbolCodes[288];
+    uint8_t symbolLengths[288];
+    uint8_t distanceCodes[30];
+
+    FixedCodeTable() {
+        for (uint32_t i = 0; i < 288; ++i) {
+            if (i < 144) {
+                symbolCodes[i] = reverseBits(0x30 + i, 8);
+                symbolLengths[i] = 8;
+            } else if (i < 256) {
+                symbolCodes[i] = reverseBits(0x190 + i - 144, 9);
+                symbolLengths[i] = 9;
+            } else if (i < 280) {
+                symbolCodes[i] = reverseBits(i - 256, 7);
+                symbolLengths[i] = 7;
+            } else {
+                symbolCodes[i] = reverseBits(0xc0 + i - 280, 8);
+                symbolLengths[i] = 8;
+            }
+        }
+
+        for (uint32_t i = 0; i < 30; ++i) {
+            distanceCodes[i] = reverseBits(i, 5);
+        }
+    }
+} fixedCodeTable;
+
+// Bits are gathered in a 64-bit buffer and flushed 32 at a time, no single write is longer than 16 bits.
+struct BitWriter {
+    std::vector<uint8_t> bytes;
+    uint64_t buffer = 0;
+    uint32_t bitCount = 0;
+
+    void write(uint32_t bits, uint32_t count) {
+        buffer |= (uint64_t)bits << bitCount;
+        bitCount += count;
+
+        if (bitCount >= 32) {
+            const uint8_t word[4] = { (uint8_t)buffer, (uint8_t)(buffer >> 8), (uint8_t)(buffer >> 16), (uint8_t)(buffer >> 24) };
+            bytes.insert(bytes.end(), word, word + 4);
+
+            buffer >>= 32;
+            bitCount -= 32;
+        }
+    }
+
+    void align() {
+        while (bitCount > 0) {
+            bytes.push_back((uint8_t)buffer);
+            buffer >>= 8;
+            bitCount = bitCount > 8 ? bitCount - 8 : 0;
+        }
+    }
+};
+
+static void writeSymbol(BitWriter& writer, uint32_t symbol) {
+    writer.write(fixedCodeTable.symbolCodes[symbol], fixedCodeTable.symbolLengths[symbol]);
+}
+
+static uint32_t getHighestBit(uint32_t value) {
+    uint32_t bit = 0;
+
+    while (value >>= 1) {
+        ++bit;
+    }
+
+    return bit;
+}
+
+static void writeMatch(BitWriter& writer, uint32_t length, uint32_t distance) {
+    // Past the first 8 lengths and 4 distances, every doubling of the range is split into 4 and 2 codes.
+    uint32_t lengthCode;
+
+    if (length == DEFLATE_MAX_MATCH) {
+        lengthCode = 28;
+    } else if (length - 3 < 8) {
+        lengthCode = length - 3;
+    } else {
+        const uint32_t bit = getHighestBit(length - 3);
+        lengthCode = 4 * (bit - 1) + (((length - 3) >> (bit - 2)) & 3);
+    }
+
+    writeSymbol(writer, 257 + lengthCode);
+    writer.write(length - lengthBases[lengthCode], lengthExtraBits[lengthCode]);
+
+    uint32_t distanceCode;
+
+    if (distance - 1 < 4) {
+        distanceCode = distance - 1;
+    } else {
+        const uint32_t bit = getHighestBit(distance - 1);
+        distanceCode = 2 * bit + (((distance - 1) >> (bit - 1)) & 1);
+    }
+
+    writer.write(fixedCodeTable.distanceCodes[distanceCode], 5);
+    writer.write(distance - distanceBases[distanceCode], distanceExtraBits[distanceCode]);
+}
+
+static uint32_t hashBytes(const uint8_t* data) {
+    const uint32_t value = data[0] | (data[1] << 8) | (data[2] << 16);
+    return (value * 2654435761u) >> (32 - DEFLATE_HASH_BITS);
+}
+
+// Deflates [begin, end) of the data into a single fixed Huffman block. Matches may start anywhere in the window before
+// begin, which the decoder will already have seen. Blocks that aren't the last end in an empty stored block, which
+// leaves the stream byte aligned for the next strip's block.
+static void deflateStrip(const uint8_t* data, uint32_t begin, uint32_t end, bool last, std::vector<uint8_t>& output) {
+    BitWriter writer;
+    writer.bytes.reserve((end - begin) / 2);
+
+    writer.write(last ? 1 : 0, 1);
+    writer.write(1, 2);
+
+    // Positions are stored plus one, zero is the end of a chain.
+    uint32_t* heads = new uint32_t[1 << DEFLATE_HASH_BITS]();
+    uint32_t* previous = new uint32_t[DEFLATE_WINDOW_SIZE];
+
+    auto insert = [&](uint32_t position) {
+        const uint32_t hash = hashBytes(data + position);
+        previous[position & (DEFLATE_WINDOW_SIZE - 1)] = heads[hash];
+        heads[hash] = position + 1;
+    };
+
+    for (uint32_t i = begin > DEFLATE_WINDOW_SIZE ? begin - DEFLATE_WINDOW_SIZE : 0; i < begin; ++i) {
+        insert(i);
+    }
+
+    uint32_t position = begin;
+
+    while (position < end) {
+        uint32_t bestLength = 0;
+        uint32_t bestDistance = 0;
+
+        if (end - position >= DEFLATE_MIN_MATCH) {
+            const uint32_t maxLength = end - position < DEFLATE_MAX_MATCH ? end - position : DEFLATE_MAX_MATCH;
+            uint32_t candidate = heads[hashBytes(data + position)];
+
+            for (uint32_t i = 0; i < DEFLATE_MAX_CHAIN && candidate != 0; ++i) {
+                const uint32_t match = candidate - 1;
+
+                if (position - match > DEFLATE_WINDOW_SIZE) {
+                    break;
+                }
+
+                uint32_t length = 0;
+
+                while (length < maxLength && data[match + length] == data[position + length]) {
+                    ++length;
+                }
+
+                if (length > bestLength) {
+                    bestLength = length;
+                    bestDistance = position - match;
+
+                    if (length >= DEFLATE_GOOD_MATCH || length == maxLength) {
+                        break;
+                    }
+                }
+
+                candidate = previous[match & (DEFLATE_WINDOW_SIZE - 1)];
+            }
+
+            insert(position);
+        }
+
+        if (bestLength >= DEFLATE_MIN_MATCH) {
+            writeMatch(writer, bestLength, bestDistance);
+
+            for (uint32_t i = 1; i < bestLength; ++i) {
+                if (end - (position + i) >= DEFLATE_MIN_MATCH) {
+                    insert(position + i);
+                }
+            }
+
+            position += bestLength;
+        } else {
+            writeSymbol(writer, data[position]);
+            ++position;
+        }
+    }
+
+    writeSymbol(writer, 256);
+
+    if (!last) {
+        writer.write(0, 3);
+        writer.align();
+
+        const uint8_t storedHeader[4] = { 0x00, 0x00, 0xff, 0xff };
+        writer.bytes.insert(writer.bytes.end(), storedHeader, storedHeader + 4);
+    } else {
+        writer.align();
+    }
+
+    delete[] previous;
+    delete[] heads;
+
+    output = std::move(writer.bytes);
+}
+
+static uint8_t getPaethPredictor(uint8_t a, uint8_t b, uint8_t c) {
+    const int32_t p = a + b - c;
+    const int32_t pa = abs(p - a);
+    const int32_t pb = abs(p - b);
+    const int32_t pc = abs(p - c);
+
+    if (pa <= pb && pa <= pc) {
+        return a;
+    }
+
+    return pb <= pc ? b : c;
+}
+
+// Predicts every byte of the row from its left, upper and upper left neighbors, which are 0 outside the image.
+static void applyFilter(uint32_t filter, const uint8_t* row, const uint8_t* previousRow, uint32_t rowSize, uint32_t bytesPerPixel, uint8_t* output) {
+    for (uint32_t i = 0; i < bytesPerPixel; ++i) {
+        const uint8_t b = previousRow[i];
+        const uint8_t predictors[5] = { 0, 0, b, (uint8_t)(b / 2), b };
+
+        output[i] = row[i] - predictors[filter];
+    }
+
+    switch (filter) {
+    case 0:
+        memcpy(output + bytesPerPixel, row + bytesPerPixel, rowSize - bytesPerPixel);
+        break;
+    case 1:
+        for (uint32_t i = bytesPerPixel; i < rowSize; ++i) {
+            output[i] = row[i] - row[i - bytesPerPixel];
+        }
+        break;
+    case 2:
+        for (uint32_t i = bytesPerPixel; i < rowSize; ++i) {
+            output[i] = row[i] - previousRow[i];
+        }
+        break;
+    case 3:
+        for (uint32_t i = bytesPerPixel; i < rowSize; ++i) {
+            output[i] = row[i] - (uint8_t)((row[i - bytesPerPixel] + previousRow[i]) / 2);
+        }
+        break;
+    case 4:
+        for (uint32_t i = bytesPerPixel; i < rowSize; ++i) {
+            output[i] = row[i] - getPaethPredictor(row[i - bytesPerPixel], previousRow[i], previousRow[i - bytesPerPixel]);
+        }
+        break;
+    }
+}
+
+// Tries every filter on the row and keeps the one with the smallest sum of absolute differences, like most encoders.
+// The first row is predicted from a row of zeros.
+static void filterRow(const uint8_t* row, const uint8_t* previousRow, uint32_t rowSize, uint32_t bytesPerPixel, uint8_t* output, uint8_t* scratch) {
+    uint32_t bestScore = UINT32_MAX;
+
+    for (uint32_t filter = 0; filter < 5; ++filter) {
+        applyFilter(filter, row, previousRow, rowSize, bytesPerPixel, scratch);
+
+        uint32_t score = 0;
+
+        for (uint32_t i = 0; i < rowSize; ++i) {
+            score += abs((int8_t)scratch[i]);
+        }
+
+        if (score < bestScore) {
+            bestScore = score;
+            output[0] = filter;
+            memcpy(output + 1, scratch, rowSize);
+        }
+    }
+}
+
+static size_t beginChunk(std::vector<uint8_t>& png, const char* type) {
+    const size_t offset = png.size();
+
+    png.insert(png.end(), 4, 0);
+    png.insert(png.end(), type, type + 4);
+
+    return offset;
+}
+
+static void writeBigEndian(std::vector<uint8_t>& png, uint32_t value) {
+    const uint8_t bytes[4] = { (uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value };
+    png.insert(png.end(), bytes, bytes + 4);
+}
+
+// Fills in the chunk's length and appends its CRC, which covers the type and the data.
+static void endChunk(std::vector<uint8_t>& png, size_t offset) {
+    const uint32_t length = (uint32_t)(png.size() - offset - 8);
+
+    png[offset + 0] = (uint8_t)(length >> 24);
+    png[offset + 1] = (uint8_t)(length >> 16);
+    png[offset + 2] = (uint8_t)(length >> 8);
+    png[offset + 3] = (uint8_t)length;
+
+    writeBigEndian(png, ~updateCrc(UINT32_MAX, png.data() + offset + 4, length + 4));
+}
+
+std::vector<uint8_t> encodePng(JobSystem& jobSystem, uint32_t width, uint32_t height, uint32_t channelCount, const uint8_t* pixels) {
+    const uint32_t rowSize = width * channelCount;
+    const uint32_t filteredRowSize = rowSize + 1;
+
+    // Filter every row first, the strips are deflated with the end of the previous strip as their window.
+    uint8_t* filtered = new uint8_t[(size_t)height * filteredRowSize];
+
+    const uint32_t stripRowCount = PNG_STRIP_SIZE / filteredRowSize > 0 ? PNG_STRIP_SIZE / filteredRowSize : 1;
+    const uint32_t stripCount = (height + stripRowCount - 1) / stripRowCount;
+
+    jobSystem.parallelFor(height, stripRowCount, [&](uint32_t begin, uint32_t end) {
+        uint8_t* scratch = new uint8_t[2 * rowSize];
+        uint8_t* zeros = scratch + rowSize;
+
+        memset(zeros, 0, rowSize);
+
+        for (uint32_t y = begin; y < end; ++y) {
+            const uint8_t* row = pixels + (size_t)y * rowSize;
+            filterRow(row, y > 0 ? row - rowSize : zeros, rowSize, channelCount, filtered + (size_t)y * filteredRowSize, scratch);
+        }
+
+        delete[] scratch;
+    });
+
+    std::vector<std::vector<uint8_t>> strips(stripCount);
+    std::vector<uint32_t> stripChecksums(stripCount);
+
+    jobSystem.parallelFor(stripCount, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            const uint32_t stripBegin = i * stripRowCount * filteredRowSize;
+            const uint32_t stripEnd = i + 1 < stripCount ? stripBegin + stripRowCount * filteredRowSize : height * filteredRowSize;
+
+            deflateStrip(filtered, stripBegin, stripEnd, i + 1 == stripCount, strips[i]);
+            stripChecksums[i] = computeAdler(filtered + stripBegin, stripEnd - stripBegin);
+        }
+    });
+
+    delete[] filtered;
+
+    // Write the signature and the chunks, the image data as one zlib stream in a single chunk.
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    size_t compressedSize = 0;
+
+    for (const std::vector<uint8_t>& strip : strips) {
+        compressedSize += strip.size();
+    }
+
+    std::vector<uint8_t> png;
+    png.reserve(compressedSize + 128);
+    png.insert(png.end(), signature, signature + sizeof(signature));
+
+    size_t chunk = beginChunk(png, "IHDR");
+    writeBigEndian(png, width);
+    writeBigEndian(png, height);
+
+    const uint8_t header[5] = { 8, (uint8_t)(channelCount == 4 ? 6 : 2), 0, 0, 0 };
+    png.insert(png.end(), header, header + sizeof(header));
+    endChunk(png, chunk);
+
+    chunk = beginChunk(png, "IDAT");
+
+    // A 32 KiB window with no preset dictionary, flagged as the fastest compression level.
+    png.push_back(0x78);
+    png.push_back(0x01);
+
+    uint32_t checksum = 1;
+
+    for (uint32_t i = 0; i < stripCount; ++i) {
+        png.insert(png.end(), strips[i].begin(), strips[i].end());
+
+        const uint32_t stripBegin = i * stripRowCount * filteredRowSize;
+        const uint32_t stripEnd = i + 1 < stripCount ? stripBegin + stripRowCount * filteredRowSize : height * filteredRowSize;
+
+        checksum = combineAdler(checksum, stripChecksums[i], stripEnd - stripBegin);
+    }
+
+    writeBigEndian(png, checksum);
+    endChunk(png, chunk);
+
+    chunk = beginChunk(png, "IEND");
+    endChunk(png, chunk);
+
+    return png;
+}
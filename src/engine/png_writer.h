@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "jobs.h"
+
+// Encodes an 8-bit RGB or RGBA image, rows top to bottom, as a PNG. Rows are filtered and deflated in strips across the
+// job system. Every strip ends in a sync flush so that their deflate streams join into one, and its matches may reach
+// back into the previous strip, so the output is about as small as a single-threaded encoder's. Only the fixed Huffman
+// codes are used, like stb_image_write, which keeps the encoder simple and fast enough for image sequences.
+std::vector<uint8_t> encodePng(JobSystem& jobSystem, uint32_t width, uint32_t height, uint32_t channelCount, const uint8_t* pixels);
@@ -0,0 +1,423 @@
+#include "post_processing.h"
+
+#include <math.h>
+
+#include "graphics.h"
+
+#define POST_PROCESSING_GROUP_SIZE 8
+
+static const VkFormat hdrFormat = VK_FORMAT_R16G16B16A16_SFLOAT;
+static const VkFormat ldrFormat = VK_FORMAT_R8G8B8A8_UNORM;
+
+static bool isSrgbFormat(VkFormat format) {
+    return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_A8B8G8R8_SRGB_PACK32;
+}
+
+static uint32_t getGroupCount(uint32_t size) {
+    return (size + POST_PROCESSING_GROUP_SIZE - 1) / POST_PROCESSING_GROUP_SIZE;
+}
+
+PostProcessor::PostProcessor(VkDevice device, VkDescriptorSetLayout bindlessDescriptorSetLayout) {
+    // Create the descriptor set layout. Binding 0 holds the HDR images and binding 1 the output.
+    VkDescriptorSetLayoutBinding descriptorSetLayoutBindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, POST_PROCESSING_HDR_IMAGE_COUNT, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }
+    };
+
+    VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo = {
+        .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .pNext        = nullptr,
+        .flags        = 0,
+        .bindingCount = ARRAY_SIZE(descriptorSetLayoutBindings),
+        .pBindings    = descriptorSetLayoutBindings
+    };
+
+    vkCreateDescriptorSetLayout(device, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout);
+
+    // Create the pipeline layout, the dither reads the blue noise through the bindless tables.
+    VkDescriptorSetLayout setLayouts[] = { descriptorSetLayout, bindlessDescriptorSetLayout };
+
+    VkPushConstantRange pushConstantRange = {
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+        .offset     = 0,
+        .size       = sizeof(DisplayPushConstants) > sizeof(DenoisePushConstants) ? sizeof(DisplayPushConstants) : sizeof(DenoisePushConstants)
+    };
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+        .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pNext                  = nullptr,
+        .flags                  = 0,
+        .setLayoutCount         = ARRAY_SIZE(setLayouts),
+        .pSetLayouts            = setLayouts,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges    = &pushConstantRange
+    };
+
+    vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
+
+    // Create the pipelines.
+    denoisePipeline = createComputePipeline(device, "post_denoise.spv", pipelineLayout);
+    displayPipeline = createComputePipeline(device, "post_display.spv", pipelineLayout);
+}
+
+void PostProcessor::destroy(VkDevice device) {
+    vkDestroyPipeline(device, displayPipeline, nullptr);
+    vkDestroyPipeline(device, denoisePipeline, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+}
+
+void PostProcessor::createResources(Device& device, VkExtent2D extent, uint32_t framesInFlight, const VkImageView* traceImageViews,
+                                    uint32_t outputCount, const VkImageView* outputImageViews, VkFormat outputFormat, bool directOutput) {
+    this->outputCount = outputCount;
+    this->directOutput = directOutput;
+
+    // A copy to an sRGB swapchain encodes by itself, every other output is written already encoded.
+    encodeSrgb = directOutput || !isSrgbFormat(outputFormat);
+
+    // Create the images, the HDR images followed by the LDR image when the output is copied.
+    const uint32_t imageCount = directOutput ? 2 : 3;
+
+    VkImage images[3];
+    VkImageView* imageViews[3] = { &hdrImageViews[0], &hdrImageViews[1], &ldrImageView };
+    VkDeviceSize imageOffsets[3];
+    VkDeviceSize allocationSize = 0;
+    uint32_t memoryTypeBits = UINT32_MAX;
+
+    for (uint32_t i = 0; i < imageCount; ++i) {
+        VkImageCreateInfo imageCreateInfo = {
+            .sType                 = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .pNext                 = nullptr,
+            .flags                 = 0,
+            .imageType             = VK_IMAGE_TYPE_2D,
+            .format                = i < 2 ? hdrFormat : ldrFormat,
+            .extent                = { extent.width, extent.height, 1 },
+            .mipLevels             = 1,
+            .arrayLayers           = 1,
+            .samples               = VK_SAMPLE_COUNT_1_BIT,
+            .tiling                = VK_IMAGE_TILING_OPTIMAL,
+            .usage                 = i < 2 ? VK_IMAGE_USAGE_STORAGE_BIT : VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            .sharingMode           = VK_SHARING_MODE_EXCLUSIVE,
+            .queueFamilyIndexCount = 0,
+            .pQueueFamilyIndices   = nullptr,
+            .initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED
+        };
+
+        vkCreateImage(device.logical, &imageCreateInfo, nullptr, &images[i]);
+
+        VkMemoryRequirements memoryRequirements;
+        vkGetImageMemoryRequirements(device.logical, images[i], &memoryRequirements);
+
+        imageOffsets[i] = (allocationSize + memoryRequirements.alignment - 1) & ~(memoryRequirements.alignment - 1);
+        allocationSize = imageOffsets[i] + memoryRequirements.size;
+        memoryTypeBits &= memoryRequirements.memoryTypeBits;
+    }
+
+    hdrImages[0] = images[0];
+    hdrImages[1] = images[1];
+    ldrImage = directOutput ? VK_NULL_HANDLE : images[2];
+
+    // Allocate and bind the images memory.
+    VkMemoryAllocateInfo memoryAllocateInfo = {
+        .sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext           = nullptr,
+        .allocationSize  = allocationSize,
+        .memoryTypeIndex = device.getMemoryTypeIndex(memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)
+    };
+
+    vkAllocateMemory(device.logical, &memoryAllocateInfo, nullptr, &imagesMemory);
+
+    VkBindImageMemoryInfo bindImageMemoryInfos[3];
+
+    for (uint32_t i = 0; i < imageCount; ++i) {
+        bindImageMemoryInfos[i].sType        = VK_STRUCTURE_TYPE_BIND_IMAGE_MEMORY_INFO;
+        bindImageMemoryInfos[i].pNext        = nullptr;
+        bindImageMemoryInfos[i].image        = images[i];
+        bindImageMemoryInfos[i].memory       = imagesMemory;
+        bindImageMemoryInfos[i].memoryOffset = imageOffsets[i];
+    }
+
+    vkBindImageMemory2(device.logical, imageCount, bindImageMemoryInfos);
+
+    // Create the image views.
+    for (uint32_t i = 0; i < imageCount; ++i) {
+        VkImageViewCreateInfo imageViewCreateInfo = {
+            .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .pNext            = nullptr,
+            .flags            = 0,
+            .image            = images[i],
+            .viewType         = VK_IMAGE_VIEW_TYPE_2D,
+            .format           = i < 2 ? hdrFormat : ldrFormat,
+            .components       = { VK_COMPONENT_SWIZZLE_IDENTITY },
+            .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+        };
+
+        vkCreateImageView(device.logical, &imageViewCreateInfo, nullptr, imageViews[i]);
+    }
+
+    // Create the descriptor pool, with a set for every pair of trace and output.
+    const uint32_t setCount = framesInFlight * outputCount;
+
+    VkDescriptorPoolSize descriptorPoolSize = {
+        VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, setCount * (POST_PROCESSING_HDR_IMAGE_COUNT + 1)
+    };
+
+    VkDescriptorPoolCreateInfo descriptorPoolCreateInfo = {
+        .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .pNext         = nullptr,
+        .flags         = 0,
+        .maxSets       = setCount,
+        .poolSizeCount = 1,
+        .pPoolSizes    = &descriptorPoolSize
+    };
+
+    vkCreateDescriptorPool(device.logical, &descriptorPoolCreateInfo, nullptr, &descriptorPool);
+
+    // Allocate the descriptor sets.
+    descriptorSets = new VkDescriptorSet[setCount];
+
+    VkDescriptorSetLayout* descriptorSetLayouts = new VkDescriptorSetLayout[setCount];
+
+    for (uint32_t i = 0; i < setCount; ++i) {
+        descriptorSetLayouts[i] = descriptorSetLayout;
+    }
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocateInfo = {
+        .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .pNext              = nullptr,
+        .descriptorPool     = descriptorPool,
+        .descriptorSetCount = setCount,
+        .pSetLayouts        = descriptorSetLayouts
+    };
+
+    vkAllocateDescriptorSets(device.logical, &descriptorSetAllocateInfo, descriptorSets);
+
+    delete[] descriptorSetLayouts;
+
+    // Update the descriptor sets, set frameIndex * outputCount + outputIndex pairs the trace with the output.
+    for (uint32_t i = 0; i < setCount; ++i) {
+        VkDescriptorImageInfo descriptorImageInfos[POST_PROCESSING_HDR_IMAGE_COUNT + 1] = {
+            { VK_NULL_HANDLE, traceImageViews[i / outputCount], VK_IMAGE_LAYOUT_GENERAL },
+            { VK_NULL_HANDLE, hdrImageViews[0], VK_IMAGE_LAYOUT_GENERAL },
+            { VK_NULL_HANDLE, hdrImageViews[1], VK_IMAGE_LAYOUT_GENERAL },
+            { VK_NULL_HANDLE, directOutput ? outputImageViews[i % outputCount] : ldrImageView, VK_IMAGE_LAYOUT_GENERAL }
+        };
+
+        VkWriteDescriptorSet writeDescriptorSets[2];
+
+        for (uint32_t j = 0; j < 2; ++j) {
+            writeDescriptorSets[j].sType            = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writeDescriptorSets[j].pNext            = nullptr;
+            writeDescriptorSets[j].dstSet           = descriptorSets[i];
+            writeDescriptorSets[j].dstBinding       = j;
+            writeDescriptorSets[j].dstArrayElement  = 0;
+            writeDescriptorSets[j].descriptorCount  = j == 0 ? POST_PROCESSING_HDR_IMAGE_COUNT : 1;
+            writeDescriptorSets[j].descriptorType   = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+            writeDescriptorSets[j].pImageInfo       = &descriptorImageInfos[j == 0 ? 0 : POST_PROCESSING_HDR_IMAGE_COUNT];
+            writeDescriptorSets[j].pBufferInfo      = nullptr;
+            writeDescriptorSets[j].pTexelBufferView = nullptr;
+        }
+
+        vkUpdateDescriptorSets(device.logical, ARRAY_SIZE(writeDescriptorSets), writeDescriptorSets, 0, nullptr);
+    }
+}
+
+void PostProcessor::destroyResources(VkDevice device) {
+    delete[] descriptorSets;
+
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        vkDestroyImageView(device, hdrImageViews[i], nullptr);
+    }
+
+    if (!directOutput) {
+        vkDestroyImageView(device, ldrImageView, nullptr);
+    }
+
+    vkFreeMemory(device, imagesMemory, nullptr);
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        vkDestroyImage(device, hdrImages[i], nullptr);
+    }
+
+    if (!directOutput) {
+        vkDestroyImage(device, ldrImage, nullptr);
+    }
+}
+
+void PostProcessor::record(VkCommandBuffer commandBuffer, Profiler& profiler, uint32_t frameIndex, uint32_t outputIndex, VkImage outputImage,
+                           VkExtent2D traceExtent, VkExtent2D extent, VkDescriptorSet bindlessDescriptorSet, uint32_t frameNumber,
+                           uint32_t blueNoiseImageIndex) {
+    // Discard the previous contents of the images the chain writes. The source stages wait for the previous frame's
+    // passes, which may still be reading them.
+    VkImageMemoryBarrier2 imageMemoryBarriers[3];
+
+    for (uint32_t i = 0; i < 3; ++i) {
+        imageMemoryBarriers[i].sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        imageMemoryBarriers[i].pNext               = nullptr;
+        imageMemoryBarriers[i].srcStageMask        = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_BLIT_BIT;
+        imageMemoryBarriers[i].srcAccessMask       = VK_ACCESS_2_NONE;
+        imageMemoryBarriers[i].dstStageMask        = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        imageMemoryBarriers[i].dstAccessMask       = VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+        imageMemoryBarriers[i].oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED;
+        imageMemoryBarriers[i].newLayout           = VK_IMAGE_LAYOUT_GENERAL;
+        imageMemoryBarriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageMemoryBarriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        imageMemoryBarriers[i].image               = i < 2 ? hdrImages[i] : directOutput ? outputImage : ldrImage;
+        imageMemoryBarriers[i].subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+    }
+
+    VkDependencyInfo dependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 0,
+        .pMemoryBarriers          = nullptr,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = ARRAY_SIZE(imageMemoryBarriers),
+        .pImageMemoryBarriers     = imageMemoryBarriers
+    };
+
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    VkDescriptorSet boundDescriptorSets[] = { descriptorSets[frameIndex * outputCount + outputIndex], bindlessDescriptorSet };
+
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, ARRAY_SIZE(boundDescriptorSets), boundDescriptorSets, 0, nullptr);
+
+    // Every iteration reads the previous one, so they are separated by barriers.
+    VkMemoryBarrier2 memoryBarrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext         = nullptr,
+        .srcStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+        .dstStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+        .dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT
+    };
+
+    VkDependencyInfo memoryDependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 1,
+        .pMemoryBarriers          = &memoryBarrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = 0,
+        .pImageMemoryBarriers     = nullptr
+    };
+
+    // Denoise the trace. The timestamps are written even when the pass is off, so that it reads as taking no time.
+    uint32_t sourceIndex = 0;
+
+    profiler.begin(commandBuffer, frameIndex, PROFILER_SECTION_DENOISE, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+
+    if (denoiseEnabled && denoiseIterationCount > 0) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, denoisePipeline);
+
+        for (uint32_t i = 0; i < denoiseIterationCount; ++i) {
+            // Following Dammertz et al., the color weight tightens as the filter grows, so that wide iterations only
+            // smooth what the narrow ones left flat.
+            DenoisePushConstants pushConstants = {
+                .sourceIndex      = sourceIndex,
+                .destinationIndex = sourceIndex == 1 ? 2u : 1u,
+                .width            = traceExtent.width,
+                .height           = traceExtent.height,
+                .stepSize         = 1u << i,
+                .colorSigma       = denoiseColorSigma / (1 << i)
+            };
+
+            vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+            vkCmdDispatch(commandBuffer, getGroupCount(traceExtent.width), getGroupCount(traceExtent.height), 1);
+            vkCmdPipelineBarrier2(commandBuffer, &memoryDependencyInfo);
+
+            sourceIndex = pushConstants.destinationIndex;
+        }
+    }
+
+    profiler.end(commandBuffer, frameIndex, PROFILER_SECTION_DENOISE, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+
+    // Scale, expose, tonemap, encode and dither into the output.
+    profiler.begin(commandBuffer, frameIndex, PROFILER_SECTION_TONEMAP, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT);
+
+    DisplayPushConstants pushConstants = {
+        .sourceIndex         = sourceIndex,
+        .sourceWidth         = traceExtent.width,
+        .sourceHeight        = traceExtent.height,
+        .outputWidth         = extent.width,
+        .outputHeight        = extent.height,
+        .exposureScale       = exposureEnabled ? exp2f(exposure) : 1.0f,
+        .tonemapper          = tonemapEnabled ? tonemapper + 1u : 0u,
+        .encodeSrgb          = encodeSrgb,
+        .ditherScale         = ditherEnabled && blueNoiseImageIndex != UINT32_MAX ? 1.0f / 255.0f : 0.0f,
+        .frameNumber         = frameNumber,
+        .blueNoiseImageIndex = blueNoiseImageIndex
+    };
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, displayPipeline);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, getGroupCount(extent.width), getGroupCount(extent.height), 1);
+
+    // Hand the output over to the GUI pass, which loads it in the transfer destination layout.
+    VkImageMemoryBarrier2& outputBarrier = imageMemoryBarriers[0];
+
+    outputBarrier.srcStageMask  = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    outputBarrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    outputBarrier.oldLayout     = VK_IMAGE_LAYOUT_GENERAL;
+    outputBarrier.image         = directOutput ? outputImage : ldrImage;
+
+    if (directOutput) {
+        outputBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_BLIT_BIT;
+        outputBarrier.dstAccessMask = VK_ACCESS_2_NONE;
+        outputBarrier.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+
+        dependencyInfo.imageMemoryBarrierCount = 1;
+    } else {
+        outputBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_BLIT_BIT;
+        outputBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT;
+        outputBarrier.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+        VkImageMemoryBarrier2& swapchainBarrier = imageMemoryBarriers[1];
+
+        swapchainBarrier.srcStageMask  = VK_PIPELINE_STAGE_2_BLIT_BIT;
+        swapchainBarrier.srcAccessMask = VK_ACCESS_2_NONE;
+        swapchainBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_BLIT_BIT;
+        swapchainBarrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        swapchainBarrier.oldLayout     = VK_IMAGE_LAYOUT_UNDEFINED;
+        swapchainBarrier.newLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        swapchainBarrier.image         = outputImage;
+
+        dependencyInfo.imageMemoryBarrierCount = 2;
+    }
+
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    if (!directOutput) {
+        // The images have the same size and are already flipped, the copy only converts the format.
+        VkImageBlit2 imageBlit = {
+            .sType          = VK_STRUCTURE_TYPE_IMAGE_BLIT_2,
+            .pNext          = nullptr,
+            .srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+            .srcOffsets     = { { 0, 0, 0 }, { (int32_t)extent.width, (int32_t)extent.height, 1 } },
+            .dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+            .dstOffsets     = { { 0, 0, 0 }, { (int32_t)extent.width, (int32_t)extent.height, 1 } }
+        };
+
+        VkBlitImageInfo2 blitImageInfo = {
+            .sType          = VK_STRUCTURE_TYPE_BLIT_IMAGE_INFO_2,
+            .pNext          = nullptr,
+            .srcImage       = ldrImage,
+            .srcImageLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            .dstImage       = outputImage,
+            .dstImageLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            .regionCount    = 1,
+            .pRegions       = &imageBlit,
+            .filter         = VK_FILTER_NEAREST
+        };
+
+        vkCmdBlitImage2(commandBuffer, &blitImageInfo);
+    }
+
+    profiler.end(commandBuffer, frameIndex, PROFILER_SECTION_TONEMAP, VK_PIPELINE_STAGE_2_BLIT_BIT);
+}
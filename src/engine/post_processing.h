@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include "profiler.h"
+
+class Device;
+
+// The HDR images the passes read and write, the trace followed by the two images the denoiser ping-pongs between.
+#define POST_PROCESSING_HDR_IMAGE_COUNT 3
+
+enum Tonemapper {
+    TONEMAPPER_ACES,
+    TONEMAPPER_AGX
+};
+
+// Matches the push constants of post_denoise.comp.
+struct DenoisePushConstants {
+    uint32_t sourceIndex;
+    uint32_t destinationIndex;
+    uint32_t width;
+    uint32_t height;
+    uint32_t stepSize;
+    float colorSigma;
+};
+
+// Matches the push constants of post_display.comp.
+struct DisplayPushConstants {
+    uint32_t sourceIndex;
+    uint32_t sourceWidth;
+    uint32_t sourceHeight;
+    uint32_t outputWidth;
+    uint32_t outputHeight;
+    float exposureScale;
+    uint32_t tonemapper;
+    uint32_t encodeSrgb;
+    float ditherScale;
+    uint32_t frameNumber;
+    uint32_t blueNoiseImageIndex;
+};
+
+// Turns the HDR trace into the image that is presented, with a chain of compute passes recorded every frame so that
+// they can be switched on and off freely. The denoiser runs a few iterations of an edge-avoiding à-trous wavelet over
+// the trace, then the display pass scales the result to the swapchain, applies the exposure, tonemaps, encodes and
+// dithers it in one go. When the swapchain can be a storage image the display pass writes it directly, otherwise it
+// writes an LDR image of the same size that is then copied over.
+class PostProcessor {
+public:
+    bool denoiseEnabled = true;
+    uint32_t denoiseIterationCount = 4;
+    float denoiseColorSigma = 0.5f;
+
+    bool exposureEnabled = true;
+    float exposure = 0.0f;
+
+    bool tonemapEnabled = true;
+    Tonemapper tonemapper = TONEMAPPER_AGX;
+
+    bool ditherEnabled = true;
+
+    PostProcessor() = default;
+    PostProcessor(VkDevice device, VkDescriptorSetLayout bindlessDescriptorSetLayout);
+    void destroy(VkDevice device);
+
+    // Creates the images and descriptor sets for a swapchain of outputCount images and framesInFlight traces, both at
+    // the given extent. Direct output writes the swapchain images, which then need the storage usage.
+    void createResources(Device& device, VkExtent2D extent, uint32_t framesInFlight, const VkImageView* traceImageViews,
+                         uint32_t outputCount, const VkImageView* outputImageViews, VkFormat outputFormat, bool directOutput);
+    void destroyResources(VkDevice device);
+
+    // Records the chain from the trace of the frame to the output image, leaving the latter in the transfer destination
+    // layout for the GUI pass. The trace must already be visible to compute shaders in the general layout, and the output
+    // image's previous contents are discarded.
+    void record(VkCommandBuffer commandBuffer, Profiler& profiler, uint32_t frameIndex, uint32_t outputIndex, VkImage outputImage,
+                VkExtent2D traceExtent, VkExtent2D extent, VkDescriptorSet bindlessDescriptorSet, uint32_t frameNumber,
+                uint32_t blueNoiseImageIndex);
+
+private:
+    VkDescriptorSetLayout descriptorSetLayout;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline denoisePipeline;
+    VkPipeline displayPipeline;
+
+    uint32_t outputCount;
+    bool directOutput;
+    bool encodeSrgb;
+    VkImage hdrImages[2];
+    VkImageView hdrImageViews[2];
+    VkImage ldrImage;
+    VkImageView ldrImageView;
+    VkDeviceMemory imagesMemory;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet* descriptorSets;
+};
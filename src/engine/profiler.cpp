@@ -0,0 +1,70 @@
+#include "profiler.h"
+
+static const uint32_t queriesPerFrame = 2 * PROFILER_SECTION_COUNT;
+
+Profiler::Profiler(VkDevice device, float timestampPeriod, uint32_t framesInFlight) : timestampPeriod(timestampPeriod) {
+    for (uint32_t i = 0; i < PROFILER_SECTION_COUNT; ++i) {
+        times[i] = 0.0f;
+    }
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {
+        .sType              = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext              = nullptr,
+        .flags              = 0,
+        .queryType          = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount         = framesInFlight * queriesPerFrame,
+        .pipelineStatistics = 0
+    };
+
+    vkCreateQueryPool(device, &queryPoolCreateInfo, nullptr, &queryPool);
+
+    // Queries have to be reset before their results can be read, even if they were never written.
+    vkResetQueryPool(device, queryPool, 0, framesInFlight * queriesPerFrame);
+}
+
+void Profiler::destroy(VkDevice device) {
+    vkDestroyQueryPool(device, queryPool, nullptr);
+}
+
+void Profiler::reset(VkCommandBuffer commandBuffer, uint32_t frameIndex) {
+    vkCmdResetQueryPool(commandBuffer, queryPool, frameIndex * queriesPerFrame, queriesPerFrame);
+}
+
+void Profiler::begin(VkCommandBuffer commandBuffer, uint32_t frameIndex, ProfilerSection section, VkPipelineStageFlags2 stage) {
+    vkCmdWriteTimestamp2(commandBuffer, stage, queryPool, frameIndex * queriesPerFrame + 2 * section);
+}
+
+void Profiler::end(VkCommandBuffer commandBuffer, uint32_t frameIndex, ProfilerSection section, VkPipelineStageFlags2 stage) {
+    vkCmdWriteTimestamp2(commandBuffer, stage, queryPool, frameIndex * queriesPerFrame + 2 * section + 1);
+}
+
+void Profiler::collect(VkDevice device, uint32_t frameIndex) {
+    // Every query is followed by its availability value.
+    uint64_t results[2 * queriesPerFrame];
+
+    vkGetQueryPoolResults(device, queryPool, frameIndex * queriesPerFrame, queriesPerFrame, sizeof(results), results,
+                          2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+
+    for (uint32_t i = 0; i < PROFILER_SECTION_COUNT; ++i) {
+        const uint64_t* begin = &results[4 * i];
+        const uint64_t* end = &results[4 * i + 2];
+
+        if (begin[1] != 0 && end[1] != 0 && end[0] >= begin[0]) {
+            times[i] = (end[0] - begin[0]) * timestampPeriod * 1e-6f;
+        }
+    }
+}
+
+float Profiler::getTime(ProfilerSection section) {
+    return times[section];
+}
+
+float Profiler::getTotalTime() {
+    float totalTime = 0.0f;
+
+    for (uint32_t i = 0; i < PROFILER_SECTION_COUNT; ++i) {
+        totalTime += times[i];
+    }
+
+    return totalTime;
+}
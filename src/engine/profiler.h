@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+enum ProfilerSection {
+    PROFILER_SECTION_TRACE,
+    PROFILER_SECTION_DENOISE,
+    PROFILER_SECTION_TONEMAP,
+    PROFILER_SECTION_GUI,
+    PROFILER_SECTION_COUNT
+};
+
+class Profiler {
+public:
+    Profiler() = default;
+    Profiler(VkDevice device, float timestampPeriod, uint32_t framesInFlight);
+    void destroy(VkDevice device);
+
+    void reset(VkCommandBuffer commandBuffer, uint32_t frameIndex);
+    void begin(VkCommandBuffer commandBuffer, uint32_t frameIndex, ProfilerSection section, VkPipelineStageFlags2 stage);
+    void end(VkCommandBuffer commandBuffer, uint32_t frameIndex, ProfilerSection section, VkPipelineStageFlags2 stage);
+
+    // Reads back the timestamps of a frame whose fence has already been waited on.
+    void collect(VkDevice device, uint32_t frameIndex);
+
+    float getTime(ProfilerSection section);
+    float getTotalTime();
+
+private:
+    VkQueryPool queryPool;
+    float timestampPeriod;
+    float times[PROFILER_SECTION_COUNT];
+};
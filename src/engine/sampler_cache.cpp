@@ -0,0 +1,190 @@
+#include "sampler_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <fstream>
+#include <string>
+
+#include "hash.h"
+
+struct SamplerAssetValue {
+    const char* name;
+    uint32_t value;
+};
+
+static const SamplerAssetValue filterValues[] = {
+    { "nearest", VK_FILTER_NEAREST },
+    { "linear",  VK_FILTER_LINEAR }
+};
+
+static const SamplerAssetValue mipmapModeValues[] = {
+    { "nearest", VK_SAMPLER_MIPMAP_MODE_NEAREST },
+    { "linear",  VK_SAMPLER_MIPMAP_MODE_LINEAR }
+};
+
+static const SamplerAssetValue addressModeValues[] = {
+    { "repeat",         VK_SAMPLER_ADDRESS_MODE_REPEAT },
+    { "mirroredRepeat", VK_SAMPLER_ADDRESS_MODE_MIRRORED_REPEAT },
+    { "clampToEdge",    VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE },
+    { "clampToBorder",  VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER }
+};
+
+template<uint32_t valueCount>
+static bool readValue(const std::string& name, const SamplerAssetValue (&values)[valueCount], uint32_t& value) {
+    for (const SamplerAssetValue& candidate : values) {
+        if (name == candidate.name) {
+            value = candidate.value;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+SamplerDescription getDefaultSamplerDescription() {
+    return {
+        .magFilter     = VK_FILTER_LINEAR,
+        .minFilter     = VK_FILTER_LINEAR,
+        .mipmapMode    = VK_SAMPLER_MIPMAP_MODE_LINEAR,
+        .addressModeU  = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        .addressModeV  = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        .addressModeW  = VK_SAMPLER_ADDRESS_MODE_REPEAT,
+        .mipLodBias    = 0.0f,
+        .maxAnisotropy = 16.0f
+    };
+}
+
+bool readSamplerAsset(const std::filesystem::path& path, SamplerDescription& description) {
+    std::ifstream file(path);
+
+    if (!file) {
+        return false;
+    }
+
+    description = getDefaultSamplerDescription();
+
+    std::string key, value;
+
+    while (file >> key >> value) {
+        bool valid;
+
+        if (key == "magFilter") {
+            valid = readValue(value, filterValues, description.magFilter);
+        } else if (key == "minFilter") {
+            valid = readValue(value, filterValues, description.minFilter);
+        } else if (key == "mipmapMode") {
+            valid = readValue(value, mipmapModeValues, description.mipmapMode);
+        } else if (key == "addressModeU") {
+            valid = readValue(value, addressModeValues, description.addressModeU);
+        } else if (key == "addressModeV") {
+            valid = readValue(value, addressModeValues, description.addressModeV);
+        } else if (key == "addressModeW") {
+            valid = readValue(value, addressModeValues, description.addressModeW);
+        } else if (key == "mipLodBias") {
+            char* end;
+            description.mipLodBias = strtof(value.c_str(), &end);
+            valid = *end == '\0';
+        } else if (key == "maxAnisotropy") {
+            char* end;
+            description.maxAnisotropy = strtof(value.c_str(), &end);
+            valid = *end == '\0';
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            return false;
+        }
+    }
+
+    return file.eof();
+}
+
+SamplerCache::SamplerCache(Device& device, BindlessTables& bindlessTables) {
+    capacity = SAMPLER_CACHE_CAPACITY;
+
+    if (capacity > device.properties.limits.maxSamplerAllocationCount) {
+        capacity = device.properties.limits.maxSamplerAllocationCount;
+    }
+
+    maxAnisotropy = device.properties.limits.maxSamplerAnisotropy;
+    entries = new Entry[capacity];
+
+    // The default sampler always takes the first entry.
+    getSampler(device, bindlessTables, getDefaultSamplerDescription());
+}
+
+void SamplerCache::destroy(VkDevice device, BindlessTables& bindlessTables) {
+    for (uint32_t i = 0; i < samplerCount; ++i) {
+        bindlessTables.removeSampler(entries[i].bindlessIndex);
+        vkDestroySampler(device, entries[i].sampler, nullptr);
+    }
+
+    delete[] entries;
+}
+
+uint32_t SamplerCache::getSampler(Device& device, BindlessTables& bindlessTables, const SamplerDescription& description) {
+    // Descriptions that only differ beyond what the device supports end up as the same sampler.
+    SamplerDescription clampedDescription = description;
+
+    if (clampedDescription.maxAnisotropy > maxAnisotropy) {
+        clampedDescription.maxAnisotropy = maxAnisotropy;
+    }
+
+    if (clampedDescription.maxAnisotropy < 1.0f) {
+        clampedDescription.maxAnisotropy = 1.0f;
+    }
+
+    const uint64_t hash = hashData(&clampedDescription, sizeof(clampedDescription));
+
+    for (uint32_t i = 0; i < samplerCount; ++i) {
+        if (entries[i].hash == hash && memcmp(&entries[i].description, &clampedDescription, sizeof(clampedDescription)) == 0) {
+            return entries[i].bindlessIndex;
+        }
+    }
+
+    if (samplerCount == capacity) {
+        return getDefaultSampler();
+    }
+
+    // Create the sampler.
+    VkSamplerCreateInfo samplerCreateInfo = {
+        .sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+        .pNext                   = nullptr,
+        .flags                   = 0,
+        .magFilter               = (VkFilter)clampedDescription.magFilter,
+        .minFilter               = (VkFilter)clampedDescription.minFilter,
+        .mipmapMode              = (VkSamplerMipmapMode)clampedDescription.mipmapMode,
+        .addressModeU            = (VkSamplerAddressMode)clampedDescription.addressModeU,
+        .addressModeV            = (VkSamplerAddressMode)clampedDescription.addressModeV,
+        .addressModeW            = (VkSamplerAddressMode)clampedDescription.addressModeW,
+        .mipLodBias              = clampedDescription.mipLodBias,
+        .anisotropyEnable        = clampedDescription.maxAnisotropy > 1.0f,
+        .maxAnisotropy           = clampedDescription.maxAnisotropy,
+        .compareEnable           = VK_FALSE,
+        .compareOp               = VK_COMPARE_OP_NEVER,
+        .minLod                  = 0.0f,
+        .maxLod                  = VK_LOD_CLAMP_NONE,
+        .borderColor             = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK,
+        .unnormalizedCoordinates = VK_FALSE
+    };
+
+    VkSampler sampler;
+    vkCreateSampler(device.logical, &samplerCreateInfo, nullptr, &sampler);
+
+    const uint32_t bindlessIndex = bindlessTables.addSampler(device.logical, sampler);
+
+    if (bindlessIndex == BINDLESS_INVALID_INDEX) {
+        vkDestroySampler(device.logical, sampler, nullptr);
+        return samplerCount > 0 ? getDefaultSampler() : BINDLESS_INVALID_INDEX;
+    }
+
+    entries[samplerCount++] = { hash, clampedDescription, sampler, bindlessIndex };
+
+    return bindlessIndex;
+}
+
+uint32_t SamplerCache::getDefaultSampler() {
+    return entries[0].bindlessIndex;
+}
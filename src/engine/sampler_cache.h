@@ -0,0 +1,65 @@
+#pragma once
+
+#include <filesystem>
+
+#include "bindless.h"
+
+#define SAMPLER_CACHE_CAPACITY 64
+#define SAMPLER_ASSET_EXTENSION ".vxs"
+
+// Everything that tells two samplers apart, stored as it is in cooked assets. Filters and address modes hold their
+// Vulkan enum values, and anisotropic filtering is off at a max anisotropy of 1.
+struct SamplerDescription {
+    uint32_t magFilter;
+    uint32_t minFilter;
+    uint32_t mipmapMode;
+    uint32_t addressModeU;
+    uint32_t addressModeV;
+    uint32_t addressModeW;
+    float mipLodBias;
+    float maxAnisotropy;
+};
+
+// Trilinear filtering, repeating, with as much anisotropy as the device allows.
+SamplerDescription getDefaultSamplerDescription();
+
+// Reads a sampler asset, a text file of "key value" lines:
+//
+//     magFilter nearest|linear
+//     minFilter nearest|linear
+//     mipmapMode nearest|linear
+//     addressModeU repeat|mirroredRepeat|clampToEdge|clampToBorder (and addressModeV, addressModeW)
+//     mipLodBias <float>
+//     maxAnisotropy <float>
+//
+// Missing keys keep their default value. Returns false if the file can't be read or has an unknown key or value.
+bool readSamplerAsset(const std::filesystem::path& path, SamplerDescription& description);
+
+// Samplers shared by every material, deduplicated by their description. Drivers limit how many samplers can exist at
+// once, so the cache holds at most SAMPLER_CACHE_CAPACITY of them and never releases any: scenes only ever use a
+// handful of distinct ones. Every sampler is exposed through the bindless sampler table.
+class SamplerCache {
+public:
+    uint32_t samplerCount = 0;
+    uint32_t capacity = 0;
+
+    SamplerCache() = default;
+    SamplerCache(Device& device, BindlessTables& bindlessTables);
+    void destroy(VkDevice device, BindlessTables& bindlessTables);
+
+    // Returns the bindless index of a sampler matching the description, creating it if it isn't cached yet. Once the
+    // cache is full, the default sampler is returned instead.
+    uint32_t getSampler(Device& device, BindlessTables& bindlessTables, const SamplerDescription& description);
+    uint32_t getDefaultSampler();
+
+private:
+    struct Entry {
+        uint64_t hash;
+        SamplerDescription description;
+        VkSampler sampler;
+        uint32_t bindlessIndex;
+    };
+
+    float maxAnisotropy;
+    Entry* entries;
+};
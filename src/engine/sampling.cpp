@@ -0,0 +1,358 @@
+#include "sampling.h"
+
+#include <math.h>
+#include <string.h>
+
+#include "file_mapping.h"
+#include "upload.h"
+
+static const VkDeviceSize sobolTableSize = SOBOL_SEQUENCE_COUNT * SOBOL_SAMPLE_COUNT * SOBOL_DIMENSION_COUNT * sizeof(uint16_t);
+static const VkDeviceSize blueNoiseSize = BLUE_NOISE_ATLAS_SIZE * BLUE_NOISE_ATLAS_SIZE * 4;
+static const VkDeviceSize cacheSize = sizeof(SamplingCacheHeader) + sobolTableSize + blueNoiseSize;
+
+static const VkDeviceSize stagingAlignment = 16;
+
+// Sequences are scrambled in batches of this many.
+static const uint32_t sequenceGrainSize = 8;
+
+// How fast the energy of void-and-cluster falls off, in pixels and in slices, and how far it reaches within a slice.
+static const float blueNoiseSigma = 1.9f;
+static const int32_t blueNoiseRadius = 7;
+
+// The primitive polynomials and initial direction numbers of the Sobol dimensions after the first, from Joe and Kuo.
+struct SobolPolynomial {
+    uint32_t degree;
+    uint32_t coefficients;
+    uint32_t initialNumbers[3];
+};
+
+static const SobolPolynomial sobolPolynomials[SOBOL_DIMENSION_COUNT - 1] = {
+    { 1, 0, { 1 } },
+    { 2, 1, { 1, 3 } },
+    { 3, 1, { 1, 3, 1 } }
+};
+
+static uint32_t hashBits(uint32_t value) {
+    value ^= value >> 16;
+    value *= 0x7feb352du;
+    value ^= value >> 15;
+    value *= 0x846ca68bu;
+    value ^= value >> 16;
+
+    return value;
+}
+
+static void getSobolDirections(uint32_t dimension, uint32_t* directions) {
+    if (dimension == 0) {
+        for (uint32_t bit = 0; bit < 32; ++bit) {
+            directions[bit] = 1u << (31 - bit);
+        }
+
+        return;
+    }
+
+    const SobolPolynomial& polynomial = sobolPolynomials[dimension - 1];
+    const uint32_t degree = polynomial.degree;
+
+    for (uint32_t bit = 0; bit < 32; ++bit) {
+        if (bit < degree) {
+            directions[bit] = polynomial.initialNumbers[bit] << (31 - bit);
+            continue;
+        }
+
+        directions[bit] = directions[bit - degree] ^ (directions[bit - degree] >> degree);
+
+        for (uint32_t term = 1; term < degree; ++term) {
+            if ((polynomial.coefficients >> (degree - 1 - term)) & 1) {
+                directions[bit] ^= directions[bit - term];
+            }
+        }
+    }
+}
+
+// Flips every bit with a coin toss that depends on the seed and on the bits above it, so that every subtree of the
+// binary digits gets its own random permutation.
+static uint16_t owenScramble(uint16_t value, uint32_t seed) {
+    uint16_t scrambled = value;
+
+    for (uint32_t bit = 0; bit < 16; ++bit) {
+        const uint32_t node = (1u << bit) | (uint32_t)(value >> (16 - bit));
+
+        if (hashBits(seed ^ hashBits(node)) & 1) {
+            scrambled ^= 0x8000 >> bit;
+        }
+    }
+
+    return scrambled;
+}
+
+void generateSobolTable(JobSystem& jobSystem, uint16_t* samples) {
+    uint32_t directions[SOBOL_DIMENSION_COUNT][32];
+
+    for (uint32_t dimension = 0; dimension < SOBOL_DIMENSION_COUNT; ++dimension) {
+        getSobolDirections(dimension, directions[dimension]);
+    }
+
+    jobSystem.parallelFor(SOBOL_SEQUENCE_COUNT, sequenceGrainSize, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t sequence = begin; sequence < end; ++sequence) {
+            uint16_t* sequenceSamples = samples + (size_t)sequence * SOBOL_SAMPLE_COUNT * SOBOL_DIMENSION_COUNT;
+
+            for (uint32_t dimension = 0; dimension < SOBOL_DIMENSION_COUNT; ++dimension) {
+                const uint32_t seed = hashBits(sequence * SOBOL_DIMENSION_COUNT + dimension + 1);
+
+                for (uint32_t i = 0; i < SOBOL_SAMPLE_COUNT; ++i) {
+                    uint32_t value = 0;
+
+                    for (uint32_t bit = 0; (i >> bit) != 0; ++bit) {
+                        if ((i >> bit) & 1) {
+                            value ^= directions[dimension][bit];
+                        }
+                    }
+
+                    sequenceSamples[SOBOL_DIMENSION_COUNT * i + dimension] = owenScramble((uint16_t)(value >> 16), seed);
+                }
+            }
+        }
+    });
+}
+
+static float getRowMinimum(const float* row) {
+    float minimum = row[0];
+
+    for (uint32_t x = 1; x < BLUE_NOISE_SIZE; ++x) {
+        minimum = row[x] < minimum ? row[x] : minimum;
+    }
+
+    return minimum;
+}
+
+// Ranks the pixels of every slice with void-and-cluster: each rank goes to the pixel of its slice with the lowest
+// energy, the largest void, which then adds a Gaussian of energy to the pixels around it in its slice and to the same
+// pixel in the nearby slices. The energy starts from a little noise, which breaks ties between voids randomly. Energy
+// only grows, so the minimum of every row is kept and only the rows that changed are searched again.
+static void generateBlueNoiseChannel(uint32_t channel, uint8_t* pixels) {
+    const uint32_t size = BLUE_NOISE_SIZE;
+    const uint32_t sliceSize = size * size;
+    const uint32_t kernelSize = 2 * blueNoiseRadius + 1;
+
+    float kernel[kernelSize * kernelSize];
+
+    for (int32_t y = -blueNoiseRadius; y <= blueNoiseRadius; ++y) {
+        for (int32_t x = -blueNoiseRadius; x <= blueNoiseRadius; ++x) {
+            kernel[kernelSize * (y + blueNoiseRadius) + x + blueNoiseRadius] = expf(-(x * x + y * y) / (2.0f * blueNoiseSigma * blueNoiseSigma));
+        }
+    }
+
+    float temporalKernel[BLUE_NOISE_SLICE_COUNT];
+
+    for (uint32_t t = 0; t < BLUE_NOISE_SLICE_COUNT; ++t) {
+        const float dt = (float)(t < BLUE_NOISE_SLICE_COUNT - t ? t : BLUE_NOISE_SLICE_COUNT - t);
+        temporalKernel[t] = expf(-dt * dt / (2.0f * blueNoiseSigma * blueNoiseSigma));
+    }
+
+    float* energy = new float[BLUE_NOISE_SLICE_COUNT * sliceSize];
+    float* rowMinima = new float[BLUE_NOISE_SLICE_COUNT * size];
+
+    for (uint32_t i = 0; i < BLUE_NOISE_SLICE_COUNT * sliceSize; ++i) {
+        energy[i] = 1e-4f * (hashBits(i ^ hashBits(channel + 1)) >> 8) / 16777216.0f;
+    }
+
+    for (uint32_t row = 0; row < BLUE_NOISE_SLICE_COUNT * size; ++row) {
+        rowMinima[row] = getRowMinimum(energy + size * row);
+    }
+
+    for (uint32_t rank = 0; rank < sliceSize; ++rank) {
+        for (uint32_t slice = 0; slice < BLUE_NOISE_SLICE_COUNT; ++slice) {
+            float* sliceEnergy = energy + (size_t)slice * sliceSize;
+            float* sliceRowMinima = rowMinima + slice * size;
+
+            // Pixels that already have a rank have infinite energy.
+            uint32_t voidY = 0;
+
+            for (uint32_t y = 1; y < size; ++y) {
+                if (sliceRowMinima[y] < sliceRowMinima[voidY]) {
+                    voidY = y;
+                }
+            }
+
+            uint32_t voidX = 0;
+
+            while (sliceEnergy[size * voidY + voidX] != sliceRowMinima[voidY]) {
+                ++voidX;
+            }
+
+            const uint32_t voidIndex = size * voidY + voidX;
+
+            const uint32_t atlasX = size * (slice % BLUE_NOISE_ATLAS_COLUMNS) + voidX;
+            const uint32_t atlasY = size * (slice / BLUE_NOISE_ATLAS_COLUMNS) + voidY;
+
+            pixels[4 * (BLUE_NOISE_ATLAS_SIZE * atlasY + atlasX) + channel] = (uint8_t)(rank * 256 / sliceSize);
+
+            sliceEnergy[voidIndex] = INFINITY;
+
+            // The slices tile, so the Gaussian wraps around their edges.
+            for (int32_t dy = -blueNoiseRadius; dy <= blueNoiseRadius; ++dy) {
+                const uint32_t y = (voidY + dy) & (size - 1);
+                float* energyRow = sliceEnergy + size * y;
+                const float* kernelRow = kernel + kernelSize * (dy + blueNoiseRadius) + blueNoiseRadius;
+
+                for (int32_t dx = -blueNoiseRadius; dx <= blueNoiseRadius; ++dx) {
+                    energyRow[(voidX + dx) & (size - 1)] += kernelRow[dx];
+                }
+
+                sliceRowMinima[y] = getRowMinimum(energyRow);
+            }
+
+            for (uint32_t other = 0; other < BLUE_NOISE_SLICE_COUNT; ++other) {
+                if (other == slice) {
+                    continue;
+                }
+
+                float& pixelEnergy = energy[(size_t)other * sliceSize + voidIndex];
+                float& rowMinimum = rowMinima[other * size + voidY];
+                const bool wasMinimum = pixelEnergy == rowMinimum;
+
+                pixelEnergy += temporalKernel[(other - slice) & (BLUE_NOISE_SLICE_COUNT - 1)];
+
+                if (wasMinimum) {
+                    rowMinimum = getRowMinimum(energy + (size_t)other * sliceSize + size * voidY);
+                }
+            }
+        }
+    }
+
+    delete[] rowMinima;
+    delete[] energy;
+}
+
+void generateBlueNoise(JobSystem& jobSystem, uint8_t* pixels) {
+    JobCounter jobCounter = 0;
+
+    for (uint32_t channel = 0; channel < 4; ++channel) {
+        jobSystem.submit([=]() {
+            generateBlueNoiseChannel(channel, pixels);
+        }, &jobCounter);
+    }
+
+    jobSystem.wait(jobCounter);
+}
+
+static bool isValidCache(const MappedFile& file) {
+    if (file.data == nullptr || file.size != cacheSize) {
+        return false;
+    }
+
+    const SamplingCacheHeader& header = *(const SamplingCacheHeader*)file.data;
+
+    return header.magic == SAMPLING_CACHE_MAGIC && header.version == SAMPLING_CACHE_VERSION && header.fileSize == file.size;
+}
+
+SamplingTables::SamplingTables(JobSystem& jobSystem, const std::filesystem::path& cachePath) : jobSystem(&jobSystem) {
+    jobCounter = new JobCounter(0);
+    tables = new uint8_t[sobolTableSize + blueNoiseSize];
+
+    // The job outlives the temporary this is constructed as, so it only holds on to the tables. Generating them keeps
+    // every thread busy for a while, so it runs in the background, behind the jobs of the frames.
+    jobSystem.submitBackground([&jobSystem, tables = tables, cachePath]() {
+        MappedFile file(cachePath);
+
+        if (isValidCache(file)) {
+            memcpy(tables, file.data + sizeof(SamplingCacheHeader), sobolTableSize + blueNoiseSize);
+            file.destroy();
+            return;
+        }
+
+        file.destroy();
+
+        // The blue noise takes the longest, one job per channel, so the Sobol table is scrambled alongside it.
+        JobCounter sobolJobCounter = 0;
+
+        jobSystem.submit([&jobSystem, tables]() {
+            generateSobolTable(jobSystem, (uint16_t*)tables);
+        }, &sobolJobCounter);
+
+        generateBlueNoise(jobSystem, tables + sobolTableSize);
+        jobSystem.wait(sobolJobCounter);
+
+        // Store the tables, moving them into place once they are complete.
+        std::filesystem::path temporaryPath = cachePath;
+        temporaryPath += ".tmp";
+
+        MappedFile temporaryFile(temporaryPath, cacheSize);
+
+        if (temporaryFile.data != nullptr) {
+            const SamplingCacheHeader header = {
+                .magic    = SAMPLING_CACHE_MAGIC,
+                .version  = SAMPLING_CACHE_VERSION,
+                .fileSize = cacheSize
+            };
+
+            memcpy(temporaryFile.data, &header, sizeof(header));
+            memcpy(temporaryFile.data + sizeof(header), tables, sobolTableSize + blueNoiseSize);
+            const bool flushed = temporaryFile.flush();
+            temporaryFile.destroy();
+
+            std::error_code error;
+
+            if (flushed) {
+                std::filesystem::rename(temporaryPath, cachePath, error);
+            } else {
+                std::filesystem::remove(temporaryPath, error);
+            }
+        }
+    }, jobCounter);
+}
+
+void SamplingTables::destroy(VkDevice device, BindlessTables& bindlessTables) {
+    jobSystem->wait(*jobCounter);
+
+    if (uploaded) {
+        bindlessTables.removeBuffer(sobolBufferIndex);
+        bindlessTables.removeImage(blueNoiseImageIndex);
+
+        sobolBuffer.destroy(device);
+        blueNoiseTexture.destroy(device);
+    }
+
+    delete[] tables;
+    delete jobCounter;
+}
+
+bool SamplingTables::update(Device& device, BindlessTables& bindlessTables, bool wait) {
+    if (uploaded) {
+        return false;
+    }
+
+    if (wait) {
+        jobSystem->wait(*jobCounter);
+    } else if (*jobCounter > 0) {
+        return false;
+    }
+
+    // Upload both tables at once.
+    sobolBuffer = Buffer(device, sobolTableSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    blueNoiseTexture = Texture(device, VK_FORMAT_R8G8B8A8_UNORM, BLUE_NOISE_ATLAS_SIZE, BLUE_NOISE_ATLAS_SIZE, 1);
+
+    Uploader uploader(device, sobolTableSize + blueNoiseSize + stagingAlignment);
+
+    VkDeviceSize sobolStagingOffset, blueNoiseStagingOffset;
+    uploader.allocate(sobolTableSize, stagingAlignment, &sobolStagingOffset);
+    uploader.allocate(blueNoiseSize, stagingAlignment, &blueNoiseStagingOffset);
+
+    memcpy(uploader.getData() + sobolStagingOffset, tables, sobolTableSize);
+    memcpy(uploader.getData() + blueNoiseStagingOffset, tables + sobolTableSize, blueNoiseSize);
+
+    uploader.copyToBuffer(sobolBuffer, 0, sobolStagingOffset, sobolTableSize);
+    uploader.copyToImageRegion(blueNoiseTexture, VK_IMAGE_LAYOUT_UNDEFINED, { 0, 0 }, { BLUE_NOISE_ATLAS_SIZE, BLUE_NOISE_ATLAS_SIZE }, blueNoiseStagingOffset);
+    uploader.finish(device);
+    uploader.destroy(device.logical);
+
+    delete[] tables;
+    tables = nullptr;
+
+    sobolBufferIndex = bindlessTables.addBuffer(device.logical, sobolBuffer);
+    blueNoiseImageIndex = bindlessTables.addImage(device.logical, blueNoiseTexture.view);
+    uploaded = true;
+
+    return true;
+}
@@ -0,0 +1,85 @@
+// Draws the random numbers of path tracing from the tables built by the sampling tables. Progressive accumulation takes
+// its samples from the Owen-scrambled Sobol table, padded 4 dimensions at a time: every pixel and group of dimensions
+// picks its own scrambled copy and shuffles its sample indices, so dimensions stay uncorrelated while the samples of a
+// pixel keep their stratification. Effects that only take a sample or two per frame read the spatiotemporal blue noise
+// instead, so their error spreads as high frequency noise that the denoiser and temporal accumulation remove easily.
+// The images are the bindless images, which the including shader declares.
+
+#extension GL_EXT_samplerless_texture_functions : enable
+
+#define SOBOL_SEQUENCE_COUNT 256
+#define SOBOL_SAMPLE_COUNT 1024
+
+#define BLUE_NOISE_SIZE 64
+#define BLUE_NOISE_SLICE_COUNT 64
+#define BLUE_NOISE_ATLAS_COLUMNS 8
+
+layout(set = 0, binding = 3) uniform FrameConstants {
+    uint frameNumber;
+    uint sobolBufferIndex;
+    uint blueNoiseImageIndex;
+    uint sampleIndex;
+    uint sampleCount;
+    uint firstSample;
+    uvec2 tileOffset;
+    uvec2 imageExtent;
+    uvec2 environmentTable;
+} frameConstants;
+
+// Every sample holds 4 unorm16s, two per word.
+layout(set = 1, binding = 2) readonly buffer SobolTable {
+    uvec2 samples[];
+} sobolTables[];
+
+uint hashSampling(uint value) {
+    value ^= value >> 16;
+    value *= 0x7feb352du;
+    value ^= value >> 15;
+    value *= 0x846ca68bu;
+    value ^= value >> 16;
+
+    return value;
+}
+
+// A nested uniform scramble of the index, as in Burley's hash-based Owen scrambling: the hash only carries bits upwards,
+// and reversing the bits around it makes every bit depend on the ones above it instead. Every aligned power of two range
+// of indices is then shuffled within an aligned range of the same size, which keeps the first 2^k samples stratified.
+uint shuffleSampleIndex(uint index, uint seed) {
+    index = bitfieldReverse(index);
+    index ^= index * 0x3d20adeau;
+    index += seed;
+    index *= (seed >> 16) | 1u;
+    index ^= index * 0x05526c56u;
+    index ^= index * 0x53a22864u;
+
+    return bitfieldReverse(index);
+}
+
+// Returns dimensions 4 * group to 4 * group + 3 of the pixel's sample.
+vec4 getSobolSample(uvec2 pixel, uint sampleIndex, uint group) {
+    uint seed = hashSampling(pixel.x ^ hashSampling(pixel.y ^ hashSampling(group)));
+
+    uint sequence = seed >> 24;
+    uint index = shuffleSampleIndex(sampleIndex, hashSampling(seed)) & (SOBOL_SAMPLE_COUNT - 1);
+
+    // A random digital shift keeps the scramble, and gives pixels that share a copy different points.
+    uvec2 packedSample = sobolTables[frameConstants.sobolBufferIndex].samples[sequence * SOBOL_SAMPLE_COUNT + index];
+    packedSample ^= uvec2(hashSampling(seed + 1u), hashSampling(seed + 2u));
+
+    uvec4 values = uvec4(packedSample.x & 0xffffu, packedSample.x >> 16, packedSample.y & 0xffffu, packedSample.y >> 16);
+
+    return (vec4(values) + 0.5) / 65536.0;
+}
+
+// Returns 4 independent blue noise values for the pixel in this frame. Groups offset the tile so that different effects
+// don't share values, and once the slices wrap around the tile moves as well, so that long runs don't repeat.
+vec4 getBlueNoise(uvec2 pixel, uint group) {
+    uint slice = frameConstants.frameNumber % BLUE_NOISE_SLICE_COUNT;
+    uint cycle = frameConstants.frameNumber / BLUE_NOISE_SLICE_COUNT;
+
+    uint offset = hashSampling(group ^ hashSampling(cycle));
+    uvec2 texel = (pixel + uvec2(offset, offset >> 16)) % BLUE_NOISE_SIZE;
+    texel += BLUE_NOISE_SIZE * uvec2(slice % BLUE_NOISE_ATLAS_COLUMNS, slice / BLUE_NOISE_ATLAS_COLUMNS);
+
+    return texelFetch(images[frameConstants.blueNoiseImageIndex], ivec2(texel), 0);
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <filesystem>
+
+#include "bindless.h"
+#include "jobs.h"
+#include "texture.h"
+
+// The Sobol table holds SOBOL_SEQUENCE_COUNT independently Owen-scrambled copies of the first SOBOL_SAMPLE_COUNT points
+// of the 4D Sobol sequence, as unorm16s. Shaders pad higher dimensions with more groups of 4, each from another copy.
+#define SOBOL_SEQUENCE_COUNT 256
+#define SOBOL_SAMPLE_COUNT 1024
+#define SOBOL_DIMENSION_COUNT 4
+
+// The blue noise holds 4 independent channels of spatiotemporal blue noise: every slice is a tileable blue noise
+// texture, and every pixel's values over consecutive slices are blue noise in time too. The slices are laid out in an
+// atlas of BLUE_NOISE_ATLAS_COLUMNS columns.
+#define BLUE_NOISE_SIZE 64
+#define BLUE_NOISE_SLICE_COUNT 64
+#define BLUE_NOISE_ATLAS_COLUMNS 8
+#define BLUE_NOISE_ATLAS_SIZE (BLUE_NOISE_SIZE * BLUE_NOISE_ATLAS_COLUMNS)
+
+// Generating the tables takes a while, so they are cached in a file that holds the header followed by both tables.
+#define SAMPLING_CACHE_MAGIC 0x53535856 // "VXSS"
+#define SAMPLING_CACHE_VERSION 1
+
+struct SamplingCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t fileSize;
+};
+
+// Fills the Sobol table, SOBOL_SEQUENCE_COUNT * SOBOL_SAMPLE_COUNT * SOBOL_DIMENSION_COUNT values.
+void generateSobolTable(JobSystem& jobSystem, uint16_t* samples);
+
+// Fills the RGBA8 blue noise atlas, BLUE_NOISE_ATLAS_SIZE * BLUE_NOISE_ATLAS_SIZE pixels.
+void generateBlueNoise(JobSystem& jobSystem, uint8_t* pixels);
+
+// The sample tables every shader draws its random numbers from, through the bindless tables. They are loaded from the
+// cache, or generated and then cached, by a background job that starts with the constructor, and uploaded by update
+// once that job is done. Until then the indices are BINDLESS_INVALID_INDEX.
+class SamplingTables {
+public:
+    uint32_t sobolBufferIndex = BINDLESS_INVALID_INDEX;
+    uint32_t blueNoiseImageIndex = BINDLESS_INVALID_INDEX;
+
+    SamplingTables() = default;
+    SamplingTables(JobSystem& jobSystem, const std::filesystem::path& cachePath);
+    void destroy(VkDevice device, BindlessTables& bindlessTables);
+
+    // Uploads the tables if their job is done, or once it is when waiting. Returns true on the call that uploads them.
+    bool update(Device& device, BindlessTables& bindlessTables, bool wait = false);
+
+private:
+    JobSystem* jobSystem = nullptr;
+    JobCounter* jobCounter = nullptr;
+    uint8_t* tables = nullptr;
+    bool uploaded = false;
+    Buffer sobolBuffer;
+    Texture blueNoiseTexture;
+};
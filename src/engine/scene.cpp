@@ -0,0 +1,290 @@
+#include "scene.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <bit>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define SCENE_USE_SSE2
+#endif
+
+// Marks storage positions whose entity was removed, they are dropped by the next sort.
+static const uint32_t removedDepth = UINT32_MAX;
+
+// Transforms are updated in batches of this many 64-entity words of the bitsets.
+static const uint32_t wordGrainSize = 16;
+
+static void readTransform(const float* columnMajor, SceneTransform& transform) {
+    for (uint32_t row = 0; row < 3; ++row) {
+        for (uint32_t column = 0; column < 4; ++column) {
+            transform.m[row][column] = columnMajor[4 * column + row];
+        }
+    }
+}
+
+// Both are affine, so the bottom row is implicitly (0, 0, 0, 1).
+static inline void multiplyTransforms(const SceneTransform& a, const SceneTransform& b, SceneTransform& result) {
+#ifdef SCENE_USE_SSE2
+    const __m128 b0 = _mm_loadu_ps(b.m[0]);
+    const __m128 b1 = _mm_loadu_ps(b.m[1]);
+    const __m128 b2 = _mm_loadu_ps(b.m[2]);
+
+    for (uint32_t row = 0; row < 3; ++row) {
+        __m128 sum = _mm_set_ps(a.m[row][3], 0.0f, 0.0f, 0.0f);
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a.m[row][0]), b0));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a.m[row][1]), b1));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(a.m[row][2]), b2));
+
+        _mm_storeu_ps(result.m[row], sum);
+    }
+#else
+    for (uint32_t row = 0; row < 3; ++row) {
+        for (uint32_t column = 0; column < 4; ++column) {
+            result.m[row][column] = a.m[row][0] * b.m[0][column] + a.m[row][1] * b.m[1][column] + a.m[row][2] * b.m[2][column];
+        }
+
+        result.m[row][3] += a.m[row][3];
+    }
+#endif
+}
+
+// The bits of a word are read by jobs that are writing other bits of it.
+static inline bool testBit(uint64_t* bits, uint32_t index) {
+    return (std::atomic_ref<uint64_t>(bits[index / 64]).load(std::memory_order_relaxed) >> (index % 64)) & 1;
+}
+
+uint32_t Scene::addEntity(uint32_t parent, const float* localTransform) {
+    uint32_t entity;
+
+    if (!freeEntities.empty()) {
+        entity = freeEntities.back();
+        freeEntities.pop_back();
+    } else {
+        entity = (uint32_t)storagePositions.size();
+        storagePositions.push_back(0);
+    }
+
+    // Parents always exist before their children, so they stay in front of them even before sorting.
+    const uint32_t position = (uint32_t)entities.size();
+    const uint32_t parentPosition = parent != SCENE_INVALID_ENTITY ? storagePositions[parent] : SCENE_INVALID_ENTITY;
+
+    SceneTransform transform;
+    readTransform(localTransform, transform);
+
+    storagePositions[entity] = position;
+    entities.push_back(entity);
+    parents.push_back(parentPosition);
+    depths.push_back(parentPosition != SCENE_INVALID_ENTITY ? depths[parentPosition] + 1 : 0);
+    instances.push_back(SCENE_NO_INSTANCE);
+    localTransforms.push_back(transform);
+    worldTransforms.push_back(transform);
+
+    sorted = false;
+
+    return entity;
+}
+
+void Scene::removeEntity(uint32_t entity) {
+    const uint32_t position = storagePositions[entity];
+
+    depths[position] = removedDepth;
+
+    // Descendants come after their ancestors, so a single pass reaches all of them.
+    for (uint32_t i = position + 1; i < entities.size(); ++i) {
+        if (depths[i] != removedDepth && parents[i] != SCENE_INVALID_ENTITY && depths[parents[i]] == removedDepth) {
+            depths[i] = removedDepth;
+        }
+    }
+
+    for (uint32_t i = position; i < entities.size(); ++i) {
+        if (depths[i] == removedDepth && storagePositions[entities[i]] == i) {
+            storagePositions[entities[i]] = SCENE_INVALID_ENTITY;
+            freeEntities.push_back(entities[i]);
+        }
+    }
+
+    sorted = false;
+}
+
+void Scene::setLocalTransform(uint32_t entity, const float* localTransform) {
+    const uint32_t position = storagePositions[entity];
+
+    readTransform(localTransform, localTransforms[position]);
+
+    if (sorted) {
+        localChangedBits[position / 64] |= 1ull << (position % 64);
+    }
+}
+
+const SceneTransform& Scene::getWorldTransform(uint32_t entity) {
+    return worldTransforms[storagePositions[entity]];
+}
+
+bool Scene::isWorldTransformChanged(uint32_t entity) {
+    return testBit(changedBits.data(), storagePositions[entity]);
+}
+
+void Scene::setInstance(uint32_t entity, uint32_t instance) {
+    const uint32_t position = storagePositions[entity];
+
+    instances[position] = instance;
+
+    // The instance needs the transform even if it doesn't move.
+    if (sorted) {
+        localChangedBits[position / 64] |= 1ull << (position % 64);
+    }
+}
+
+void Scene::updateWorldTransforms(JobSystem& jobSystem) {
+    if (!sorted) {
+        sortByDepth();
+    }
+
+    memset(changedBits.data(), 0, changedBits.size() * sizeof(uint64_t));
+
+    for (size_t level = 0; level + 1 < levelOffsets.size(); ++level) {
+        const uint32_t begin = levelOffsets[level];
+        const uint32_t end = levelOffsets[level + 1];
+        const uint32_t firstWord = begin / 64;
+        const uint32_t wordCount = (end + 63) / 64 - firstWord;
+
+        // Jobs own whole words, the first and last words of a level are only shared with levels that aren't running.
+        jobSystem.parallelFor(wordCount, wordGrainSize, [&](uint32_t beginWord, uint32_t endWord) {
+            for (uint32_t word = firstWord + beginWord; word < firstWord + endWord; ++word) {
+                const uint32_t wordBegin = word * 64 > begin ? word * 64 : begin;
+                const uint32_t wordEnd = word * 64 + 64 < end ? word * 64 + 64 : end;
+
+                uint64_t bits = 0;
+
+                for (uint32_t i = wordBegin; i < wordEnd; ++i) {
+                    const uint32_t parent = parents[i];
+                    const bool localChanged = (localChangedBits[word] >> (i % 64)) & 1;
+
+                    if (parent == SCENE_INVALID_ENTITY) {
+                        if (localChanged) {
+                            worldTransforms[i] = localTransforms[i];
+                            bits |= 1ull << (i % 64);
+                        }
+                    } else if (localChanged || testBit(changedBits.data(), parent)) {
+                        multiplyTransforms(worldTransforms[parent], localTransforms[i], worldTransforms[i]);
+                        bits |= 1ull << (i % 64);
+                    }
+                }
+
+                if (bits != 0) {
+                    std::atomic_ref<uint64_t>(changedBits[word]).fetch_or(bits, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+
+    memset(localChangedBits.data(), 0, localChangedBits.size() * sizeof(uint64_t));
+}
+
+uint32_t Scene::updateInstanceTransforms(JobSystem& jobSystem, VkAccelerationStructureInstanceKHR* instances) {
+    std::atomic<uint32_t> instanceCount = 0;
+
+    jobSystem.parallelFor((uint32_t)changedBits.size(), wordGrainSize, [&](uint32_t beginWord, uint32_t endWord) {
+        uint32_t count = 0;
+
+        for (uint32_t word = beginWord; word < endWord; ++word) {
+            // Only the entities that changed are visited, words without any are skipped as a whole.
+            for (uint64_t bits = changedBits[word]; bits != 0; bits &= bits - 1) {
+                const uint32_t i = word * 64 + (uint32_t)std::countr_zero(bits);
+                const uint32_t instance = this->instances[i];
+
+                if (instance != SCENE_NO_INSTANCE) {
+                    memcpy(&instances[instance].transform, &worldTransforms[i], sizeof(VkTransformMatrixKHR));
+                    ++count;
+                }
+            }
+        }
+
+        instanceCount += count;
+    });
+
+    return instanceCount;
+}
+
+uint32_t Scene::getEntityCount() {
+    return (uint32_t)(storagePositions.size() - freeEntities.size());
+}
+
+void Scene::sortByDepth() {
+    // Counting sort, which keeps parents in front of their children since it's stable.
+    uint32_t levelCount = 0;
+
+    for (uint32_t depth : depths) {
+        if (depth != removedDepth && depth + 1 > levelCount) {
+            levelCount = depth + 1;
+        }
+    }
+
+    levelOffsets.assign(levelCount + 1, 0);
+
+    for (uint32_t depth : depths) {
+        if (depth != removedDepth) {
+            ++levelOffsets[depth + 1];
+        }
+    }
+
+    for (uint32_t level = 0; level < levelCount; ++level) {
+        levelOffsets[level + 1] += levelOffsets[level];
+    }
+
+    const uint32_t count = levelOffsets[levelCount];
+
+    std::vector<uint32_t> newPositions(entities.size(), SCENE_INVALID_ENTITY);
+    std::vector<uint32_t> nextPositions(levelOffsets.begin(), levelOffsets.end() - 1);
+
+    for (uint32_t i = 0; i < entities.size(); ++i) {
+        if (depths[i] != removedDepth) {
+            newPositions[i] = nextPositions[depths[i]]++;
+        }
+    }
+
+    std::vector<uint32_t> sortedEntities(count);
+    std::vector<uint32_t> sortedParents(count);
+    std::vector<uint32_t> sortedDepths(count);
+    std::vector<uint32_t> sortedInstances(count);
+    std::vector<SceneTransform> sortedLocalTransforms(count);
+    std::vector<SceneTransform> sortedWorldTransforms(count);
+
+    for (uint32_t i = 0; i < entities.size(); ++i) {
+        const uint32_t position = newPositions[i];
+
+        if (position == SCENE_INVALID_ENTITY) {
+            continue;
+        }
+
+        sortedEntities[position] = entities[i];
+        sortedParents[position] = parents[i] != SCENE_INVALID_ENTITY ? newPositions[parents[i]] : SCENE_INVALID_ENTITY;
+        sortedDepths[position] = depths[i];
+        sortedInstances[position] = instances[i];
+        sortedLocalTransforms[position] = localTransforms[i];
+        sortedWorldTransforms[position] = worldTransforms[i];
+
+        storagePositions[entities[i]] = position;
+    }
+
+    entities = std::move(sortedEntities);
+    parents = std::move(sortedParents);
+    depths = std::move(sortedDepths);
+    instances = std::move(sortedInstances);
+    localTransforms = std::move(sortedLocalTransforms);
+    worldTransforms = std::move(sortedWorldTransforms);
+
+    // Every entity may have moved, so every world transform is computed again.
+    const uint32_t wordCount = (count + 63) / 64;
+
+    localChangedBits.assign(wordCount, ~0ull);
+    changedBits.assign(wordCount, 0);
+
+    if (count % 64 != 0) {
+        localChangedBits[wordCount - 1] = (1ull << (count % 64)) - 1;
+    }
+
+    sorted = true;
+}
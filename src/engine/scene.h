@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "graphics.h"
+#include "jobs.h"
+
+#define SCENE_INVALID_ENTITY UINT32_MAX
+#define SCENE_NO_INSTANCE UINT32_MAX
+
+// Affine transforms keep the top three rows of a row-major 4x4 matrix, the same layout as VkTransformMatrixKHR.
+struct SceneTransform {
+    float m[3][4];
+};
+
+// The transform hierarchy of every entity in the world. Entities are handles into structure-of-arrays storage that is
+// sorted by depth in the hierarchy, so world transforms are computed one level at a time with every entity of a level
+// in parallel, and each level only reads the level above it.
+//
+// Entities whose world transform changed in the last update are flagged in a bitset indexed by storage position, which
+// is what the TLAS instance updater walks to only touch the instances that moved.
+class Scene {
+public:
+    Scene() = default;
+    Scene(const Scene&) = delete;
+    Scene& operator=(const Scene&) = delete;
+
+    // The local transform is a column-major 4x4 matrix, like glTF's.
+    uint32_t addEntity(uint32_t parent, const float* localTransform);
+
+    // Removes the entity along with all of its descendants.
+    void removeEntity(uint32_t entity);
+
+    void setLocalTransform(uint32_t entity, const float* localTransform);
+    const SceneTransform& getWorldTransform(uint32_t entity);
+
+    // Whether the entity's world transform changed in the last update.
+    bool isWorldTransformChanged(uint32_t entity);
+
+    // Links the entity to an instance of the TLAS, or unlinks it with SCENE_NO_INSTANCE.
+    void setInstance(uint32_t entity, uint32_t instance);
+
+    // Computes the world transforms of the entities whose local transform, or that of an ancestor, changed since the
+    // last update.
+    void updateWorldTransforms(JobSystem& jobSystem);
+
+    // Copies the world transforms that changed in the last update into the instances they are linked to. Returns the
+    // number of instances written.
+    uint32_t updateInstanceTransforms(JobSystem& jobSystem, VkAccelerationStructureInstanceKHR* instances);
+
+    uint32_t getEntityCount();
+
+private:
+    // Storage, sorted by depth. Parents are storage positions too.
+    std::vector<uint32_t> entities;
+    std::vector<uint32_t> parents;
+    std::vector<uint32_t> depths;
+    std::vector<uint32_t> instances;
+    std::vector<SceneTransform> localTransforms;
+    std::vector<SceneTransform> worldTransforms;
+    std::vector<uint64_t> localChangedBits;
+    std::vector<uint64_t> changedBits;
+
+    // Where each depth starts in storage, with the total count at the end.
+    std::vector<uint32_t> levelOffsets;
+
+    // Entity handles map to storage positions, freed handles are reused.
+    std::vector<uint32_t> storagePositions;
+    std::vector<uint32_t> freeEntities;
+
+    // Entities are appended as they come, sorting is deferred until the next update.
+    bool sorted = true;
+
+    void sortByDepth();
+};
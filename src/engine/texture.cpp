@@ -0,0 +1,91 @@
+#include "texture.h"
+
+Texture::Texture(Device& device, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels)
+        : format(format), width(width), height(height), mipLevels(mipLevels) {
+    // Create the image.
+    VkImageCreateInfo imageCreateInfo = {
+        .sType                 = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .pNext                 = nullptr,
+        .flags                 = 0,
+        .imageType             = VK_IMAGE_TYPE_2D,
+        .format                = format,
+        .extent                = { width, height, 1 },
+        .mipLevels             = mipLevels,
+        .arrayLayers           = 1,
+        .samples               = VK_SAMPLE_COUNT_1_BIT,
+        .tiling                = VK_IMAGE_TILING_OPTIMAL,
+        .usage                 = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        .sharingMode           = VK_SHARING_MODE_EXCLUSIVE,
+        .queueFamilyIndexCount = 0,
+        .pQueueFamilyIndices   = nullptr,
+        .initialLayout         = VK_IMAGE_LAYOUT_UNDEFINED
+    };
+
+    vkCreateImage(device.logical, &imageCreateInfo, nullptr, &image);
+
+    // Allocate the image memory.
+    VkMemoryRequirements memoryRequirements;
+    vkGetImageMemoryRequirements(device.logical, image, &memoryRequirements);
+
+    uint32_t memoryTypeIndex = device.getMemoryTypeIndex(memoryRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VkMemoryAllocateInfo memoryAllocateInfo = {
+        .sType           = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .pNext           = nullptr,
+        .allocationSize  = memoryRequirements.size,
+        .memoryTypeIndex = memoryTypeIndex
+    };
+
+    vkAllocateMemory(device.logical, &memoryAllocateInfo, nullptr, &memory);
+
+    // Bind the image memory.
+    vkBindImageMemory(device.logical, image, memory, 0);
+
+    // Create the image view. Single channel textures are read as grayscale.
+    VkComponentMapping components = { VK_COMPONENT_SWIZZLE_IDENTITY };
+
+    if (format == VK_FORMAT_BC4_UNORM_BLOCK) {
+        components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+    }
+
+    VkImageViewCreateInfo imageViewCreateInfo = {
+        .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .pNext            = nullptr,
+        .flags            = 0,
+        .image            = image,
+        .viewType         = VK_IMAGE_VIEW_TYPE_2D,
+        .format           = format,
+        .components       = components,
+        .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 }
+    };
+
+    vkCreateImageView(device.logical, &imageViewCreateInfo, nullptr, &view);
+}
+
+void Texture::destroy(VkDevice device) {
+    vkDestroyImageView(device, view, nullptr);
+    vkFreeMemory(device, memory, nullptr);
+    vkDestroyImage(device, image, nullptr);
+}
+
+uint32_t Texture::getMipWidth(uint32_t mipLevel) {
+    const uint32_t mipWidth = width >> mipLevel;
+    return mipWidth > 0 ? mipWidth : 1;
+}
+
+uint32_t Texture::getMipHeight(uint32_t mipLevel) {
+    const uint32_t mipHeight = height >> mipLevel;
+    return mipHeight > 0 ? mipHeight : 1;
+}
+
+uint32_t getMipLevelCount(uint32_t width, uint32_t height) {
+    uint32_t size = width > height ? width : height;
+    uint32_t mipLevels = 1;
+
+    while (size > 1) {
+        size >>= 1;
+        ++mipLevels;
+    }
+
+    return mipLevels;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "graphics.h"
+
+class Texture {
+public:
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView view;
+    VkFormat format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+
+    Texture() = default;
+    Texture(Device& device, VkFormat format, uint32_t width, uint32_t height, uint32_t mipLevels);
+    void destroy(VkDevice device);
+
+    uint32_t getMipWidth(uint32_t mipLevel);
+    uint32_t getMipHeight(uint32_t mipLevel);
+};
+
+uint32_t getMipLevelCount(uint32_t width, uint32_t height);
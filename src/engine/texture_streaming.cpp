@@ -0,0 +1,350 @@
+#include "texture_streaming.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+// Uploads of a frame share one staging batch, which caps how much is streamed per frame.
+static const VkDeviceSize stagingCapacity = 32ull << 20;
+static const VkDeviceSize stagingAlignment = 16;
+
+// Mips up to this size are always resident, so every texture can be sampled as soon as it's added.
+static const uint32_t baseMipSize = 64;
+
+// Part of the budget reported by the driver that is left for the rest of the application and other processes.
+static const VkDeviceSize budgetHeadroomPercentage = 10;
+
+static VkDeviceSize getMipChainSize(const CookedTexture& cookedTexture, uint32_t firstMip) {
+    VkDeviceSize size = 0;
+
+    for (uint32_t i = firstMip; i < cookedTexture.mipLevels; ++i) {
+        size += cookedTexture.mipSizes[i] + stagingAlignment;
+    }
+
+    return size;
+}
+
+static uint32_t getBaseMip(const CookedTexture& cookedTexture) {
+    uint32_t mip = 0;
+
+    while (mip + 1 < cookedTexture.mipLevels && std::max(cookedTexture.width >> mip, cookedTexture.height >> mip) > baseMipSize) {
+        ++mip;
+    }
+
+    return mip;
+}
+
+// Returns how much device-local memory the streamed textures may use.
+static VkDeviceSize getTextureBudget(Device& device, VkDeviceSize residentSize) {
+    VkPhysicalDeviceMemoryBudgetPropertiesEXT memoryBudgetProperties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT,
+        .pNext = nullptr
+    };
+
+    VkPhysicalDeviceMemoryProperties2 memoryProperties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2,
+        .pNext = device.memoryBudgetSupported ? &memoryBudgetProperties : nullptr
+    };
+
+    vkGetPhysicalDeviceMemoryProperties2(device.physical, &memoryProperties);
+
+    // Textures live in the biggest device-local heap.
+    uint32_t heapIndex = 0;
+
+    for (uint32_t i = 0; i < memoryProperties.memoryProperties.memoryHeapCount; ++i) {
+        const VkMemoryHeap& heap = memoryProperties.memoryProperties.memoryHeaps[i];
+
+        if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap.size > memoryProperties.memoryProperties.memoryHeaps[heapIndex].size) {
+            heapIndex = i;
+        }
+    }
+
+    // Without the extension there's no way to know what else is using the heap, so only half of it is taken.
+    if (!device.memoryBudgetSupported) {
+        return memoryProperties.memoryProperties.memoryHeaps[heapIndex].size / 2;
+    }
+
+    const VkDeviceSize heapBudget = memoryBudgetProperties.heapBudget[heapIndex];
+    const VkDeviceSize heapUsage = memoryBudgetProperties.heapUsage[heapIndex];
+
+    const VkDeviceSize availableSize = heapBudget - heapBudget * budgetHeadroomPercentage / 100;
+    const VkDeviceSize otherUsage = heapUsage > residentSize ? heapUsage - residentSize : 0;
+
+    return availableSize > otherUsage ? availableSize - otherUsage : 0;
+}
+
+TextureStreamer::TextureStreamer(Device& device, uint32_t framesInFlight)
+        : framesInFlight(framesInFlight), frame(0), slotCount(0), freeSlotCount(0), staleTableCount(0) {
+    uploader = Uploader(device, stagingCapacity);
+
+    textures = new StreamedTexture[TEXTURE_TABLE_CAPACITY];
+    usedSlots = new bool[TEXTURE_TABLE_CAPACITY]();
+    freeSlots = new uint32_t[TEXTURE_TABLE_CAPACITY];
+}
+
+void TextureStreamer::destroy(VkDevice device, BindlessTables& bindlessTables) {
+    for (uint32_t i = 0; i < slotCount; ++i) {
+        if (usedSlots[i]) {
+            removeTexture(i);
+        }
+    }
+
+    for (RetiredMips& retired : retiredMips) {
+        bindlessTables.removeImage(retired.mips.bindlessIndex);
+        retired.mips.texture.destroy(device);
+    }
+
+    for (StreamedFile& file : files) {
+        file.file.destroy();
+    }
+
+    delete[] freeSlots;
+    delete[] usedSlots;
+    delete[] textures;
+
+    uploader.destroy(device);
+}
+
+uint32_t TextureStreamer::addFile(const MappedFile& file) {
+    for (uint32_t i = 0; i < files.size(); ++i) {
+        if (files[i].file.data == nullptr) {
+            files[i] = { file, 1 };
+            return i;
+        }
+    }
+
+    files.push_back({ file, 1 });
+
+    return (uint32_t)files.size() - 1;
+}
+
+void TextureStreamer::releaseFile(uint32_t fileIndex) {
+    if (--files[fileIndex].referenceCount == 0) {
+        files[fileIndex].file.destroy();
+    }
+}
+
+uint32_t TextureStreamer::addTexture(Device& device, BindlessTables& bindlessTables, uint32_t fileIndex, const CookedTexture& cookedTexture) {
+    uint32_t slot;
+
+    if (freeSlotCount > 0) {
+        slot = freeSlots[--freeSlotCount];
+    } else if (slotCount < TEXTURE_TABLE_CAPACITY) {
+        slot = slotCount++;
+    } else {
+        return BINDLESS_INVALID_INDEX;
+    }
+
+    StreamedTexture& texture = textures[slot];
+
+    texture.fileIndex     = fileIndex;
+    texture.cookedTexture = cookedTexture;
+    texture.streaming     = false;
+    texture.lastUsedFrame = frame;
+
+    // Upload the base mips right away, flushing the staging memory if it's full.
+    const uint32_t baseMip = getBaseMip(cookedTexture);
+
+    if (!uploadMips(device, bindlessTables, texture, baseMip, texture.base)) {
+        uploader.flush(device);
+
+        if (!uploadMips(device, bindlessTables, texture, baseMip, texture.base)) {
+            freeSlots[freeSlotCount++] = slot;
+            return BINDLESS_INVALID_INDEX;
+        }
+    }
+
+    ++files[fileIndex].referenceCount;
+    usedSlots[slot] = true;
+    staleTableCount = framesInFlight;
+
+    return slot;
+}
+
+void TextureStreamer::removeTexture(uint32_t slot) {
+    StreamedTexture& texture = textures[slot];
+
+    retire(texture.base);
+
+    if (texture.streaming) {
+        retire(texture.streamed);
+        --streamedTextureCount;
+    }
+
+    releaseFile(texture.fileIndex);
+
+    usedSlots[slot] = false;
+    freeSlots[freeSlotCount++] = slot;
+    staleTableCount = framesInFlight;
+}
+
+void TextureStreamer::update(Device& device, BindlessTables& bindlessTables, const uint32_t* feedback, uint32_t* textureTable) {
+    ++frame;
+
+    // Destroy the mips that no frame in flight can sample anymore.
+    for (size_t i = 0; i < retiredMips.size();) {
+        if (retiredMips[i].frame + framesInFlight > frame) {
+            ++i;
+            continue;
+        }
+
+        bindlessTables.removeImage(retiredMips[i].mips.bindlessIndex);
+        retiredMips[i].mips.texture.destroy(device.logical);
+
+        retiredMips[i] = retiredMips.back();
+        retiredMips.pop_back();
+    }
+
+    budget = getTextureBudget(device, residentSize);
+
+    // Find the textures that were sampled at a finer mip than the one resident.
+    struct Request {
+        uint32_t slot;
+        uint32_t firstMip;
+        uint32_t missingMipCount;
+    };
+
+    std::vector<Request> requests;
+
+    for (uint32_t i = 0; i < slotCount && feedback != nullptr; ++i) {
+        if (!usedSlots[i] || feedback[i] == UINT32_MAX) {
+            continue;
+        }
+
+        StreamedTexture& texture = textures[i];
+        texture.lastUsedFrame = frame;
+
+        const uint32_t residentMip = texture.streaming ? texture.streamed.firstMip : texture.base.firstMip;
+        uint32_t requestedMip = std::min(feedback[i], texture.cookedTexture.mipLevels - 1);
+
+        // A mip chain that doesn't fit in the staging memory could never be uploaded.
+        while (requestedMip < residentMip && getMipChainSize(texture.cookedTexture, requestedMip) > uploader.capacity) {
+            ++requestedMip;
+        }
+
+        if (requestedMip < residentMip) {
+            requests.push_back({ i, requestedMip, residentMip - requestedMip });
+        }
+    }
+
+    // Stream the textures that are missing the most detail first.
+    std::sort(requests.begin(), requests.end(), [](const Request& a, const Request& b) {
+        return a.missingMipCount > b.missingMipCount;
+    });
+
+    for (const Request& request : requests) {
+        StreamedTexture& texture = textures[request.slot];
+
+        const VkDeviceSize size = getMipChainSize(texture.cookedTexture, request.firstMip);
+        const VkDeviceSize replacedSize = texture.streaming ? texture.streamed.size : 0;
+
+        while (residentSize + size - replacedSize > budget && evictLeastRecentlyUsed());
+
+        if (residentSize + size - replacedSize > budget) {
+            continue;
+        }
+
+        // Stop once this frame's staging memory is used up, the rest is streamed in the following frames.
+        ResidentMips mips;
+
+        if (!uploadMips(device, bindlessTables, texture, request.firstMip, mips)) {
+            break;
+        }
+
+        if (texture.streaming) {
+            retire(texture.streamed);
+        } else {
+            ++streamedTextureCount;
+        }
+
+        texture.streamed = mips;
+        texture.streaming = true;
+        staleTableCount = framesInFlight;
+    }
+
+    // Point the shaders at the finest mips of every texture, each frame's table is rewritten until it's up to date.
+    if (staleTableCount > 0) {
+        for (uint32_t i = 0; i < slotCount; ++i) {
+            if (usedSlots[i]) {
+                const ResidentMips& mips = textures[i].streaming ? textures[i].streamed : textures[i].base;
+                textureTable[i] = mips.bindlessIndex | mips.firstMip << 24;
+            }
+        }
+
+        --staleTableCount;
+    }
+
+    uploader.flush(device);
+}
+
+bool TextureStreamer::needsUpdate() {
+    return staleTableCount > 0 || !retiredMips.empty();
+}
+
+bool TextureStreamer::uploadMips(Device& device, BindlessTables& bindlessTables, StreamedTexture& texture, uint32_t firstMip, ResidentMips& mips) {
+    const CookedTexture& cookedTexture = texture.cookedTexture;
+    const uint8_t* fileData = files[texture.fileIndex].file.data;
+
+    VkDeviceSize mipStagingOffsets[COOKED_TEXTURE_MAX_MIP_LEVELS];
+
+    for (uint32_t i = firstMip; i < cookedTexture.mipLevels; ++i) {
+        if (!uploader.allocate(cookedTexture.mipSizes[i], stagingAlignment, &mipStagingOffsets[i - firstMip])) {
+            return false;
+        }
+    }
+
+    const uint32_t width = std::max(cookedTexture.width >> firstMip, 1u);
+    const uint32_t height = std::max(cookedTexture.height >> firstMip, 1u);
+
+    mips.texture = Texture(device, (VkFormat)cookedTexture.format, width, height, cookedTexture.mipLevels - firstMip);
+    mips.bindlessIndex = bindlessTables.addImage(device.logical, mips.texture.view);
+
+    if (mips.bindlessIndex == BINDLESS_INVALID_INDEX) {
+        mips.texture.destroy(device.logical);
+        return false;
+    }
+
+    for (uint32_t i = firstMip; i < cookedTexture.mipLevels; ++i) {
+        memcpy(uploader.getData() + mipStagingOffsets[i - firstMip], fileData + cookedTexture.mipOffsets[i], cookedTexture.mipSizes[i]);
+    }
+
+    uploader.copyToImage(mips.texture, mipStagingOffsets);
+
+    mips.firstMip = firstMip;
+    mips.size = getMipChainSize(cookedTexture, firstMip);
+
+    residentSize += mips.size;
+
+    return true;
+}
+
+void TextureStreamer::retire(const ResidentMips& mips) {
+    // The memory is counted as free right away, it's released once the frames in flight are done with it.
+    residentSize -= mips.size;
+    retiredMips.push_back({ mips, frame });
+}
+
+bool TextureStreamer::evictLeastRecentlyUsed() {
+    uint32_t leastRecentlyUsedSlot = UINT32_MAX;
+    uint64_t leastRecentlyUsedFrame = frame;
+
+    // Textures sampled in the last frame are never evicted, that would only make them stream in again.
+    for (uint32_t i = 0; i < slotCount; ++i) {
+        if (usedSlots[i] && textures[i].streaming && textures[i].lastUsedFrame < leastRecentlyUsedFrame) {
+            leastRecentlyUsedSlot = i;
+            leastRecentlyUsedFrame = textures[i].lastUsedFrame;
+        }
+    }
+
+    if (leastRecentlyUsedSlot == UINT32_MAX) {
+        return false;
+    }
+
+    retire(textures[leastRecentlyUsedSlot].streamed);
+
+    textures[leastRecentlyUsedSlot].streaming = false;
+    --streamedTextureCount;
+    staleTableCount = framesInFlight;
+
+    return true;
+}
@@ -0,0 +1,26 @@
+// Samples textures through the texture table and reports the finest mip each one needed, so that the texture streamer
+// can make it resident. Ray tracing shaders have no derivatives, the caller computes the level of detail.
+
+#extension GL_EXT_nonuniform_qualifier : enable
+
+layout(set = 0, binding = 1) buffer TextureFeedback {
+    uint textureFeedback[];
+};
+
+layout(set = 0, binding = 2) readonly buffer TextureTable {
+    uint textureTable[];
+};
+
+layout(set = 1, binding = 0) uniform texture2D images[];
+layout(set = 1, binding = 1) uniform sampler samplers[];
+
+vec4 sampleStreamedTexture(uint slot, uint samplerIndex, vec2 uv, float lod) {
+    atomicMin(textureFeedback[slot], uint(max(lod, 0.0)));
+
+    uint entry = textureTable[slot];
+    uint imageIndex = entry & 0xffffff;
+    float residentMip = float(entry >> 24);
+
+    // The resident image starts at the finest resident mip, so the level of detail is shifted to match.
+    return textureLod(sampler2D(images[nonuniformEXT(imageIndex)], samplers[nonuniformEXT(samplerIndex)]), uv, max(lod - residentMip, 0.0));
+}
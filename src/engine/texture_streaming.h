@@ -0,0 +1,86 @@
+#pragma once
+
+#include <vector>
+
+#include "bindless.h"
+#include "cooked_asset.h"
+#include "file_mapping.h"
+#include "texture.h"
+#include "upload.h"
+
+// Keeps the mips of cooked textures resident on demand. Every texture always has its smallest mips resident, the finer
+// ones are uploaded from the mapped file once the shaders report sampling them through the texture feedback, and are
+// dropped again, least recently used first, when they no longer fit in the memory budget.
+//
+// Shaders see a texture through its slot in the texture table, whose entries are written as
+// bindlessIndex | residentMip << 24.
+class TextureStreamer {
+public:
+    VkDeviceSize budget = 0;
+    VkDeviceSize residentSize = 0;
+    uint32_t streamedTextureCount = 0;
+
+    TextureStreamer() = default;
+    TextureStreamer(Device& device, uint32_t framesInFlight);
+    void destroy(VkDevice device, BindlessTables& bindlessTables);
+
+    // Takes ownership of a mapped cooked asset. Every texture from the file holds a reference to it, as does the caller
+    // until it releases the file, and the file is unmapped once the last reference is released.
+    uint32_t addFile(const MappedFile& file);
+    void releaseFile(uint32_t fileIndex);
+
+    // Returns the texture's slot in the texture table, or BINDLESS_INVALID_INDEX if the table is full.
+    uint32_t addTexture(Device& device, BindlessTables& bindlessTables, uint32_t fileIndex, const CookedTexture& cookedTexture);
+    void removeTexture(uint32_t slot);
+
+    // Reads the feedback of a frame that has completed, uploads and evicts mips, and writes the frame's texture table.
+    // The feedback is nullptr when no shader reports it, then only added and removed textures are handled.
+    void update(Device& device, BindlessTables& bindlessTables, const uint32_t* feedback, uint32_t* textureTable);
+
+    // Whether a texture table is out of date or mips are waiting to be destroyed, which update has to handle even
+    // without feedback.
+    bool needsUpdate();
+
+private:
+    struct StreamedFile {
+        MappedFile file;
+        uint32_t referenceCount;
+    };
+
+    struct ResidentMips {
+        Texture texture;
+        uint32_t bindlessIndex;
+        uint32_t firstMip;
+        VkDeviceSize size;
+    };
+
+    struct StreamedTexture {
+        uint32_t fileIndex;
+        CookedTexture cookedTexture;
+        ResidentMips base;
+        ResidentMips streamed;
+        bool streaming;
+        uint64_t lastUsedFrame;
+    };
+
+    struct RetiredMips {
+        ResidentMips mips;
+        uint64_t frame;
+    };
+
+    uint32_t framesInFlight;
+    uint64_t frame;
+    Uploader uploader;
+    std::vector<StreamedFile> files;
+    StreamedTexture* textures;
+    bool* usedSlots;
+    uint32_t slotCount;
+    uint32_t* freeSlots;
+    uint32_t freeSlotCount;
+    uint32_t staleTableCount;
+    std::vector<RetiredMips> retiredMips;
+
+    bool uploadMips(Device& device, BindlessTables& bindlessTables, StreamedTexture& texture, uint32_t firstMip, ResidentMips& mips);
+    void retire(const ResidentMips& mips);
+    bool evictLeastRecentlyUsed();
+};
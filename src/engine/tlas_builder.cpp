@@ -0,0 +1,311 @@
+#include "tlas_builder.h"
+
+#include <string.h>
+
+// Refitting lets the TLAS degrade as instances move, so it's rebuilt from scratch every so often.
+static const uint32_t maxRefitCount = 64;
+
+static VkDeviceSize alignSize(VkDeviceSize size, VkDeviceSize alignment) {
+    return (size + alignment - 1) & ~(alignment - 1);
+}
+
+TlasBuilder::TlasBuilder(Device& device, uint32_t capacity) : capacity(capacity), instanceCount(0), rebuildNeeded(true), refitNeeded(false), refitCount(0) {
+    // Create the command pool.
+    VkCommandPoolCreateInfo commandPoolCreateInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = device.renderQueue.familyIndex
+    };
+
+    vkCreateCommandPool(device.logical, &commandPoolCreateInfo, nullptr, &commandPool);
+
+    // Allocate the command buffer.
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+        .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .pNext              = nullptr,
+        .commandPool        = commandPool,
+        .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = 1
+    };
+
+    vkAllocateCommandBuffers(device.logical, &commandBufferAllocateInfo, &commandBuffer);
+
+    // Create the fence.
+    VkFenceCreateInfo fenceCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+        .pNext = nullptr,
+        .flags = VK_FENCE_CREATE_SIGNALED_BIT
+    };
+
+    vkCreateFence(device.logical, &fenceCreateInfo, nullptr, &fence);
+
+    createResources(device);
+}
+
+void TlasBuilder::destroy(VkDevice device) {
+    vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+
+    destroyResources(device);
+
+    vkDestroyFence(device, fence, nullptr);
+    vkDestroyCommandPool(device, commandPool, nullptr);
+}
+
+uint32_t TlasBuilder::addInstance(Device& device, const InstanceDescription& description) {
+    uint32_t instance;
+
+    if (!freeInstances.empty()) {
+        instance = freeInstances.back();
+        freeInstances.pop_back();
+    } else {
+        if (instanceCount == capacity) {
+            // Frames in flight may still trace the old TLAS.
+            vkQueueWaitIdle(device.renderQueue);
+
+            VkAccelerationStructureInstanceKHR* oldInstances = new VkAccelerationStructureInstanceKHR[instanceCount];
+            memcpy(oldInstances, instances, instanceCount * sizeof(VkAccelerationStructureInstanceKHR));
+
+            destroyResources(device.logical);
+            capacity *= 2;
+            createResources(device);
+
+            memcpy(instances, oldInstances, instanceCount * sizeof(VkAccelerationStructureInstanceKHR));
+            delete[] oldInstances;
+        }
+
+        instance = instanceCount++;
+    }
+
+    // The transform is identity until the scene writes the real one.
+    getInstances(device.logical)[instance] = {
+        .transform                              = { .matrix = { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f, 0.0f }, { 0.0f, 0.0f, 1.0f, 0.0f } } },
+        .instanceCustomIndex                    = description.customIndex,
+        .mask                                   = description.mask,
+        .instanceShaderBindingTableRecordOffset = description.sbtRecordOffset,
+        .flags                                  = description.flags,
+        .accelerationStructureReference         = description.blasAddress
+    };
+
+    rebuildNeeded = true;
+
+    return instance;
+}
+
+void TlasBuilder::removeInstance(VkDevice device, uint32_t instance) {
+    // Instances without a BLAS are inactive, so the slot can stay where it is until it's reused.
+    getInstances(device);
+
+    instances[instance].mask = 0;
+    instances[instance].accelerationStructureReference = 0;
+
+    freeInstances.push_back(instance);
+    rebuildNeeded = true;
+}
+
+void TlasBuilder::setInstanceMask(VkDevice device, uint32_t instance, uint8_t mask) {
+    getInstances(device)[instance].mask = mask;
+    refitNeeded = true;
+}
+
+VkAccelerationStructureInstanceKHR* TlasBuilder::getInstances(VkDevice device) {
+    vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+    return instances;
+}
+
+void TlasBuilder::markInstancesChanged() {
+    refitNeeded = true;
+}
+
+void TlasBuilder::build(Device& device) {
+    if (!rebuildNeeded && !refitNeeded) {
+        return;
+    }
+
+    const bool refit = !rebuildNeeded && refitCount < maxRefitCount;
+
+    refitCount = refit ? refitCount + 1 : 0;
+    rebuildNeeded = false;
+    refitNeeded = false;
+
+    vkWaitForFences(device.logical, 1, &fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(device.logical, 1, &fence);
+
+    vkResetCommandBuffer(commandBuffer, 0);
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr
+    };
+
+    vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo);
+
+    // Wait for the frames that are still tracing the TLAS before writing it.
+    VkMemoryBarrier2 memoryBarrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext         = nullptr,
+        .srcStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .srcAccessMask = VK_ACCESS_2_NONE,
+        .dstStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR,
+        .dstAccessMask = VK_ACCESS_2_NONE
+    };
+
+    VkDependencyInfo dependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 1,
+        .pMemoryBarriers          = &memoryBarrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = 0,
+        .pImageMemoryBarriers     = nullptr
+    };
+
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    const VkAccelerationStructureGeometryKHR geometry = getGeometry();
+
+    VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+        .pNext                    = nullptr,
+        .type                     = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
+        .flags                    = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR,
+        .mode                     = refit ? VK_BUILD_ACCELERATION_STRUCTURE_MODE_UPDATE_KHR : VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
+        .srcAccelerationStructure = refit ? (VkAccelerationStructureKHR)tlas : VK_NULL_HANDLE,
+        .dstAccelerationStructure = tlas,
+        .geometryCount            = 1,
+        .pGeometries              = &geometry,
+        .ppGeometries             = nullptr,
+        .scratchData              = { .deviceAddress = scratchAddress }
+    };
+
+    VkAccelerationStructureBuildRangeInfoKHR buildRangeInfo = {
+        .primitiveCount  = instanceCount,
+        .primitiveOffset = 0,
+        .firstVertex     = 0,
+        .transformOffset = 0
+    };
+
+    const VkAccelerationStructureBuildRangeInfoKHR* buildRangeInfoPointer = &buildRangeInfo;
+
+    vkCmdBuildAccelerationStructures(commandBuffer, 1, &buildGeometryInfo, &buildRangeInfoPointer);
+
+    // Make the TLAS visible to the ray tracing shaders.
+    memoryBarrier.srcStageMask  = VK_PIPELINE_STAGE_2_ACCELERATION_STRUCTURE_BUILD_BIT_KHR;
+    memoryBarrier.srcAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_WRITE_BIT_KHR;
+    memoryBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    memoryBarrier.dstAccessMask = VK_ACCESS_2_ACCELERATION_STRUCTURE_READ_BIT_KHR;
+
+    vkCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+
+    vkEndCommandBuffer(commandBuffer);
+
+    VkCommandBufferSubmitInfo commandBufferSubmitInfo = {
+        .sType         = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .pNext         = nullptr,
+        .commandBuffer = commandBuffer,
+        .deviceMask    = 0
+    };
+
+    VkSubmitInfo2 submitInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .pNext                    = nullptr,
+        .flags                    = 0,
+        .waitSemaphoreInfoCount   = 0,
+        .pWaitSemaphoreInfos      = nullptr,
+        .commandBufferInfoCount   = 1,
+        .pCommandBufferInfos      = &commandBufferSubmitInfo,
+        .signalSemaphoreInfoCount = 0,
+        .pSignalSemaphoreInfos    = nullptr
+    };
+
+    vkQueueSubmit2(device.renderQueue, 1, &submitInfo, fence);
+}
+
+VkDeviceAddress TlasBuilder::getDeviceAddress() {
+    return tlas.deviceAddress;
+}
+
+TlasBuilder::operator VkAccelerationStructureKHR() {
+    return tlas;
+}
+
+void TlasBuilder::createResources(Device& device) {
+    // Create the instance buffer.
+    instanceBuffer = Buffer(device, capacity * sizeof(VkAccelerationStructureInstanceKHR),
+                            VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_BUILD_INPUT_READ_ONLY_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+    vkMapMemory(device.logical, instanceBuffer.memory, 0, VK_WHOLE_SIZE, 0, (void**)&instances);
+    instanceAddress = instanceBuffer.getDeviceAddress(device.logical);
+
+    // Get the build sizes, for as many instances as fit so that the TLAS never has to be reallocated until it grows.
+    const VkAccelerationStructureGeometryKHR geometry = getGeometry();
+
+    VkAccelerationStructureBuildGeometryInfoKHR buildGeometryInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_GEOMETRY_INFO_KHR,
+        .pNext                    = nullptr,
+        .type                     = VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR,
+        .flags                    = VK_BUILD_ACCELERATION_STRUCTURE_PREFER_FAST_TRACE_BIT_KHR | VK_BUILD_ACCELERATION_STRUCTURE_ALLOW_UPDATE_BIT_KHR,
+        .mode                     = VK_BUILD_ACCELERATION_STRUCTURE_MODE_BUILD_KHR,
+        .srcAccelerationStructure = VK_NULL_HANDLE,
+        .dstAccelerationStructure = VK_NULL_HANDLE,
+        .geometryCount            = 1,
+        .pGeometries              = &geometry,
+        .ppGeometries             = nullptr,
+        .scratchData              = { .deviceAddress = 0 }
+    };
+
+    VkAccelerationStructureBuildSizesInfoKHR buildSizesInfo = {
+        .sType = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_BUILD_SIZES_INFO_KHR,
+        .pNext = nullptr
+    };
+
+    vkGetAccelerationStructureBuildSizes(device.logical, VK_ACCELERATION_STRUCTURE_BUILD_TYPE_DEVICE_KHR, &buildGeometryInfo, &capacity, &buildSizesInfo);
+
+    // Create the TLAS.
+    storageBuffer = Buffer(device, buildSizesInfo.accelerationStructureSize,
+                           VK_BUFFER_USAGE_ACCELERATION_STRUCTURE_STORAGE_BIT_KHR | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    tlas = AccelerationStructure(device.logical, VK_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL_KHR, storageBuffer, 0, buildSizesInfo.accelerationStructureSize);
+
+    // Create the scratch buffer, which builds and refits share.
+    const VkDeviceSize scratchAlignment = device.asProperties.minAccelerationStructureScratchOffsetAlignment;
+    const VkDeviceSize scratchSize = buildSizesInfo.buildScratchSize > buildSizesInfo.updateScratchSize ? buildSizesInfo.buildScratchSize : buildSizesInfo.updateScratchSize;
+
+    scratchBuffer = Buffer(device, scratchSize + scratchAlignment,
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    scratchAddress = alignSize(scratchBuffer.getDeviceAddress(device.logical), scratchAlignment);
+
+    rebuildNeeded = true;
+}
+
+void TlasBuilder::destroyResources(VkDevice device) {
+    tlas.destroy(device);
+    scratchBuffer.destroy(device);
+    storageBuffer.destroy(device);
+    instanceBuffer.destroy(device);
+}
+
+VkAccelerationStructureGeometryKHR TlasBuilder::getGeometry() {
+    return {
+        .sType        = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_KHR,
+        .pNext        = nullptr,
+        .geometryType = VK_GEOMETRY_TYPE_INSTANCES_KHR,
+        .geometry     = {
+            .instances = {
+                .sType           = VK_STRUCTURE_TYPE_ACCELERATION_STRUCTURE_GEOMETRY_INSTANCES_DATA_KHR,
+                .pNext           = nullptr,
+                .arrayOfPointers = VK_FALSE,
+                .data            = { .deviceAddress = instanceAddress }
+            }
+        },
+        .flags        = 0
+    };
+}
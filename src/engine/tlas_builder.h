@@ -0,0 +1,70 @@
+#pragma once
+
+#include <vector>
+
+#include "acceleration_structure.h"
+
+#define TLAS_INVALID_INSTANCE UINT32_MAX
+#define TLAS_VISIBILITY_LAYER_COUNT 8
+
+// Instances only reference their BLAS, so any number of them can share the same geometry. The custom index is what the
+// hit shaders see as gl_InstanceCustomIndexEXT, the SBT offset selects the hit record, and the mask holds the
+// visibility layers the instance belongs to.
+struct InstanceDescription {
+    VkDeviceAddress blasAddress;
+    uint32_t customIndex;
+    uint32_t sbtRecordOffset;
+    uint8_t mask;
+    VkGeometryInstanceFlagsKHR flags;
+};
+
+// Owns the TLAS and its instances, which live in host-visible memory so that changed transforms can be written straight
+// into them. Adding or removing instances rebuilds the TLAS, changing transforms or masks only refits it.
+class TlasBuilder {
+public:
+    uint32_t capacity;
+    uint32_t instanceCount;
+
+    // Passed as the cull mask of the traced rays, so layers are hidden and shown without touching the TLAS.
+    uint32_t visibleLayers = (1 << TLAS_VISIBILITY_LAYER_COUNT) - 1;
+
+    TlasBuilder() = default;
+    TlasBuilder(Device& device, uint32_t capacity);
+    void destroy(VkDevice device);
+
+    // The capacity doubles when it runs out, which waits for the device to be idle.
+    uint32_t addInstance(Device& device, const InstanceDescription& description);
+    void removeInstance(VkDevice device, uint32_t instance);
+    void setInstanceMask(VkDevice device, uint32_t instance, uint8_t mask);
+
+    // Waits until the last build is done reading the instances. Call markInstancesChanged after writing them.
+    VkAccelerationStructureInstanceKHR* getInstances(VkDevice device);
+    void markInstancesChanged();
+
+    // Submits a build or refit to the render queue if anything changed, ordered before the frames submitted after it.
+    void build(Device& device);
+
+    VkDeviceAddress getDeviceAddress();
+    operator VkAccelerationStructureKHR();
+
+private:
+    Buffer instanceBuffer;
+    VkAccelerationStructureInstanceKHR* instances;
+    VkDeviceAddress instanceAddress;
+    Buffer storageBuffer;
+    AccelerationStructure tlas;
+    Buffer scratchBuffer;
+    VkDeviceAddress scratchAddress;
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+
+    std::vector<uint32_t> freeInstances;
+    bool rebuildNeeded;
+    bool refitNeeded;
+    uint32_t refitCount;
+
+    void createResources(Device& device);
+    void destroyResources(VkDevice device);
+    VkAccelerationStructureGeometryKHR getGeometry();
+};
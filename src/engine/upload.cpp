@@ -0,0 +1,284 @@
+#include "upload.h"
+
+#include "texture.h"
+
+Uploader::Uploader(Device& device, VkDeviceSize capacity) : capacity(capacity), batchIndex(0), offset(0) {
+    // Create the command pool.
+    VkCommandPoolCreateInfo commandPoolCreateInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+        .queueFamilyIndex = device.renderQueue.familyIndex
+    };
+
+    vkCreateCommandPool(device.logical, &commandPoolCreateInfo, nullptr, &commandPool);
+
+    for (Batch& batch : batches) {
+        // Create the staging buffer.
+        batch.stagingBuffer = Buffer(device, capacity,
+                                     VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        vkMapMemory(device.logical, batch.stagingBuffer.memory, 0, VK_WHOLE_SIZE, 0, (void**)&batch.data);
+
+        // Allocate the command buffer.
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+            .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .pNext              = nullptr,
+            .commandPool        = commandPool,
+            .level              = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1
+        };
+
+        vkAllocateCommandBuffers(device.logical, &commandBufferAllocateInfo, &batch.commandBuffer);
+
+        // Create the fence.
+        VkFenceCreateInfo fenceCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+            .pNext = nullptr,
+            .flags = VK_FENCE_CREATE_SIGNALED_BIT
+        };
+
+        vkCreateFence(device.logical, &fenceCreateInfo, nullptr, &batch.fence);
+    }
+
+    beginBatch(device);
+}
+
+void Uploader::destroy(VkDevice device) {
+    for (Batch& batch : batches) {
+        vkDestroyFence(device, batch.fence, nullptr);
+        batch.stagingBuffer.destroy(device);
+    }
+
+    vkDestroyCommandPool(device, commandPool, nullptr);
+}
+
+bool Uploader::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset) {
+    const VkDeviceSize alignedOffset = (this->offset + alignment - 1) & ~(alignment - 1);
+
+    if (alignedOffset + size > capacity) {
+        return false;
+    }
+
+    *offset = alignedOffset;
+    this->offset = alignedOffset + size;
+
+    return true;
+}
+
+uint8_t* Uploader::getData() {
+    return batches[batchIndex].data;
+}
+
+void Uploader::copyToBuffer(VkBuffer buffer, VkDeviceSize bufferOffset, VkDeviceSize stagingOffset, VkDeviceSize size) {
+    Batch& batch = batches[batchIndex];
+
+    VkBufferCopy region = {
+        .srcOffset = stagingOffset,
+        .dstOffset = bufferOffset,
+        .size      = size
+    };
+
+    vkCmdCopyBuffer(batch.commandBuffer, batch.stagingBuffer, buffer, 1, &region);
+}
+
+void Uploader::copyToImage(Texture& texture, const VkDeviceSize* mipStagingOffsets) {
+    Batch& batch = batches[batchIndex];
+
+    VkImageMemoryBarrier2 imageMemoryBarrier = {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext               = nullptr,
+        .srcStageMask        = VK_PIPELINE_STAGE_2_NONE,
+        .srcAccessMask       = VK_ACCESS_2_NONE,
+        .dstStageMask        = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .dstAccessMask       = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .oldLayout           = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = texture.image,
+        .subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, texture.mipLevels, 0, 1 }
+    };
+
+    VkDependencyInfo dependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 0,
+        .pMemoryBarriers          = nullptr,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = 1,
+        .pImageMemoryBarriers     = &imageMemoryBarrier
+    };
+
+    vkCmdPipelineBarrier2(batch.commandBuffer, &dependencyInfo);
+
+    VkBufferImageCopy* regions = new VkBufferImageCopy[texture.mipLevels];
+
+    for (uint32_t i = 0; i < texture.mipLevels; ++i) {
+        regions[i].bufferOffset      = mipStagingOffsets[i];
+        regions[i].bufferRowLength   = 0;
+        regions[i].bufferImageHeight = 0;
+        regions[i].imageSubresource  = { VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+        regions[i].imageOffset       = { 0, 0, 0 };
+        regions[i].imageExtent       = { texture.getMipWidth(i), texture.getMipHeight(i), 1 };
+    }
+
+    vkCmdCopyBufferToImage(batch.commandBuffer, batch.stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, texture.mipLevels, regions);
+
+    delete[] regions;
+
+    imageMemoryBarrier.srcStageMask  = VK_PIPELINE_STAGE_2_COPY_BIT;
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    imageMemoryBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    imageMemoryBarrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageMemoryBarrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    vkCmdPipelineBarrier2(batch.commandBuffer, &dependencyInfo);
+}
+
+void Uploader::copyToImageRegion(Texture& texture, VkImageLayout oldLayout, VkOffset2D offset, VkExtent2D extent, VkDeviceSize stagingOffset) {
+    Batch& batch = batches[batchIndex];
+
+    // Wait for whatever was still sampling the texture before overwriting it.
+    VkImageMemoryBarrier2 imageMemoryBarrier = {
+        .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+        .pNext               = nullptr,
+        .srcStageMask        = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .srcAccessMask       = VK_ACCESS_2_NONE,
+        .dstStageMask        = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .dstAccessMask       = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .oldLayout           = oldLayout,
+        .newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image               = texture.image,
+        .subresourceRange    = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+    };
+
+    VkDependencyInfo dependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 0,
+        .pMemoryBarriers          = nullptr,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = 1,
+        .pImageMemoryBarriers     = &imageMemoryBarrier
+    };
+
+    vkCmdPipelineBarrier2(batch.commandBuffer, &dependencyInfo);
+
+    VkBufferImageCopy region = {
+        .bufferOffset      = stagingOffset,
+        .bufferRowLength   = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource  = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+        .imageOffset       = { offset.x, offset.y, 0 },
+        .imageExtent       = { extent.width, extent.height, 1 }
+    };
+
+    vkCmdCopyBufferToImage(batch.commandBuffer, batch.stagingBuffer, texture.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+    imageMemoryBarrier.srcStageMask  = VK_PIPELINE_STAGE_2_COPY_BIT;
+    imageMemoryBarrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    imageMemoryBarrier.dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    imageMemoryBarrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+    imageMemoryBarrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    imageMemoryBarrier.newLayout     = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+    vkCmdPipelineBarrier2(batch.commandBuffer, &dependencyInfo);
+}
+
+void Uploader::flush(Device& device) {
+    // Nothing has been recorded if no staging memory has been used.
+    if (offset == 0) {
+        return;
+    }
+
+    Batch& batch = batches[batchIndex];
+
+    // Make the copied data visible to whatever reads it next.
+    VkMemoryBarrier2 memoryBarrier = {
+        .sType         = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+        .pNext         = nullptr,
+        .srcStageMask  = VK_PIPELINE_STAGE_2_COPY_BIT,
+        .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+        .dstStageMask  = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+        .dstAccessMask = VK_ACCESS_2_MEMORY_READ_BIT
+    };
+
+    VkDependencyInfo dependencyInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+        .pNext                    = nullptr,
+        .dependencyFlags          = 0,
+        .memoryBarrierCount       = 1,
+        .pMemoryBarriers          = &memoryBarrier,
+        .bufferMemoryBarrierCount = 0,
+        .pBufferMemoryBarriers    = nullptr,
+        .imageMemoryBarrierCount  = 0,
+        .pImageMemoryBarriers     = nullptr
+    };
+
+    vkCmdPipelineBarrier2(batch.commandBuffer, &dependencyInfo);
+
+    vkEndCommandBuffer(batch.commandBuffer);
+
+    VkCommandBufferSubmitInfo commandBufferSubmitInfo = {
+        .sType         = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO,
+        .pNext         = nullptr,
+        .commandBuffer = batch.commandBuffer,
+        .deviceMask    = 0
+    };
+
+    VkSubmitInfo2 submitInfo = {
+        .sType                    = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+        .pNext                    = nullptr,
+        .flags                    = 0,
+        .waitSemaphoreInfoCount   = 0,
+        .pWaitSemaphoreInfos      = nullptr,
+        .commandBufferInfoCount   = 1,
+        .pCommandBufferInfos      = &commandBufferSubmitInfo,
+        .signalSemaphoreInfoCount = 0,
+        .pSignalSemaphoreInfos    = nullptr
+    };
+
+    vkQueueSubmit2(device.renderQueue, 1, &submitInfo, batch.fence);
+
+    batchIndex = (batchIndex + 1) % ARRAY_SIZE(batches);
+
+    beginBatch(device);
+}
+
+void Uploader::finish(Device& device) {
+    flush(device);
+
+    // The current batch has just begun, so only the other one can still be in flight.
+    const Batch& previousBatch = batches[(batchIndex + 1) % ARRAY_SIZE(batches)];
+    vkWaitForFences(device.logical, 1, &previousBatch.fence, VK_TRUE, UINT64_MAX);
+}
+
+void Uploader::beginBatch(Device& device) {
+    Batch& batch = batches[batchIndex];
+
+    // Wait until the device is done with the staging memory before handing it out again.
+    vkWaitForFences(device.logical, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+    vkResetFences(device.logical, 1, &batch.fence);
+
+    vkResetCommandBuffer(batch.commandBuffer, 0);
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo = {
+        .sType            = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .pNext            = nullptr,
+        .flags            = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+        .pInheritanceInfo = nullptr
+    };
+
+    vkBeginCommandBuffer(batch.commandBuffer, &commandBufferBeginInfo);
+
+    offset = 0;
+}
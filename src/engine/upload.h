@@ -0,0 +1,50 @@
+#pragma once
+
+#include "graphics.h"
+
+class Texture;
+
+// Streams data to device-local resources through two staging buffers, so that the next batch can be filled on the host
+// while the previous one is being copied on the device.
+class Uploader {
+public:
+    VkDeviceSize capacity;
+
+    Uploader() = default;
+    Uploader(Device& device, VkDeviceSize capacity);
+    void destroy(VkDevice device);
+
+    // Reserves staging memory in the current batch. Returns false when the batch is full and has to be flushed.
+    bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize* offset);
+    uint8_t* getData();
+
+    void copyToBuffer(VkBuffer buffer, VkDeviceSize bufferOffset, VkDeviceSize stagingOffset, VkDeviceSize size);
+
+    // Copies every mip level of the texture from the staging memory and leaves it ready to be sampled.
+    void copyToImage(Texture& texture, const VkDeviceSize* mipStagingOffsets);
+
+    // Copies a region of the texture's first mip level from the staging memory and leaves it ready to be sampled. The
+    // rest of the texture keeps its contents, unless oldLayout is VK_IMAGE_LAYOUT_UNDEFINED for the very first copy.
+    void copyToImageRegion(Texture& texture, VkImageLayout oldLayout, VkOffset2D offset, VkExtent2D extent, VkDeviceSize stagingOffset);
+
+    // Submits the current batch without waiting for it.
+    void flush(Device& device);
+
+    // Submits the current batch and waits for every batch to complete.
+    void finish(Device& device);
+
+private:
+    struct Batch {
+        Buffer stagingBuffer;
+        uint8_t* data;
+        VkCommandBuffer commandBuffer;
+        VkFence fence;
+    };
+
+    VkCommandPool commandPool;
+    Batch batches[2];
+    uint32_t batchIndex;
+    VkDeviceSize offset;
+
+    void beginBatch(Device& device);
+};
@@ -0,0 +1,179 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <application.h>
+#include <tile_render.h>
+
+static void printUsage() {
+    fprintf(stderr,
+            "Usage: vortex-render <project> [options]\n"
+            "\n"
+            "  --output <directory>     Where the frames are written, the project's Captures/Render by default.\n"
+            "  --size <width>x<height>  The resolution, 1920x1080 by default.\n"
+            "  --frames <first>-<last>  The frames to render, 0-0 by default.\n"
+            "  --samples <count>        The samples per pixel of every frame, 64 by default.\n"
+            "  --format <exr|png>       The image format, exr by default.\n"
+            "  --compression <zip|piz>  The EXR compression, zip by default.\n"
+            "  --denoise                Denoises the frames before they're written.\n"
+            "  --reference <directory>  Compares every frame to the EXR of the same name in the directory, a converged render.\n"
+            "  --compare-denoiser <samples>\n"
+            "                           Renders the frames denoised, undenoised, and undenoised with as many samples as take\n"
+            "                           as long as denoising, and compares them to the reference. Without --reference, it's\n"
+            "                           rendered first with this many samples. Each render goes to a directory of its own.\n"
+            "  --workers <count>        Splits the frames into tiles traced by this many worker processes, one per device.\n"
+            "  --tile-size <pixels>     The size of the workers' tiles, 256 by default.\n"
+            "  --task-samples <count>   The samples of a tile a worker traces at once, 16 by default.\n"
+            "  --device <index|uuid>    The Vulkan device to trace on, the best one by default. VORTEX_DEVICE sets it too.\n"
+            "\n"
+            "The timings of every frame are written to the standard output as JSON, one object per line.\n"
+            "\n"
+            "Workers are started by the renderer itself with --worker <port> and --device-rank <index>, and --size set to the\n"
+            "tile size.\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    const char* projectPath = argv[1];
+    const char* outputDirectory = nullptr;
+    VkExtent2D extent = { 1920, 1080 };
+    uint32_t workerCount = 0;
+    uint32_t tileSize = 256;
+    uint32_t samplesPerTask = 16;
+    uint32_t workerPort = 0;
+    uint32_t referenceSampleCount = 0;
+    DeviceSelection deviceSelection;
+
+    BatchRenderSettings settings = {
+        .firstFrame     = 0,
+        .lastFrame      = 0,
+        .sampleCount    = 64,
+        .format         = CAPTURE_FORMAT_EXR,
+        .exrCompression = EXR_COMPRESSION_ZIP
+    };
+
+    for (int i = 2; i < argc; ++i) {
+        const char* option = argv[i];
+
+        // Flags have no value.
+        if (strcmp(option, "--denoise") == 0) {
+            settings.denoise = true;
+            continue;
+        }
+
+        const char* value = i + 1 < argc ? argv[++i] : "";
+        bool valid;
+
+        if (strcmp(option, "--output") == 0) {
+            valid = value[0] != '\0';
+            outputDirectory = value;
+        } else if (strcmp(option, "--size") == 0) {
+            valid = sscanf(value, "%ux%u", &extent.width, &extent.height) == 2 && extent.width > 0 && extent.height > 0;
+        } else if (strcmp(option, "--frames") == 0) {
+            valid = sscanf(value, "%u-%u", &settings.firstFrame, &settings.lastFrame) == 2 && settings.firstFrame <= settings.lastFrame;
+        } else if (strcmp(option, "--samples") == 0) {
+            valid = sscanf(value, "%u", &settings.sampleCount) == 1 && settings.sampleCount > 0;
+        } else if (strcmp(option, "--format") == 0) {
+            valid = strcmp(value, "exr") == 0 || strcmp(value, "png") == 0;
+            settings.format = strcmp(value, "png") == 0 ? CAPTURE_FORMAT_PNG : CAPTURE_FORMAT_EXR;
+        } else if (strcmp(option, "--compression") == 0) {
+            valid = strcmp(value, "zip") == 0 || strcmp(value, "piz") == 0;
+            settings.exrCompression = strcmp(value, "piz") == 0 ? EXR_COMPRESSION_PIZ : EXR_COMPRESSION_ZIP;
+        } else if (strcmp(option, "--reference") == 0) {
+            valid = value[0] != '\0';
+            settings.referenceDirectory = value;
+        } else if (strcmp(option, "--compare-denoiser") == 0) {
+            valid = sscanf(value, "%u", &referenceSampleCount) == 1 && referenceSampleCount > 0;
+        } else if (strcmp(option, "--workers") == 0) {
+            valid = sscanf(value, "%u", &workerCount) == 1 && workerCount > 0;
+        } else if (strcmp(option, "--tile-size") == 0) {
+            valid = sscanf(value, "%u", &tileSize) == 1 && tileSize > 0;
+        } else if (strcmp(option, "--task-samples") == 0) {
+            valid = sscanf(value, "%u", &samplesPerTask) == 1 && samplesPerTask > 0;
+        } else if (strcmp(option, "--worker") == 0) {
+            valid = sscanf(value, "%u", &workerPort) == 1 && workerPort > 0 && workerPort <= UINT16_MAX;
+        } else if (strcmp(option, "--device") == 0) {
+            valid = value[0] != '\0';
+            deviceSelection.override = value;
+        } else if (strcmp(option, "--device-rank") == 0) {
+            valid = sscanf(value, "%u", &deviceSelection.rank) == 1;
+        } else {
+            valid = false;
+        }
+
+        if (!valid) {
+            fprintf(stderr, "Invalid option: %s\n\n", option);
+            printUsage();
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (referenceSampleCount > 0 && workerCount > 0) {
+        fprintf(stderr, "--compare-denoiser can't be used with --workers\n\n");
+        printUsage();
+        return EXIT_FAILURE;
+    }
+
+    // The coordinator only needs the project for its captures directory, the workers open it themselves.
+    if (workerCount > 0) {
+        Project project;
+
+        if (!project.open(projectPath)) {
+            fprintf(stderr, "Couldn't open the project at %s\n", projectPath);
+            return EXIT_FAILURE;
+        }
+
+        settings.outputDirectory = outputDirectory != nullptr ? std::filesystem::path(outputDirectory) : project.getCapturesDirectoryPath() / "Render";
+        project.close();
+
+        DistributedRenderSettings distributedSettings = {
+            .batch          = settings,
+            .extent         = extent,
+            .executablePath = argv[0],
+            .projectPath    = projectPath,
+            .workerCount    = workerCount,
+            .tileSize       = tileSize,
+            .samplesPerTask = samplesPerTask
+        };
+
+        if (!renderDistributed(distributedSettings, stdout)) {
+            fprintf(stderr, "Couldn't write every frame to %s\n", settings.outputDirectory.string().c_str());
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    Application app(extent, deviceSelection);
+
+    if (!app.openProject(projectPath)) {
+        fprintf(stderr, "Couldn't open the project at %s\n", projectPath);
+        return EXIT_FAILURE;
+    }
+
+    if (workerPort != 0) {
+        return app.runTileWorker((uint16_t)workerPort) ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    settings.outputDirectory = outputDirectory != nullptr ? std::filesystem::path(outputDirectory) : app.project.getCapturesDirectoryPath() / "Render";
+
+    if (referenceSampleCount > 0) {
+        if (!app.compareDenoiser(settings, referenceSampleCount, stdout)) {
+            fprintf(stderr, "Couldn't write every frame to %s\n", settings.outputDirectory.string().c_str());
+            return EXIT_FAILURE;
+        }
+
+        return EXIT_SUCCESS;
+    }
+
+    if (!app.renderBatch(settings, stdout)) {
+        fprintf(stderr, "Couldn't write every frame to %s\n", settings.outputDirectory.string().c_str());
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,309 @@
+#include <math.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include <cooked_asset.h>
+#include <file_mapping.h>
+#include <gltf.h>
+
+#include "test.h"
+
+static const TextureImportSettings importSettings = {
+    .mipFilter = MIP_FILTER_KAISER,
+    .quality   = BLOCK_COMPRESSION_QUALITY_NORMAL
+};
+
+static const float quadPositions[4][3] = {
+    { 0.0f, 0.0f, 0.0f },
+    { 1.0f, 0.0f, 0.0f },
+    { 1.0f, 1.0f, 0.0f },
+    { 0.0f, 1.0f, 0.0f }
+};
+
+static const uint16_t quadIndices[6] = { 0, 1, 2, 0, 2, 3 };
+
+// A unit quad under a translated parent node, with its buffer in a file of its own.
+static const char quadGltf[] = R"({
+    "asset": { "version": "2.0" },
+    "scene": 0,
+    "scenes": [ { "nodes": [ 0 ] } ],
+    "nodes": [
+        { "translation": [ 2.0, 3.0, 4.0 ], "children": [ 1 ] },
+        { "mesh": 0 }
+    ],
+    "meshes": [ { "primitives": [ { "attributes": { "POSITION": 0 }, "indices": 1 } ] } ],
+    "accessors": [
+        { "bufferView": 0, "componentType": 5126, "count": 4, "type": "VEC3", "min": [ 0.0, 0.0, 0.0 ], "max": [ 1.0, 1.0, 0.0 ] },
+        { "bufferView": 1, "componentType": 5123, "count": 6, "type": "SCALAR" }
+    ],
+    "bufferViews": [
+        { "buffer": 0, "byteOffset": 0, "byteLength": 48 },
+        { "buffer": 0, "byteOffset": 48, "byteLength": 12 }
+    ],
+    "buffers": [ { "uri": "quad.bin", "byteLength": 60 } ]
+})";
+
+static bool writeFile(const std::filesystem::path& path, const void* data, size_t size) {
+    FILE* file = fopen(path.string().c_str(), "wb");
+
+    if (file == nullptr) {
+        return false;
+    }
+
+    const bool written = fwrite(data, 1, size, file) == size;
+    fclose(file);
+
+    return written;
+}
+
+static void writeQuad(const std::filesystem::path& directory) {
+    uint8_t buffer[60];
+    memcpy(buffer, quadPositions, sizeof(quadPositions));
+    memcpy(buffer + sizeof(quadPositions), quadIndices, sizeof(quadIndices));
+
+    CHECK(writeFile(directory / "quad.gltf", quadGltf, sizeof(quadGltf) - 1));
+    CHECK(writeFile(directory / "quad.bin", buffer, sizeof(buffer)));
+}
+
+// Checks a changed copy of a cooked asset.
+template<typename Function>
+static bool isValidWhenChanged(const std::vector<uint8_t>& asset, Function&& change) {
+    std::vector<uint8_t> changed = asset;
+    change(changed, *(CookedAssetHeader*)changed.data());
+
+    MappedFile file;
+    file.data = changed.data();
+    file.size = changed.size();
+
+    return isValidCookedAsset(file);
+}
+
+static void testQuad(JobSystem& jobSystem, const std::filesystem::path& directory) {
+    const std::filesystem::path cookedPath = directory / "quad.vxa";
+
+    CHECK(cookGltf(jobSystem, importSettings, directory / "quad.gltf", cookedPath));
+    CHECK(!std::filesystem::exists(directory / "quad.vxa.tmp"));
+
+    MappedFile file(cookedPath);
+    CHECK(file.data != nullptr);
+
+    if (file.data == nullptr) {
+        return;
+    }
+
+    CHECK(isValidCookedAsset(file));
+
+    const CookedAssetHeader& header = *(const CookedAssetHeader*)file.data;
+    CHECK(header.meshCount == 1);
+    CHECK(header.nodeCount == 2);
+    CHECK(header.materialCount == 1);
+    CHECK(header.textureCount == 0);
+    CHECK(header.vertexCount == 4);
+    CHECK(header.lodCount >= 1 && header.lodCount <= COOKED_MESH_MAX_LODS);
+
+    // Every section is aligned and they follow each other in the documented order.
+    const uint64_t offsets[] = {
+        header.meshesOffset, header.lodsOffset, header.nodesOffset, header.materialsOffset,
+        header.samplersOffset, header.texturesOffset, header.verticesOffset, header.indicesOffset
+    };
+
+    for (uint32_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); ++i) {
+        CHECK(offsets[i] % COOKED_ASSET_ALIGNMENT == 0);
+        CHECK(i == 0 || offsets[i] >= offsets[i - 1]);
+    }
+
+    CHECK(header.fileSize % COOKED_ASSET_ALIGNMENT == 0);
+
+    if (header.meshCount != 1 || header.nodeCount != 2 || header.vertexCount != 4 || !isValidCookedAsset(file)) {
+        file.destroy();
+        return;
+    }
+
+    // The hierarchy is flattened parents first, with the mesh on the child.
+    const ModelNode* nodes = (const ModelNode*)(file.data + header.nodesOffset);
+    CHECK(nodes[0].parent == -1 && nodes[0].meshCount == 0);
+    CHECK(nodes[0].transform[12] == 2.0f && nodes[0].transform[13] == 3.0f && nodes[0].transform[14] == 4.0f);
+    CHECK(nodes[1].parent == 0 && nodes[1].firstMesh == 0 && nodes[1].meshCount == 1);
+
+    // The mesh has the default material, which comes after the glTF's own.
+    const CookedMesh& mesh = *(const CookedMesh*)(file.data + header.meshesOffset);
+    CHECK(mesh.firstVertex == 0 && mesh.vertexCount == 4);
+    CHECK(mesh.firstLod == 0 && mesh.lodCount == header.lodCount);
+    CHECK(mesh.materialIndex == 0);
+    CHECK(fabsf(mesh.surfaceArea - 1.0f) < 1e-4f);
+
+    // The finest LOD is the whole quad. Its triangles decode to the source positions and cover the same area.
+    const CookedMeshLod* lods = (const CookedMeshLod*)(file.data + header.lodsOffset);
+    const QuantizedVertex* vertices = (const QuantizedVertex*)(file.data + header.verticesOffset);
+    const uint32_t* indices = (const uint32_t*)(file.data + header.indicesOffset);
+
+    CHECK(lods[0].firstIndex == 0 && lods[0].indexCount == 6);
+    CHECK(lods[0].error == 0.0f);
+
+    for (uint32_t i = 1; i < mesh.lodCount; ++i) {
+        CHECK(lods[i].firstIndex == lods[i - 1].firstIndex + lods[i - 1].indexCount);
+        CHECK(lods[i].indexCount < lods[i - 1].indexCount);
+        CHECK(lods[i].contentHash != lods[i - 1].contentHash);
+    }
+
+    float positions[4][3];
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        for (uint32_t c = 0; c < 3; ++c) {
+            positions[i][c] = mesh.positionOffset[c] + mesh.positionScale[c] * fmaxf(vertices[i].position[c] / 32767.0f, -1.0f);
+        }
+
+        bool found = false;
+
+        for (uint32_t j = 0; j < 4; ++j) {
+            found = found || (fabsf(positions[i][0] - quadPositions[j][0]) < 1e-4f && fabsf(positions[i][1] - quadPositions[j][1]) < 1e-4f &&
+                              fabsf(positions[i][2] - quadPositions[j][2]) < 1e-4f);
+        }
+
+        CHECK(found);
+    }
+
+    float area = 0.0f;
+
+    for (uint32_t i = 0; i + 2 < lods[0].indexCount; i += 3) {
+        const uint32_t* triangle = &indices[lods[0].firstIndex + i];
+        CHECK(triangle[0] < 4 && triangle[1] < 4 && triangle[2] < 4);
+
+        if (triangle[0] < 4 && triangle[1] < 4 && triangle[2] < 4) {
+            const float* a = positions[triangle[0]];
+            const float* b = positions[triangle[1]];
+            const float* c = positions[triangle[2]];
+
+            area += 0.5f * fabsf((b[0] - a[0]) * (c[1] - a[1]) - (b[1] - a[1]) * (c[0] - a[0]));
+        }
+    }
+
+    CHECK(fabsf(area - 1.0f) < 1e-3f);
+
+    // Every kind of damage the loader relies on being caught is.
+    const std::vector<uint8_t> asset(file.data, file.data + file.size);
+    file.destroy();
+
+    CHECK(isValidWhenChanged(asset, [](std::vector<uint8_t>&, CookedAssetHeader&) {}));
+
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>& data, CookedAssetHeader&) { data.resize(data.size() - COOKED_ASSET_ALIGNMENT); }));
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>& data, CookedAssetHeader&) { data.resize(sizeof(CookedAssetHeader) - 1); }));
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>&, CookedAssetHeader& header) { header.magic ^= 1; }));
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>&, CookedAssetHeader& header) { ++header.version; }));
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>&, CookedAssetHeader& header) { header.fileSize += COOKED_ASSET_ALIGNMENT; }));
+
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>&, CookedAssetHeader& header) { header.indicesOffset = header.fileSize; }));
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>&, CookedAssetHeader& header) { header.meshesOffset = ~(uint64_t)(COOKED_ASSET_ALIGNMENT - 1); }));
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>&, CookedAssetHeader& header) { header.lodsOffset += 4; }));
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>&, CookedAssetHeader& header) { header.vertexCount = UINT32_MAX; }));
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>&, CookedAssetHeader& header) { header.nodeCount = UINT32_MAX; }));
+
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>& data, CookedAssetHeader& header) {
+        ((CookedMesh*)(data.data() + header.meshesOffset))->firstVertex = 1;
+    }));
+
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>& data, CookedAssetHeader& header) {
+        ((CookedMesh*)(data.data() + header.meshesOffset))->lodCount = 0;
+    }));
+
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>& data, CookedAssetHeader& header) {
+        ((CookedMesh*)(data.data() + header.meshesOffset))->firstLod = 1;
+    }));
+
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>&, CookedAssetHeader& header) { ++header.lodCount; }));
+
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>& data, CookedAssetHeader& header) {
+        CookedMeshLod* lods = (CookedMeshLod*)(data.data() + header.lodsOffset);
+        lods[header.lodCount - 1].firstIndex = header.indexCount - lods[header.lodCount - 1].indexCount + 1;
+    }));
+
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>& data, CookedAssetHeader& header) {
+        ((CookedMeshLod*)(data.data() + header.lodsOffset))->indexCount = UINT32_MAX;
+    }));
+
+    // Parents have to come first and mesh ranges have to be in bounds.
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>& data, CookedAssetHeader& header) {
+        ((ModelNode*)(data.data() + header.nodesOffset))[0].parent = 1;
+    }));
+
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>& data, CookedAssetHeader& header) {
+        ((ModelNode*)(data.data() + header.nodesOffset))[1].parent = 1;
+    }));
+
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>& data, CookedAssetHeader& header) {
+        ((ModelNode*)(data.data() + header.nodesOffset))[1].firstMesh = 1;
+    }));
+
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>& data, CookedAssetHeader& header) {
+        ((ModelNode*)(data.data() + header.nodesOffset))[1].firstMesh = UINT32_MAX;
+    }));
+
+    CHECK(!isValidWhenChanged(asset, [](std::vector<uint8_t>& data, CookedAssetHeader& header) {
+        ((ModelNode*)(data.data() + header.nodesOffset))[1].meshCount = UINT32_MAX;
+    }));
+}
+
+// Scenes that list a node more than once, or a child as a root, still get every node exactly once.
+static void testRepeatedNodes(JobSystem& jobSystem, const std::filesystem::path& directory) {
+    std::string gltf = quadGltf;
+    const size_t rootsOffset = gltf.find("\"nodes\": [ 0 ]");
+    CHECK(rootsOffset != std::string::npos);
+
+    if (rootsOffset == std::string::npos) {
+        return;
+    }
+
+    gltf.replace(rootsOffset, strlen("\"nodes\": [ 0 ]"), "\"nodes\": [ 0, 1, 0, 1 ]");
+    CHECK(writeFile(directory / "repeated.gltf", gltf.data(), gltf.size()));
+    CHECK(cookGltf(jobSystem, importSettings, directory / "repeated.gltf", directory / "repeated.vxa"));
+
+    MappedFile file(directory / "repeated.vxa");
+    CHECK(isValidCookedAsset(file));
+
+    if (isValidCookedAsset(file)) {
+        const CookedAssetHeader& header = *(const CookedAssetHeader*)file.data;
+        const ModelNode* nodes = (const ModelNode*)(file.data + header.nodesOffset);
+
+        CHECK(header.nodeCount == 2);
+        CHECK(nodes[0].parent == -1 && nodes[1].parent == 0 && nodes[1].meshCount == 1);
+    }
+
+    file.destroy();
+}
+
+// A cook that fails leaves nothing behind, and the previous cooked asset as it was.
+static void testFailedCooks(JobSystem& jobSystem, const std::filesystem::path& directory) {
+    const std::filesystem::path cookedPath = directory / "quad.vxa";
+    const uintmax_t cookedSize = std::filesystem::file_size(cookedPath);
+
+    CHECK(!cookGltf(jobSystem, importSettings, directory / "missing.gltf", cookedPath));
+
+    const char invalidJson[] = "{ \"asset\": { \"version\": \"2.0\" }, ";
+    CHECK(writeFile(directory / "invalid.gltf", invalidJson, sizeof(invalidJson) - 1));
+    CHECK(!cookGltf(jobSystem, importSettings, directory / "invalid.gltf", cookedPath));
+
+    // Valid JSON whose buffer is missing.
+    std::filesystem::remove(directory / "quad.bin");
+    CHECK(!cookGltf(jobSystem, importSettings, directory / "quad.gltf", cookedPath));
+
+    CHECK(!std::filesystem::exists(directory / "quad.vxa.tmp"));
+    CHECK(std::filesystem::file_size(cookedPath) == cookedSize);
+
+    MappedFile file(cookedPath);
+    CHECK(isValidCookedAsset(file));
+    file.destroy();
+}
+
+int main() {
+    JobSystem jobSystem;
+    const std::filesystem::path directory = createTestDirectory("vortex_cooked_asset_test");
+
+    writeQuad(directory);
+    testQuad(jobSystem, directory);
+    testRepeatedNodes(jobSystem, directory);
+    testFailedCooks(jobSystem, directory);
+
+    return finishTest();
+}
@@ -0,0 +1,210 @@
+#include <math.h>
+
+#include <vector>
+
+#include <environment_map.h>
+
+#include "test.h"
+
+static const double pi = 3.14159265358979323846;
+
+static double getLuminance(const float* pixel) {
+    return 0.2126 * pixel[0] + 0.7152 * pixel[1] + 0.0722 * pixel[2];
+}
+
+// Checks an alias table against the probabilities it should sample with. Every entry is picked with probability 1 / count
+// and then gives the part of that above its threshold to its alias, so summing those up gives what the table samples.
+static void checkAliasTable(const EnvironmentAliasEntry* entries, const std::vector<double>& probabilities) {
+    const uint32_t count = (uint32_t)probabilities.size();
+    std::vector<double> sampled(count, 0.0);
+
+    for (uint32_t i = 0; i < count; ++i) {
+        const EnvironmentAliasEntry& entry = entries[i];
+
+        CHECK(entry.threshold >= 0.0f && entry.threshold <= 1.0f);
+        CHECK(entry.alias < count);
+
+        if (entry.alias >= count) {
+            return;
+        }
+
+        sampled[i] += (double)entry.threshold / count;
+        sampled[entry.alias] += (1.0 - entry.threshold) / count;
+
+        // The stored probabilities are what shaders divide by, they have to match what's actually sampled.
+        CHECK(fabs(entry.probability - probabilities[i]) <= 1e-6 + 1e-5 * probabilities[i]);
+        CHECK(entry.aliasProbability == entries[entry.alias].probability);
+    }
+
+    for (uint32_t i = 0; i < count; ++i) {
+        CHECK(fabs(sampled[i] - probabilities[i]) <= 1e-6 + 1e-4 * probabilities[i]);
+    }
+}
+
+// The marginal table samples rows by their luminance weighted by their solid angle, the row tables pixels by luminance.
+static void checkDistribution(const EnvironmentDistribution& distribution, const std::vector<float>& pixels, uint32_t width, uint32_t height) {
+    CHECK(distribution.width == width && distribution.height == height);
+    CHECK(distribution.entries.size() == height + (size_t)width * height);
+
+    if (distribution.entries.size() != height + (size_t)width * height) {
+        return;
+    }
+
+    std::vector<double> rowWeights(height, 0.0);
+    double weightSum = 0.0;
+
+    for (uint32_t y = 0; y < height; ++y) {
+        std::vector<double> pixelProbabilities(width);
+        double rowSum = 0.0;
+
+        for (uint32_t x = 0; x < width; ++x) {
+            pixelProbabilities[x] = getLuminance(&pixels[4 * ((size_t)width * y + x)]);
+            rowSum += pixelProbabilities[x];
+        }
+
+        // Black rows are sampled uniformly, they're never picked by the marginal table anyway.
+        for (double& probability : pixelProbabilities) {
+            probability = rowSum > 0.0 ? probability / rowSum : 1.0 / width;
+        }
+
+        checkAliasTable(&distribution.entries[height + (size_t)width * y], pixelProbabilities);
+
+        rowWeights[y] = rowSum * sin(pi * (y + 0.5) / height);
+        weightSum += rowWeights[y];
+    }
+
+    for (double& weight : rowWeights) {
+        weight = weightSum > 0.0 ? weight / weightSum : 1.0 / height;
+    }
+
+    checkAliasTable(distribution.entries.data(), rowWeights);
+}
+
+static uint32_t nextRandom(uint32_t& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+
+    return state;
+}
+
+static float nextUniform(uint32_t& state) {
+    return (nextRandom(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+// Picks an entry the way environment.glsl does.
+static uint32_t sampleAliasTable(const EnvironmentAliasEntry* entries, uint32_t count, float u, float v, float* probability) {
+    const uint32_t index = (uint32_t)(u * count) < count - 1 ? (uint32_t)(u * count) : count - 1;
+
+    if (v < entries[index].threshold) {
+        *probability = entries[index].probability;
+        return index;
+    }
+
+    *probability = entries[index].aliasProbability;
+    return entries[index].alias;
+}
+
+// Samples pixels as shaders do and compares how often each comes up with its probability.
+static void checkSampling(const EnvironmentDistribution& distribution, uint32_t sampleCount) {
+    const uint32_t width = distribution.width;
+    const uint32_t height = distribution.height;
+    const EnvironmentAliasEntry* entries = distribution.entries.data();
+
+    std::vector<uint32_t> histogram((size_t)width * height, 0);
+    std::vector<double> probabilities((size_t)width * height, 0.0);
+    uint32_t state = 0x9E3779B9;
+
+    for (uint32_t i = 0; i < sampleCount; ++i) {
+        float rowProbability, pixelProbability;
+        const uint32_t y = sampleAliasTable(entries, height, nextUniform(state), nextUniform(state), &rowProbability);
+        const uint32_t x = sampleAliasTable(entries + height + (size_t)width * y, width, nextUniform(state), nextUniform(state), &pixelProbability);
+
+        ++histogram[(size_t)width * y + x];
+        probabilities[(size_t)width * y + x] = (double)rowProbability * pixelProbability;
+    }
+
+    // Pixels that come up at all must have been expected to, and within a few standard deviations as often.
+    for (size_t i = 0; i < histogram.size(); ++i) {
+        if (histogram[i] == 0) {
+            continue;
+        }
+
+        const double expected = probabilities[i] * sampleCount;
+        CHECK(probabilities[i] > 0.0);
+        CHECK(fabs(histogram[i] - expected) <= 5.0 * sqrt(expected) + 1.0);
+    }
+}
+
+static std::vector<float> getTestMap(uint32_t width, uint32_t height) {
+    std::vector<float> pixels(4 * (size_t)width * height);
+    uint32_t state = 12345;
+
+    for (float& value : pixels) {
+        value = nextUniform(state) * nextUniform(state) * 4.0f;
+    }
+
+    return pixels;
+}
+
+int main() {
+    JobSystem jobSystem;
+
+    const uint32_t width = 64;
+    const uint32_t height = 32;
+    std::vector<float> pixels = getTestMap(width, height);
+
+    // A sun, and a black row.
+    pixels[4 * (width * 10 + 7) + 0] = 5000.0f;
+    pixels[4 * (width * 10 + 7) + 1] = 4000.0f;
+
+    for (uint32_t x = 0; x < width; ++x) {
+        for (uint32_t c = 0; c < 4; ++c) {
+            pixels[4 * (width * 5 + x) + c] = 0.0f;
+        }
+    }
+
+    EnvironmentDistribution distribution;
+    distribution.build(jobSystem, pixels.data(), width, height);
+    CHECK(distribution.builtRowCount == height);
+    checkDistribution(distribution, pixels, width, height);
+    checkSampling(distribution, 1 << 21);
+
+    // Rows that are the same as in the last build keep their tables, the rest are rebuilt.
+    distribution.build(jobSystem, pixels.data(), width, height);
+    CHECK(distribution.builtRowCount == 0);
+    checkDistribution(distribution, pixels, width, height);
+
+    pixels[4 * (width * 20 + 3)] += 10.0f;
+    pixels[4 * (width * 31 + 63) + 2] = 0.0f;
+    distribution.build(jobSystem, pixels.data(), width, height);
+    CHECK(distribution.builtRowCount == 2);
+    checkDistribution(distribution, pixels, width, height);
+
+    // A map of another size is built from scratch.
+    std::vector<float> smallPixels = getTestMap(8, 4);
+    distribution.build(jobSystem, smallPixels.data(), 8, 4);
+    CHECK(distribution.builtRowCount == 4);
+    checkDistribution(distribution, smallPixels, 8, 4);
+    checkSampling(distribution, 1 << 18);
+
+    // A single lit pixel takes every sample.
+    std::vector<float> singlePixel(4 * 16 * 8, 0.0f);
+    singlePixel[4 * (16 * 3 + 9) + 1] = 1.0f;
+    distribution.build(jobSystem, singlePixel.data(), 16, 8);
+    checkDistribution(distribution, singlePixel, 16, 8);
+    CHECK(distribution.entries[3].probability == 1.0f);
+    CHECK(distribution.entries[8 + 16 * 3 + 9].probability == 1.0f);
+
+    // A black map is sampled uniformly.
+    std::vector<float> black(4 * 16 * 8, 0.0f);
+    distribution.build(jobSystem, black.data(), 16, 8);
+    checkDistribution(distribution, black, 16, 8);
+
+    // So is a map of a single pixel.
+    const float onePixel[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    distribution.build(jobSystem, onePixel, 1, 1);
+    checkDistribution(distribution, std::vector<float>(onePixel, onePixel + 4), 1, 1);
+
+    return finishTest();
+}
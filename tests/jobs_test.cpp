@@ -0,0 +1,186 @@
+#include <string>
+#include <thread>
+
+#include <jobs.h>
+
+#include "test.h"
+
+// Waiting never picks up a job of another counter, however long it has been queued.
+static void testWaitLeavesOtherJobs() {
+    JobSystem jobSystem(1);
+
+    // Keep the only worker busy until the waits below are done.
+    std::atomic<bool> started = false;
+    std::atomic<bool> released = false;
+    JobCounter blockerCounter = 0;
+
+    jobSystem.submit([&]() {
+        started = true;
+
+        while (!released.load()) {
+            std::this_thread::yield();
+        }
+    }, &blockerCounter);
+
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+
+    // Queued ahead of the caller's own jobs, with a counter and without.
+    std::atomic<uint32_t> otherJobCount = 0;
+    JobCounter otherCounter = 0;
+
+    jobSystem.submit([&]() {
+        ++otherJobCount;
+    }, &otherCounter);
+
+    jobSystem.submit([&]() {
+        ++otherJobCount;
+    });
+
+    // The caller runs its own jobs, and parallelFor's ranges, itself.
+    JobCounter counter = 0;
+    std::atomic<uint32_t> ownJobCount = 0;
+
+    for (uint32_t i = 0; i < 8; ++i) {
+        jobSystem.submit([&]() {
+            ++ownJobCount;
+        }, &counter);
+    }
+
+    jobSystem.wait(counter);
+    CHECK(ownJobCount == 8);
+
+    std::atomic<uint32_t> sum = 0;
+
+    jobSystem.parallelFor(100, 10, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; ++i) {
+            sum += i;
+        }
+    });
+
+    CHECK(sum == 4950);
+    CHECK(otherJobCount == 0);
+
+    // Once the worker is free again it gets to them.
+    released = true;
+    jobSystem.wait(blockerCounter);
+    jobSystem.wait(otherCounter);
+
+    while (otherJobCount.load() != 2) {
+        std::this_thread::yield();
+    }
+}
+
+// Background jobs run after every other queued job, and the jobs they submit are background jobs as well.
+static void testBackgroundJobs() {
+    JobSystem jobSystem(1);
+
+    std::atomic<bool> started = false;
+    std::atomic<bool> released = false;
+    JobCounter counter = 0;
+
+    jobSystem.submit([&]() {
+        started = true;
+
+        while (!released.load()) {
+            std::this_thread::yield();
+        }
+    }, &counter);
+
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+
+    // The worker is busy, so the order the jobs run in is only up to their priorities.
+    std::mutex orderMutex;
+    std::string order;
+
+    auto record = [&](char name) {
+        std::lock_guard<std::mutex> lock(orderMutex);
+        order += name;
+    };
+
+    std::atomic<bool> nestedSubmitted = false;
+    std::atomic<bool> normalSubmitted = false;
+
+    jobSystem.submitBackground([&]() {
+        record('B');
+
+        // Submitted ahead of N, but still runs after it.
+        jobSystem.submit([&]() {
+            record('C');
+        }, &counter);
+
+        nestedSubmitted = true;
+
+        while (!normalSubmitted.load()) {
+            std::this_thread::yield();
+        }
+    }, &counter);
+
+    jobSystem.submit([&]() {
+        record('A');
+    }, &counter);
+
+    released = true;
+
+    while (!nestedSubmitted.load()) {
+        std::this_thread::yield();
+    }
+
+    jobSystem.submit([&]() {
+        record('N');
+    }, &counter);
+
+    normalSubmitted = true;
+
+    // Waiting would run the remaining jobs here, out of order.
+    while (true) {
+        std::lock_guard<std::mutex> lock(orderMutex);
+
+        if (order.size() == 4) {
+            break;
+        }
+    }
+
+    jobSystem.wait(counter);
+    CHECK(order == "ABNC");
+}
+
+// Jobs that wait on jobs of their own, on every thread at once, still finish.
+static void testNestedWaits() {
+    JobSystem jobSystem(3);
+    JobCounter counter = 0;
+    std::atomic<uint32_t> leafCount = 0;
+
+    for (uint32_t i = 0; i < 16; ++i) {
+        jobSystem.submit([&]() {
+            JobCounter innerCounter = 0;
+
+            for (uint32_t j = 0; j < 16; ++j) {
+                jobSystem.submit([&]() {
+                    jobSystem.parallelFor(64, 4, [&](uint32_t begin, uint32_t end) {
+                        leafCount += end - begin;
+                    });
+                }, &innerCounter);
+            }
+
+            jobSystem.wait(innerCounter);
+        }, &counter);
+    }
+
+    jobSystem.wait(counter);
+    CHECK(leafCount == 16 * 16 * 64);
+}
+
+int main() {
+    testWaitLeavesOtherJobs();
+    testBackgroundJobs();
+
+    for (uint32_t i = 0; i < 20; ++i) {
+        testNestedWaits();
+    }
+
+    return finishTest();
+}
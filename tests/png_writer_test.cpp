@@ -0,0 +1,223 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <vector>
+
+#include <stb_image.h>
+
+#include <png_writer.h>
+
+#include "test.h"
+
+static uint32_t readBigEndian(const uint8_t* data) {
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+static uint32_t computeCrc(const uint8_t* data, size_t size) {
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (size_t i = 0; i < size; ++i) {
+        crc ^= data[i];
+
+        for (uint32_t j = 0; j < 8; ++j) {
+            crc = crc & 1 ? 0xEDB88320 ^ (crc >> 1) : crc >> 1;
+        }
+    }
+
+    return crc ^ 0xFFFFFFFF;
+}
+
+static uint32_t computeAdler(const uint8_t* data, size_t size) {
+    uint32_t a = 1;
+    uint32_t b = 0;
+
+    for (size_t i = 0; i < size; ++i) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+
+    return (b << 16) | a;
+}
+
+static uint8_t predictPaeth(uint8_t left, uint8_t up, uint8_t upLeft) {
+    const int estimate = left + up - upLeft;
+    const int leftDistance = abs(estimate - left);
+    const int upDistance = abs(estimate - up);
+    const int upLeftDistance = abs(estimate - upLeft);
+
+    if (leftDistance <= upDistance && leftDistance <= upLeftDistance) {
+        return left;
+    }
+
+    return upDistance <= upLeftDistance ? up : upLeft;
+}
+
+// Decodes the PNG without stb_image's own checks getting in the way: every chunk's CRC and the Adler-32 of the whole
+// deflate stream, which the encoder combines from its strips, are checked, and the rows are unfiltered here.
+static bool decodePng(const std::vector<uint8_t>& png, uint32_t width, uint32_t height, uint32_t channelCount, std::vector<uint8_t>& pixels) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+    if (png.size() < sizeof(signature) || memcmp(png.data(), signature, sizeof(signature)) != 0) {
+        return false;
+    }
+
+    std::vector<uint8_t> compressed;
+    bool ended = false;
+    bool headerRead = false;
+
+    for (size_t offset = sizeof(signature); offset < png.size();) {
+        if (ended || png.size() - offset < 12) {
+            return false;
+        }
+
+        const uint32_t length = readBigEndian(&png[offset]);
+        const uint8_t* type = &png[offset + 4];
+        const uint8_t* data = &png[offset + 8];
+
+        if (length > png.size() - offset - 12) {
+            return false;
+        }
+
+        CHECK(computeCrc(type, length + 4) == readBigEndian(data + length));
+
+        if (memcmp(type, "IHDR", 4) == 0) {
+            const uint8_t colorType = channelCount == 4 ? 6 : 2;
+
+            if (headerRead || length != 13 || readBigEndian(data) != width || readBigEndian(data + 4) != height || data[8] != 8 ||
+                data[9] != colorType || data[10] != 0 || data[11] != 0 || data[12] != 0) {
+                return false;
+            }
+
+            headerRead = true;
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            compressed.insert(compressed.end(), data, data + length);
+        } else if (memcmp(type, "IEND", 4) == 0) {
+            ended = true;
+        }
+
+        offset += length + 12;
+    }
+
+    if (!headerRead || !ended || compressed.size() < 6) {
+        return false;
+    }
+
+    int filteredSize;
+    uint8_t* filtered = (uint8_t*)stbi_zlib_decode_malloc((const char*)compressed.data(), (int)compressed.size(), &filteredSize);
+
+    if (filtered == nullptr) {
+        return false;
+    }
+
+    const size_t rowSize = (size_t)width * channelCount;
+    bool valid = (size_t)filteredSize == (rowSize + 1) * height && computeAdler(filtered, filteredSize) == readBigEndian(&compressed[compressed.size() - 4]);
+
+    pixels.assign(rowSize * height, 0);
+
+    for (uint32_t y = 0; valid && y < height; ++y) {
+        const uint8_t filter = filtered[y * (rowSize + 1)];
+        const uint8_t* source = &filtered[y * (rowSize + 1) + 1];
+        uint8_t* row = &pixels[y * rowSize];
+        const uint8_t* previousRow = y > 0 ? row - rowSize : nullptr;
+
+        for (size_t x = 0; x < rowSize; ++x) {
+            const uint8_t left = x >= channelCount ? row[x - channelCount] : 0;
+            const uint8_t up = previousRow != nullptr ? previousRow[x] : 0;
+            const uint8_t upLeft = previousRow != nullptr && x >= channelCount ? previousRow[x - channelCount] : 0;
+
+            switch (filter) {
+                case 0: row[x] = source[x];                                       break;
+                case 1: row[x] = source[x] + left;                                break;
+                case 2: row[x] = source[x] + up;                                  break;
+                case 3: row[x] = source[x] + (uint8_t)((left + up) / 2);          break;
+                case 4: row[x] = source[x] + predictPaeth(left, up, upLeft);      break;
+                default: valid = false;                                           break;
+            }
+        }
+    }
+
+    free(filtered);
+
+    return valid;
+}
+
+static void testImage(JobSystem& jobSystem, const char* name, uint32_t width, uint32_t height, uint32_t channelCount, const std::vector<uint8_t>& pixels) {
+    const std::vector<uint8_t> png = encodePng(jobSystem, width, height, channelCount, pixels.data());
+
+    std::vector<uint8_t> decoded;
+    const bool valid = decodePng(png, width, height, channelCount, decoded);
+
+    if (!valid || decoded != pixels) {
+        fprintf(stderr, "%s, %ux%u with %u channels:\n", name, width, height, channelCount);
+    }
+
+    CHECK(valid);
+    CHECK(decoded == pixels);
+
+    // stb_image reads it back the same.
+    int decodedWidth, decodedHeight, decodedChannelCount;
+    stbi_uc* stbPixels = stbi_load_from_memory(png.data(), (int)png.size(), &decodedWidth, &decodedHeight, &decodedChannelCount, (int)channelCount);
+
+    CHECK(stbPixels != nullptr);
+
+    if (stbPixels != nullptr) {
+        CHECK((uint32_t)decodedWidth == width && (uint32_t)decodedHeight == height && (uint32_t)decodedChannelCount == channelCount);
+        CHECK(memcmp(stbPixels, pixels.data(), pixels.size()) == 0);
+        stbi_image_free(stbPixels);
+    }
+}
+
+// Smooth gradients with a little noise, like a render, which every filter has something to gain on.
+static std::vector<uint8_t> getGradient(uint32_t width, uint32_t height, uint32_t channelCount) {
+    std::vector<uint8_t> pixels((size_t)width * height * channelCount);
+    uint32_t seed = 1;
+
+    for (size_t i = 0; i < pixels.size(); ++i) {
+        const size_t pixel = i / channelCount;
+        const uint32_t x = (uint32_t)(pixel % width);
+        const uint32_t y = (uint32_t)(pixel / width);
+
+        seed = seed * 1664525 + 1013904223;
+        pixels[i] = (uint8_t)((x * 3 + y * 5 + (uint32_t)(i % channelCount) * 40 + (seed >> 29)) & 0xFF);
+    }
+
+    return pixels;
+}
+
+static std::vector<uint8_t> getNoise(uint32_t width, uint32_t height, uint32_t channelCount) {
+    std::vector<uint8_t> pixels((size_t)width * height * channelCount);
+    uint32_t seed = 7;
+
+    for (uint8_t& value : pixels) {
+        seed = seed * 1664525 + 1013904223;
+        value = (uint8_t)(seed >> 24);
+    }
+
+    return pixels;
+}
+
+int main() {
+    JobSystem jobSystem;
+
+    for (uint32_t channelCount = 3; channelCount <= 4; ++channelCount) {
+        // Images smaller than a filter's reach, and rows of a single pixel.
+        testImage(jobSystem, "single pixel", 1, 1, channelCount, getNoise(1, 1, channelCount));
+        testImage(jobSystem, "odd size", 3, 5, channelCount, getGradient(3, 5, channelCount));
+        testImage(jobSystem, "single row", 17, 1, channelCount, getNoise(17, 1, channelCount));
+        testImage(jobSystem, "single column", 1, 300, channelCount, getGradient(1, 300, channelCount));
+
+        // Many strips, whose deflate streams and checksums are joined, and whose matches reach into the strip before.
+        testImage(jobSystem, "gradient", 640, 480, channelCount, getGradient(640, 480, channelCount));
+        testImage(jobSystem, "noise", 640, 480, channelCount, getNoise(640, 480, channelCount));
+        testImage(jobSystem, "solid", 640, 480, channelCount, std::vector<uint8_t>(640 * 480 * channelCount, 200));
+
+        // Rows longer than a strip, so that every strip holds a single row.
+        testImage(jobSystem, "wide", 70000, 3, channelCount, getGradient(70000, 3, channelCount));
+    }
+
+    // Solid images are runs of matches, even across strips.
+    const std::vector<uint8_t> solid(1024 * 1024 * 4, 17);
+    CHECK(encodePng(jobSystem, 1024, 1024, 4, solid.data()).size() < solid.size() / 100);
+
+    return finishTest();
+}
@@ -0,0 +1,375 @@
+#include <string.h>
+
+#include <vector>
+
+#include <cooked_asset.h>
+#include <hash.h>
+#include <project.h>
+
+#include "test.h"
+
+struct TestChunk {
+    uint32_t type;
+    uint32_t version;
+    std::vector<uint8_t> data;
+};
+
+// Lays out a project file the way Project::save does, so that single fields can be damaged afterwards.
+static std::vector<uint8_t> layOutProjectFile(const std::vector<TestChunk>& chunks) {
+    std::vector<ProjectChunk> table;
+    uint64_t offset = sizeof(ProjectFileHeader) + chunks.size() * sizeof(ProjectChunk);
+
+    for (const TestChunk& chunk : chunks) {
+        offset = (offset + PROJECT_FILE_ALIGNMENT - 1) & ~(uint64_t)(PROJECT_FILE_ALIGNMENT - 1);
+        table.push_back({ chunk.type, chunk.version, offset, chunk.data.size(), hashData(chunk.data.data(), chunk.data.size()) });
+        offset += chunk.data.size();
+    }
+
+    const ProjectFileHeader header = {
+        .magic      = PROJECT_FILE_MAGIC,
+        .version    = PROJECT_FILE_VERSION,
+        .fileSize   = offset,
+        .chunkCount = (uint32_t)chunks.size(),
+        .padding    = 0
+    };
+
+    std::vector<uint8_t> file(offset);
+    memcpy(file.data(), &header, sizeof(header));
+    memcpy(file.data() + sizeof(header), table.data(), table.size() * sizeof(ProjectChunk));
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        if (!chunks[i].data.empty()) {
+            memcpy(file.data() + table[i].offset, chunks[i].data.data(), chunks[i].data.size());
+        }
+    }
+
+    return file;
+}
+
+static void writeProjectFile(const std::filesystem::path& projectPath, const std::vector<uint8_t>& data) {
+    FILE* file = fopen((projectPath / PROJECT_FILE_NAME).string().c_str(), "wb");
+
+    if (!data.empty()) {
+        fwrite(data.data(), 1, data.size(), file);
+    }
+
+    fclose(file);
+}
+
+static std::vector<uint8_t> readProjectFile(const std::filesystem::path& projectPath) {
+    std::vector<uint8_t> data;
+    FILE* file = fopen((projectPath / PROJECT_FILE_NAME).string().c_str(), "rb");
+
+    if (file != nullptr) {
+        fseek(file, 0, SEEK_END);
+        data.resize(ftell(file));
+        fseek(file, 0, SEEK_SET);
+        data.resize(fread(data.data(), 1, data.size(), file));
+        fclose(file);
+    }
+
+    return data;
+}
+
+// The settings chunk holds the mip filter and the compression quality.
+static TestChunk getSettingsChunk(MipFilter mipFilter, BlockCompressionQuality quality) {
+    const uint32_t settings[] = { (uint32_t)mipFilter, (uint32_t)quality };
+
+    TestChunk chunk = { PROJECT_CHUNK_SETTINGS, 1, std::vector<uint8_t>(sizeof(settings)) };
+    memcpy(chunk.data.data(), settings, sizeof(settings));
+
+    return chunk;
+}
+
+static void testRoundTrip(const std::filesystem::path& directory) {
+    const std::filesystem::path projectPath = directory / "RoundTrip";
+    const std::filesystem::path imagePath = projectPath / "Assets" / "Images" / "brick.png";
+    const std::filesystem::path scenePath = directory / "Sources" / "sponza.gltf";
+    const std::filesystem::path otherScenePath = directory / "Sources" / "bistro.glb";
+
+    AssetGuid imageGuid, sceneGuid, otherSceneGuid;
+
+    {
+        Project project(projectPath);
+        CHECK(!project.hasUnsavedChanges());
+
+        imageGuid = project.getAssetGuid(imagePath, ASSET_TYPE_IMAGE);
+        sceneGuid = project.getAssetGuid(scenePath, ASSET_TYPE_SCENE);
+        otherSceneGuid = project.getAssetGuid(otherScenePath, ASSET_TYPE_SCENE);
+        CHECK(!(imageGuid == sceneGuid) && !(sceneGuid == otherSceneGuid));
+
+        // Registering an asset again hands out the same GUID.
+        CHECK(project.getAssetGuid(imagePath, ASSET_TYPE_IMAGE) == imageGuid);
+
+        project.addToScene(otherSceneGuid);
+        project.addToScene(sceneGuid);
+        project.addToScene(otherSceneGuid);
+
+        project.textureImportSettings = { MIP_FILTER_BOX, BLOCK_COMPRESSION_QUALITY_HIGH };
+        project.markSettingsChanged();
+
+        CHECK(project.hasUnsavedChanges());
+        CHECK(project.save());
+        CHECK(!project.hasUnsavedChanges());
+        project.close();
+    }
+
+    Project project;
+    CHECK(project.open(projectPath));
+    CHECK(project.textureImportSettings.mipFilter == MIP_FILTER_BOX);
+    CHECK(project.textureImportSettings.quality == BLOCK_COMPRESSION_QUALITY_HIGH);
+
+    const std::vector<AssetGuid>& scene = project.getScene();
+    CHECK(scene.size() == 3);
+
+    if (scene.size() == 3) {
+        CHECK(scene[0] == otherSceneGuid && scene[1] == sceneGuid && scene[2] == otherSceneGuid);
+    }
+
+    // Assets inside the project are stored relative to it, the rest by their absolute path.
+    const ProjectAsset* image = project.findAsset(imageGuid);
+    CHECK(image != nullptr);
+
+    if (image != nullptr) {
+        CHECK(image->type == ASSET_TYPE_IMAGE);
+        CHECK(image->path == "Images/brick.png");
+        CHECK(project.getAssetPath(*image).lexically_normal() == imagePath.lexically_normal());
+    }
+
+    const ProjectAsset* sceneAsset = project.findAsset(sceneGuid);
+    CHECK(sceneAsset != nullptr);
+
+    if (sceneAsset != nullptr) {
+        CHECK(sceneAsset->type == ASSET_TYPE_SCENE);
+        CHECK(project.getAssetPath(*sceneAsset) == std::filesystem::absolute(scenePath).lexically_normal());
+    }
+
+    CHECK(project.getAssetGuid(scenePath, ASSET_TYPE_SCENE) == sceneGuid);
+    CHECK(!project.hasUnsavedChanges());
+
+    // Saving only the scene keeps the assets chunk that was never loaded again.
+    project.close();
+    CHECK(project.open(projectPath));
+    project.addToScene(imageGuid);
+    CHECK(project.save());
+    project.close();
+
+    CHECK(project.open(projectPath));
+    CHECK(project.getScene().size() == 4);
+    CHECK(project.findAsset(otherSceneGuid) != nullptr);
+    project.close();
+}
+
+static void testUnknownChunks(const std::filesystem::path& directory) {
+    const std::filesystem::path projectPath = directory / "UnknownChunks";
+    std::filesystem::create_directories(projectPath);
+
+    TestChunk unknownChunk = { 0x54534554, 3, {} }; // "TEST"
+
+    for (uint32_t i = 0; i < 100; ++i) {
+        unknownChunk.data.push_back((uint8_t)(i * 7));
+    }
+
+    writeProjectFile(projectPath, layOutProjectFile({ unknownChunk, getSettingsChunk(MIP_FILTER_BOX, BLOCK_COMPRESSION_QUALITY_FAST) }));
+
+    Project project;
+    CHECK(project.open(projectPath));
+    CHECK(project.textureImportSettings.mipFilter == MIP_FILTER_BOX);
+    CHECK(project.textureImportSettings.quality == BLOCK_COMPRESSION_QUALITY_FAST);
+
+    project.textureImportSettings.quality = BLOCK_COMPRESSION_QUALITY_HIGH;
+    project.markSettingsChanged();
+    CHECK(project.save());
+    project.close();
+
+    // The chunk this version doesn't know is still there, first and unchanged.
+    std::vector<uint8_t> file = readProjectFile(projectPath);
+    CHECK(file.size() >= sizeof(ProjectFileHeader) + sizeof(ProjectChunk));
+
+    if (file.size() >= sizeof(ProjectFileHeader) + sizeof(ProjectChunk)) {
+        const ProjectChunk& chunk = *(const ProjectChunk*)(file.data() + sizeof(ProjectFileHeader));
+
+        CHECK(chunk.type == unknownChunk.type && chunk.version == unknownChunk.version && chunk.size == unknownChunk.data.size());
+        CHECK(chunk.offset % PROJECT_FILE_ALIGNMENT == 0 && chunk.offset + chunk.size <= file.size());
+
+        if (chunk.offset + chunk.size <= file.size()) {
+            CHECK(memcmp(file.data() + chunk.offset, unknownChunk.data.data(), unknownChunk.data.size()) == 0);
+        }
+    }
+
+    CHECK(project.open(projectPath));
+    CHECK(project.textureImportSettings.quality == BLOCK_COMPRESSION_QUALITY_HIGH);
+    project.close();
+}
+
+static void testDamagedChunks(const std::filesystem::path& directory) {
+    const std::filesystem::path projectPath = directory / "DamagedChunks";
+    std::filesystem::create_directories(projectPath);
+
+    const TestChunk settingsChunk = getSettingsChunk(MIP_FILTER_BOX, BLOCK_COMPRESSION_QUALITY_HIGH);
+    Project project;
+
+    // A chunk whose data doesn't match its hash reads as empty, the project still opens.
+    std::vector<uint8_t> file = layOutProjectFile({ settingsChunk });
+    const ProjectChunk& chunk = *(const ProjectChunk*)(file.data() + sizeof(ProjectFileHeader));
+    file[chunk.offset] ^= 1;
+    writeProjectFile(projectPath, file);
+
+    CHECK(project.open(projectPath));
+    CHECK(project.textureImportSettings.mipFilter == MIP_FILTER_KAISER);
+    CHECK(project.textureImportSettings.quality == BLOCK_COMPRESSION_QUALITY_NORMAL);
+    project.close();
+
+    // So does a chunk from another version.
+    TestChunk newerChunk = settingsChunk;
+    newerChunk.version = 2;
+    writeProjectFile(projectPath, layOutProjectFile({ newerChunk }));
+
+    CHECK(project.open(projectPath));
+    CHECK(project.textureImportSettings.quality == BLOCK_COMPRESSION_QUALITY_NORMAL);
+    project.close();
+
+    // A chunk too small for its records is ignored too.
+    TestChunk shortChunk = settingsChunk;
+    shortChunk.data.resize(4);
+    writeProjectFile(projectPath, layOutProjectFile({ shortChunk }));
+
+    CHECK(project.open(projectPath));
+    CHECK(project.textureImportSettings.quality == BLOCK_COMPRESSION_QUALITY_NORMAL);
+    project.close();
+
+    // An assets chunk that claims more records than it holds loads nothing.
+    TestChunk assetsChunk = { PROJECT_CHUNK_ASSETS, 1, std::vector<uint8_t>(sizeof(uint64_t)) };
+    const uint64_t assetCount = 1000000;
+    memcpy(assetsChunk.data.data(), &assetCount, sizeof(assetCount));
+    writeProjectFile(projectPath, layOutProjectFile({ assetsChunk }));
+
+    CHECK(project.open(projectPath));
+    CHECK(project.findAsset({ 0, 0 }) == nullptr);
+    CHECK(!project.hasUnsavedChanges());
+    project.close();
+}
+
+static void testTableOfContents(const std::filesystem::path& directory) {
+    const std::filesystem::path projectPath = directory / "TableOfContents";
+    std::filesystem::create_directories(projectPath);
+
+    const std::vector<uint8_t> validFile = layOutProjectFile({ getSettingsChunk(MIP_FILTER_BOX, BLOCK_COMPRESSION_QUALITY_HIGH), { PROJECT_CHUNK_SCENE, 1, {} } });
+    Project project;
+
+    writeProjectFile(projectPath, validFile);
+    CHECK(project.open(projectPath));
+    CHECK(project.getScene().empty());
+    project.close();
+
+    auto opens = [&](const std::vector<uint8_t>& file) {
+        writeProjectFile(projectPath, file);
+
+        const bool opened = project.open(projectPath);
+        project.close();
+
+        return opened;
+    };
+
+    auto getHeader = [](std::vector<uint8_t>& file) -> ProjectFileHeader& {
+        return *(ProjectFileHeader*)file.data();
+    };
+
+    auto getChunk = [](std::vector<uint8_t>& file, uint32_t index) -> ProjectChunk& {
+        return ((ProjectChunk*)(file.data() + sizeof(ProjectFileHeader)))[index];
+    };
+
+    std::vector<uint8_t> file;
+
+    // Files that are missing, empty or truncated.
+    std::filesystem::remove(projectPath / PROJECT_FILE_NAME);
+    CHECK(!project.open(projectPath));
+    project.close();
+
+    CHECK(!opens({}));
+    CHECK(!opens(std::vector<uint8_t>(validFile.begin(), validFile.begin() + sizeof(ProjectFileHeader) - 1)));
+    CHECK(!opens(std::vector<uint8_t>(validFile.begin(), validFile.end() - 1)));
+
+    file = validFile;
+    getHeader(file).magic = 0;
+    CHECK(!opens(file));
+
+    file = validFile;
+    getHeader(file).version = PROJECT_FILE_VERSION + 1;
+    CHECK(!opens(file));
+
+    file = validFile;
+    getHeader(file).fileSize += PROJECT_FILE_ALIGNMENT;
+    CHECK(!opens(file));
+
+    // A table of contents that runs past the end of the file.
+    file = validFile;
+    getHeader(file).chunkCount = (uint32_t)((file.size() - sizeof(ProjectFileHeader)) / sizeof(ProjectChunk) + 1);
+    CHECK(!opens(file));
+
+    file = validFile;
+    getHeader(file).chunkCount = UINT32_MAX;
+    CHECK(!opens(file));
+
+    // Chunks that aren't aligned or don't fit in the file.
+    file = validFile;
+    getChunk(file, 0).offset += 4;
+    CHECK(!opens(file));
+
+    file = validFile;
+    getChunk(file, 0).offset = file.size() + PROJECT_FILE_ALIGNMENT;
+    CHECK(!opens(file));
+
+    file = validFile;
+    getChunk(file, 1).size = 1;
+    CHECK(!opens(file));
+
+    file = validFile;
+    getChunk(file, 0).size = UINT64_MAX;
+    CHECK(!opens(file));
+
+    // A chunk may end exactly at the end of the file.
+    file = validFile;
+    getChunk(file, 1).offset = file.size() - file.size() % PROJECT_FILE_ALIGNMENT;
+    getChunk(file, 1).size = file.size() - getChunk(file, 1).offset;
+    CHECK(opens(file));
+}
+
+static void testCookedAssetPaths(const std::filesystem::path& directory) {
+    const std::filesystem::path projectPath = directory / "CookedPaths";
+    const std::filesystem::path movedProjectPath = directory / "Moved" / "CookedPaths";
+
+    const std::filesystem::path firstPath = getCookedAssetPath(projectPath, projectPath / "Assets" / "Kitchen" / "scene.gltf");
+    const std::filesystem::path secondPath = getCookedAssetPath(projectPath, projectPath / "Assets" / "Garden" / "scene.gltf");
+
+    // Sources of the same name in different directories are cooked to different files, named after the source.
+    CHECK(firstPath != secondPath);
+    CHECK(firstPath.parent_path() == projectPath / "Cooked");
+    CHECK(firstPath.extension() == COOKED_ASSET_EXTENSION);
+    CHECK(firstPath.filename().string().rfind("scene-", 0) == 0);
+
+    // The key is the normalized path relative to the project, so it survives moving the project.
+    CHECK(getCookedAssetPath(projectPath, projectPath / "Assets" / "Kitchen" / "." / "scene.gltf") == firstPath);
+    CHECK(getCookedAssetPath(projectPath, projectPath / "Assets" / "Garden" / ".." / "Kitchen" / "scene.gltf") == firstPath);
+    CHECK(getCookedAssetPath(movedProjectPath, movedProjectPath / "Assets" / "Kitchen" / "scene.gltf").filename() == firstPath.filename());
+
+    // Sources outside the project are keyed by their absolute path.
+    const std::filesystem::path outsidePath = getCookedAssetPath(projectPath, directory / "Sources" / "scene.gltf");
+    CHECK(outsidePath != firstPath && outsidePath != secondPath);
+    CHECK(getCookedAssetPath(movedProjectPath, directory / "Sources" / "scene.gltf").filename() == outsidePath.filename());
+}
+
+int main() {
+    const std::filesystem::path directory = createTestDirectory("vortex_project_test");
+
+    testRoundTrip(directory);
+    testUnknownChunks(directory);
+    testDamagedChunks(directory);
+    testTableOfContents(directory);
+    testCookedAssetPaths(directory);
+
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+
+    return finishTest();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdio.h>
+
+#include <filesystem>
+
+// Tests are plain executables that exit with a failure if any check failed, so that CTest can run them without a
+// framework. A failed check is reported and the test carries on, so one run shows every check that fails.
+inline int failedCheckCount = 0;
+
+#define CHECK(condition)                                                                   \
+    do {                                                                                   \
+        if (!(condition)) {                                                                \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++failedCheckCount;                                                            \
+        }                                                                                  \
+    } while (0)
+
+// An empty directory of the test's own in the temporary directory.
+inline std::filesystem::path createTestDirectory(const char* name) {
+    std::filesystem::path path = std::filesystem::temp_directory_path() / name;
+
+    std::error_code error;
+    std::filesystem::remove_all(path, error);
+    std::filesystem::create_directories(path, error);
+
+    return path;
+}
+
+inline int finishTest() {
+    if (failedCheckCount > 0) {
+        fprintf(stderr, "%d checks failed\n", failedCheckCount);
+        return 1;
+    }
+
+    return 0;
+}